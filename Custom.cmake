@@ -24,6 +24,7 @@ set(CUSTOM_SVG_ICON_FILE "${CMAKE_SOURCE_DIR}/icons/icon.svg")
 # Список компонентов проекта с путями, которые включаются как поддиректории
 set(PROJECT_MODULES_LIST
   "stl2step"
+  "stl2step_bench"
 )
 
 # Путь к директории с изображениями для Doxygen
@@ -58,6 +59,17 @@ set(CUSTOM_PVS_ARGS -d V122,V2014)
 # Аргументы и комментарии тестов
 ##############################################################################
 
+  # Файл задания для теста пакетного режима (результаты записываются в каталог результатов тестов)
+  if(DEFINED TEST_RESULTS)
+    file(WRITE "${TEST_RESULTS}/Batch.txt"
+      "# Задания теста пакетного режима\n"
+      "--ocn --stl ../tests/blue.stl --out ${TEST_RESULTS}/Batch_blue.step\n"
+      "--color 1 0 0 \\\n"
+      "  --stl ../tests/metals_l.obj --out ${TEST_RESULTS}/Batch_metals.step\n"
+      "--stl ../tests/plastic.stl --out ${TEST_RESULTS}/Batch_plastic.step\n"
+    )
+  endif()
+
   # Список комментариев и аргументов
   set(TEST_ARGUMENTS_LIST
     "Запуск без параметров - вывод справки"
@@ -72,4 +84,40 @@ set(CUSTOM_PVS_ARGS -d V122,V2014)
     "--d3 --ocn --stl ../tests/blue.stl --out ${TEST_RESULTS}/Blue.step"
     "Тест (с отладочными сообщениями) с выпукло-вогнутой поверхностью"
     "--d3 --ocn --stl ../tests/bad_blue.stl --out ${TEST_RESULTS}/Bad_blue.step"
+    "Тест с созданием промежуточных объектов для граней (без непосредственного вывода в текст STEP)"
+    "--obn --ocn --stl ../tests/blue.stl --out ${TEST_RESULTS}/Blue_obn.step"
+    "Тест с сохранением всех объектов в памяти до записи файла STEP (без промежуточного вывода)"
+    "--oin --copy 0.65 0 0 --stl ../tests/metals_l.stl --stl ../tests/plastic.stl --out ${TEST_RESULTS}/Metals_oin.step"
+    "Тест с параллельной записью файла STEP в четыре потока"
+    "--threads 4 --obn --oin --ocn --stl ../tests/bad_blue2.stl --out ${TEST_RESULTS}/Bad_blue2_threads.step"
+    "Тест с синхронной записью файла STEP без фонового потока"
+    "--oan --threads 1 --stl ../tests/label.stl --out ${TEST_RESULTS}/Label_oan.step"
+    "Тест с записью файла STEP в сжатом виде (gzip)"
+    "--ocn --stl ../tests/blue.stl --out ${TEST_RESULTS}/Blue.stp.gz"
+    "Тест с разбором файла STL с дублирующимся треугольником шестнадцатью частями параллельно (повтор не в первой части: номера строк #240 и #247 в предупреждении пересчитываются от начала файла)"
+    "--threads 16 0 --ocn --stl ../tests/blue.stl --out ${TEST_RESULTS}/Blue_threads.step"
+    "Тест с чтением сжатого файла STL (gzip)"
+    "--stl ../tests/metals_l.stl.gz --out ${TEST_RESULTS}/Metals_l_gz.step"
+    "Тест с чтением файлов STL из архива zip"
+    "--copy 0.65 0 0 --stl ../tests/metals.zip --name high pin --stl ../tests/metals.zip/metals?h.stl --out ${TEST_RESULTS}/Metals_zip.step"
+    "Тест с чтением индексированных сеток из файлов OBJ и PLY"
+    "--copy 0.65 0 0 --stl ../tests/metals_l.obj --color 0.3 0.3 0.3 --stl ../tests/metals_l.ply --out ${TEST_RESULTS}/Metals_mesh.step"
+    "Тест (с отладочными сообщениями) с нулевыми нормалями и вырожденным треугольником в файле STL"
+    "--d2 --stl ../tests/metals_l_bad_normals.stl --out ${TEST_RESULTS}/Metals_bad_normals.step"
+    "Тест с проверкой плоскостности объединяемых граней"
+    "--opy --stl ../tests/blue.stl --out ${TEST_RESULTS}/Blue_plane.step"
+    "Тест с профилированием и записью трассировки этапов обработки"
+    "--dp --trace ${TEST_RESULTS}/Trace.json --stl ../tests/blue.stl --stl ../tests/metals_l.obj --out ${TEST_RESULTS}/Trace.step"
+    "Тест с записью показателей обработки"
+    "--metrics ${TEST_RESULTS}/Metrics.json --stl ../tests/blue.stl --copy 10 0 0 --stl ../tests/metals_l.obj --out ${TEST_RESULTS}/Metrics.step"
+    "Тест с профилированием по аппаратным счётчикам процессора (без доступа к счётчикам - только предупреждение)"
+    "--dh --stl ../tests/blue.stl --out ${TEST_RESULTS}/Perf.step"
+    "Тест с кэшем обработанных фигур (второй файл совпадает с первым и загружается из кэша)"
+    "--cache ${TEST_RESULTS} --stl ../tests/blue.stl --copy 10 0 0 --stl ../tests/blue.stl --out ${TEST_RESULTS}/Cache.step"
+    "Тест преобразования файла STL в файл топологии (без файла STEP)"
+    "--topo ${TEST_RESULTS} --stl ../tests/plastic.stl"
+    "Тест создания файла STEP из файла топологии, записанного предыдущим тестом"
+    "--stl ${TEST_RESULTS}/plastic.s2t --out ${TEST_RESULTS}/Topology.step"
+    "Тест пакетного режима: три задания из файла задания двумя исполнителями"
+    "--batch ${TEST_RESULTS}/Batch.txt 2"
   )
@@ -0,0 +1,341 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями функций учёта выделения динамической памяти
+ * и заменяющих глобальных операторов new и delete
+ */
+
+#include "stdafx.h"
+#if defined(ALLOC_TRACKING)
+#include <new>
+#include <cstddef>
+#if defined(__GNUC__)
+# include <cxxabi.h>
+#endif
+#include "alloc_tracker.h"
+
+#if defined(new)
+# undef new
+#endif
+
+/** \brief Наибольшее количество учитываемых этапов обработки */
+#define ALLOC_STAGES_MAX 64
+/** \brief Наибольшее количество учитываемых типов экземпляров STEP */
+#define ALLOC_TYPES_MAX 512
+
+namespace alloc {
+
+  /**
+   * \brief Заголовок выделенного блока памяти
+   */
+  struct alignas(std::max_align_t) block_header {
+    /** Размер блока, запрошенный у оператора new */
+    size_t size;
+    /** Номер этапа, на котором блок выделен */
+    unsigned stage;
+  };
+
+  /**
+   * \brief Счётчики выделений памяти этапа обработки
+   */
+  struct stage_counters {
+    /** Количество выделенных блоков */
+    std::atomic<uint64_t> allocs;
+    /** Объём выделенных блоков, байт */
+    std::atomic<uint64_t> bytes;
+    /** Объём ещё не освобождённых блоков, байт */
+    std::atomic<int64_t> live;
+    /** Пиковый объём не освобождённых блоков, байт */
+    std::atomic<int64_t> peak;
+  };
+
+  /**
+   * \brief Счётчики выделений памяти экземпляров STEP одного типа
+   */
+  struct type_counters {
+    /** Количество выделенных при выводе текста блоков */
+    std::atomic<uint64_t> allocs;
+    /** Объём выделенных при выводе текста блоков, байт */
+    std::atomic<uint64_t> bytes;
+    /** Количество уничтоженных экземпляров */
+    std::atomic<uint64_t> instances;
+    /** Количество освобождённых при уничтожении блоков */
+    std::atomic<uint64_t> frees;
+    /** Объём освобождённых при уничтожении блоков, байт */
+    std::atomic<uint64_t> freed_bytes;
+  };
+
+  /** \brief Названия этапов (нулевой - выделения вне областей трассировки) */
+  static const char* stage_names[ALLOC_STAGES_MAX] = { "(вне этапов)" };
+  /** \brief Количество известных этапов */
+  static std::atomic<unsigned> stages_num(1);
+  /** \brief Счётчики этапов */
+  static stage_counters stages[ALLOC_STAGES_MAX];
+
+  /** \brief Имена типов экземпляров STEP (нулевой не используется) */
+  static const char* type_names[ALLOC_TYPES_MAX] = { "" };
+  /** \brief Количество известных типов */
+  static std::atomic<unsigned> types_num(1);
+  /** \brief Счётчики типов */
+  static type_counters types[ALLOC_TYPES_MAX];
+
+  /** \brief Защита таблиц названий от одновременного дополнения из разных потоков */
+  static std::mutex names_mutex;
+
+  /** \brief Текущий этап потока */
+  static thread_local unsigned cur_stage = 0;
+  /** \brief Текущий тип экземпляра STEP потока или 0 */
+  static thread_local unsigned cur_type = 0;
+  /** \brief Экземпляр текущего типа уничтожается */
+  static thread_local bool cur_destroying = false;
+
+  /**
+   * \brief Найти название в таблице или добавить его в таблицу.
+   *
+   * Таблица только дополняется, поэтому поиск выполняется без блокировки.
+   *
+   * \param [in,out] names таблица названий
+   * \param [in,out] num количество названий в таблице
+   * \param [in] max наибольшее количество названий
+   * \param [in] name название (строковая константа)
+   * \return номер названия или 0, если таблица переполнена
+   */
+  static unsigned find_name(const char** names, std::atomic<unsigned>& num, unsigned max, const char* name) {
+    unsigned n = num.load(std::memory_order_acquire);
+    for (unsigned i = 1; i < n; ++i) {
+      if (names[i] == name || strcmp(names[i], name) == 0) return i;
+    }
+    std::lock_guard<std::mutex> lock(names_mutex);
+    n = num.load(std::memory_order_relaxed);
+    for (unsigned i = 1; i < n; ++i) {
+      if (strcmp(names[i], name) == 0) return i;
+    }
+    if (n >= max) return 0;
+    names[n] = name;
+    num.store(n + 1, std::memory_order_release);
+    return n;
+  }
+
+  /**
+   * \brief Выделить блок памяти с заголовком и учесть его.
+   *
+   * \param [in] size размер блока
+   * \return указатель на блок или nullptr, если памяти недостаточно
+   */
+  static void* tracked_alloc(size_t size) noexcept {
+    block_header* h = static_cast<block_header*>(malloc(sizeof(block_header) + size));
+    if (h == nullptr) return nullptr;
+    h->size = size;
+    h->stage = cur_stage;
+
+    stage_counters& s = stages[cur_stage];
+    s.allocs.fetch_add(1, std::memory_order_relaxed);
+    s.bytes.fetch_add(size, std::memory_order_relaxed);
+    const int64_t live = s.live.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size);
+    int64_t peak = s.peak.load(std::memory_order_relaxed);
+    while (live > peak && !s.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+    if (cur_type != 0 && !cur_destroying) {
+      types[cur_type].allocs.fetch_add(1, std::memory_order_relaxed);
+      types[cur_type].bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    return h + 1;
+  }
+
+  /**
+   * \brief Освободить блок памяти, выделенный \ref tracked_alloc, и учесть его.
+   *
+   * \param [in] p указатель на блок или nullptr
+   */
+  static void tracked_free(void* p) noexcept {
+    if (p == nullptr) return;
+    block_header* h = static_cast<block_header*>(p) - 1;
+    stages[h->stage].live.fetch_sub(static_cast<int64_t>(h->size), std::memory_order_relaxed);
+    if (cur_type != 0 && cur_destroying) {
+      types[cur_type].frees.fetch_add(1, std::memory_order_relaxed);
+      types[cur_type].freed_bytes.fetch_add(h->size, std::memory_order_relaxed);
+    }
+    free(h);
+  }
+
+  unsigned push_stage(const char* name) {
+    const unsigned prev = cur_stage;
+    cur_stage = find_name(stage_names, stages_num, ALLOC_STAGES_MAX, name);
+    return prev;
+  }
+
+  void pop_stage(unsigned prev) {
+    cur_stage = prev;
+  }
+
+  /**
+   * \file
+   * * \copybrief alloc::entity_scope::entity_scope(const char*, bool)
+   */
+  entity_scope::entity_scope(const char* type, bool destroying) : prev(cur_type) {
+    cur_type = find_name(type_names, types_num, ALLOC_TYPES_MAX, type);
+    cur_destroying = destroying;
+    if (destroying && cur_type != 0) types[cur_type].instances.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * \file
+   * * \copybrief alloc::entity_scope::~entity_scope()
+   */
+  entity_scope::~entity_scope() {
+    cur_type = prev;
+  }
+
+  /**
+   * \brief Получить имя типа экземпляра STEP без пространства имён express.
+   *
+   * \param [in] name имя типа (typeid(...).name())
+   * \return имя типа
+   */
+  static std::string type_name(const char* name) {
+    std::string s(name);
+#if defined(__GNUC__)
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (demangled != nullptr) {
+      if (status == 0) s = demangled;
+      free(demangled);
+    }
+#endif
+    /** Убрать пространство имён (в том числе в параметрах шаблонов) и ключевые слова MSVC */
+    static const char* const prefixes[] = { "express::", "class ", "struct " };
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); ++i) {
+      const size_t len = strlen(prefixes[i]);
+      for (size_t pos = s.find(prefixes[i]); pos != std::string::npos; pos = s.find(prefixes[i], pos)) {
+        s.erase(pos, len);
+      }
+    }
+    return s;
+  }
+
+  /**
+   * \brief Дополнить текст пробелами до ширины столбца таблицы (ширина считается в символах UTF-8).
+   *
+   * \param [in] text текст
+   * \param [in] width ширина столбца
+   * \param [in] right выравнивание по правому краю
+   * \return текст столбца
+   */
+  static std::string cell(const std::string& text, size_t width, bool right) {
+    size_t chars = 0;
+    for (auto it = text.cbegin(); it != text.cend(); ++it) {
+      if ((static_cast<unsigned char>(*it) & 0xC0) != 0x80) ++chars;
+    }
+    const std::string spaces(chars < width ? width - chars : 0, ' ');
+    return right ? spaces + text : text + spaces;
+  }
+
+  /**
+   * \brief Получить текст столбца таблицы с объёмом памяти в кибибайтах.
+   *
+   * \param [in] bytes объём в байтах
+   * \param [in] width ширина столбца
+   * \return текст столбца
+   */
+  static std::string kib_cell(uint64_t bytes, size_t width) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.1f", static_cast<double>(bytes) / 1024.0);
+    return cell(buf, width, true);
+  }
+
+  void report() {
+    /** Счётчики копируются до вывода, чтобы вывод не учитывал сам себя */
+    const unsigned sn = stages_num.load(std::memory_order_acquire);
+    std::vector<std::array<uint64_t, 3> > st(sn);
+    for (unsigned i = 0; i < sn; ++i) {
+      st[i][0] = stages[i].allocs.load(std::memory_order_relaxed);
+      st[i][1] = stages[i].bytes.load(std::memory_order_relaxed);
+      st[i][2] = static_cast<uint64_t>(stages[i].peak.load(std::memory_order_relaxed));
+    }
+    const unsigned tn = types_num.load(std::memory_order_acquire);
+    std::vector<std::array<uint64_t, 6> > tt;
+    for (unsigned i = 1; i < tn; ++i) {
+      tt.push_back({ i, types[i].instances.load(std::memory_order_relaxed),
+        types[i].frees.load(std::memory_order_relaxed), types[i].freed_bytes.load(std::memory_order_relaxed),
+        types[i].allocs.load(std::memory_order_relaxed), types[i].bytes.load(std::memory_order_relaxed) });
+    }
+
+    std::cout << std::endl << "Выделение памяти по этапам:" << std::endl;
+    std::cout << cell("этап", 26, false) << cell("блоков", 12, true) << cell("всего, КиБ", 14, true) <<
+      cell("пик, КиБ", 14, true) << std::endl;
+    uint64_t allocs_sum = 0;
+    uint64_t bytes_sum = 0;
+    for (unsigned i = 0; i < sn; ++i) {
+      if (st[i][0] == 0) continue;
+      std::cout << cell(stage_names[i], 26, false) << cell(std::to_string(st[i][0]), 12, true) <<
+        kib_cell(st[i][1], 14) << kib_cell(st[i][2], 14) << std::endl;
+      allocs_sum += st[i][0];
+      bytes_sum += st[i][1];
+    }
+    std::cout << cell("всего", 26, false) << cell(std::to_string(allocs_sum), 12, true) << kib_cell(bytes_sum, 14) << std::endl;
+
+    if (tt.empty()) return;
+
+    /** Типы упорядочиваются по убыванию объёма памяти, которой владели экземпляры */
+    std::sort(tt.begin(), tt.end(), [](const std::array<uint64_t, 6>& a, const std::array<uint64_t, 6>& b) {
+      return a[3] > b[3];
+    });
+    std::cout << std::endl << "Выделение памяти по типам экземпляров STEP (владение - блоки, освобождённые при уничтожении," << std::endl <<
+      "вывод - блоки, выделенные при создании текста экземпляров):" << std::endl;
+    std::cout << cell("тип", 48, false) << cell("экз.", 8, true) << cell("владение", 10, true) << cell("КиБ", 10, true) <<
+      cell("вывод", 10, true) << cell("КиБ", 10, true) << std::endl;
+    for (auto it = tt.cbegin(); it != tt.cend(); ++it) {
+      std::cout << cell(type_name(type_names[(*it)[0]]), 48, false) << cell(std::to_string((*it)[1]), 8, true) <<
+        cell(std::to_string((*it)[2]), 10, true) << kib_cell((*it)[3], 10) <<
+        cell(std::to_string((*it)[4]), 10, true) << kib_cell((*it)[5], 10) << std::endl;
+    }
+  }
+}
+
+// Заменяющие глобальные операторы выделения и освобождения памяти
+
+void* operator new(size_t size) {
+  void* p = alloc::tracked_alloc(size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  void* p = alloc::tracked_alloc(size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return alloc::tracked_alloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return alloc::tracked_alloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  alloc::tracked_free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  alloc::tracked_free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  alloc::tracked_free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  alloc::tracked_free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  alloc::tracked_free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  alloc::tracked_free(p);
+}
+
+#endif
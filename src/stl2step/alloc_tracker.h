@@ -0,0 +1,90 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлениями функций учёта выделения динамической памяти
+ *
+ * При сборке с определённым макросом ALLOC_TRACKING глобальные операторы new и delete
+ * заменяются считающими: перед каждым блоком хранится его размер и этап обработки, на
+ * котором он выделен. Этапом считается последняя незавершённая область трассировки
+ * (\ref trace::span) текущего потока. Для каждого этапа подсчитываются количество и объём
+ * выделенных блоков, а также пиковый объём ещё не освобождённых блоков этого этапа.
+ *
+ * Для экземпляров STEP учёт ведётся по типам: выделения при выводе текста экземпляра
+ * и освобождения при его уничтожении (то есть все блоки, которыми экземпляр владел).
+ *
+ * Без макроса ALLOC_TRACKING функции учёта пустые и не влияют на работу программы.
+ */
+
+#ifndef _ALLOC_TRACKER_H
+#define _ALLOC_TRACKER_H
+
+namespace alloc {
+
+#if defined(ALLOC_TRACKING)
+
+  /**
+   * \brief Сделать текущим этапом обработки потока этап с указанным названием.
+   *
+   * \param [in] name название этапа (строковая константа)
+   * \return номер предыдущего этапа для \ref pop_stage
+   */
+  unsigned push_stage(const char* name);
+
+  /**
+   * \brief Вернуть текущий этап обработки потока, действовавший до \ref push_stage.
+   *
+   * \param [in] prev номер предыдущего этапа
+   */
+  void pop_stage(unsigned prev);
+
+  /**
+   * \brief Вывести таблицы выделения памяти по этапам и по типам экземпляров STEP.
+   */
+  void report();
+
+#else
+
+  inline unsigned push_stage(const char*) { return 0; }
+  inline void pop_stage(unsigned) {}
+  inline void report() {}
+
+#endif
+
+  /**
+   * \brief Учёт выделений и освобождений памяти текущего потока за экземпляром STEP
+   * указанного типа от создания объекта до его уничтожения.
+   */
+  class entity_scope {
+
+#if defined(ALLOC_TRACKING)
+  private:
+
+    /** Номер предыдущего типа экземпляра потока */
+    unsigned prev;
+
+  public:
+
+    /**
+     * \brief Начать учёт.
+     *
+     * \param [in] type имя типа экземпляра (typeid(...).name())
+     * \param [in] destroying экземпляр уничтожается (иначе выводится его текст)
+     */
+    entity_scope(const char* type, bool destroying);
+
+    /**
+     * \brief Завершить учёт.
+     */
+    ~entity_scope();
+#else
+  public:
+
+    entity_scope(const char*, bool) {}
+#endif
+
+    entity_scope(const entity_scope&) = delete;
+    entity_scope& operator=(const entity_scope&) = delete;
+  };
+}
+
+#endif /* _ALLOC_TRACKER_H */
@@ -0,0 +1,407 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями методов классов непосредственной записи
+ * граничного представления (B-rep) фигуры в текст ISO 10303-21
+ */
+
+#include "stdafx.h"
+#include <stdarg.h>
+#if defined(_MSC_VER) || defined(__MINGW32__)
+# include <io.h>
+#elif defined(__GNUC__)
+# include <unistd.h>
+#endif
+#include "err.h"
+#include "brep_writer.h"
+
+/**
+ * \brief Переместить указатель позиции временного файла (с поддержкой файлов больше 2 ГБ).
+ *
+ * \param [in] f временный файл
+ * \param [in] pos смещение
+ * \param [in] whence точка отсчёта смещения (SEEK_SET, SEEK_END)
+ * \return 0 в случае успешного завершения
+ */
+static int spool_seek(FILE* f, long long pos, int whence) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+  return _fseeki64(f, pos, whence);
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  return fseeko(f, static_cast<off_t>(pos), whence);
+#else
+# error Unknown C++ compiler
+#endif
+}
+
+/**
+ * \brief Получить текущую позицию временного файла (с поддержкой файлов больше 2 ГБ).
+ *
+ * \param [in] f временный файл
+ * \return текущая позиция или -1 в случае ошибки
+ */
+static long long spool_tell(FILE* f) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+  return _ftelli64(f);
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  return static_cast<long long>(ftello(f));
+#else
+# error Unknown C++ compiler
+#endif
+}
+
+/**
+ * \brief Прочитать текст из заданного места временного файла, не изменяя позицию файла.
+ *
+ * Чтение с указанием смещения не использует общую позицию и буфер FILE, поэтому
+ * тексты групп экземпляров одного временного файла читаются потоками одновременно,
+ * без блокировки. Записанный через FILE текст должен быть предварительно сброшен
+ * в файл (fflush).
+ *
+ * \param [in] f временный файл
+ * \param [in] pos смещение текста от начала файла
+ * \param [out] buf буфер для текста
+ * \param [in] len длина текста
+ * \return true, если текст прочитан полностью
+ */
+static bool spool_read(FILE* f, long long pos, char* buf, size_t len) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+  HANDLE h = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(f)));
+  if (h == INVALID_HANDLE_VALUE) return false;
+  while (len > 0) {
+    OVERLAPPED ov = {};
+    ov.Offset = static_cast<DWORD>(pos);
+    ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+    DWORD readed = 0;
+    DWORD part = static_cast<DWORD>(std::min(len, static_cast<size_t>(1 << 30)));
+    if (!ReadFile(h, buf, part, &readed, &ov) || readed == 0) return false;
+    buf += readed;
+    pos += readed;
+    len -= readed;
+  }
+  return true;
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  const int fd = fileno(f);
+  while (len > 0) {
+    ssize_t readed = pread(fd, buf, len, static_cast<off_t>(pos));
+    if (readed < 0 && errno == EINTR) continue;
+    if (readed <= 0) return false;
+    buf += readed;
+    pos += readed;
+    len -= static_cast<size_t>(readed);
+  }
+  return true;
+#else
+# error Unknown C++ compiler
+#endif
+}
+
+/**
+ * \brief Дописать к строке текст, сформированный по образцу printf.
+ *
+ * \param [out] text строка, к которой дописывается текст
+ * \param [in] format образец
+ */
+static void append_format(std::string& text, const char* format, ...) {
+  char Buff[256];
+  va_list args;
+
+  va_start(args, format);
+  int len = vsnprintf(Buff, sizeof(Buff), format, args);
+  va_end(args);
+
+  if (len < 0) return;
+  if (static_cast<size_t>(len) < sizeof(Buff)) {
+    text.append(Buff, static_cast<size_t>(len));
+    return;
+  }
+
+  /* Текст не поместился в буфер (очень большие координаты) */
+  std::vector<char> Big(static_cast<size_t>(len) + 1);
+  va_start(args, format);
+  vsnprintf(Big.data(), Big.size(), format, args);
+  va_end(args);
+  text.append(Big.data(), static_cast<size_t>(len));
+}
+
+/**
+ * \brief Дописать к строке экземпляр CARTESIAN_POINT.
+ *
+ * \param [out] text строка, к которой дописывается текст
+ * \param [in] id уникальное имя экземпляра
+ * \param [in] v координаты точки
+ */
+static void append_point(std::string& text, unsigned id, const geometry::vector& v) {
+  append_format(text, "#%u = CARTESIAN_POINT('',(%.7f,%.7f,%.7f));%s", id, v.getX(), v.getY(), v.getZ(), express::STEP_CRLF);
+}
+
+/**
+ * \brief Дописать к строке экземпляр DIRECTION.
+ *
+ * \param [out] text строка, к которой дописывается текст
+ * \param [in] id уникальное имя экземпляра
+ * \param [in] v направление
+ */
+static void append_direction(std::string& text, unsigned id, const geometry::vector& v) {
+  append_format(text, "#%u = DIRECTION('',(%.7f,%.7f,%.7f));%s", id, v.getX(), v.getY(), v.getZ(), express::STEP_CRLF);
+}
+
+/**
+ * \brief Дописать к строке список уникальных имён в виде агрегата "(#1,#2,...)".
+ *
+ * \param [out] text строка, к которой дописывается текст
+ * \param [in] ids список уникальных имён
+ */
+static void append_id_list(std::string& text, const std::vector<unsigned>& ids) {
+  text += '(';
+  for (auto it = ids.cbegin(); it != ids.cend(); ++it) {
+    if (it != ids.cbegin()) text += express::STEP_SPACER;
+    append_format(text, "#%u", *it);
+  }
+  text += ')';
+}
+
+namespace express {
+
+  /**
+   * \file
+   * Функции, являющиеся методами класса \ref express::brep_closed_shell "brep_closed_shell":
+   * <BR>
+   */
+
+  /**
+   * \file
+   * * \copybrief express::brep_closed_shell::brep_closed_shell(const std::string&, const std::vector<unsigned>&)
+   */
+  brep_closed_shell::brep_closed_shell(const std::string& Name, const std::vector<unsigned>& Face_ids) :
+    representation_item(Name),
+    closed_shell(Name),
+    face_ids(Face_ids) {
+  }
+
+  /**
+   * \file
+   * * \copybrief express::brep_closed_shell::print() const
+   */
+  std::string brep_closed_shell::print(void) const {
+    std::string text;
+    append_format(text, "#%u = CLOSED_SHELL('',", get_id());
+    append_id_list(text, face_ids);
+    text += ");";
+    return text;
+  }
+
+  /**
+   * \file
+   * Функции, являющиеся методами класса \ref express::brep_fragment "brep_fragment":
+   * <BR>
+   */
+
+  /**
+   * \file
+   * * \copybrief express::brep_fragment::brep_fragment(FILE*, unsigned, unsigned, long long, size_t)
+   */
+  brep_fragment::brep_fragment(FILE* Spool, unsigned First_id, unsigned Ids_num, long long Offset, size_t Length) :
+    spool(Spool), first_id(First_id), ids_num(Ids_num), offset(Offset), length(Length) {
+  }
+
+  /**
+   * \file
+   * * \copybrief express::brep_fragment::create(FILE*, unsigned, unsigned, const std::string&)
+   */
+  brep_fragment* brep_fragment::create(FILE* Spool, unsigned First_id, unsigned Ids_num, const std::string& Text) {
+    if (spool_seek(Spool, 0, SEEK_END) != 0) return nullptr;
+    long long Offset = spool_tell(Spool);
+    if (Offset < 0) return nullptr;
+    if (fwrite(Text.data(), 1, Text.size(), Spool) != Text.size()) return nullptr;
+    if (fputs(STEP_CRLF, Spool) == EOF) return nullptr;
+    return new brep_fragment(Spool, First_id, Ids_num, Offset, Text.size());
+  }
+
+  /**
+   * \file
+   * * \copybrief express::brep_fragment::print() const
+   */
+  std::string brep_fragment::print(void) const {
+    /** Уникальные имена в тексте были присвоены заранее и должны совпасть с присвоенными при записи */
+    if (get_id() != first_id) {
+      std::cout << "INTERNAL_ERROR: brep_fragment::print() id " << get_id() << " differs from reserved " << first_id << std::endl;
+      exit(static_cast<int>(err_enum_t::ERROR_INTERNAL));
+    }
+
+    std::string text(length, '\0');
+    if (!spool_read(spool, offset, &text[0], length)) {
+      std::cout << "INTERNAL_ERROR: brep_fragment::print() can't read temporary file" << std::endl;
+      exit(static_cast<int>(err_enum_t::ERROR_INTERNAL));
+    }
+    return text;
+  }
+
+  /**
+   * \file
+   * Функции, являющиеся методами класса \ref express::brep_writer "brep_writer":
+   * <BR>
+   */
+
+  /**
+   * \file
+   * * \copybrief express::brep_writer::brep_writer(FILE*, unsigned, const prim3d::shell&)
+   */
+  brep_writer::brep_writer(FILE* Spool, unsigned First_id, const prim3d::shell& sh) :
+    spool(Spool), first_id(First_id), next_id(First_id), offset(0), length(0) {
+
+    /** Таблицы уникальных имён индексируются номерами вершин и рёбер фигуры */
+    sh.index_elements();
+    vertex_ids.assign(sh.vertexes_num(), 0);
+    edge_ids.assign(sh.edges_num(), 0);
+    face_ids.reserve(sh.faces_num());
+
+    /** Текст фигуры дописывается в конец временного файла */
+    spool_seek(spool, 0, SEEK_END);
+    offset = spool_tell(spool);
+  }
+
+  /**
+   * \file
+   * * \copybrief express::brep_writer::add_border(const prim3d::border&, size_t, std::string&)
+   */
+  unsigned brep_writer::add_border(const prim3d::border& b, size_t first_edge, std::string& text) {
+
+    /** Уникальные имена петли и границы выделяются до имён рёбер, как в STEP_API::CreateShell() */
+    unsigned loop_id = next_id++;
+    unsigned bound_id = next_id++;
+
+    std::vector<unsigned> oriented_ids;
+    oriented_ids.reserve(b.edges_num());
+
+    std::string edges_text;
+
+    /** Перебор ориентированных рёбер границы */
+    for (auto it = b.get_edges().cbegin(); it != b.get_edges().cend(); ++it) {
+
+      const prim3d::edge* e = (*it).get_base_edge();
+
+      unsigned curve_id = edge_ids[e->get_index()];
+      if (curve_id == 0) {
+        /** Кривая ребра ещё не выведена */
+        const prim3d::vertex* v[2] = { e->get_start(), e->get_end() };
+        unsigned v_id[2];
+
+        for (size_t i = 0; i < 2; ++i) {
+          v_id[i] = vertex_ids[v[i]->get_index()];
+          if (v_id[i] != 0) continue;
+          /** Точка вершины и её декартова точка */
+          v_id[i] = next_id++;
+          unsigned p_id = next_id++;
+          vertex_ids[v[i]->get_index()] = v_id[i];
+          append_format(edges_text, "#%u = VERTEX_POINT('',#%u);%s", v_id[i], p_id, STEP_CRLF);
+          append_point(edges_text, p_id, v[i]->get_coord());
+        }
+
+        /** Вектор ребра */
+        geometry::vector vd = edge_dirs.get(first_edge + std::distance(b.get_edges().cbegin(), it));
+
+        curve_id = next_id++;
+        unsigned line_id = next_id++;
+        unsigned line_pc_id = next_id++;
+        unsigned vect_id = next_id++;
+        unsigned dir_id = next_id++;
+        edge_ids[e->get_index()] = curve_id;
+
+        append_format(edges_text, "#%u = EDGE_CURVE('',#%u,#%u,#%u,.T.);%s", curve_id, v_id[0], v_id[1], line_id, STEP_CRLF);
+        append_format(edges_text, "#%u = LINE('',#%u,#%u);%s", line_id, line_pc_id, vect_id, STEP_CRLF);
+        append_point(edges_text, line_pc_id, v[0]->get_coord());
+        append_format(edges_text, "#%u = VECTOR('',#%u,%.7f);%s", vect_id, dir_id, 1.0, STEP_CRLF);
+        append_direction(edges_text, dir_id, vd);
+      }
+
+      /** Ориентированное ребро */
+      unsigned oriented_id = next_id++;
+      oriented_ids.push_back(oriented_id);
+      append_format(edges_text, "#%u = ORIENTED_EDGE('',*,*,#%u,%s);%s", oriented_id, curve_id, (*it).get_direction() ? ".T." : ".F.", STEP_CRLF);
+    }
+
+    append_format(text, "#%u = EDGE_LOOP('',", loop_id);
+    append_id_list(text, oriented_ids);
+    text += ");";
+    text += STEP_CRLF;
+    append_format(text, "#%u = FACE_OUTER_BOUND('',#%u,.T.);%s", bound_id, loop_id, STEP_CRLF);
+    text += edges_text;
+
+    return bound_id;
+  }
+
+  /**
+   * \file
+   * * \copybrief express::brep_writer::add_face(const prim3d::face&)
+   */
+  err_enum_t brep_writer::add_face(const prim3d::face& f) {
+
+    /** Проверка грани на наличие границ */
+    if (f.borders_num() == 0) {
+      std::cout << "ERROR (brep_writer): Face with no bordres" << std::endl;
+      return err_enum_t::ERROR_INTERNAL;
+    }
+
+    /** Проверка списка границ грани */
+    for (auto it = f.get_borders().cbegin(); it != f.get_borders().cend(); ++it) {
+      if ((*it).edges_num() < 3) {
+        std::cout << "ERROR (brep_writer): face #" << face_ids.size() + 1 << \
+          ", border #" << std::distance(f.get_borders().cbegin(), it) + 1 << " with " << (*it).edges_num() << " edges/vertexes" << std::endl;
+        return err_enum_t::ERROR_INTERNAL;
+      }
+    }
+
+    /** Уникальные имена грани, плоскости, системы координат, точки и двух направлений */
+    unsigned face_id = next_id++;
+    unsigned plane_id = next_id++;
+    unsigned axis_id = next_id++;
+    unsigned cp_id = next_id++;
+    unsigned norm_id = next_id++;
+    unsigned dir_id = next_id++;
+    face_ids.push_back(face_id);
+
+    /** Первое ребро первой границы задаёт начало отсчёта и ось X системы координат грани */
+    const prim3d::edge* e1 = (*f.get_borders().cbegin()->get_edges().cbegin()).get_base_edge();
+    const geometry::vector& vv1 = e1->get_start()->get_coord();
+    f.get_edge_directions(edge_dirs, edge_work);
+    geometry::vector fvd = edge_dirs.get(0);
+
+    std::string borders_text;
+    std::vector<unsigned> bound_ids;
+    bound_ids.reserve(f.borders_num());
+    size_t first_edge = 0;
+    for (auto it = f.get_borders().cbegin(); it != f.get_borders().cend(); ++it) {
+      bound_ids.push_back(add_border(*it, first_edge, borders_text));
+      first_edge += (*it).edges_num();
+    }
+
+    std::string text;
+    append_format(text, "#%u = ADVANCED_FACE('',", face_id);
+    append_id_list(text, bound_ids);
+    append_format(text, ",#%u,.T.);%s", plane_id, STEP_CRLF);
+    append_format(text, "#%u = PLANE('',#%u);%s", plane_id, axis_id, STEP_CRLF);
+    append_format(text, "#%u = AXIS2_PLACEMENT_3D('',#%u,#%u,#%u);%s", axis_id, cp_id, norm_id, dir_id, STEP_CRLF);
+    append_point(text, cp_id, vv1);
+    append_direction(text, norm_id, f.get_normal());
+    append_direction(text, dir_id, fvd);
+    text += borders_text;
+
+    if (fwrite(text.data(), 1, text.size(), spool) != text.size()) {
+      std::cout << "ERROR (brep_writer): can't write temporary file" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    length += text.size();
+
+    return err_enum_t::ERROR_OK;
+  }
+
+  /**
+   * \file
+   * * \copybrief express::brep_writer::create_fragment() const
+   */
+  brep_fragment* brep_writer::create_fragment() const {
+    if (next_id == first_id) return nullptr;
+    /** Завершающий разделитель строк добавляется при записи файла STEP */
+    return new brep_fragment(spool, first_id, next_id - first_id, offset, length - strlen(STEP_CRLF));
+  }
+}
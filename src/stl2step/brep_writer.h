@@ -0,0 +1,223 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлениями классов непосредственной записи
+ * граничного представления (B-rep) фигуры в текст ISO 10303-21
+ *
+ * Обычный путь создания файла STEP строит для каждой грани, ребра и вершины
+ * фигуры объекты EXPRESS (advanced_face, edge_loop, edge_curve, vertex_point и т.д.),
+ * которые хранятся до вызова \ref express::STEP_API::save() "STEP_API::save()".
+ * Классы этого файла позволяют сразу после обработки фигуры вывести её B-rep
+ * в виде готового текста во временный файл, присваивая уникальные имена экземпляров
+ * по мере вывода. Объекты EXPRESS при этом не создаются, а пиковый расход памяти
+ * ограничивается размером самой большой фигуры.
+ */
+
+#ifndef _BREP_WRITER_H
+#define _BREP_WRITER_H
+
+#include "err.h"
+#include "shell.h"
+#include "express.h"
+
+namespace express {
+
+  /**
+   * \brief Замкнутая оболочка, грани которой выведены в текст ISO 10303-21
+   * классом \ref express::brep_writer "brep_writer".
+   *
+   * Вместо списка объектов advanced_face хранит список уникальных имён граней.
+   */
+  class brep_closed_shell : public closed_shell {
+
+  private:
+
+    /** \brief Уникальные имена граней оболочки */
+    std::vector<unsigned> face_ids;
+
+  public:
+
+    /**
+     * \brief Конструктор из параметров
+     *
+     * \param [in] Name имя оболочки
+     * \param [in] Face_ids уникальные имена граней оболочки
+     */
+    brep_closed_shell(const std::string& Name, const std::vector<unsigned>& Face_ids);
+
+    /**
+     * \brief Отображение экземпляра замкнутой оболочки (ГОСТ Р ИСО 10303-21, 10.2).
+     * \return Строка с текстом отображения.
+     */
+    virtual std::string print(void) const;
+  };
+
+  /**
+   * \brief Группа экземпляров объектов, заранее выведенных в текст ISO 10303-21.
+   *
+   * Занимает непрерывный диапазон уникальных имён, начиная с собственного.
+   * Текст хранится во временном файле и считывается только при записи файла STEP
+   * чтением с указанием смещения, поэтому группы одного файла могут отображаться
+   * несколькими потоками одновременно.
+   */
+  class brep_fragment : public STEP_ENTITY {
+
+  private:
+
+    /** \brief Временный файл, содержащий текст группы */
+    FILE* spool; //-V122_NOPTR
+
+    /** \brief Первое уникальное имя, использованное в тексте группы */
+    unsigned first_id;
+
+    /** \brief Количество уникальных имён, использованных в тексте группы */
+    unsigned ids_num;
+
+    /** \brief Смещение текста группы от начала временного файла */
+    long long offset;
+
+    /** \brief Длина текста группы */
+    size_t length;
+
+  public:
+
+    /**
+     * \brief Конструктор из параметров
+     *
+     * \param [in] Spool временный файл, содержащий текст группы
+     * \param [in] First_id первое уникальное имя, использованное в тексте группы
+     * \param [in] Ids_num количество уникальных имён, использованных в тексте группы
+     * \param [in] Offset смещение текста группы от начала временного файла
+     * \param [in] Length длина текста группы
+     */
+    brep_fragment(FILE* Spool, unsigned First_id, unsigned Ids_num, long long Offset, size_t Length);
+
+    /**
+     * \brief Дописать готовый текст в конец временного файла и создать соответствующую ему группу экземпляров.
+     *
+     * \param [in] Spool временный файл
+     * \param [in] First_id первое уникальное имя, использованное в тексте
+     * \param [in] Ids_num количество уникальных имён, использованных в тексте
+     * \param [in] Text текст экземпляров без завершающего разделителя строк
+     * \return указатель на новую группу экземпляров или nullptr в случае ошибки записи
+     */
+    static brep_fragment* create(FILE* Spool, unsigned First_id, unsigned Ids_num, const std::string& Text);
+
+    /**
+     * \brief Отображение группы экземпляров, считанное из временного файла.
+     * \return Строка с текстом группы без завершающего разделителя строк.
+     */
+    virtual std::string print(void) const;
+
+    /**
+     * \brief Получить количество уникальных имён, занимаемых группой.
+     * \return количество уникальных имён
+     */
+    virtual unsigned get_ids_num() const {
+      return ids_num;
+    }
+
+    /**
+     * \brief Получить длину текста группы.
+     * \return длина текста без завершающего разделителя строк
+     */
+    size_t get_length() const {
+      return length;
+    }
+  };
+
+  /**
+   * \brief Класс непосредственной записи граней фигуры в текст ISO 10303-21.
+   *
+   * Порядок и состав выводимых экземпляров совпадает с тем, который создаёт
+   * \ref express::STEP_API::CreateShell() "STEP_API::CreateShell()", поэтому получаемый
+   * файл STEP не зависит от выбранного способа записи.
+   */
+  class brep_writer {
+
+  private:
+
+    /** \brief Временный файл, в который выводится текст */
+    FILE* spool; //-V122_NOPTR
+
+    /** \brief Первое уникальное имя, выделенное фигуре */
+    unsigned first_id;
+
+    /** \brief Следующее свободное уникальное имя */
+    unsigned next_id;
+
+    /** \brief Смещение текста фигуры от начала временного файла */
+    long long offset;
+
+    /** \brief Длина выведенного текста фигуры */
+    size_t length;
+
+    /**
+     * \brief Уникальные имена экземпляров vertex_point, созданных для вершин фигуры,
+     * по номерам вершин (0 - экземпляр ещё не создан)
+     */
+    std::vector<unsigned> vertex_ids;
+
+    /**
+     * \brief Уникальные имена экземпляров edge_curve, созданных для рёбер фигуры,
+     * по номерам рёбер (0 - экземпляр ещё не создан)
+     */
+    std::vector<unsigned> edge_ids;
+
+    /** \brief Уникальные имена экземпляров advanced_face, созданных для граней фигуры */
+    std::vector<unsigned> face_ids;
+
+    /** \brief Направления рёбер текущей грани (рассчитываются пакетно для каждой грани) */
+    geometry::vector_array edge_dirs;
+
+    /** \brief Рабочий массив для расчёта направлений рёбер */
+    geometry::vector_array edge_work;
+
+    /**
+     * \brief Вывести в буфер экземпляры, относящиеся к одной границе грани.
+     *
+     * \param [in] b граница грани
+     * \param [in] first_edge номер первого ребра границы в массиве направлений рёбер грани
+     * \param [out] text буфер, в который дописывается текст
+     * \return уникальное имя экземпляра face_outer_bound
+     */
+    unsigned add_border(const prim3d::border& b, size_t first_edge, std::string& text);
+
+  public:
+
+    /**
+     * \brief Конструктор из параметров
+     *
+     * \param [in] Spool временный файл, в который выводится текст
+     * \param [in] First_id первое уникальное имя, выделенное фигуре
+     * \param [in] sh фигура, для которой создаются таблицы уникальных имён
+     */
+    brep_writer(FILE* Spool, unsigned First_id, const prim3d::shell& sh);
+
+    /**
+     * \brief Вывести экземпляры, относящиеся к грани фигуры.
+     *
+     * \param [in] f грань фигуры
+     * \retval err_enum_t::ERROR_INTERNAL если у грани нет границ или в границе меньше трёх рёбер;
+     * \retval err_enum_t::ERROR_FILE_IO в случае ошибки записи во временный файл;
+     * \retval err_enum_t::ERROR_OK в случае успешного завершения.
+     */
+    err_enum_t add_face(const prim3d::face& f);
+
+    /**
+     * \brief Получить уникальные имена выведенных граней
+     * \return константную ссылку на список уникальных имён граней
+     */
+    const std::vector<unsigned>& get_face_ids() const {
+      return face_ids;
+    }
+
+    /**
+     * \brief Создать группу экземпляров, соответствующую выведенному тексту.
+     * \return указатель на новую группу экземпляров или nullptr, если не было выведено ни одного экземпляра
+     */
+    brep_fragment* create_fragment() const;
+  };
+}
+
+#endif /* _BREP_WRITER_H */
@@ -22,7 +22,8 @@
  * в "class express::class_name".
  */ 
 inline static const char *demangle(const char *mangled) {
-  static char demangled[100];
+  /* Буфер у каждого потока свой, так как экземпляры могут отображаться параллельно */
+  thread_local static char demangled[100];
   const size_t len = strlen(mangled);
   if (mangled[0] == 'N') {
     char sn[50];
@@ -85,6 +86,20 @@ namespace express {
   /** \brief Разделитель при выводе атрибутов объекта */
   constexpr auto STEP_SPACER = ",";
 
+  /**
+   * \brief Разделитель строк при выводе экземпляров объектов в файл STEP
+   *
+   * Для Visual Studio файл открывается в текстовом режиме, поэтому достаточно
+   * символа перевода строки.
+   */
+#if defined(_MSC_VER)
+  constexpr auto STEP_CRLF = "\n";
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  constexpr auto STEP_CRLF = "\r\n";
+#else
+# error Unknown C++ compiler
+#endif
+
   /**
    * \enum STEP_OBJTYPE
    * \brief Разновидности типов данных
@@ -918,7 +933,7 @@ namespace express {
      * Экземпляр типа данных объекта из EXPRESS должен быть отображен в структуру обмена как
      * ENTITY_INSTANCE.
      */
-    std::string print(void) const {
+    virtual std::string print(void) const {
 
       std::stringstream s;
       if (uid > 0) {
@@ -1016,6 +1031,19 @@ namespace express {
       return uid;
     }
 
+    /**
+     * \brief Получить количество уникальных имён, занимаемых объектом.
+     *
+     * Обычный объект занимает одно имя. Объект, выводящий при записи в файл STEP
+     * сразу группу экземпляров (например, \ref express::brep_fragment "brep_fragment"),
+     * занимает непрерывный диапазон имён, начинающийся с его собственного.
+     *
+     * \return количество уникальных имён
+     */
+    virtual unsigned get_ids_num() const {
+      return 1;
+    }
+
     /**
      * \brief Получить указанный элемент дополнения комплексного объекта
      */
@@ -5,8 +5,63 @@
  */
 
 #include "stdafx.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define GEOMETRY_SSE2
+#endif
 #include "precision.h"
 #include "geometry.h"
+#include "predicates.h"
+
+#if defined(GEOMETRY_SSE2)
+
+/**
+ * \brief Команды SSE для координат типа T: в регистре помещается width координат
+ * (две типа double или четыре типа float).
+ */
+template <typename T> struct simd;
+
+/** \brief Команды SSE2 для координат типа double */
+template <> struct simd<double> {
+  typedef __m128d reg;
+  static const size_t width = 2;
+  static reg load(const double* p) { return _mm_loadu_pd(p); }
+  static void store(double* p, reg r) { _mm_storeu_pd(p, r); }
+  static reg set1(double v) { return _mm_set1_pd(v); }
+  static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+  static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+  static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+  static reg sqrt(reg a) { return _mm_sqrt_pd(a); }
+  static reg abs(reg a) { return _mm_and_pd(a, _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL))); }
+  static reg lt(reg a, reg b) { return _mm_cmplt_pd(a, b); }
+  static reg neq(reg a, reg b) { return _mm_cmpneq_pd(a, b); }
+  static reg and_(reg a, reg b) { return _mm_and_pd(a, b); }
+  static reg select(reg mask, reg a, reg b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+  static int movemask(reg a) { return _mm_movemask_pd(a); }
+};
+
+/** \brief Команды SSE для координат типа float */
+template <> struct simd<float> {
+  typedef __m128 reg;
+  static const size_t width = 4;
+  static reg load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, reg r) { _mm_storeu_ps(p, r); }
+  static reg set1(float v) { return _mm_set1_ps(v); }
+  static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+  static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+  static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+  static reg sqrt(reg a) { return _mm_sqrt_ps(a); }
+  static reg abs(reg a) { return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF))); }
+  static reg lt(reg a, reg b) { return _mm_cmplt_ps(a, b); }
+  static reg neq(reg a, reg b) { return _mm_cmpneq_ps(a, b); }
+  static reg and_(reg a, reg b) { return _mm_and_ps(a, b); }
+  static reg select(reg mask, reg a, reg b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+  static int movemask(reg a) { return _mm_movemask_ps(a); }
+};
+
+#endif
 
 namespace geometry {
 
@@ -14,28 +69,18 @@ namespace geometry {
 //    std::cout << "(" << X << " " << Y << " " << Z << ")";
 //  }
 
-  std::ostream& operator<<(std::ostream& os, const vector& v) {
-    os << "(" << v.getX() << " " << v.getY() << " " << v.getZ() << ")";
-    return os;
-  }
-
-  bool vector::operator==(const vector& v) const {
-    return is_equal(v, EPSILON_X);
-  }
-
-  bool vector::is_equal(const vector& v, double epsilon) const {
-    return (fabs(this->X - v.X) < epsilon) && (fabs(this->Y - v.Y) < epsilon) && (fabs(this->Z - v.Z) < epsilon);
-  }
-
-  bool vector::is_null(double epsilon) {
+  template <typename T>
+  bool basic_vector<T>::is_null(double epsilon) {
     return fabs(this->X) < epsilon && fabs(this->Y) < epsilon && fabs(this->Z) < epsilon;
   }
 
-  bool vector::operator!=(const vector& v) const {
+  template <typename T>
+  bool basic_vector<T>::operator!=(const basic_vector& v) const {
     return !(*this == v);
   }
 
-  bool vector::operator<(const vector& v) const {
+  template <typename T>
+  bool basic_vector<T>::operator<(const basic_vector& v) const {
     if (X < v.X) return true;
     if (X > v.X) return false;
     if (Y < v.Y) return true;
@@ -46,61 +91,224 @@ namespace geometry {
     return false;
   }
 
-  vector& vector::operator+=(const vector& v) {
+  template <typename T>
+  basic_vector<T>& basic_vector<T>::operator+=(const basic_vector& v) {
     X += v.X;
     Y += v.Y;
     Z += v.Z;
     return *this;
   }
 
-  vector& vector::operator-=(const vector& v) {
+  template <typename T>
+  basic_vector<T>& basic_vector<T>::operator-=(const basic_vector& v) {
     X -= v.X;
     Y -= v.Y;
     Z -= v.Z;
     return *this;
   }
 
-  vector vector::operator-(const vector& v) const {
-    return vector(X - v.X, Y - v.Y, Z - v.Z);
-  }
-
-  vector& vector::operator/=(double d) {
+  template <typename T>
+  basic_vector<T>& basic_vector<T>::operator/=(T d) {
     X /= d;
     Y /= d;
     Z /= d;
     return *this;
   }
 
-  vector vector::operator*(const vector& v) const {
-    return vector(v.Y * Z - v.Z * Y, v.Z * X - v.X * Z, v.X * Y - v.Y * X);
+  template <typename T>
+  T basic_vector<T>::mix(const basic_vector& v1, const basic_vector& v2, const basic_vector& v3) {
+    /** скалярное произведение вектора v1 на векторное произведение векторов v2 и v3 */
+    return v1.scalar(v2 * v3);
   }
 
-  double vector::scalar(const vector& v) const {
-    return X * v.X + Y * v.Y + Z * v.Z;
+  template <typename T>
+  bool basic_vector<T>::check_4_points_in_plane(const basic_vector& p0, const basic_vector& p1, const basic_vector& p2, const basic_vector& p3, double epsilon) {
+    /** Проверка: смешанное произведение векторов (определитель ориентации) равно нулю? */
+    return predicates::orient3d_less(p1, p2, p3, p0, epsilon);
   }
 
-  vector vector::normalize(void) const {
-    double length = sqrt(X * X + Y * Y + Z * Z);
-    return vector(X / length, Y / length, Z / length);
+  template <typename T>
+  bool basic_vector<T>::check_collinear(const basic_vector& v1, const basic_vector& v2, double epsilon) {
+    /** Проверка: векторное произведение - это нулевой вектор? */
+    return predicates::cross_less(v1, v2, epsilon);
   }
 
-  double vector::mix(const vector& v1, const vector& v2, const vector& v3) {
-    /** скалярное произведение вектора v1 на векторное произведение векторов v2 и v3 */
-    return v1.scalar(v2 * v3);
+  template <typename T>
+  bool basic_vector<T>::check_3_points_in_line(const basic_vector& p0, const basic_vector& p1, const basic_vector& p2, double epsilon) {
+    /** Проверка: вектора p0-p1 и p0-p2 коллинеарны? (разности вычисляются без округления) */
+    return predicates::collinear_less(p0, p1, p2, epsilon);
   }
 
-  bool vector::check_4_points_in_plane(const vector& p0, const vector& p1, const vector& p2, const vector& p3, double epsilon) {
-    /** Проверка: смешанное произведение векторов равно нулю? */
-    return fabs(mix(vector(p0, p1), vector(p0, p2), vector(p0, p3))) < epsilon;
+  /**
+   * Пакетные функции обрабатывают по simd<T>::width векторов за раз командами SSE и остаток -
+   * простым циклом. Порядок операций совпадает с порядком в методах класса basic_vector,
+   * поэтому результаты пакетной и поэлементной обработки совпадают побитово.
+   */
+
+  template <typename T>
+  void batch_sub(const basic_vector_array<T>& a, const basic_vector_array<T>& b, basic_vector_array<T>& r) {
+    const size_t n = a.size();
+    r.resize(n);
+    const T *ax = a.x(), *ay = a.y(), *az = a.z();
+    const T *bx = b.x(), *by = b.y(), *bz = b.z();
+    T *rx = r.x(), *ry = r.y(), *rz = r.z();
+    size_t i = 0;
+#if defined(GEOMETRY_SSE2)
+    typedef simd<T> S;
+    for (; i + S::width <= n; i += S::width) {
+      S::store(rx + i, S::sub(S::load(ax + i), S::load(bx + i)));
+      S::store(ry + i, S::sub(S::load(ay + i), S::load(by + i)));
+      S::store(rz + i, S::sub(S::load(az + i), S::load(bz + i)));
+    }
+#endif
+    for (; i < n; ++i) {
+      rx[i] = ax[i] - bx[i];
+      ry[i] = ay[i] - by[i];
+      rz[i] = az[i] - bz[i];
+    }
   }
 
-  bool vector::check_collinear(const vector& v1, const vector& v2, double epsilon) {
-    /** Проверка: векторное произведение - это нулевой вектор? */
-    return (v1 * v2).is_null(epsilon);
+  template <typename T>
+  void batch_cross(const basic_vector_array<T>& a, const basic_vector_array<T>& b, basic_vector_array<T>& r) {
+    const size_t n = a.size();
+    r.resize(n);
+    const T *ax = a.x(), *ay = a.y(), *az = a.z();
+    const T *bx = b.x(), *by = b.y(), *bz = b.z();
+    T *rx = r.x(), *ry = r.y(), *rz = r.z();
+    size_t i = 0;
+#if defined(GEOMETRY_SSE2)
+    typedef simd<T> S;
+    for (; i + S::width <= n; i += S::width) {
+      const typename S::reg ux = S::load(ax + i), uy = S::load(ay + i), uz = S::load(az + i);
+      const typename S::reg vx = S::load(bx + i), vy = S::load(by + i), vz = S::load(bz + i);
+      const typename S::reg cx = S::sub(S::mul(uy, vz), S::mul(uz, vy));
+      const typename S::reg cy = S::sub(S::mul(uz, vx), S::mul(ux, vz));
+      const typename S::reg cz = S::sub(S::mul(ux, vy), S::mul(uy, vx));
+      S::store(rx + i, cx);
+      S::store(ry + i, cy);
+      S::store(rz + i, cz);
+    }
+#endif
+    for (; i < n; ++i) {
+      const T cx = ay[i] * bz[i] - az[i] * by[i];
+      const T cy = az[i] * bx[i] - ax[i] * bz[i];
+      const T cz = ax[i] * by[i] - ay[i] * bx[i];
+      rx[i] = cx;
+      ry[i] = cy;
+      rz[i] = cz;
+    }
   }
 
-  bool vector::check_3_points_in_line(const vector& p0, const vector& p1, const vector& p2, double epsilon) {
-    /** Проверка: вектора p1-p2 и p2-p3 коллинеарны? */
-    return check_collinear(vector(p0, p1), vector(p0, p2), epsilon);
+  template <typename T>
+  void batch_dot(const basic_vector_array<T>& a, const basic_vector_array<T>& b, T* r) {
+    const size_t n = a.size();
+    const T *ax = a.x(), *ay = a.y(), *az = a.z();
+    const T *bx = b.x(), *by = b.y(), *bz = b.z();
+    size_t i = 0;
+#if defined(GEOMETRY_SSE2)
+    typedef simd<T> S;
+    for (; i + S::width <= n; i += S::width) {
+      S::store(r + i, S::add(S::add(
+        S::mul(S::load(ax + i), S::load(bx + i)),
+        S::mul(S::load(ay + i), S::load(by + i))),
+        S::mul(S::load(az + i), S::load(bz + i))));
+    }
+#endif
+    for (; i < n; ++i) {
+      r[i] = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i];
+    }
   }
+
+  template <typename T>
+  void batch_normalize(basic_vector_array<T>& a) {
+    const size_t n = a.size();
+    T *ax = a.x(), *ay = a.y(), *az = a.z();
+    size_t i = 0;
+#if defined(GEOMETRY_SSE2)
+    typedef simd<T> S;
+    const typename S::reg zero = S::set1(T(0)), one = S::set1(T(1));
+    for (; i + S::width <= n; i += S::width) {
+      const typename S::reg x = S::load(ax + i), y = S::load(ay + i), z = S::load(az + i);
+      const typename S::reg length = S::sqrt(S::add(S::add(S::mul(x, x), S::mul(y, y)), S::mul(z, z)));
+      // Для нулевого вектора делитель заменяется единицей
+      const typename S::reg d = S::select(S::neq(length, zero), length, one);
+      S::store(ax + i, S::div(x, d));
+      S::store(ay + i, S::div(y, d));
+      S::store(az + i, S::div(z, d));
+    }
+#endif
+    for (; i < n; ++i) {
+      const T length = sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+      if (length == T(0)) continue;
+      ax[i] /= length;
+      ay[i] /= length;
+      az[i] /= length;
+    }
+  }
+
+  template <typename T>
+  void batch_equal(const basic_vector_array<T>& a, const basic_vector_array<T>& b, double epsilon, unsigned char* r) {
+    const size_t n = a.size();
+    const T *ax = a.x(), *ay = a.y(), *az = a.z();
+    const T *bx = b.x(), *by = b.y(), *bz = b.z();
+    size_t i = 0;
+#if defined(GEOMETRY_SSE2)
+    typedef simd<T> S;
+    const typename S::reg eps = S::set1(static_cast<T>(epsilon));
+    for (; i + S::width <= n; i += S::width) {
+      const typename S::reg ex = S::lt(S::abs(S::sub(S::load(ax + i), S::load(bx + i))), eps);
+      const typename S::reg ey = S::lt(S::abs(S::sub(S::load(ay + i), S::load(by + i))), eps);
+      const typename S::reg ez = S::lt(S::abs(S::sub(S::load(az + i), S::load(bz + i))), eps);
+      const int mask = S::movemask(S::and_(S::and_(ex, ey), ez));
+      for (size_t k = 0; k < S::width; ++k) {
+        r[i + k] = static_cast<unsigned char>((mask >> k) & 1);
+      }
+    }
+#endif
+    const T e = static_cast<T>(epsilon);
+    for (; i < n; ++i) {
+      r[i] = (fabs(ax[i] - bx[i]) < e) && (fabs(ay[i] - by[i]) < e) && (fabs(az[i] - bz[i]) < e);
+    }
+  }
+
+  template <typename T>
+  size_t batch_find(const basic_vector_array<T>& a, const basic_vector<T>& v, double epsilon) {
+    const size_t n = a.size();
+    const T *ax = a.x(), *ay = a.y(), *az = a.z();
+    size_t i = 0;
+#if defined(GEOMETRY_SSE2)
+    typedef simd<T> S;
+    const typename S::reg eps = S::set1(static_cast<T>(epsilon));
+    const typename S::reg vx = S::set1(v.getX()), vy = S::set1(v.getY()), vz = S::set1(v.getZ());
+    for (; i + S::width <= n; i += S::width) {
+      const typename S::reg ex = S::lt(S::abs(S::sub(S::load(ax + i), vx)), eps);
+      const typename S::reg ey = S::lt(S::abs(S::sub(S::load(ay + i), vy)), eps);
+      const typename S::reg ez = S::lt(S::abs(S::sub(S::load(az + i), vz)), eps);
+      const int mask = S::movemask(S::and_(S::and_(ex, ey), ez));
+      if (mask != 0) {
+        size_t k = 0;
+        while (((mask >> k) & 1) == 0) ++k;
+        return i + k;
+      }
+    }
+#endif
+    const T e = static_cast<T>(epsilon);
+    for (; i < n; ++i) {
+      if ((fabs(ax[i] - v.getX()) < e) && (fabs(ay[i] - v.getY()) < e) && (fabs(az[i] - v.getZ()) < e)) return i;
+    }
+    return n;
+  }
+
+  /** \brief Явное создание экземпляров шаблонов для координат типа T */
+#define GEOMETRY_INSTANTIATE(T) \
+  template class basic_vector<T>; \
+  template void batch_sub<T>(const basic_vector_array<T>&, const basic_vector_array<T>&, basic_vector_array<T>&); \
+  template void batch_cross<T>(const basic_vector_array<T>&, const basic_vector_array<T>&, basic_vector_array<T>&); \
+  template void batch_dot<T>(const basic_vector_array<T>&, const basic_vector_array<T>&, T*); \
+  template void batch_normalize<T>(basic_vector_array<T>&); \
+  template void batch_equal<T>(const basic_vector_array<T>&, const basic_vector_array<T>&, double, unsigned char*); \
+  template size_t batch_find<T>(const basic_vector_array<T>&, const basic_vector<T>&, double);
+
+  GEOMETRY_INSTANTIATE(double)
+  GEOMETRY_INSTANTIATE(float)
 }
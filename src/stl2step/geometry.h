@@ -7,23 +7,31 @@
 #ifndef _GEOMETRY_H
 #define _GEOMETRY_H
 
+#include "precision.h"
+
 namespace geometry {
 
   /**
    * \brief Вектор.
+   *
+   * Хранит только три координаты, что позволяет плотно размещать векторы в массивах
+   * и копировать их в массивы координат (\ref basic_vector_array).
+   *
+   * \tparam T тип координат (double или float), см. \ref geometry::real
    */
-  class vector {
+  template <typename T>
+  class basic_vector {
 
   private:
 
-    double X, Y, Z, W;
+    T X, Y, Z;
 
   public:
 
     /**
     * \brief Конструктор вектора по умолчанию (нулевого вектора).
     */
-    vector() { X = 0.0; Y = 0.0; Z = 0.0; W = 1.0; }
+    basic_vector() { X = 0.0; Y = 0.0; Z = 0.0; }
 
     /**
     * \brief Конструктор вектора от координаты 'a' к координате 'b'.
@@ -31,11 +39,10 @@ namespace geometry {
     * \param [in] a координаты начальной точки вектора
     * \param [in] b координаты конечной точки вектоа
     */
-    vector(const vector& a, const vector& b) {
+    basic_vector(const basic_vector& a, const basic_vector& b) {
       X = b.X - a.X;
       Y = b.Y - a.Y;
       Z = b.Z - a.Z;
-      W = 1.0;
     }
 
     /**
@@ -45,11 +52,10 @@ namespace geometry {
     * \param [in] y координата Y
     * \param [in] z координата Z
     */
-    vector(double x, double y, double z) {
+    basic_vector(T x, T y, T z) {
       X = x;
       Y = y;
       Z = z;
-      W = 1.0;
     }
 
 //    /**
@@ -60,7 +66,10 @@ namespace geometry {
     /**
      * \brief Потоковый вывод значения вектора.
      */
-    friend std::ostream& operator<<(std::ostream& os, const vector& v);
+    friend std::ostream& operator<<(std::ostream& os, const basic_vector& v) {
+      os << "(" << v.X << " " << v.Y << " " << v.Z << ")";
+      return os;
+    }
 
     /**
      * \brief Проверка: равенство координат (векторов) с точностью EPSILON_X.
@@ -68,7 +77,7 @@ namespace geometry {
      * \param [in] v вектор, с которым производится сравнение
      * \return true, если разница всех координат векторов меньше точноcти, false в противном случае
      */
-    bool operator==(const vector& v) const;
+    bool operator==(const basic_vector& v) const { return is_equal(v, EPSILON_X); }
 
     /**
      * \brief Проверка: равенство координат (векторов) с указанной точностью.
@@ -77,7 +86,9 @@ namespace geometry {
      * \param [in] epsilon точность, с которой производится сравнение
      * \return true, если разница всех координат векторов меньше точноcти, false в противном случае
      */
-    bool is_equal(const vector& v, double epsilon) const;
+    bool is_equal(const basic_vector& v, double epsilon) const {
+      return (fabs(X - v.X) < epsilon) && (fabs(Y - v.Y) < epsilon) && (fabs(Z - v.Z) < epsilon);
+    }
 
     /**
      * \brief Проверка: неравенство координат (векторов) с точностью по умолчанию.
@@ -85,7 +96,7 @@ namespace geometry {
      * \param [in] v вектор, с которым производится сравнение
      * \return false, если разница всех координат векторов меньше или равна точноcти, true в противном случае
      */
-    bool operator!=(const vector& v) const;
+    bool operator!=(const basic_vector& v) const;
 
     /**
      * \brief Сравнение векторов (условное, только для выполнения однозначной сортировки).
@@ -93,34 +104,34 @@ namespace geometry {
      * \param [in] v вектор, с которым производится сравнение
      * \return true, если объект условно меньше вектора 'v'
      */
-    bool operator<(const vector& v) const;
+    bool operator<(const basic_vector& v) const;
 
     // Сложение с вектором
-    vector& operator+=(const vector& v);
+    basic_vector& operator+=(const basic_vector& v);
 
     // Вычитание вектора
-    vector& operator-=(const vector& v);
+    basic_vector& operator-=(const basic_vector& v);
 
-    vector operator-(const vector& v) const;
+    basic_vector operator-(const basic_vector& v) const { return basic_vector(X - v.X, Y - v.Y, Z - v.Z); }
 
     // Деление на число
-    vector& operator/=(double d);
+    basic_vector& operator/=(T d);
 
-    // Векторное произведение
-    vector operator*(const vector& v) const;
+    // Векторное произведение (произведение аргумента на объект: v x this)
+    basic_vector operator*(const basic_vector& v) const { return basic_vector(v.Y * Z - v.Z * Y, v.Z * X - v.X * Z, v.X * Y - v.Y * X); }
 
     // Скалярное произведение
-    double scalar(const vector& v) const;
+    T scalar(const basic_vector& v) const { return X * v.X + Y * v.Y + Z * v.Z; }
 
     // Расстояние между векторами
-    double distance(const vector& v) const { vector t(*this); t -= v; return t.module(); }
+    T distance(const basic_vector& v) const { basic_vector t(*this); t -= v; return t.module(); }
 
     /**
      * Рассчитать значение модуля вектора.
      *
      * \return значение модуля вектора
      */
-    double module(void) const { return sqrt(X * X + Y * Y + Z * Z); }
+    T module(void) const { return sqrt(X * X + Y * Y + Z * Z); }
 
     /**
      * Рассчитать угол между векторами.
@@ -128,14 +139,18 @@ namespace geometry {
      * \param [in] v вектор, угол с которым требуется рассчитать
      * \return число - угол между объектом и вектором 'v'
      */
-    double angle(const vector& v) const { return acos(this->scalar(v) / (this->module() * v.module())); }
+    T angle(const basic_vector& v) const { return acos(this->scalar(v) / (this->module() * v.module())); }
 
     /**
-     * Нормализовать вектор.
+     * Нормализовать вектор. Нулевой вектор возвращается без изменения (как в \ref batch_normalize).
      *
      * \return нормализованный вектор
      */
-    vector normalize(void) const;
+    basic_vector normalize(void) const {
+      T length = sqrt(X * X + Y * Y + Z * Z);
+      if (length == T(0)) return *this;
+      return basic_vector(X / length, Y / length, Z / length);
+    }
 
     /**
      * Проверка: является ли вектор нулевым (с указанной точностью).
@@ -150,21 +165,21 @@ namespace geometry {
      *
      * \return координату X вектора
      */
-    double getX(void) const { return X; }
+    T getX(void) const { return X; }
 
     /**
      * Получить координату Y вектора.
      *
      * \return координату Y вектора
      */
-    double getY(void) const { return Y; }
+    T getY(void) const { return Y; }
 
     /**
      * Получить координату Z вектора.
      *
      * \return координату Z вектора
      */
-    double getZ(void) const { return Z; }
+    T getZ(void) const { return Z; }
 
     /**
      * \brief Смешанное произведение векторов p1, p2 и p3.
@@ -174,7 +189,7 @@ namespace geometry {
      * \param [in] v3 третий вектор
      * \return число - результат смешанного произведения векторов
      */
-    static double mix(const vector& v1, const vector& v2, const vector& v3);
+    static T mix(const basic_vector& v1, const basic_vector& v2, const basic_vector& v3);
 
     /**
      * Проверка: лежат ли четыре точки в одной плоскости (с указанной точночтью)?
@@ -184,9 +199,10 @@ namespace geometry {
      * \param [in] p2 координаты третьей точки
      * \param [in] p3 координаты четвёртой точки
      * \param [in] epsilon точность, с которой производится сравнение
-     * \return
+     * \return true, если модуль смешанного произведения векторов p0-p1, p0-p2, p0-p3
+     * меньше epsilon (вычисляется с адаптивной точностью, см. \ref geometry::predicates)
      */
-    static bool check_4_points_in_plane(const vector& p0, const vector& p1, const vector& p2, const vector& p3, double epsilon);
+    static bool check_4_points_in_plane(const basic_vector& p0, const basic_vector& p1, const basic_vector& p2, const basic_vector& p3, double epsilon);
 
     /**
      * Проверка: два вектора коллинеарны (с указанной точночтью)?
@@ -196,7 +212,7 @@ namespace geometry {
      * \param [in] epsilon точность, с которой производится сравнение
      * \return true, если векторы коллинеарны с указанной точночтью, и false в противном случае
      */
-    static bool check_collinear(const vector& v1, const vector& v2, double epsilon);
+    static bool check_collinear(const basic_vector& v1, const basic_vector& v2, double epsilon);
 
     /**
      * Проверка: лежат ли три точки на линии (с указанной точночтью)?
@@ -207,9 +223,180 @@ namespace geometry {
      * \param [in] epsilon точность, с которой производится сравнение
      * \return true, если три точки лежат на одной линии с указанной точночтью, и false в противном случае
      */
-    static bool check_3_points_in_line(const vector& p0, const vector& p1, const vector& p2, double epsilon);
+    static bool check_3_points_in_line(const basic_vector& p0, const basic_vector& p1, const basic_vector& p2, double epsilon);
+  };
+
+  /**
+   * \brief Тип координат, используемый программой: double (по умолчанию) или float
+   * (при сборке с определённым макросом GEOMETRY_FLOAT).
+   */
+#if defined(GEOMETRY_FLOAT)
+  typedef float real;
+#else
+  typedef double real;
+#endif
+
+  /** \brief Вектор с координатами типа \ref geometry::real */
+  typedef basic_vector<real> vector;
+
+  /**
+   * \brief Массив векторов, хранящийся в виде отдельных массивов координат X, Y и Z.
+   *
+   * Используется для пакетной обработки большого числа векторов функциями batch_*,
+   * которые обрабатывают по два вектора за раз командами SSE2 (в остальных средах -
+   * простым циклом). Результаты пакетных функций совпадают с результатами
+   * соответствующих методов класса \ref basic_vector.
+   *
+   * \tparam T тип координат (double или float)
+   */
+  template <typename T>
+  class basic_vector_array {
+
+  private:
+
+    std::vector<T> X, Y, Z;
+
+  public:
+
+    /**
+     * \brief Конструктор пустого массива.
+     */
+    basic_vector_array() {}
+
+    /**
+     * \brief Конструктор массива заданного размера (из нулевых векторов).
+     *
+     * \param [in] n количество векторов
+     */
+    explicit basic_vector_array(size_t n) : X(n, T(0)), Y(n, T(0)), Z(n, T(0)) {}
+
+    /**
+     * \brief Получить количество векторов в массиве.
+     *
+     * \return количество векторов
+     */
+    size_t size() const { return X.size(); }
+
+    /**
+     * \brief Изменить количество векторов в массиве.
+     *
+     * \param [in] n новое количество векторов
+     */
+    void resize(size_t n) { X.resize(n); Y.resize(n); Z.resize(n); }
+
+    /**
+     * \brief Зарезервировать память для векторов.
+     *
+     * \param [in] n количество векторов
+     */
+    void reserve(size_t n) { X.reserve(n); Y.reserve(n); Z.reserve(n); }
+
+    /**
+     * \brief Удалить все векторы из массива.
+     */
+    void clear() { X.clear(); Y.clear(); Z.clear(); }
+
+    /**
+     * \brief Добавить вектор в конец массива.
+     *
+     * \param [in] v вектор
+     */
+    void push_back(const basic_vector<T>& v) { X.push_back(v.getX()); Y.push_back(v.getY()); Z.push_back(v.getZ()); }
+
+    /**
+     * \brief Записать вектор в массив.
+     *
+     * \param [in] i номер вектора
+     * \param [in] v вектор
+     */
+    void set(size_t i, const basic_vector<T>& v) { X[i] = v.getX(); Y[i] = v.getY(); Z[i] = v.getZ(); }
+
+    /**
+     * \brief Получить вектор из массива.
+     *
+     * \param [in] i номер вектора
+     * \return вектор
+     */
+    basic_vector<T> get(size_t i) const { return basic_vector<T>(X[i], Y[i], Z[i]); }
+
+    /** \brief Массив координат X */
+    T* x() { return X.data(); }
+    /** \brief Массив координат Y */
+    T* y() { return Y.data(); }
+    /** \brief Массив координат Z */
+    T* z() { return Z.data(); }
+    /** \brief Массив координат X */
+    const T* x() const { return X.data(); }
+    /** \brief Массив координат Y */
+    const T* y() const { return Y.data(); }
+    /** \brief Массив координат Z */
+    const T* z() const { return Z.data(); }
   };
 
+  /** \brief Массив векторов с координатами типа \ref geometry::real */
+  typedef basic_vector_array<real> vector_array;
+
+  /**
+   * \brief Разность векторов: r[i] = a[i] - b[i].
+   *
+   * \param [in] a уменьшаемые векторы
+   * \param [in] b вычитаемые векторы (не меньше, чем a)
+   * \param [out] r результат (размер устанавливается равным размеру a)
+   */
+  template <typename T>
+  void batch_sub(const basic_vector_array<T>& a, const basic_vector_array<T>& b, basic_vector_array<T>& r);
+
+  /**
+   * \brief Векторное произведение: r[i] = a[i] x b[i] (то же, что b[i] * a[i] для класса \ref basic_vector).
+   *
+   * \param [in] a первые сомножители
+   * \param [in] b вторые сомножители (не меньше, чем a)
+   * \param [out] r результат (размер устанавливается равным размеру a)
+   */
+  template <typename T>
+  void batch_cross(const basic_vector_array<T>& a, const basic_vector_array<T>& b, basic_vector_array<T>& r);
+
+  /**
+   * \brief Скалярное произведение: r[i] = a[i] . b[i].
+   *
+   * \param [in] a первые сомножители
+   * \param [in] b вторые сомножители (не меньше, чем a)
+   * \param [out] r результат (a.size() чисел)
+   */
+  template <typename T>
+  void batch_dot(const basic_vector_array<T>& a, const basic_vector_array<T>& b, T* r);
+
+  /**
+   * \brief Нормализовать векторы массива (результаты совпадают побитно с результатами
+   * \ref basic_vector::normalize). Нулевые векторы остаются без изменения.
+   *
+   * \param [in,out] a векторы
+   */
+  template <typename T>
+  void batch_normalize(basic_vector_array<T>& a);
+
+  /**
+   * \brief Попарное сравнение векторов с указанной точностью (как \ref basic_vector::is_equal).
+   *
+   * \param [in] a первые векторы
+   * \param [in] b вторые векторы (не меньше, чем a)
+   * \param [in] epsilon точность, с которой производится сравнение
+   * \param [out] r результат (a.size() значений: 1 - векторы равны, 0 - не равны)
+   */
+  template <typename T>
+  void batch_equal(const basic_vector_array<T>& a, const basic_vector_array<T>& b, double epsilon, unsigned char* r);
+
+  /**
+   * \brief Найти в массиве первый вектор, равный заданному с указанной точностью.
+   *
+   * \param [in] a векторы
+   * \param [in] v искомый вектор
+   * \param [in] epsilon точность, с которой производится сравнение
+   * \return номер найденного вектора или a.size(), если вектор не найден
+   */
+  template <typename T>
+  size_t batch_find(const basic_vector_array<T>& a, const basic_vector<T>& v, double epsilon);
+
 }
 
 #endif /* _GEOMETRY_H */
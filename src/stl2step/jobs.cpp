@@ -0,0 +1,450 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями функций выполнения заданий преобразования несколькими
+ * потоками в одном процессе
+ */
+
+#include "stdafx.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+
+#include "err.h"
+#include "jobs.h"
+#include "trace.h"
+
+namespace jobs {
+
+  /**
+   * \brief Буфер сообщений выполняемого потоком задания (nullptr - сообщения потока отбрасываются)
+   */
+  static thread_local std::string* messages = nullptr;
+
+  /**
+   * \brief Выполняются ли задания (пока существует объект вывода результатов заданий)
+   */
+  static std::atomic<bool> is_active(false);
+
+  bool active() {
+    return is_active.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Буфер стандартного вывода на время выполнения заданий.
+   *
+   * Буфер не хранит символов: выводимый текст сразу дописывается в буфер сообщений задания,
+   * выполняемого текущим потоком (\ref messages), или отбрасывается, если поток не выполняет
+   * задание. Поэтому сообщения одновременно выполняемых заданий не перемешиваются.
+   */
+  class job_streambuf : public std::streambuf {
+
+  protected:
+
+    virtual int_type overflow(int_type c) {
+      if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+      if (messages != nullptr) messages->push_back(traits_type::to_char_type(c));
+      return c;
+    }
+
+    virtual std::streamsize xsputn(const char* s, std::streamsize n) {
+      if (messages != nullptr) messages->append(s, static_cast<size_t>(n));
+      return n;
+    }
+  };
+
+  /**
+   * \brief Задание
+   */
+  struct job_t {
+    /** Номер задания (с 1, в порядке поступления) */
+    unsigned id;
+    /** Строка директив */
+    std::string directives;
+  };
+
+  /**
+   * \brief Результат выполнения задания
+   */
+  struct result_t {
+    /** Код завершения */
+    err_enum_t err;
+    /** Общее время выполнения, нс */
+    uint64_t time;
+    /** Время этапов обработки */
+    stages_t stages;
+    /** Сообщения преобразователя, выведенные при выполнении задания */
+    std::string messages;
+  };
+
+  /**
+   * \brief Очередь заданий, выполняемых потоками-исполнителями.
+   *
+   * Задания выполняются в порядке поступления; по завершении каждого задания вызывается
+   * функция обработки результата (в потоке-исполнителе, одновременно для разных заданий).
+   */
+  class pool {
+
+  private:
+
+    /** \brief Функция выполнения задания */
+    job_func func;
+
+    /** \brief Функция обработки результата задания */
+    std::function<void(const job_t&, const result_t&)> done;
+
+    /** \brief Очередь заданий */
+    std::deque<job_t> queue;
+
+    /** \brief Блокировка очереди и счётчиков */
+    std::mutex m;
+
+    /** \brief Оповещение исполнителей о новом задании или закрытии очереди */
+    std::condition_variable cv;
+
+    /** \brief Новые задания не поступают */
+    bool closed;
+
+    /** \brief Количество выполняемых заданий */
+    unsigned running;
+
+    /** \brief Количество выполненных заданий */
+    unsigned finished;
+
+    /** \brief Количество заданий, завершившихся с ошибкой */
+    unsigned failed;
+
+    /** \brief Потоки-исполнители */
+    std::vector<std::thread> workers;
+
+    /**
+     * \brief Цикл потока-исполнителя: выполнять задания из очереди до её закрытия и опустошения.
+     */
+    void work() {
+      for (;;) {
+        job_t job;
+        {
+          std::unique_lock<std::mutex> lock(m);
+          cv.wait(lock, [this]() { return closed || !queue.empty(); });
+          if (queue.empty()) return;
+          job = std::move(queue.front());
+          queue.pop_front();
+          ++running;
+        }
+        result_t result;
+        const uint64_t start = trace::now();
+        messages = &result.messages;
+        result.err = func(job.directives, result.stages);
+        std::cout.flush();
+        messages = nullptr;
+        result.time = trace::now() - start;
+        {
+          std::lock_guard<std::mutex> lock(m);
+          --running;
+          ++finished;
+          if (result.err != err_enum_t::ERROR_OK) ++failed;
+        }
+        done(job, result);
+      }
+    }
+
+  public:
+
+    /**
+     * \brief Конструктор: запустить потоки-исполнители.
+     *
+     * \param [in] f функция выполнения задания
+     * \param [in] d функция обработки результата задания
+     * \param [in] n количество потоков-исполнителей
+     */
+    pool(job_func f, std::function<void(const job_t&, const result_t&)> d, unsigned n) :
+      func(f), done(std::move(d)), closed(false), running(0), finished(0), failed(0) {
+      for (unsigned i = 0; i < std::max(n, 1u); ++i) {
+        workers.emplace_back(&pool::work, this);
+      }
+    }
+
+    ~pool() {
+      wait();
+    }
+
+    pool(const pool&) = delete;
+    pool& operator=(const pool&) = delete;
+
+    /**
+     * \brief Добавить задание в очередь.
+     *
+     * \param [in] job задание
+     */
+    void add(job_t job) {
+      {
+        std::lock_guard<std::mutex> lock(m);
+        queue.push_back(std::move(job));
+      }
+      cv.notify_one();
+    }
+
+    /**
+     * \brief Закрыть очередь и дождаться выполнения всех заданий.
+     */
+    void wait() {
+      {
+        std::lock_guard<std::mutex> lock(m);
+        closed = true;
+      }
+      cv.notify_all();
+      for (auto it = workers.begin(); it != workers.end(); ++it) {
+        if ((*it).joinable()) (*it).join();
+      }
+    }
+
+    /**
+     * \brief Получить состояние очереди.
+     *
+     * \param [out] q_queued количество заданий в очереди
+     * \param [out] q_running количество выполняемых заданий
+     * \param [out] q_finished количество выполненных заданий
+     * \param [out] q_failed количество заданий, завершившихся с ошибкой
+     */
+    void status(unsigned& q_queued, unsigned& q_running, unsigned& q_finished, unsigned& q_failed) {
+      std::lock_guard<std::mutex> lock(m);
+      q_queued = static_cast<unsigned>(queue.size());
+      q_running = running;
+      q_finished = finished;
+      q_failed = failed;
+    }
+  };
+
+  /**
+   * \brief Получить название кода ошибки.
+   *
+   * \param [in] err код ошибки
+   * \return название кода
+   */
+  static const char* err_name(err_enum_t err) {
+    switch (err) {
+      case err_enum_t::ERROR_OK:         return "OK";
+      case err_enum_t::ERROR_CMD_FORMAT: return "ERROR_CMD_FORMAT";
+      case err_enum_t::ERROR_FILE_IO:    return "ERROR_FILE_IO";
+      case err_enum_t::ERROR_IMPORT:     return "ERROR_IMPORT";
+      case err_enum_t::ERROR_INTERNAL:   return "ERROR_INTERNAL";
+    }
+    return "ERROR";
+  }
+
+  /**
+   * \brief Сформировать строку результата задания вида
+   * "job N: OK (0), 12.345 ms; import 1.234, weld 0.100, ...".
+   *
+   * \param [in] job задание
+   * \param [in] result результат задания
+   * \return строка результата
+   */
+  static std::string result_line(const job_t& job, const result_t& result) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3) << "job " << job.id << ": " << err_name(result.err) <<
+      " (" << static_cast<int>(result.err) << "), " << static_cast<double>(result.time) / 1.E6 << " ms";
+    for (auto it = result.stages.cbegin(); it != result.stages.cend(); ++it) {
+      ss << (it == result.stages.cbegin() ? "; " : ", ") << (*it).first << " " << static_cast<double>((*it).second) / 1.E6;
+    }
+    return ss.str();
+  }
+
+  /**
+   * \brief Сформировать строки сообщений задания, каждую с новой строки и с отступом "    | ".
+   *
+   * \param [in] messages сообщения задания
+   * \return строки сообщений (пустая строка, если сообщений нет)
+   */
+  static std::string message_lines(const std::string& messages) {
+    std::string text, line;
+    std::stringstream ss(messages);
+    while (std::getline(ss, line)) {
+      text += "\n    | " + line;
+    }
+    return text;
+  }
+
+  /**
+   * \brief Вывод строк результатов заданий на время их выполнения.
+   *
+   * Пока существует объект, сообщения преобразователя (std::cout) собираются по заданиям
+   * (см. \ref job_streambuf), а строки результатов выводятся в исходный буфер стандартного
+   * вывода целиком, по одной.
+   */
+  class console {
+
+  private:
+
+    /** \brief Буфер сообщений заданий */
+    job_streambuf jobs_buf;
+
+    /** \brief Исходный буфер стандартного вывода */
+    std::streambuf* buf;
+
+    /** \brief Поток вывода в исходный буфер */
+    std::ostream out;
+
+    /** \brief Блокировка вывода строк из разных потоков */
+    std::mutex m;
+
+  public:
+
+    console() : buf(std::cout.rdbuf(&jobs_buf)), out(buf) {
+      is_active = true;
+    }
+
+    ~console() {
+      is_active = false;
+      std::cout.rdbuf(buf);
+    }
+
+    console(const console&) = delete;
+    console& operator=(const console&) = delete;
+
+    /**
+     * \brief Вывести строку.
+     *
+     * \param [in] line строка
+     */
+    void send(const std::string& line) {
+      std::lock_guard<std::mutex> lock(m);
+      out << line << std::endl;
+    }
+  };
+
+  err_enum_t serve(job_func func, const std::string& prefix, unsigned workers) {
+    console con;
+    auto send = [&con](const std::string& line) { con.send(line); };
+
+    const uint64_t start = trace::now();
+    unsigned jobs_num = 0;
+    {
+      /** За строкой ответа задания с ошибкой следуют его сообщения (выводятся вместе, одним блоком) */
+      pool p(func, [&send](const job_t& job, const result_t& result) {
+        send(result_line(job, result) + (result.err == err_enum_t::ERROR_OK ? std::string() : message_lines(result.messages)));
+      }, workers);
+      send("ready: " + std::to_string(std::max(workers, 1u)) + " workers");
+
+      std::string line;
+      while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        const size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') continue;
+        line.erase(0, first);
+        if (line.compare("quit") == 0) break;
+        if (line.compare("status") == 0) {
+          unsigned queued, running, finished, failed;
+          p.status(queued, running, finished, failed);
+          send("status: " + std::to_string(queued) + " queued, " + std::to_string(running) + " running, " +
+            std::to_string(finished) + " finished, " + std::to_string(failed) + " failed");
+          continue;
+        }
+        p.add({ ++jobs_num, prefix.empty() ? line : prefix + " " + line });
+      }
+      p.wait();
+
+      unsigned queued, running, finished, failed;
+      p.status(queued, running, finished, failed);
+      std::stringstream ss;
+      ss << std::fixed << std::setprecision(3) << "done: " << finished << " jobs, " << failed << " failed, " <<
+        static_cast<double>(trace::now() - start) / 1.E6 << " ms";
+      send(ss.str());
+    }
+    return err_enum_t::ERROR_OK;
+  }
+
+  err_enum_t batch(job_func func, const std::string& prefix, const std::string& manifest, unsigned workers) {
+    /** Прочитать задания; строка, оканчивающаяся символом '\\', продолжается следующей */
+    std::ifstream in(manifest);
+    if (!in.is_open()) {
+      std::cout << "Ошибка чтения файла задания '" << manifest << "'" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    std::vector<job_t> list;
+    std::string line, text;
+    while (std::getline(in, line)) {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      if (!line.empty() && line.back() == '\\') {
+        line.back() = ' ';
+        text += line;
+        continue;
+      }
+      text += line;
+      const size_t first = text.find_first_not_of(" \t");
+      if (first != std::string::npos && text[first] != '#') {
+        list.push_back({ static_cast<unsigned>(list.size() + 1), prefix.empty() ? text.substr(first) : prefix + " " + text.substr(first) });
+      }
+      text.clear();
+    }
+    if (in.bad()) {
+      std::cout << "Ошибка чтения файла задания '" << manifest << "'" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+
+    /** Выполнить задания, сохраняя результаты по номерам заданий */
+    std::vector<result_t> results(list.size());
+    const uint64_t start = trace::now();
+    uint64_t full_time;
+    {
+      console con;
+      con.send("Пакетное преобразование '" + manifest + "': " + std::to_string(list.size()) + " заданий, " +
+        std::to_string(std::max(workers, 1u)) + " исполнителей");
+      pool p(func, [&con, &results](const job_t& job, const result_t& result) {
+        results[job.id - 1] = result;
+        /** Сообщения сохраняются только для отчёта о заданиях с ошибкой */
+        if (result.err == err_enum_t::ERROR_OK) std::string().swap(results[job.id - 1].messages);
+        con.send(result_line(job, result));
+      }, workers);
+      for (auto it = list.cbegin(); it != list.cend(); ++it) {
+        p.add(*it);
+      }
+      p.wait();
+      full_time = trace::now() - start;
+    }
+
+    /** Общий отчёт: время заданий и этапов суммируется по всем заданиям */
+    uint64_t jobs_time = 0;
+    unsigned failed = 0;
+    err_enum_t err = err_enum_t::ERROR_OK;
+    stages_t totals;
+    for (auto it = results.cbegin(); it != results.cend(); ++it) {
+      jobs_time += (*it).time;
+      if ((*it).err != err_enum_t::ERROR_OK) {
+        ++failed;
+        if (err == err_enum_t::ERROR_OK) err = (*it).err;
+      }
+      for (size_t i = 0; i < (*it).stages.size(); ++i) {
+        if (totals.size() <= i) totals.emplace_back((*it).stages[i].first, 0);
+        totals[i].second += (*it).stages[i].second;
+      }
+    }
+
+    std::cout << std::endl << "Итог пакетного преобразования:" << std::endl;
+    std::cout << "Заданий:                      " << std::setw(12) << results.size() << " (с ошибкой: " << failed << ")" << std::endl;
+    std::cout << "Всего затрачено времени:      " << std::setw(12) << std::fixed << std::setprecision(3) << static_cast<double>(full_time) / 1.E6 << " ms" << std::endl;
+    std::cout << "Сумма времени заданий:        " << std::setw(12) << static_cast<double>(jobs_time) / 1.E6 << " ms";
+    if (full_time != 0) {
+      std::cout << " (в среднем одновременно " << std::setprecision(2) << static_cast<double>(jobs_time) / static_cast<double>(full_time) << ")";
+    }
+    std::cout << std::endl;
+    if (!totals.empty()) {
+      std::cout << "Сумма времени этапов по успешным заданиям:" << std::endl;
+      for (auto it = totals.cbegin(); it != totals.cend(); ++it) {
+        std::cout << "  " << std::left << std::setw(28) << (*it).first << std::right << std::setw(12) <<
+          std::setprecision(3) << static_cast<double>((*it).second) / 1.E6 << " ms" << std::endl;
+      }
+    }
+    if (failed != 0) {
+      std::cout << "Задания с ошибкой:" << std::endl;
+      for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].err == err_enum_t::ERROR_OK) continue;
+        std::cout << "  job " << list[i].id << ": " << err_name(results[i].err) << " (" << static_cast<int>(results[i].err) << "): " <<
+          list[i].directives << message_lines(results[i].messages) << std::endl;
+      }
+    }
+    return err;
+  }
+}
@@ -0,0 +1,87 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлениями функций выполнения заданий преобразования
+ * несколькими потоками в одном процессе
+ *
+ * Задание - строка директив в том же виде, что и командная строка программы (например,
+ * "--color 1 0 0 --stl in.stl --out out.step"). Задания поступают со стандартного ввода
+ * (режим сервера) или из файла задания (пакетный режим) и выполняются потоками-исполнителями
+ * одновременно, каждое со своими структурами файла STEP, без повторного запуска программы.
+ */
+
+#ifndef _JOBS_H
+#define _JOBS_H
+
+#include <string>
+#include <vector>
+#include "err.h"
+
+namespace jobs {
+
+  /** \brief Время этапов обработки: пары "название этапа - время в наносекундах" */
+  typedef std::vector<std::pair<std::string, uint64_t> > stages_t;
+
+  /**
+   * \brief Функция выполнения одного задания.
+   *
+   * \param [in] directives строка директив
+   * \param [out] stages время этапов обработки (в случае успешного завершения)
+   * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+   */
+  typedef err_enum_t (*job_func)(const std::string& directives, stages_t& stages);
+
+  /**
+   * \brief Выполнять задания, поступающие построчно со стандартного ввода (режим сервера).
+   *
+   * Каждая строка стандартного ввода - одно задание; пустые строки и строки, начинающиеся
+   * с символа '#', пропускаются. Строка "status" - запрос количества заданий в очереди,
+   * выполняемых, выполненных и завершившихся с ошибкой; строка "quit" или конец ввода -
+   * завершение работы после выполнения всех принятых заданий. Задания нумеруются с 1
+   * в порядке поступления. На стандартный вывод по мере выполнения заданий выводятся
+   * строки ответов с номером задания, кодом завершения, общим временем и временем этапов;
+   * сообщения преобразователя собираются отдельно для каждого задания, и за строкой ответа
+   * задания с ошибкой следуют его сообщения, по одному в строке с отступом "    | ".
+   *
+   * Между заданиями сохраняются процесс, потоки-исполнители и кэш обработанных фигур;
+   * потоки разбора файлов STL и записи файла STEP (флаг --threads) каждое задание
+   * создаёт заново, как при отдельном запуске программы.
+   *
+   * \param [in] func функция выполнения задания
+   * \param [in] prefix директивы, добавляемые перед директивами каждого задания
+   * \param [in] workers количество потоков-исполнителей
+   * \return \ref err_enum_t::ERROR_OK "ERROR_OK"
+   */
+  err_enum_t serve(job_func func, const std::string& prefix, unsigned workers);
+
+  /**
+   * \brief Выполнить задания из файла задания (пакетный режим) и вывести общий отчёт.
+   *
+   * Файл задания содержит задания по одному в строке, как стандартный ввод режима сервера
+   * (см. \ref serve); строка, оканчивающаяся символом '\\', продолжается следующей строкой.
+   * Все задания ставятся в очередь сразу и выполняются одновременно; по мере выполнения
+   * выводятся строки результатов заданий, а после выполнения всех заданий - общий отчёт:
+   * количество заданий и заданий с ошибкой, общее время, сумма времени заданий и времени
+   * каждого этапа по всем заданиям, список заданий с ошибкой. Сообщения преобразователя
+   * собираются отдельно для каждого задания и выводятся в общем отчёте под строкой
+   * задания с ошибкой.
+   *
+   * \param [in] func функция выполнения задания
+   * \param [in] prefix директивы, добавляемые перед директивами каждого задания
+   * \param [in] manifest имя файла задания
+   * \param [in] workers количество потоков-исполнителей
+   * \return \ref err_enum_t::ERROR_OK "ERROR_OK", если все задания выполнены успешно,
+   * \ref err_enum_t::ERROR_FILE_IO "ERROR_FILE_IO", если файл задания не удалось прочитать,
+   * иначе код ошибки первого (по номеру) задания, завершившегося с ошибкой.
+   */
+  err_enum_t batch(job_func func, const std::string& prefix, const std::string& manifest, unsigned workers);
+
+  /**
+   * \brief Проверить, выполняются ли задания (режим сервера или пакетный режим).
+   *
+   * \return true, если стандартный вывод преобразователя собирается по заданиям
+   */
+  bool active();
+}
+
+#endif /* _JOBS_H */
@@ -0,0 +1,69 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями методов класса файла, отображённого в память
+ */
+
+#include "stdafx.h"
+#if defined(__GNUC__) && !defined(__MINGW32__)
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "mapped_file.h"
+
+mapped_file::~mapped_file() {
+#if defined(__GNUC__) && !defined(__MINGW32__)
+  if (map != nullptr) munmap(map, size);
+#endif
+}
+
+/**
+ * \file
+ * * \copybrief mapped_file::open(const std::string&)
+ */
+bool mapped_file::open(const std::string& fname) {
+#if defined(__GNUC__) && !defined(__MINGW32__)
+  /** Именованный канал и другие специальные файлы читаются последовательно, без открытия здесь */
+  struct stat fst;
+  if (stat(fname.c_str(), &fst) != 0 || !S_ISREG(fst.st_mode)) return false;
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+  size = static_cast<size_t>(st.st_size);
+  map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    map = nullptr;
+    return false;
+  }
+  data = static_cast<const char*>(map);
+  return true;
+#else
+  struct _stat64 fst;
+  if (_stat64(fname.c_str(), &fst) != 0 || (fst.st_mode & _S_IFREG) == 0) return false;
+  FILE* in;
+# if defined(_MSC_VER)
+  if (fopen_s(&in, fname.c_str(), "rb") != 0 || in == nullptr) return false;
+# else
+  in = fopen(fname.c_str(), "rb");
+  if (in == nullptr) return false;
+# endif
+  char Buf[64 * 1024];
+  for (;;) {
+    size_t n = fread(Buf, 1, sizeof(Buf), in);
+    if (n == 0) break;
+    buf.insert(buf.end(), Buf, Buf + n);
+  }
+  fclose(in);
+  data = buf.data();
+  size = buf.size();
+  return size > 0;
+#endif
+}
@@ -0,0 +1,65 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлением класса файла, отображённого в память
+ */
+
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * \brief Файл, целиком отображённый (или, где отображение недоступно, прочитанный) в память.
+ */
+class mapped_file {
+
+private:
+
+  /** \brief Адрес содержимого файла */
+  const char* data;
+
+  /** \brief Размер файла */
+  size_t size;
+
+#if defined(__GNUC__) && !defined(__MINGW32__)
+  /** \brief Адрес отображения или nullptr */
+  void* map;
+#else
+  /** \brief Содержимое файла */
+  std::vector<char> buf;
+#endif
+
+public:
+
+  mapped_file() : data(nullptr), size(0)
+#if defined(__GNUC__) && !defined(__MINGW32__)
+    , map(nullptr)
+#endif
+  {
+  }
+
+  ~mapped_file();
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  /**
+   * \brief Отобразить файл в память.
+   *
+   * Именованный канал и другие специальные файлы, а также пустой файл не отображаются.
+   *
+   * \param [in] fname имя файла
+   * \return true в случае успешного завершения
+   */
+  bool open(const std::string& fname);
+
+  /** \brief Получить адрес содержимого файла */
+  const char* get_data() const { return data; }
+
+  /** \brief Получить размер файла */
+  size_t get_size() const { return size; }
+};
+
+#endif /* _MAPPED_FILE_H */
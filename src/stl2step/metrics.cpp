@@ -0,0 +1,304 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями функций сбора показателей обработки
+ */
+
+#include "stdafx.h"
+#include <map>
+#if defined(_MSC_VER) || defined(__MINGW32__)
+# include <psapi.h>
+#else
+# include <sys/resource.h>
+#endif
+#include "err.h"
+#include "metrics.h"
+#include "trace.h"
+
+namespace metrics {
+
+  /**
+   * \brief Показатели одного входного файла
+   */
+  struct file_metrics {
+    /** Имя файла */
+    std::string name;
+    /** Время начала обработки файла, нс */
+    uint64_t start;
+    /** Время последнего изменения показателей файла, нс */
+    uint64_t last;
+    /** Счётчики в порядке первого изменения */
+    std::vector<std::pair<std::string, long long> > counters;
+  };
+
+  /**
+   * \brief Пиковый объём памяти после этапа
+   */
+  struct phase_rss {
+    /** Имя этапа */
+    std::string name;
+    /** Номер входного файла (с 1) или 0 для этапов, общих для всех файлов */
+    size_t file;
+    /** Пиковый объём памяти процесса, байт */
+    long long bytes;
+  };
+
+  /** \brief Сбор показателей включён */
+  static std::atomic<bool> is_enabled(false);
+
+  /** \brief Защита показателей от одновременного изменения из разных потоков */
+  static std::mutex metrics_mutex;
+
+  /** \brief Время включения сбора показателей, нс */
+  static uint64_t origin = 0;
+
+  /** \brief Общие счётчики в порядке первого изменения */
+  static std::vector<std::pair<std::string, long long> > totals;
+
+  /** \brief Показатели входных файлов */
+  static std::vector<file_metrics> files;
+
+  /** \brief Показатели добавляются к последнему входному файлу */
+  static bool file_open = false;
+
+  /** \brief Количество экземпляров STEP по типам */
+  static std::map<std::string, long long> entities;
+
+  /** \brief Пиковый объём памяти после этапов */
+  static std::vector<phase_rss> phases;
+
+  /**
+   * \brief Добавить значение к счётчику из списка (счётчик создаётся при первом изменении).
+   *
+   * \param [in,out] counters список счётчиков
+   * \param [in] name имя счётчика
+   * \param [in] value добавляемое значение
+   */
+  static void add_counter(std::vector<std::pair<std::string, long long> >& counters, const char* name, long long value) {
+    for (auto it = counters.begin(); it != counters.end(); ++it) {
+      if ((*it).first.compare(name) == 0) {
+        (*it).second += value;
+        return;
+      }
+    }
+    counters.emplace_back(name, value);
+  }
+
+  /**
+   * \brief Получить значение счётчика из списка.
+   *
+   * \param [in] counters список счётчиков
+   * \param [in] name имя счётчика
+   * \return значение счётчика или 0, если счётчик не изменялся
+   */
+  static long long get_counter(const std::vector<std::pair<std::string, long long> >& counters, const char* name) {
+    for (auto it = counters.cbegin(); it != counters.cend(); ++it) {
+      if ((*it).first.compare(name) == 0) return (*it).second;
+    }
+    return 0;
+  }
+
+  /**
+   * \brief Добавить к тексту JSON строку в кавычках с экранированием специальных символов.
+   *
+   * \param [in,out] text текст JSON
+   * \param [in] s строка
+   */
+  static void append_quoted(std::string& text, const std::string& s) {
+    text += '"';
+    for (auto it = s.cbegin(); it != s.cend(); ++it) {
+      const unsigned char c = static_cast<unsigned char>(*it);
+      if (c == '"' || c == '\\') {
+        text += '\\';
+        text += *it;
+      } else if (c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        text += buf;
+      } else {
+        text += *it;
+      }
+    }
+    text += '"';
+  }
+
+  /**
+   * \brief Добавить к тексту JSON счётчики и производные показатели производительности.
+   *
+   * \param [in,out] text текст JSON
+   * \param [in] counters список счётчиков
+   * \param [in] elapsed время обработки, нс
+   * \param [in] indent отступ строк
+   */
+  static void append_counters(std::string& text, const std::vector<std::pair<std::string, long long> >& counters, uint64_t elapsed, const char* indent) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(elapsed) / 1.E6);
+    text += indent;
+    text += "\"elapsed_ms\": ";
+    text += buf;
+    const double seconds = static_cast<double>(elapsed) / 1.E9;
+    const long long triangles = get_counter(counters, "triangles_imported");
+    if (seconds > 0.0 && triangles > 0) {
+      snprintf(buf, sizeof(buf), "%.0f", static_cast<double>(triangles) / seconds);
+      text += ",\n";
+      text += indent;
+      text += "\"triangles_per_second\": ";
+      text += buf;
+    }
+    const long long bytes = get_counter(counters, "bytes_written");
+    if (seconds > 0.0 && bytes > 0) {
+      snprintf(buf, sizeof(buf), "%.0f", static_cast<double>(bytes) / seconds);
+      text += ",\n";
+      text += indent;
+      text += "\"bytes_written_per_second\": ";
+      text += buf;
+    }
+    for (auto it = counters.cbegin(); it != counters.cend(); ++it) {
+      text += ",\n";
+      text += indent;
+      append_quoted(text, (*it).first);
+      text += ": " + std::to_string((*it).second);
+    }
+  }
+
+  void enable() {
+    origin = trace::now();
+    is_enabled = true;
+  }
+
+  bool enabled() {
+    return is_enabled;
+  }
+
+  void begin_file(const std::string& name) {
+    if (!is_enabled) return;
+    const uint64_t t = trace::now();
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    files.push_back(file_metrics{ name, t, t, std::vector<std::pair<std::string, long long> >() });
+    file_open = true;
+  }
+
+  void end_file() {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    file_open = false;
+  }
+
+  void add(const char* name, long long value) {
+    if (!is_enabled) return;
+    const uint64_t t = trace::now();
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    add_counter(totals, name, value);
+    if (file_open) {
+      add_counter(files.back().counters, name, value);
+      files.back().last = t;
+    }
+  }
+
+  void phase(const char* name) {
+    if (!is_enabled) return;
+    const long long bytes = peak_rss();
+    const uint64_t t = trace::now();
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    phases.push_back(phase_rss{ name, file_open ? files.size() : 0, bytes });
+    if (file_open) files.back().last = t;
+  }
+
+  void count_entities(const char* data, size_t size) {
+    if (!is_enabled) return;
+    std::map<std::string, long long> counts;
+    const char* end = data + size;
+    for (const char* p = data; p < end;) {
+      const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+      const char* next = (eol == nullptr) ? end : eol + 1;
+      /** Строка экземпляра начинается с "#N = " */
+      if (*p == '#') {
+        const char* eq = static_cast<const char*>(memchr(p, '=', next - p));
+        if (eq != nullptr) {
+          const char* k = eq + 1;
+          while (k < next && *k == ' ') ++k;
+          const char* k_end = k;
+          while (k_end < next && *k_end != '(' && *k_end != ' ') ++k_end;
+          if (k_end == k) {
+            counts["COMPLEX_ENTITY"]++;
+          } else {
+            counts[std::string(k, k_end)]++;
+          }
+        }
+      }
+      p = next;
+    }
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+      entities[(*it).first] += (*it).second;
+    }
+  }
+
+  long long peak_rss() {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return static_cast<long long>(pmc.PeakWorkingSetSize);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+# if defined(__APPLE__)
+    return static_cast<long long>(usage.ru_maxrss);
+# else
+    /** В Linux размер возвращается в килобайтах */
+    return static_cast<long long>(usage.ru_maxrss) * 1024;
+# endif
+#endif
+  }
+
+  err_enum_t write(const std::string& name) {
+    std::string text = "{\n  \"totals\": {\n";
+    {
+      std::lock_guard<std::mutex> lock(metrics_mutex);
+
+      append_counters(text, totals, trace::now() - origin, "    ");
+      text += "\n  },\n  \"files\": [";
+      for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        text += (it == files.cbegin()) ? "\n" : ",\n";
+        text += "    {\n      \"file\": ";
+        append_quoted(text, (*it).name);
+        text += ",\n";
+        append_counters(text, (*it).counters, (*it).last - (*it).start, "      ");
+        text += "\n    }";
+      }
+      text += "\n  ],\n  \"entities\": {";
+      long long entities_num = 0;
+      for (auto it = entities.cbegin(); it != entities.cend(); ++it) {
+        text += (it == entities.cbegin()) ? "\n    " : ",\n    ";
+        append_quoted(text, (*it).first);
+        text += ": " + std::to_string((*it).second);
+        entities_num += (*it).second;
+      }
+      text += "\n  },\n  \"entities_total\": " + std::to_string(entities_num);
+      text += ",\n  \"peak_rss\": [";
+      for (auto it = phases.cbegin(); it != phases.cend(); ++it) {
+        text += (it == phases.cbegin()) ? "\n" : ",\n";
+        text += "    { \"phase\": ";
+        append_quoted(text, (*it).name);
+        text += ", \"file\": " + std::to_string((*it).file) + ", \"bytes\": " + std::to_string((*it).bytes) + " }";
+      }
+      text += "\n  ]\n}\n";
+    }
+
+    FILE* out;
+#if defined(_MSC_VER)
+    if (fopen_s(&out, name.c_str(), "wb") != 0) out = nullptr;
+#else
+    out = fopen(name.c_str(), "wb");
+#endif
+    if (out == nullptr) {
+      std::cout << "ERROR (metrics::write): can't open file '" << name << "' for writing" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    const bool ok = fwrite(text.data(), 1, text.size(), out) == text.size();
+    if (fclose(out) != 0 || !ok) {
+      std::cout << "ERROR (metrics::write): can't write file '" << name << "'" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    return err_enum_t::ERROR_OK;
+  }
+}
@@ -0,0 +1,87 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлениями функций сбора показателей обработки
+ *
+ * Этапы обработки (импорт, построение топологии, объединение граней, создание и запись
+ * экземпляров STEP) сообщают объём выполненной работы в виде именованных счётчиков.
+ * Счётчики суммируются по всем файлам и отдельно для каждого входного файла, после
+ * каждого этапа запоминается пиковый объём занятой процессом памяти. Показатели
+ * записываются в файл JSON. Пока сбор не включён, функции сбора ничего не делают.
+ */
+
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include "err.h"
+
+namespace metrics {
+
+  /**
+   * \brief Включить сбор показателей.
+   */
+  void enable();
+
+  /**
+   * \brief Проверка: сбор показателей включён.
+   *
+   * \return true, если показатели собираются
+   */
+  bool enabled();
+
+  /**
+   * \brief Начать сбор показателей очередного входного файла.
+   *
+   * \param [in] name имя файла
+   */
+  void begin_file(const std::string& name);
+
+  /**
+   * \brief Завершить сбор показателей входного файла: следующие значения добавляются
+   * только к общим счётчикам.
+   */
+  void end_file();
+
+  /**
+   * \brief Добавить значение к счётчику (общему и текущего файла).
+   *
+   * \param [in] name имя счётчика
+   * \param [in] value добавляемое значение
+   */
+  void add(const char* name, long long value);
+
+  /**
+   * \brief Запомнить пиковый объём памяти процесса после завершения этапа.
+   *
+   * \param [in] name имя этапа
+   */
+  void phase(const char* name);
+
+  /**
+   * \brief Подсчитать экземпляры STEP по типам в тексте ISO 10303-21.
+   *
+   * Текст должен состоять из целых строк вида "#N = ТИП(...);", экземпляры сложного
+   * объекта ("#N = (...);") считаются как COMPLEX_ENTITY.
+   *
+   * \param [in] data текст
+   * \param [in] size длина текста
+   */
+  void count_entities(const char* data, size_t size);
+
+  /**
+   * \brief Получить пиковый объём памяти процесса (resident set size).
+   *
+   * \return объём памяти в байтах или 0, если он не может быть получен
+   */
+  long long peak_rss();
+
+  /**
+   * \brief Записать собранные показатели в файл JSON.
+   *
+   * \param [in] name имя файла
+   * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+   */
+  err_enum_t write(const std::string& name);
+}
+
+#endif /* _METRICS_H */
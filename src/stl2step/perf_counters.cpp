@@ -0,0 +1,120 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями функций чтения аппаратных счётчиков процессора
+ */
+
+#include "stdafx.h"
+#if defined(__linux__)
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+#endif
+#include "perf_counters.h"
+
+namespace perf {
+
+  /** \brief Названия счётчиков */
+  static const char* const counter_names[PERF_COUNTERS_NUM] = {
+    "cycles", "instructions", "cache-misses", "branch-misses"
+  };
+
+#if defined(__linux__)
+
+  /** \brief События счётчиков */
+  static const uint64_t counter_events[PERF_COUNTERS_NUM] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  /** \brief Дескрипторы счётчиков или -1 */
+  static int fds[PERF_COUNTERS_NUM] = { -1, -1, -1, -1 };
+
+  /** \brief Счётчики открыты (дескрипторы записаны до установки признака) */
+  static std::atomic<bool> is_open(false);
+
+  /** \brief Защита дескрипторов при открытии счётчиков */
+  static std::mutex open_mutex;
+
+  /**
+   * \brief Открыть один счётчик.
+   *
+   * Счётчики открываются по отдельности, а не группой: значения наследуемых счётчиков
+   * нельзя читать группой.
+   *
+   * \param [in] config событие счётчика
+   * \return дескриптор счётчика или -1
+   */
+  static int open_counter(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+#endif
+
+  bool enable() {
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(open_mutex);
+    if (is_open) return true;
+    for (size_t i = 0; i < PERF_COUNTERS_NUM; ++i) {
+      fds[i] = open_counter(counter_events[i]);
+      if (fds[i] == -1) {
+        std::cout << "WARNING (perf): аппаратный счётчик '" << counter_names[i] << "' недоступен (" << strerror(errno) <<
+          "), профилирование без аппаратных счётчиков" << std::endl;
+        for (size_t k = 0; k < i; ++k) {
+          close(fds[k]);
+          fds[k] = -1;
+        }
+        return false;
+      }
+    }
+    for (size_t i = 0; i < PERF_COUNTERS_NUM; ++i) {
+      ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    is_open = true;
+    return true;
+#else
+    std::cout << "WARNING (perf): аппаратные счётчики поддерживаются только в Linux, профилирование без аппаратных счётчиков" << std::endl;
+    return false;
+#endif
+  }
+
+  bool enabled() {
+#if defined(__linux__)
+    return is_open;
+#else
+    return false;
+#endif
+  }
+
+  void read(counts& c) {
+    c = counts();
+#if defined(__linux__)
+    if (!is_open) return;
+    for (size_t i = 0; i < PERF_COUNTERS_NUM; ++i) {
+      /** Формат счётчика: значение, время включения, время работы */
+      uint64_t buf[3];
+      if (::read(fds[i], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf))) continue;
+      /** При разделении аппаратных счётчиков между событиями значения масштабируются на время работы */
+      const uint64_t time_enabled = buf[1];
+      const uint64_t time_running = buf[2];
+      c.values[i] = (time_running == 0 || time_running >= time_enabled) ? buf[0] :
+        static_cast<uint64_t>(static_cast<double>(buf[0]) * static_cast<double>(time_enabled) / static_cast<double>(time_running));
+    }
+#endif
+  }
+
+  const char* name(size_t index) {
+    return index < PERF_COUNTERS_NUM ? counter_names[index] : "";
+  }
+}
@@ -0,0 +1,65 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлениями функций чтения аппаратных счётчиков процессора
+ *
+ * В Linux счётчики тактов, команд, промахов кэша и ошибок предсказания переходов
+ * открываются системным вызовом perf_event_open для основного потока с наследованием
+ * потоками, которые он создаёт после открытия счётчиков (разбор частей файла STL, отображение
+ * частей файла STEP, фоновая запись). Значения потока добавляются к счётчикам после его
+ * завершения, поэтому этап, потоки которого завершаются до его окончания, учитывается
+ * целиком (учитывается только пользовательский код). Если счётчики недоступны (нет поддержки
+ * в ядре или виртуальной машине, запрет kernel.perf_event_paranoid, другая ОС), выводится
+ * предупреждение и обработка продолжается без них.
+ */
+
+#ifndef _PERF_COUNTERS_H
+#define _PERF_COUNTERS_H
+
+/** \brief Количество аппаратных счётчиков */
+#define PERF_COUNTERS_NUM 4
+
+namespace perf {
+
+  /**
+   * \brief Значения аппаратных счётчиков
+   */
+  struct counts {
+    /** Такты, команды, промахи кэша последнего уровня, ошибки предсказания переходов */
+    uint64_t values[PERF_COUNTERS_NUM];
+
+    /** \brief Конструктор нулевых значений */
+    counts() : values() {}
+  };
+
+  /**
+   * \brief Открыть аппаратные счётчики для текущего потока и создаваемых им потоков.
+   *
+   * \return true, если счётчики открыты; false, если они недоступны (с выводом предупреждения)
+   */
+  bool enable();
+
+  /**
+   * \brief Проверка: аппаратные счётчики открыты.
+   *
+   * \return true, если счётчики открыты
+   */
+  bool enabled();
+
+  /**
+   * \brief Прочитать текущие значения счётчиков (нарастающим итогом).
+   *
+   * \param [out] c значения счётчиков (нули, если счётчики недоступны)
+   */
+  void read(counts& c);
+
+  /**
+   * \brief Получить название счётчика.
+   *
+   * \param [in] index номер счётчика
+   * \return название счётчика
+   */
+  const char* name(size_t index);
+}
+
+#endif /* _PERF_COUNTERS_H */
@@ -8,11 +8,36 @@
 #ifndef _PRECISION_H
 #define _PRECISION_H
 
+#if defined(GEOMETRY_FLOAT)
+/**
+ * Точность сравнения координат, она же погрешность измерения длины, указанная в файле STEP
+ * (для координат типа float - с учётом семи значащих цифр числа float)
+ */
+#define EPSILON_X   1.E-5
+#else
 /** Точность сравнения координат, она же погрешность измерения длины, указанная в файле STEP */
 #define EPSILON_X   1.E-7
+#endif
 /** Точность сравнения нормалей граней (определение, лежат ли треугольники в одной плоскости) */
 #define EPSILON_Y   8.E-3
-/** Точность сравнения координат при поиске клонов */
+/**
+ * Точность сравнения координат при поиске клонов, абсолютная (в единицах модели).
+ * Координаты файла STL - числа float, поэтому точность уже допускает их погрешность
+ * округления (единица младшего разряда float для координат до ~1000 - не более 6.E-5);
+ * при координатах типа float добавляется не более половины единицы младшего разряда
+ * при вычитании условного центра фигуры (он вычисляется в double), поэтому значение
+ * не изменяется
+ */
 #define EPSILON_C   1.E-4
+/**
+ * Допустимое отклонение вершины объединяемой грани от плоскости объединённой грани,
+ * абсолютное (в единицах модели). Расстояние вычисляется в double (см.
+ * geometry::predicates::in_plane), а координаты типа float отличаются от исходных
+ * координат файла STL не более чем на половину единицы младшего разряда float, что
+ * для моделей размером до ~1000 много меньше допуска, поэтому значение не изменяется
+ */
+#define EPSILON_P   1.E-4
+/** Допустимое отклонение нормали из файла STL от нормали, вычисленной по вершинам треугольника */
+#define EPSILON_N   1.E-3
 
 #endif /* _PRECISION_H */
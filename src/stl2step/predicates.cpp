@@ -0,0 +1,361 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями функций геометрических предикатов с адаптивной точностью
+ *
+ * Разложение (expansion) - это последовательность неперекрывающихся чисел double,
+ * упорядоченная по возрастанию модуля, сумма которой точно равна представляемому числу.
+ * Знак разложения равен знаку его последнего (наибольшего по модулю) элемента.
+ * Функции работы с разложениями и оценки погрешности фильтров взяты из работы
+ * J.R. Shewchuk, "Adaptive Precision Floating-Point Arithmetic and Fast Robust
+ * Geometric Predicates", 1997.
+ */
+
+#include "stdafx.h"
+#include "precision.h"
+#include "geometry.h"
+#include "predicates.h"
+
+/** \brief Половина машинного эпсилона double (2^-53) */
+#define PRED_EPS      (1.1102230246251565e-16)
+
+/** \brief Множитель для разделения числа double на две половины по 26 бит (2^27 + 1) */
+#define PRED_SPLITTER (134217729.0)
+
+/** \brief Коэффициент оценки погрешности для orient2d */
+#define CCW_ERRBOUND  ((3.0 + 16.0 * PRED_EPS) * PRED_EPS)
+
+/** \brief Коэффициент оценки погрешности для orient3d */
+#define O3D_ERRBOUND  ((7.0 + 56.0 * PRED_EPS) * PRED_EPS)
+
+/** \brief Коэффициент оценки погрешности для скалярного произведения (v - p) . n */
+#define DOT_ERRBOUND  ((5.0 + 64.0 * PRED_EPS) * PRED_EPS)
+
+/** \brief Разложение */
+typedef std::vector<double> expansion;
+
+/** \brief Количество точных вычислений */
+static std::atomic<unsigned long long> exact_evaluations(0);
+
+/**
+ * \brief Точная сумма двух чисел: a + b = x + y, где x = fl(a + b).
+ */
+static inline void two_sum(double a, double b, double& x, double& y) {
+  x = a + b;
+  const double bvirt = x - a;
+  const double avirt = x - bvirt;
+  y = (a - avirt) + (b - bvirt);
+}
+
+/**
+ * \brief Точная сумма двух чисел при |a| >= |b|.
+ */
+static inline void fast_two_sum(double a, double b, double& x, double& y) {
+  x = a + b;
+  y = b - (x - a);
+}
+
+/**
+ * \brief Разделить число на две половины по 26 бит: a = hi + lo.
+ */
+static inline void split(double a, double& hi, double& lo) {
+  const double c = PRED_SPLITTER * a;
+  const double big = c - a;
+  hi = c - big;
+  lo = a - hi;
+}
+
+/**
+ * \brief Точное произведение двух чисел: a * b = x + y, где x = fl(a * b)
+ * (число b уже разделено на половины bhi и blo).
+ */
+static inline void two_product_presplit(double a, double b, double bhi, double blo, double& x, double& y) {
+  x = a * b;
+  double ahi, alo;
+  split(a, ahi, alo);
+  const double err1 = x - (ahi * bhi);
+  const double err2 = err1 - (alo * bhi);
+  const double err3 = err2 - (ahi * blo);
+  y = (alo * blo) - err3;
+}
+
+/**
+ * \brief Разложение точной разности двух чисел.
+ */
+static expansion diff(double a, double b) {
+  double x, y;
+  two_sum(a, -b, x, y);
+  expansion e;
+  if (y != 0.0) e.push_back(y);
+  if (x != 0.0 || e.empty()) e.push_back(x);
+  return e;
+}
+
+/**
+ * \brief Прибавить число к разложению (с удалением нулевых элементов).
+ */
+static void grow(expansion& e, double b) {
+  expansion h;
+  h.reserve(e.size() + 1);
+  double q = b;
+  for (size_t i = 0; i < e.size(); ++i) {
+    double sum, hh;
+    two_sum(q, e[i], sum, hh);
+    q = sum;
+    if (hh != 0.0) h.push_back(hh);
+  }
+  if (q != 0.0 || h.empty()) h.push_back(q);
+  e.swap(h);
+}
+
+/**
+ * \brief Прибавить разложение f к разложению e.
+ */
+static void add(expansion& e, const expansion& f) {
+  for (size_t i = 0; i < f.size(); ++i) {
+    grow(e, f[i]);
+  }
+}
+
+/**
+ * \brief Умножить разложение на число (с удалением нулевых элементов).
+ */
+static expansion scale(const expansion& e, double b) {
+  expansion h;
+  h.reserve(e.size() * 2);
+  double bhi, blo;
+  split(b, bhi, blo);
+  double q, hh;
+  two_product_presplit(e[0], b, bhi, blo, q, hh);
+  if (hh != 0.0) h.push_back(hh);
+  for (size_t i = 1; i < e.size(); ++i) {
+    double p1, p0, sum;
+    two_product_presplit(e[i], b, bhi, blo, p1, p0);
+    two_sum(q, p0, sum, hh);
+    if (hh != 0.0) h.push_back(hh);
+    fast_two_sum(p1, sum, q, hh);
+    if (hh != 0.0) h.push_back(hh);
+  }
+  if (q != 0.0 || h.empty()) h.push_back(q);
+  return h;
+}
+
+/**
+ * \brief Произведение двух разложений.
+ */
+static expansion mul(const expansion& e, const expansion& f) {
+  expansion r(1, 0.0);
+  for (size_t i = 0; i < f.size(); ++i) {
+    add(r, scale(e, f[i]));
+  }
+  return r;
+}
+
+/**
+ * \brief Изменить знак разложения.
+ */
+static expansion negate(const expansion& e) {
+  expansion r(e);
+  for (size_t i = 0; i < r.size(); ++i) r[i] = -r[i];
+  return r;
+}
+
+/**
+ * \brief Приближённое значение разложения (знак точен).
+ */
+static double estimate(const expansion& e) {
+  double s = 0.0;
+  for (size_t i = 0; i < e.size(); ++i) s += e[i];
+  return s;
+}
+
+/**
+ * \brief Проверка: модуль числа, заданного разложением, меньше epsilon.
+ */
+static bool abs_less(const expansion& e, double epsilon) {
+  expansion lo(e), hi(e);
+  grow(lo, epsilon);
+  grow(hi, -epsilon);
+  return lo.back() > 0.0 && hi.back() < 0.0;
+}
+
+/**
+ * \brief Проверка приближённого значения с оценкой погрешности: модуль меньше epsilon?
+ *
+ * \return 1 - доказано, что меньше; 0 - доказано, что не меньше; -1 - оценки недостаточно
+ */
+static inline int filter_less(double value, double err, double epsilon) {
+  /** Погрешность сравнения с epsilon учитывается отдельным слагаемым */
+  err += 2.0 * PRED_EPS * epsilon;
+  const double a = fabs(value);
+  if (a + err < epsilon) return 1;
+  if (a - err >= epsilon) return 0;
+  return -1;
+}
+
+/**
+ * \brief Точное значение определителя (a - c, b - c) на плоскости.
+ */
+static expansion orient2d_exact(double ax, double ay, double bx, double by, double cx, double cy) {
+  expansion left = mul(diff(ax, cx), diff(by, cy));
+  expansion right = mul(diff(ay, cy), diff(bx, cx));
+  add(left, negate(right));
+  return left;
+}
+
+/**
+ * \brief Точное значение определителя (a - d, b - d, c - d).
+ */
+template <typename T>
+static expansion orient3d_exact(const geometry::basic_vector<T>& a, const geometry::basic_vector<T>& b, const geometry::basic_vector<T>& c, const geometry::basic_vector<T>& d) {
+  const expansion adx = diff(a.getX(), d.getX()), ady = diff(a.getY(), d.getY()), adz = diff(a.getZ(), d.getZ());
+  const expansion bdx = diff(b.getX(), d.getX()), bdy = diff(b.getY(), d.getY()), bdz = diff(b.getZ(), d.getZ());
+  const expansion cdx = diff(c.getX(), d.getX()), cdy = diff(c.getY(), d.getY()), cdz = diff(c.getZ(), d.getZ());
+
+  expansion m1 = mul(bdx, cdy); add(m1, negate(mul(cdx, bdy)));
+  expansion m2 = mul(cdx, ady); add(m2, negate(mul(adx, cdy)));
+  expansion m3 = mul(adx, bdy); add(m3, negate(mul(bdx, ady)));
+
+  expansion det = mul(m1, adz);
+  add(det, mul(m2, bdz));
+  add(det, mul(m3, cdz));
+  return det;
+}
+
+/**
+ * \brief Приближённое значение определителя (a - d, b - d, c - d) и его оценка погрешности.
+ */
+template <typename T>
+static inline double orient3d_fast(const geometry::basic_vector<T>& a, const geometry::basic_vector<T>& b, const geometry::basic_vector<T>& c, const geometry::basic_vector<T>& d, double& err) {
+  const double adx = double(a.getX()) - d.getX(), ady = double(a.getY()) - d.getY(), adz = double(a.getZ()) - d.getZ();
+  const double bdx = double(b.getX()) - d.getX(), bdy = double(b.getY()) - d.getY(), bdz = double(b.getZ()) - d.getZ();
+  const double cdx = double(c.getX()) - d.getX(), cdy = double(c.getY()) - d.getY(), cdz = double(c.getZ()) - d.getZ();
+
+  const double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+  const double cdxady = cdx * ady, adxcdy = adx * cdy;
+  const double adxbdy = adx * bdy, bdxady = bdx * ady;
+
+  const double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+  const double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * fabs(adz) +
+    (fabs(cdxady) + fabs(adxcdy)) * fabs(bdz) + (fabs(adxbdy) + fabs(bdxady)) * fabs(cdz);
+  err = O3D_ERRBOUND * permanent;
+  return det;
+}
+
+/**
+ * \brief Проверка: модуль разности произведений a * b - c * d меньше epsilon.
+ */
+static bool det2_less(double a, double b, double c, double d, double epsilon) {
+  const double ab = a * b, cd = c * d;
+  switch (filter_less(ab - cd, CCW_ERRBOUND * (fabs(ab) + fabs(cd)), epsilon)) {
+  case 1: return true;
+  case 0: return false;
+  default: break;
+  }
+  exact_evaluations++;
+  expansion e = mul(expansion(1, a), expansion(1, b));
+  add(e, negate(mul(expansion(1, c), expansion(1, d))));
+  return abs_less(e, epsilon);
+}
+
+/**
+ * \brief Проверка: модуль определителя (a - c, b - c) на плоскости меньше epsilon.
+ */
+static bool orient2d_less(double ax, double ay, double bx, double by, double cx, double cy, double epsilon) {
+  const double left = (ax - cx) * (by - cy);
+  const double right = (ay - cy) * (bx - cx);
+  switch (filter_less(left - right, CCW_ERRBOUND * (fabs(left) + fabs(right)), epsilon)) {
+  case 1: return true;
+  case 0: return false;
+  default: break;
+  }
+  exact_evaluations++;
+  return abs_less(orient2d_exact(ax, ay, bx, by, cx, cy), epsilon);
+}
+
+namespace geometry {
+
+  namespace predicates {
+
+    double orient2d(double ax, double ay, double bx, double by, double cx, double cy) {
+      const double left = (ax - cx) * (by - cy);
+      const double right = (ay - cy) * (bx - cx);
+      const double det = left - right;
+      const double err = CCW_ERRBOUND * (fabs(left) + fabs(right));
+      if (det > err || -det > err) return det;
+      exact_evaluations++;
+      return estimate(orient2d_exact(ax, ay, bx, by, cx, cy));
+    }
+
+    template <typename T>
+    double orient3d(const basic_vector<T>& a, const basic_vector<T>& b, const basic_vector<T>& c, const basic_vector<T>& d) {
+      double err;
+      const double det = orient3d_fast(a, b, c, d, err);
+      if (det > err || -det > err) return det;
+      exact_evaluations++;
+      return estimate(orient3d_exact(a, b, c, d));
+    }
+
+    template <typename T>
+    bool orient3d_less(const basic_vector<T>& a, const basic_vector<T>& b, const basic_vector<T>& c, const basic_vector<T>& d, double epsilon) {
+      double err;
+      const double det = orient3d_fast(a, b, c, d, err);
+      switch (filter_less(det, err, epsilon)) {
+      case 1: return true;
+      case 0: return false;
+      default: break;
+      }
+      exact_evaluations++;
+      return abs_less(orient3d_exact(a, b, c, d), epsilon);
+    }
+
+    template <typename T>
+    bool cross_less(const basic_vector<T>& v1, const basic_vector<T>& v2, double epsilon) {
+      return det2_less(v1.getY(), v2.getZ(), v1.getZ(), v2.getY(), epsilon) &&
+        det2_less(v1.getZ(), v2.getX(), v1.getX(), v2.getZ(), epsilon) &&
+        det2_less(v1.getX(), v2.getY(), v1.getY(), v2.getX(), epsilon);
+    }
+
+    template <typename T>
+    bool collinear_less(const basic_vector<T>& a, const basic_vector<T>& b, const basic_vector<T>& c, double epsilon) {
+      /** Координаты векторного произведения - определители проекций точек на координатные плоскости */
+      return orient2d_less(b.getY(), b.getZ(), c.getY(), c.getZ(), a.getY(), a.getZ(), epsilon) &&
+        orient2d_less(b.getZ(), b.getX(), c.getZ(), c.getX(), a.getZ(), a.getX(), epsilon) &&
+        orient2d_less(b.getX(), b.getY(), c.getX(), c.getY(), a.getX(), a.getY(), epsilon);
+    }
+
+    template <typename T>
+    bool in_plane(const basic_vector<T>& p, const basic_vector<T>& n, const basic_vector<T>& v, double tolerance) {
+      const double tx = (double(v.getX()) - p.getX()) * n.getX();
+      const double ty = (double(v.getY()) - p.getY()) * n.getY();
+      const double tz = (double(v.getZ()) - p.getZ()) * n.getZ();
+      const double dot = tx + ty + tz;
+      const double err = DOT_ERRBOUND * (fabs(tx) + fabs(ty) + fabs(tz));
+      switch (filter_less(dot, err, tolerance)) {
+      case 1: return true;
+      case 0: return false;
+      default: break;
+      }
+      exact_evaluations++;
+      expansion e = scale(diff(v.getX(), p.getX()), n.getX());
+      add(e, scale(diff(v.getY(), p.getY()), n.getY()));
+      add(e, scale(diff(v.getZ(), p.getZ()), n.getZ()));
+      return abs_less(e, tolerance);
+    }
+
+    unsigned long long exact_count() {
+      return exact_evaluations.load();
+    }
+
+    /** \brief Явное создание экземпляров шаблонов для координат типа T */
+#define PREDICATES_INSTANTIATE(T) \
+    template double orient3d<T>(const basic_vector<T>&, const basic_vector<T>&, const basic_vector<T>&, const basic_vector<T>&); \
+    template bool orient3d_less<T>(const basic_vector<T>&, const basic_vector<T>&, const basic_vector<T>&, const basic_vector<T>&, double); \
+    template bool cross_less<T>(const basic_vector<T>&, const basic_vector<T>&, double); \
+    template bool collinear_less<T>(const basic_vector<T>&, const basic_vector<T>&, const basic_vector<T>&, double); \
+    template bool in_plane<T>(const basic_vector<T>&, const basic_vector<T>&, const basic_vector<T>&, double);
+
+    PREDICATES_INSTANTIATE(double)
+    PREDICATES_INSTANTIATE(float)
+  }
+}
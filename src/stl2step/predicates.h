@@ -0,0 +1,116 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлениями функций геометрических предикатов
+ * с адаптивной точностью
+ *
+ * Каждый предикат сначала вычисляется в арифметике с плавающей точкой вместе с доказуемой
+ * оценкой погрешности результата (фильтр). Если оценки достаточно для однозначного ответа,
+ * он возвращается сразу; иначе значение вычисляется точно - в виде суммы неперекрывающихся
+ * чисел double (разложения, по J.R. Shewchuk, "Adaptive Precision Floating-Point Arithmetic
+ * and Fast Robust Geometric Predicates", 1997). Координаты типа float преобразуются в double
+ * без потери точности.
+ */
+
+#ifndef _PREDICATES_H
+#define _PREDICATES_H
+
+#include "geometry.h"
+
+namespace geometry {
+
+  namespace predicates {
+
+    /**
+     * \brief Ориентация трёх точек на плоскости.
+     *
+     * \param [in] ax координата X первой точки
+     * \param [in] ay координата Y первой точки
+     * \param [in] bx координата X второй точки
+     * \param [in] by координата Y второй точки
+     * \param [in] cx координата X третьей точки
+     * \param [in] cy координата Y третьей точки
+     * \return приближённое значение определителя (a - c, b - c), знак которого точен:
+     * больше нуля, если точки a, b, c обходятся против часовой стрелки, ноль, если они
+     * лежат на одной прямой
+     */
+    double orient2d(double ax, double ay, double bx, double by, double cx, double cy);
+
+    /**
+     * \brief Ориентация четырёх точек в пространстве.
+     *
+     * \param [in] a первая точка
+     * \param [in] b вторая точка
+     * \param [in] c третья точка
+     * \param [in] d четвёртая точка
+     * \return приближённое значение определителя (a - d, b - d, c - d) (шестикратного
+     * объёма тетраэдра), знак которого точен; ноль, если точки лежат в одной плоскости
+     */
+    template <typename T>
+    double orient3d(const basic_vector<T>& a, const basic_vector<T>& b, const basic_vector<T>& c, const basic_vector<T>& d);
+
+    /**
+     * \brief Проверка: модуль определителя (a - d, b - d, c - d) меньше epsilon
+     * (с точной классификацией пограничных случаев).
+     *
+     * \param [in] a первая точка
+     * \param [in] b вторая точка
+     * \param [in] c третья точка
+     * \param [in] d четвёртая точка
+     * \param [in] epsilon точность
+     * \return true, если модуль определителя меньше epsilon
+     */
+    template <typename T>
+    bool orient3d_less(const basic_vector<T>& a, const basic_vector<T>& b, const basic_vector<T>& c, const basic_vector<T>& d, double epsilon);
+
+    /**
+     * \brief Проверка: модули всех координат векторного произведения векторов v1 и v2
+     * меньше epsilon (с точной классификацией пограничных случаев).
+     *
+     * \param [in] v1 первый вектор
+     * \param [in] v2 второй вектор
+     * \param [in] epsilon точность
+     * \return true, если векторное произведение нулевое с точностью epsilon
+     */
+    template <typename T>
+    bool cross_less(const basic_vector<T>& v1, const basic_vector<T>& v2, double epsilon);
+
+    /**
+     * \brief Проверка: модули всех координат векторного произведения (b - a) x (c - a)
+     * меньше epsilon (с точной классификацией пограничных случаев).
+     *
+     * \param [in] a первая точка
+     * \param [in] b вторая точка
+     * \param [in] c третья точка
+     * \param [in] epsilon точность
+     * \return true, если три точки лежат на одной прямой с точностью epsilon
+     */
+    template <typename T>
+    bool collinear_less(const basic_vector<T>& a, const basic_vector<T>& b, const basic_vector<T>& c, double epsilon);
+
+    /**
+     * \brief Проверка: расстояние от точки v до плоскости, проходящей через точку p
+     * перпендикулярно единичному вектору n, меньше tolerance.
+     *
+     * Сравнивается модуль значения (v - p) . n, пограничные случаи классифицируются точно.
+     *
+     * \param [in] p точка плоскости
+     * \param [in] n единичная нормаль плоскости
+     * \param [in] v проверяемая точка
+     * \param [in] tolerance допустимое расстояние
+     * \return true, если точка лежит в плоскости с точностью tolerance
+     */
+    template <typename T>
+    bool in_plane(const basic_vector<T>& p, const basic_vector<T>& n, const basic_vector<T>& v, double tolerance);
+
+    /**
+     * \brief Получить количество вычислений, для которых фильтра оказалось недостаточно
+     * и потребовалась точная арифметика.
+     *
+     * \return количество точных вычислений с начала работы программы
+     */
+    unsigned long long exact_count();
+  }
+}
+
+#endif /* _PREDICATES_H */
@@ -10,10 +10,46 @@
 #include "precision.h"
 #include "err.h"
 #include "shell.h"
+#include "predicates.h"
+#include "metrics.h"
 
 /** \brief Ширина выводимого в отладочных сообшениях числа (номера грани, ребра и т.д.) */
 #define PRINT_WIDTH 4
 
+/**
+ * \brief Сформировать строку номера шириной \ref PRINT_WIDTH для отладочных сообщений.
+ *
+ * Номер форматируется в отдельном потоке: ширина, заданная для std::cout, - общее
+ * состояние, которое изменялось бы одновременно заданиями режима сервера и пакетного режима.
+ *
+ * \param [in] n номер
+ * \return строка номера
+ */
+static std::string print_number(ptrdiff_t n) {
+  std::stringstream ss;
+  ss << std::setw(PRINT_WIDTH) << n;
+  return ss.str();
+}
+
+/**
+ * \brief Проверка: все вершины грани лежат в плоскости с точностью EPSILON_P.
+ *
+ * \param [in] f грань
+ * \param [in] p точка плоскости
+ * \param [in] n единичная нормаль плоскости
+ * \return true, если все вершины грани лежат в плоскости
+ */
+static bool face_in_plane(const prim3d::face* f, const geometry::vector& p, const geometry::vector& n) {
+  for (auto it_b = f->get_borders().cbegin(); it_b != f->get_borders().cend(); ++it_b) {
+    for (auto it = (*it_b).get_edges().cbegin(); it != (*it_b).get_edges().cend(); ++it) {
+      const prim3d::edge* e = (*it).get_base_edge();
+      if (!geometry::predicates::in_plane(p, n, e->get_start()->get_coord(), EPSILON_P) ||
+          !geometry::predicates::in_plane(p, n, e->get_end()->get_coord(), EPSILON_P)) return false;
+    }
+  }
+  return true;
+}
+
 namespace prim3d {
 
   /**
@@ -71,14 +107,14 @@ namespace prim3d {
    * \file
    * * \copybrief prim3d::vertex::vertex()
    */
-  vertex::vertex() : coord() {
+  vertex::vertex() : coord(), index(0) {
   }
 
   /**
    * \file
    * * \copybrief prim3d::vertex::vertex(const geometry::vector&)
    */
-  vertex::vertex(const geometry::vector& v) : coord(v) {
+  vertex::vertex(const geometry::vector& v) : coord(v), index(0) {
   }
 
   /**
@@ -97,6 +133,22 @@ namespace prim3d {
     coord = v;
   }
 
+  /**
+   * \file
+   * * \copybrief prim3d::vertex::get_index() const
+   */
+  unsigned vertex::get_index() const {
+    return index;
+  }
+
+  /**
+   * \file
+   * * \copybrief prim3d::vertex::set_index(unsigned) const
+   */
+  void vertex::set_index(unsigned i) const {
+    index = i;
+  }
+
   /**
    * \file
    * * \copybrief prim3d::vertex::operator==(const prim3d::vertex& v) const
@@ -148,7 +200,7 @@ namespace prim3d {
    * * \copybrief prim3d::edge::edge(const prim3d::vertex*, const prim3d::vertex*, const prim3d::face*)
    */
   edge::edge(const vertex* start, const vertex* end, const face* left) :
-    start_vertex(start), end_vertex(end), left_face(left), right_face(nullptr) {
+    start_vertex(start), end_vertex(end), left_face(left), right_face(nullptr), index(0) {
   }
 
   /**
@@ -199,6 +251,22 @@ namespace prim3d {
     right_face = f;
   }
 
+  /**
+   * \file
+   * * \copybrief prim3d::edge::get_index() const
+   */
+  unsigned edge::get_index() const {
+    return index;
+  }
+
+  /**
+   * \file
+   * * \copybrief prim3d::edge::set_index(unsigned) const
+   */
+  void edge::set_index(unsigned i) const {
+    index = i;
+  }
+
   /**
    * \file
    * * \copybrief prim3d::edge::print(const prim3d::shell*) const
@@ -211,7 +279,7 @@ namespace prim3d {
       if (found == s->get_edges().cend()) {
         std::cout << "edge #**** ";
       } else {
-        std::cout << "edge #" << std::setw(PRINT_WIDTH) << std::distance(s->get_edges().cbegin(), found) + 1 << " ";
+        std::cout << "edge #" << print_number(std::distance(s->get_edges().cbegin(), found) + 1) << " ";
       }
       std::cout << start_vertex->print(s) << "->" << end_vertex->print(s);
 
@@ -220,7 +288,7 @@ namespace prim3d {
         if (found == s->get_faces().cend()) {
           std::cout << " left face#****/";
         } else {
-          std::cout << " left face#" << std::setw(PRINT_WIDTH) << std::distance(s->get_faces().cbegin(), found) + 1 << "/";
+          std::cout << " left face#" << print_number(std::distance(s->get_faces().cbegin(), found) + 1) << "/";
         }
       }
       else {
@@ -231,7 +299,7 @@ namespace prim3d {
         if (found == s->get_faces().cend()) {
           std::cout << "right face#****/";
         } else {
-          std::cout << "right face#" << std::setw(PRINT_WIDTH) << std::distance(s->get_faces().cbegin(), found) + 1;
+          std::cout << "right face#" << print_number(std::distance(s->get_faces().cbegin(), found) + 1);
         }
       }
       else {
@@ -310,7 +378,7 @@ namespace prim3d {
    * \file
    * * \copybrief prim3d::border::get_edges() const
    */
-  const std::vector<oriented_edge>& border::get_edges() const {
+  const border::edge_list& border::get_edges() const {
     return edges;
   }
 
@@ -325,9 +393,9 @@ namespace prim3d {
 
   /**
    * \file
-   * * \copybrief prim3d::border::remove(std::vector<prim3d::oriented_edge>::iterator)
+   * * \copybrief prim3d::border::remove(prim3d::border::edge_list::const_iterator)
    */
-  std::vector<oriented_edge>::iterator border::remove(std::vector<oriented_edge>::const_iterator it) {
+  border::edge_list::iterator border::remove(edge_list::const_iterator it) {
     return edges.erase(it);
   }
 
@@ -368,28 +436,54 @@ namespace prim3d {
 
   /**
    * \file
-   * * \copybrief prim3d::face::add_border(const prim3d::border&)
+   * * \copybrief prim3d::face::add_border(prim3d::border&&)
    */
-  void face::add_border(const border& b) {
-    borders.push_back(b);
+  void face::add_border(border&& b) {
+    borders.push_back(std::move(b));
   }
 
   /**
    * \file
-   * * \copybrief prim3d::face::set_borders(const std::vector<prim3d::border>&)
+   * * \copybrief prim3d::face::set_borders(prim3d::face::border_list&&)
    */
-  void face::set_borders(const std::vector<border>& new_borders) {
-    borders = new_borders;
+  void face::set_borders(border_list&& new_borders) {
+    borders = std::move(new_borders);
+  }
+
+  /**
+   * \file
+   * * \copybrief prim3d::face::take_borders()
+   */
+  face::border_list face::take_borders() {
+    return std::move(borders);
   }
 
   /**
    * \file
    * * \copybrief prim3d::face::get_borders() const
    */
-  const std::vector<border>& face::get_borders() const {
+  const face::border_list& face::get_borders() const {
     return borders;
   }
 
+  /**
+   * \file
+   * * \copybrief prim3d::face::get_edge_directions(geometry::vector_array&, geometry::vector_array&) const
+   */
+  void face::get_edge_directions(geometry::vector_array& dirs, geometry::vector_array& work) const {
+    dirs.clear();
+    work.clear();
+    for (auto it_b = borders.cbegin(); it_b != borders.cend(); ++it_b) {
+      for (auto it = (*it_b).get_edges().cbegin(); it != (*it_b).get_edges().cend(); ++it) {
+        const edge* e = (*it).get_base_edge();
+        dirs.push_back(e->get_end()->get_coord());
+        work.push_back(e->get_start()->get_coord());
+      }
+    }
+    geometry::batch_sub(dirs, work, dirs);
+    geometry::batch_normalize(dirs);
+  }
+
   /**
    * \file
    * * \copybrief prim3d::face::borders_num() const
@@ -412,7 +506,7 @@ namespace prim3d {
       if (found == s->get_faces().cend()) {
           std::cout << "face #****";
       } else {
-          std::cout << "face #" << std::setw(PRINT_WIDTH) << std::distance(s->get_faces().cbegin(), found) + 1;
+          std::cout << "face #" << print_number(std::distance(s->get_faces().cbegin(), found) + 1);
       }
     }
     std::cout << " of " << borders.size() << " borders" << std::endl;
@@ -440,6 +534,10 @@ namespace prim3d {
    * * \copybrief prim3d::shell::shell(const std::vector<geometry::vector>& stlf)
    */
   shell::shell(const std::vector<geometry::vector>& stlf) : clone(nullptr) {
+    // Координаты вершин фигуры (в том же порядке, что и список вершин) для пакетного поиска
+    geometry::vector_array coords;
+    coords.reserve(stlf.size() / 4 * 3);
+
     // Перебор граней, наполнение взаимно индексированных списков вершин и рёбер
     for (auto it = stlf.cbegin(); it != stlf.cend();) {
 
@@ -454,57 +552,104 @@ namespace prim3d {
         // Взять координаты текущей вершины текущей грани
 
         // Проверить, нет ли уже вершины с такими координатами в списке вершин фигуры
-        std::vector<vertex*>::const_iterator it_sv;
-        for (it_sv = vertexes.cbegin(); it_sv != vertexes.cend(); ++it_sv) {
-          if ((*it_sv)->get_coord() == *it) break;
-        }
+        size_t found = geometry::batch_find(coords, *it, EPSILON_X);
 
-        if (it_sv == vertexes.cend()) {
+        if (found == vertexes.size()) {
           // Такой вершины нет, создать её.
           ptr_vertex[i] = new vertex(*it);
           // Добавить вершину в список вершин фигуры
           vertexes.push_back(ptr_vertex[i]);
+          coords.push_back(*it);
         }
         else {
           // Такая вершина есть.
-          ptr_vertex[i] = *it_sv;
+          ptr_vertex[i] = vertexes[found];
         }
         // Добавить указатель на грань в список указателей на грани вершины
 //!!!	   ptr_vertex[i]->add_face(f);
       }
 
-      // Первое ребро грани
-      edge* e1 = new edge(ptr_vertex[0], ptr_vertex[1], f);
-      edges.push_back(e1);
-      // Второе ребро грани
-      edge* e2 = new edge(ptr_vertex[1], ptr_vertex[2], f);
-      edges.push_back(e2);
-      // Третье ребро грани
-      edge* e3 = new edge(ptr_vertex[2], ptr_vertex[0], f);
-      edges.push_back(e3);
-
-      // Добавить указатель на ребро в список указателей на рёбра вершины для 3х вершин
-      ptr_vertex[0]->add_edge(e1); //-V525
-      ptr_vertex[0]->add_edge(e3); //-V525
-      ptr_vertex[1]->add_edge(e1); //-V525
-      ptr_vertex[1]->add_edge(e2); //-V525
-      ptr_vertex[2]->add_edge(e2); //-V525
-      ptr_vertex[2]->add_edge(e3); //-V525
-
-      // Граница грани
-      border b;
-      b.add_edge(oriented_edge(e1));
-      b.add_edge(oriented_edge(e2));
-      b.add_edge(oriented_edge(e3));
-
-      // Добавить границу в список границ грани
-      f->add_border(b);
-
-      // Добавить новую грань в список граней фигуры
-      faces.push_back(f);
+      add_triangle(f, ptr_vertex);
     }
   }
 
+  /**
+   * \file
+   * * \copybrief prim3d::shell::shell(const std::vector<geometry::vector>&, const std::vector<size_t>&)
+   */
+  shell::shell(const std::vector<geometry::vector>& points, const std::vector<size_t>& indices) : clone(nullptr) {
+    // Вершины фигуры по индексам сетки (создаются при первом использовании)
+    std::vector<vertex*> index_vertex(points.size(), nullptr);
+
+    // Нормали всех треугольников по обходу вершин рассчитываются пакетно
+    const size_t triangles = indices.size() / 3;
+    geometry::vector_array p0(triangles), p1(triangles), p2(triangles);
+    for (size_t t = 0; t < triangles; ++t) {
+      p0.set(t, points[indices[t * 3]]);
+      p1.set(t, points[indices[t * 3 + 1]]);
+      p2.set(t, points[indices[t * 3 + 2]]);
+    }
+    geometry::vector_array normals;
+    geometry::batch_sub(p1, p0, p1);
+    geometry::batch_sub(p2, p0, p2);
+    geometry::batch_cross(p1, p2, normals);
+    geometry::batch_normalize(normals);
+
+    for (size_t k = 0; k + 2 < indices.size(); k += 3) {
+      const size_t* idx = &indices[k];
+      if (idx[0] == idx[1] || idx[1] == idx[2] || idx[2] == idx[0]) continue;
+
+      face* f = new face(normals.get(k / 3));
+
+      vertex* ptr_vertex[3] = {};
+      for (auto i = 0; i < 3; ++i) {
+        if (index_vertex[idx[i]] == nullptr) {
+          index_vertex[idx[i]] = new vertex(points[idx[i]]);
+          vertexes.push_back(index_vertex[idx[i]]);
+        }
+        ptr_vertex[i] = index_vertex[idx[i]];
+      }
+
+      add_triangle(f, ptr_vertex);
+    }
+  }
+
+  /**
+   * \file
+   * * \copybrief prim3d::shell::add_triangle(face*, vertex* const[3])
+   */
+  void shell::add_triangle(face* f, vertex* const ptr_vertex[3]) {
+    // Первое ребро грани
+    edge* e1 = new edge(ptr_vertex[0], ptr_vertex[1], f);
+    edges.push_back(e1);
+    // Второе ребро грани
+    edge* e2 = new edge(ptr_vertex[1], ptr_vertex[2], f);
+    edges.push_back(e2);
+    // Третье ребро грани
+    edge* e3 = new edge(ptr_vertex[2], ptr_vertex[0], f);
+    edges.push_back(e3);
+
+    // Добавить указатель на ребро в список указателей на рёбра вершины для 3х вершин
+    ptr_vertex[0]->add_edge(e1); //-V525
+    ptr_vertex[0]->add_edge(e3); //-V525
+    ptr_vertex[1]->add_edge(e1); //-V525
+    ptr_vertex[1]->add_edge(e2); //-V525
+    ptr_vertex[2]->add_edge(e2); //-V525
+    ptr_vertex[2]->add_edge(e3); //-V525
+
+    // Граница грани
+    border b;
+    b.add_edge(oriented_edge(e1));
+    b.add_edge(oriented_edge(e2));
+    b.add_edge(oriented_edge(e3));
+
+    // Добавить границу в список границ грани
+    f->add_border(std::move(b));
+
+    // Добавить новую грань в список граней фигуры
+    faces.push_back(f);
+  }
+
   /**
    * \file
    * * \copybrief prim3d::shell::~shell()
@@ -580,6 +725,15 @@ namespace prim3d {
     return pos;
   }
 
+  /**
+   * \file
+   * * \copybrief prim3d::shell::index_elements() const
+   */
+  void shell::index_elements() const {
+    for (size_t i = 0; i < vertexes.size(); ++i) vertexes[i]->set_index(static_cast<unsigned>(i));
+    for (size_t i = 0; i < edges.size(); ++i) edges[i]->set_index(static_cast<unsigned>(i));
+  }
+
   /**
    * \file
    * * \copybrief prim3d::shell::unmark_vertexes() const
@@ -721,16 +875,19 @@ namespace prim3d {
      */
 
      /** Перебрать все помеченные рёбра в списке фигуры. */
+    size_t paired = 0;
     for (auto it = edges.cbegin(); it != edges.cend();) {
       if ((*it)->is_marked()) {
         /** Уничтожить объект-ребро. */
         delete* it;
         /** Удалить указатель на ребро из списка рёбер фигуры */
         it = edges.erase(it);
+        paired++;
         continue;
       }
       ++it;
     }
+    metrics::add("twin_edges_paired", static_cast<long long>(paired));
 
     unmark_faces();
     unmark_edges();
@@ -745,14 +902,20 @@ namespace prim3d {
    */
   void shell::normalize_shell() {
 
-    pos = geometry::vector(0, 0, 0);
-
-    /** Поиск условного центра (это не центр масс! Просто условный центр для возможности сравнения фигур) */
+    /**
+     * Поиск условного центра (это не центр масс! Просто условный центр для возможности сравнения фигур);
+     * сумма координат накапливается в double и при координатах типа float, иначе ошибка округления
+     * суммы смещает координаты фигуры больше, чем допускает сравнение клонов с точностью EPSILON_C
+     */
+    double x = 0.0, y = 0.0, z = 0.0;
     for (auto it = vertexes.cbegin(); it != vertexes.cend(); ++it) {
-      pos += (*it)->get_coord();
+      x += (*it)->get_coord().getX();
+      y += (*it)->get_coord().getY();
+      z += (*it)->get_coord().getZ();
     }
     /** Условный центр - это среднее арифметическое всех координат  */
-    pos /= static_cast<double>(vertexes.size());
+    const double n = static_cast<double>(vertexes.size());
+    pos = geometry::vector(static_cast<geometry::real>(x / n), static_cast<geometry::real>(y / n), static_cast<geometry::real>(z / n));
 
     /** Вычитание координат условного центра из координат всех вершин */
     for (auto it = vertexes.begin(); it != vertexes.end(); ++it) {
@@ -908,6 +1071,7 @@ namespace prim3d {
       unmark_edges();
     }
 
+    metrics::add("components_found", static_cast<long long>(Shells.size()));
     return Shells;
   }
 
@@ -988,15 +1152,17 @@ namespace prim3d {
 
   /**
    * \file
-   * * \copybrief prim3d::shell::merge_faces(bool)
+   * * \copybrief prim3d::shell::merge_faces(bool, bool)
    */
-  void shell::merge_faces(bool debug) {
+  void shell::merge_faces(bool debug, bool check_plane) {
 
     /**
      * Алгоритм:
      * <BR>
      */
 
+    metrics::add("faces_before_merge", static_cast<long long>(faces.size()));
+
     /**
      * 1 Определить список объединённых граней.
      */
@@ -1067,6 +1233,10 @@ namespace prim3d {
       face* unated_face = new face(base_normal);
       unated_face->set_mark(unated_face); //-V678
 
+      /** Точка плоскости объединённой грани - первая вершина первой грани */
+      const geometry::vector& base_point =
+        (*first_face->get_borders().cbegin()->get_edges().cbegin()).get_base_edge()->get_start()->get_coord();
+
       /**
        * &nbsp;&nbsp;&nbsp;&nbsp;2.4.4 Пометить первую грань объединённой гранью.
        */
@@ -1130,7 +1300,8 @@ namespace prim3d {
           edge_faces[1] = (*it)->get_right();
           for (size_t i = 0; i < 2; ++i) {
             if (!edge_faces[i]->is_marked() &&
-                 edge_faces[i]->get_normal().is_equal(base_normal, EPSILON_Y)) {
+                 edge_faces[i]->get_normal().is_equal(base_normal, EPSILON_Y) &&
+                 (!check_plane || face_in_plane(edge_faces[i], base_point, base_normal))) {
               if (debug) {
                 std::cout << "Непомеченная грань (с ребром из списка необработанных рёбер) в нужной плоскости вносится в список необработанных граней" << std::endl;
                 edge_faces[i]->print(this);
@@ -1170,8 +1341,9 @@ namespace prim3d {
 
       for (auto it = faces.cbegin(); it != faces.cend(); ++it) {
         if ((*it)->get_mark() == unated_face) {
-          for (auto it_b = (*it)->get_borders().cbegin(); it_b != (*it)->get_borders().cend(); ++it_b) {
-            unated_face->add_border(*it_b);
+          face::border_list moved = (*it)->take_borders();
+          for (auto it_b = moved.begin(); it_b != moved.end(); ++it_b) {
+            unated_face->add_border(std::move(*it_b));
           }
         }
       }
@@ -1271,6 +1443,7 @@ namespace prim3d {
      * 3 Заменить исходный список граней фигуры списком объединённых граней.
      */
     faces.swap(unated_shell_faces);
+    metrics::add("faces_after_merge", static_cast<long long>(faces.size()));
 
     if (debug) {
       std::cout << std::endl;
@@ -1333,6 +1506,14 @@ namespace prim3d {
      * 3 Шаг 7 - для каждой грани удалить помеченные рёбра из всех границ, объединить границы.
      */
 
+    if (metrics::enabled()) {
+      long long removed = 0;
+      for (auto it = edges.cbegin(); it != edges.cend(); ++it) {
+        if ((*it)->is_marked()) removed++;
+      }
+      metrics::add("edges_removed", removed);
+    }
+
     if (debug) {
       std::cout << std::endl;
       std::cout << "* reduce_edges ******************************************************" << std::endl;
@@ -1374,9 +1555,9 @@ namespace prim3d {
         return err_enum_t::ERROR_INTERNAL;
       }
 
-      std::vector<border> new_borders;
-      new_borders.push_back(new_border);
-      (*it)->set_borders(new_borders);
+      face::border_list new_borders;
+      new_borders.push_back(std::move(new_border));
+      (*it)->set_borders(std::move(new_borders));
     }
 
     /**
@@ -1406,7 +1587,7 @@ namespace prim3d {
         return err_enum_t::ERROR_INTERNAL;
       }
 
-      border old_border = *(*it)->get_borders().cbegin();
+      border old_border = std::move((*it)->take_borders()[0]);
       /** Проверка: в старой границе должно быть не меньше трёх рёбер */
       if (old_border.edges_num() < 3) {
         std::cout << "ERROR (split_edges_to_borders): border with number of edges < 3 in face #" << std::distance(faces.cbegin(), it) + 1 << std::endl;
@@ -1419,7 +1600,7 @@ namespace prim3d {
         std::cout << std::endl;
       }
 
-      std::vector<border> new_border_list;
+      face::border_list new_border_list;
 
       /** Цикл продолжается, пока в старой границе есть ориентированные рёбра. */
       for (; old_border.edges_num() != 0;) {
@@ -1479,9 +1660,9 @@ namespace prim3d {
         } while (last_vertex != first_vertex);
 
         /** Добавить новую границу в список новых границ. */
-        new_border_list.push_back(new_border);
+        new_border_list.push_back(std::move(new_border));
       }
-      (*it)->set_borders(new_border_list);
+      (*it)->set_borders(std::move(new_border_list));
     }
     return err_enum_t::ERROR_OK;
   }
@@ -1502,200 +1683,4 @@ namespace prim3d {
       (*it)->print();
     }
   }
-
-/** \brief Количество векторов (координат), определяющих одну грань (нормаль и три вершины) */
-#define NORMAL_NUM 1
-#define COORDS_NUM 3
-
-  /**
-   * \file
-   * * \copybrief prim3d::shell::import(const std::string&, std::vector<geometry::vector>&)
-   */
-  err_enum_t shell::import(const std::string& fname, std::vector<geometry::vector>& faces) {
-    bool                     wassolid = false;
-    bool                     wasface = false;
-    bool                     wasouterloop = false;
-    geometry::vector         face_normal;      /** Нормаль новой грани */
-    geometry::vector         face_outer[COORDS_NUM]; /**  Вершины новой грани */
-    size_t                   face_line;        /** Номер строки, в которой начинается описание новой грани */
-    size_t                   vnum = 0;         /** Счётчик вершин в новой грани */
-    size_t                   line_num = 0;     /** Счётчик строк импортируемого файла */
-    std::vector<size_t>      facet_lines;      /** Номера строк, в которых начинается описание граней */
-
-    // Прочитать файл STL
-    FILE* in;
-
-#if defined(_MSC_VER)
-    errno_t err = fopen_s(&in, fname.c_str(), "rt");
-    if (err != 0 || in == nullptr)
-#elif defined(__GNUC__) || defined(__DOXYGEN__)
-    in = fopen(fname.c_str(), "rt");
-    if (in == nullptr)
-#else
-# error Unknown C++ compiler
-#endif
-    {
-      std::cout << "ERROR (import): Can't open file '" << fname << "' for reading" << std::endl;
-      return err_enum_t::ERROR_FILE_IO;
-    }
-
-    faces.clear();
-    for (;;) {
-      char Buf[1000];
-
-      if (fgets(Buf, sizeof(Buf), in) == nullptr) break;
-      line_num ++;
-
-//!!! Свести любое количество пробелов/табуляций к одному пробелу!
-
-      // Убрать переводы строки в конце строки
-      size_t blen = strlen(Buf);
-      if (blen > 1 && Buf[blen - 1] == '\n') blen--;
-      if (blen > 1 && Buf[blen - 1] == '\r') blen--;
-      Buf[blen] = '\0';
-
-      // Убрать пробелы в начале строки
-      const char* B = Buf;
-      for (; *B == ' '; ++B);
-      if (*B == '\0') {
-        std::cout << "ERROR (import): no text in line #" << line_num << std::endl;
-        fclose(in);
-        return err_enum_t::ERROR_IMPORT;
-      }
-
-      // Разбор файла STL
-      if (strncmp(B, "solid ", 6) == 0) {
-        wassolid = true;
-        continue;
-      }
-
-      if (wassolid == false) {
-        std::cout << "ERROR (import): no 'solid' in line #" << line_num << "!" << std::endl;
-        fclose(in);
-        return err_enum_t::ERROR_IMPORT;
-      }
-
-      if (strncmp(B, "endsolid ", 9) == 0) {
-        wassolid = false;
-        break;
-      }
-
-      if (strncmp(B, "facet normal ", 13) == 0) {
-        float X, Y, Z;
-        wasface = true;
-#if defined(_MSC_VER)
-        int readed = sscanf_s(&B[13], "%f %f %f", &X, &Y, &Z);
-#elif defined(__GNUC__) || defined(__DOXYGEN__)
-        int readed = sscanf(&B[13], "%f %f %f", &X, &Y, &Z);
-#else
-# error Unknown C++ compiler
-#endif
-
-        if (readed != 3) {
-          std::cout << "ERROR (import): can not read coordinates in line #" << line_num << "!" << std::endl;
-          fclose(in);
-          return err_enum_t::ERROR_IMPORT;
-        }
-        face_normal = geometry::vector(X, Y, Z);
-        face_line = line_num;
-        continue;
-      }
-
-      if (wasface == false) {
-        std::cout << "ERROR (import): no 'facet' in line #" << line_num << "!" << std::endl;
-        fclose(in);
-        return err_enum_t::ERROR_IMPORT;
-      }
-
-      if (strncmp(B, "endfacet", 8) == 0) {
-        wasface = false;
-
-        // Входной контроль: нет ли уже такой грани?
-        bool add_face = true;
-        for (auto it = faces.cbegin(); it != faces.cend();) {
-          const geometry::vector& nr = *it ++;
-          const geometry::vector& p1 = *it ++;
-          const geometry::vector& p2 = *it ++;
-          const geometry::vector& p3 = *it ++;
-
-          if (nr == face_normal) {
-            if ((p1 == face_outer[0] && p2 == face_outer[1] && p3 == face_outer[2]) ||
-                (p1 == face_outer[0] && p2 == face_outer[2] && p3 == face_outer[1]) ||
-                (p1 == face_outer[1] && p2 == face_outer[2] && p3 == face_outer[0]) ||
-                (p1 == face_outer[1] && p2 == face_outer[0] && p3 == face_outer[2]) ||
-                (p1 == face_outer[2] && p2 == face_outer[0] && p3 == face_outer[1]) ||
-                (p1 == face_outer[2] && p2 == face_outer[1] && p3 == face_outer[0])) {
-               add_face = false;
-               std::cout << "WARNING (import): одинаковые грани в строке #" <<
-                 facet_lines[std::distance(faces.cbegin(), it) / (NORMAL_NUM + COORDS_NUM) - 1]  << " и в строке #" << face_line << std::endl;
-               break;
-            }
-          }
-        }
-        
-        if (add_face) {
-          // Можно формировать грань
-          faces.emplace_back(face_normal);
-          faces.emplace_back(face_outer[0]);
-          faces.emplace_back(face_outer[1]);
-          faces.emplace_back(face_outer[2]);
-          facet_lines.push_back(face_line);
-        }
-        continue;
-      }
-
-      if (strncmp(B, "outer loop", 10) == 0) {
-        wasouterloop = true;
-        vnum = 0;
-        continue;
-      }
-
-      if (wasouterloop == false) {
-        std::cout << "ERROR (import): no 'outer loop' in line #" << line_num << "!" << std::endl;
-        fclose(in);
-        return err_enum_t::ERROR_IMPORT;
-      }
-
-      if (strncmp(B, "endloop", 7) == 0) {
-        wasouterloop = false;
-        continue;
-      }
-
-      // Запомнить координаты вершины
-      if (strncmp(B, "vertex ", 7) == 0) {
-        if (vnum >= 3) {
-          std::cout << "ERROR (import): 4th vertex per face in line #" << line_num << "!" << std::endl;
-          fclose(in);
-          return err_enum_t::ERROR_IMPORT;
-        }
-        float X, Y, Z;
-#if defined(_MSC_VER)
-        int readed = sscanf_s(&B[7], "%f %f %f", &X, &Y, &Z);
-#elif defined(__GNUC__) || defined(__DOXYGEN__)
-        int readed = sscanf(&B[7], "%f %f %f", &X, &Y, &Z);
-#else
-# error Unknown C++ compiler
-#endif
-        if (readed != 3) {
-          std::cout << "ERROR (import): can not read coordinates in line #" << line_num << "!" << std::endl;
-          fclose(in);
-          return err_enum_t::ERROR_IMPORT;
-        }
-        face_outer[vnum++] = geometry::vector(X, Y, Z);
-        continue;
-      }
-
-      std::cout << "ERROR (import): unknown keyword in line #" << line_num << "!" << std::endl;
-      fclose(in);
-      return err_enum_t::ERROR_IMPORT;
-    }
-    fclose(in);
-
-    if (faces.size() / (NORMAL_NUM + COORDS_NUM) * (NORMAL_NUM + COORDS_NUM) != faces.size()) {
-      std::cout << "ERROR (import): количество прочитанных векторов не кратно " << (NORMAL_NUM + COORDS_NUM) << std::endl;
-      return err_enum_t::ERROR_INTERNAL;
-    }
-
-    return err_enum_t::ERROR_OK;
-  }
 }
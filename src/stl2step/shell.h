@@ -16,6 +16,23 @@
 
 #include "err.h"
 #include "geometry.h"
+#include "small_vector.h"
+
+namespace topology {
+  class file;
+}
+
+/**
+ * \brief Количество направленных рёбер границы, размещаемых без выделения памяти в куче
+ * (достаточно для треугольных и четырёхугольных границ)
+ */
+#define BORDER_INLINE_EDGES 4
+
+/**
+ * \brief Размер файла STL по умолчанию, начиная с которого имеет смысл параллельный разбор
+ * (см. \ref prim3d::shell::import())
+ */
+#define PARALLEL_IMPORT_MIN_SIZE (4 * 1024 * 1024)
 
 namespace prim3d {
 
@@ -89,6 +106,11 @@ namespace prim3d {
      */
     geometry::vector coord;
 
+    /**
+     * \brief Номер вершины в списке вершин фигуры (см. \ref shell::index_elements())
+     */
+    mutable unsigned index;
+
     /**
      * \brief Список указателей на рёбра фигуры, включающих данную вершину.
      */
@@ -166,6 +188,20 @@ namespace prim3d {
      */
     void add_edge(edge* e);
 
+    /**
+     * \brief Получить номер вершины в списке вершин фигуры
+     *
+     * \return номер, присвоенный последним вызовом \ref shell::index_elements().
+     */
+    unsigned get_index() const;
+
+    /**
+     * \brief Установить номер вершины в списке вершин фигуры
+     *
+     * \param [in] i номер вершины
+     */
+    void set_index(unsigned i) const;
+
     /**
      * \brief Отладочный вывод информации о вершине
      *
@@ -209,6 +245,11 @@ namespace prim3d {
      */
     const face* right_face; //-V122_NOPTR
 
+    /**
+     * \brief Номер ребра в списке рёбер фигуры (см. \ref shell::index_elements())
+     */
+    mutable unsigned index;
+
   public:
 
     /**
@@ -271,6 +312,20 @@ namespace prim3d {
      */
     void set_right(const face* f);
 
+    /**
+     * \brief Получить номер ребра в списке рёбер фигуры
+     *
+     * \return номер, присвоенный последним вызовом \ref shell::index_elements().
+     */
+    unsigned get_index() const;
+
+    /**
+     * \brief Установить номер ребра в списке рёбер фигуры
+     *
+     * \param [in] i номер ребра
+     */
+    void set_index(unsigned i) const;
+
     /**
      * \brief Отладочный вывод информации о ребре
      *
@@ -359,15 +414,36 @@ namespace prim3d {
    */
   class border {
 
+  public:
+
+    /**
+     * \brief Тип списка направленных рёбер границы: рёбра треугольной и четырёхугольной границ
+     * размещаются без выделения памяти в куче
+     */
+    typedef small_vector<oriented_edge, BORDER_INLINE_EDGES> edge_list;
+
   private:
 
     /**
      * \brief Цепочка направленных рёбер, образующих границу
      */
-    std::vector<oriented_edge> edges;
+    edge_list edges;
 
   public:
 
+    /**
+     * \brief Конструктор пустой границы
+     */
+    border() = default;
+
+    /**
+     * \brief Граница только перемещается (копирование запрещено)
+     */
+    border(border&&) = default;
+    border& operator=(border&&) = default;
+    border(const border&) = delete;
+    border& operator=(const border&) = delete;
+
     /**
      * \brief Добавить ребро к списку рёбер границы
      *
@@ -380,7 +456,7 @@ namespace prim3d {
      *
      * \return константную ссылку на цепочку направленных рёбер, образующих границу.
      */
-    const std::vector<oriented_edge>& get_edges() const;
+    const edge_list& get_edges() const;
 
     /**
      * \brief Получить количество рёбер в списке рёбер границы
@@ -396,7 +472,7 @@ namespace prim3d {
      * \return итератор ребра, находящегося после удаляемого,
      * или итератор конца списка рёбер.
      */
-    std::vector<oriented_edge>::iterator remove(std::vector<oriented_edge>::const_iterator it);
+    edge_list::iterator remove(edge_list::const_iterator it);
 
     /**
      * \brief Отладочный вывод информации о границе
@@ -415,6 +491,14 @@ namespace prim3d {
    */
   class face : public primitive {
 
+  public:
+
+    /**
+     * \brief Тип списка границ грани: единственная (внешняя) граница размещается
+     * без выделения памяти в куче
+     */
+    typedef small_vector<border, 1> border_list;
+
   private:
 
     /**
@@ -425,7 +509,7 @@ namespace prim3d {
     /**
      * \brief Список из одной и более границ, образующих грань
      */
-    std::vector<border> borders;
+    border_list borders;
 
   public:
 
@@ -455,23 +539,30 @@ namespace prim3d {
     /**
      * \brief Добавить границу к списку границ грани
      *
-     * \param [in] b добавляемая граница.
+     * \param [in] b добавляемая граница (перемещается).
      */
-    void add_border(const border& b);
+    void add_border(border&& b);
 
     /**
      * \brief Заменить список границ грани на указанный
      *
-     * \param [in] new_borders новый список границ грани.
+     * \param [in] new_borders новый список границ грани (перемещается).
      */
-    void set_borders(const std::vector<border>& new_borders);
+    void set_borders(border_list&& new_borders);
+
+    /**
+     * \brief Забрать список границ грани, оставив грань без границ
+     *
+     * \return список границ грани.
+     */
+    border_list take_borders();
 
     /**
      * \brief Получить константную ссылку на список границ грани
      *
      * \return константную ссылку на список границ грани.
      */
-    const std::vector<border>& get_borders() const;
+    const border_list& get_borders() const;
 
     /**
      * \brief Получить количество границ грани
@@ -480,6 +571,15 @@ namespace prim3d {
      */
     size_t borders_num() const;
 
+    /**
+     * \brief Рассчитать единичные векторы направлений (от начала к концу) базовых рёбер
+     * всех границ грани в порядке их следования.
+     *
+     * \param [out] dirs направления рёбер
+     * \param [out] work рабочий массив (передаётся, чтобы не выделять память для каждой грани)
+     */
+    void get_edge_directions(geometry::vector_array& dirs, geometry::vector_array& work) const;
+
     /**
      * \brief Отладочный вывод информации о грани
      *
@@ -533,6 +633,30 @@ namespace prim3d {
      */
     shell* split(const void* marker);
 
+    /**
+     * \brief Добавить в фигуру треугольную грань с тремя рёбрами
+     *
+     * \param [in] f новая грань (без границ)
+     * \param [in] ptr_vertex три вершины грани, уже входящие в список вершин фигуры
+     */
+    void add_triangle(face* f, vertex* const ptr_vertex[3]);
+
+    /**
+     * \brief Параллельный импорт информации о треугольниках из большого файла STL.
+     *
+     * Файл отображается в память и делится на части по строкам "facet normal",
+     * части разбираются одновременно, грани объединяются в порядке следования в файле.
+     *
+     * \param [in] fname имя импортируемого файла
+     * \param [out] faces список треугольных граней (4 вектора на грань - нормаль и три вершины)
+     * \param [in] threads количество потоков разбора
+     * \param [in] min_size размер файла, начиная с которого файл разбирается параллельно
+     * \retval err_enum_t::ERROR_OK в случае успешного импорта;
+     * \retval err_enum_t::ERROR_INTERNAL если файл мал, не отображается в память или
+     * содержит ошибки - тогда он читается последовательно.
+     */
+    static err_enum_t import_parallel(const std::string& fname, std::vector<geometry::vector>& faces, unsigned threads, size_t min_size);
+
   public:
 
     /**
@@ -548,6 +672,19 @@ namespace prim3d {
      */
     shell(const std::vector<geometry::vector>& stlf);
 
+    /**
+     * \brief Конструктор фигуры из индексированной сетки треугольников (без объединения вершин)
+     *
+     * Вершины с одним индексом становятся одной вершиной фигуры, совпадение координат
+     * вершин с разными индексами не проверяется. Нормали граней вычисляются по вершинам.
+     * Треугольники с повторяющимися индексами вершин пропускаются.
+     *
+     * \param [in] points координаты вершин сетки
+     * \param [in] indices индексы вершин треугольников (по три на треугольник, обход
+     * против часовой стрелки при взгляде снаружи)
+     */
+    shell(const std::vector<geometry::vector>& points, const std::vector<size_t>& indices);
+
     /**
      * \brief Деструктор фигуры
      */
@@ -602,6 +739,14 @@ namespace prim3d {
      */
     const geometry::vector& get_pos() const;
 
+    /**
+     * \brief Пронумеровать вершины и рёбра фигуры по их положению в списках вершин и рёбер.
+     *
+     * Номера позволяют хранить сведения о вершинах и рёбрах фигуры в обычных массивах,
+     * индексируемых номером (см. \ref vertex::get_index(), \ref edge::get_index()).
+     */
+    void index_elements() const;
+
     /**
      * \brief Снять пометки со всех вершин фигуры
      */
@@ -692,9 +837,17 @@ namespace prim3d {
      * \brief Объединить треугольные грани в многоугольные (первая часть объединения
      * граней в многоугольные)
      *
+     * Соседние грани объединяются, если их нормали совпадают с точностью EPSILON_Y.
+     * При проверке плоскостности дополнительно требуется, чтобы все вершины присоединяемой
+     * грани лежали в плоскости первой грани группы (проходящей через её первую вершину
+     * перпендикулярно её нормали) с точностью EPSILON_P; это не даёт объединить в одну
+     * плоскую грань пологую поверхность или тонкий элемент, наклонённый на угол, меньший
+     * точности сравнения нормалей.
+     *
      * \param [in] debug выводить отладочную информацию
+     * \param [in] check_plane проверять плоскостность объединённой грани
      */
-    void merge_faces(bool debug);
+    void merge_faces(bool debug, bool check_plane = false);
 
     /**
      * \brief Удалить избыточные рёбра в многоугольных гранях (вторая часть объединения
@@ -732,11 +885,74 @@ namespace prim3d {
      *
      * \param [in] fname имя импортируемого файла
      * \param [out] faces список треугольных граней (4 вектора на грань - нормаль и три вершины)
+     * \param [in] threads количество потоков разбора (большие файлы разбираются частями параллельно)
+     * \param [in] min_size размер файла, начиная с которого файл разбирается частями параллельно
+     * \retval err_enum_t::ERROR_OK в случае успешного импорта;
+     * \retval err_enum_t::ERROR_FILE_IO в случае ошибки ввода-вывода;
+     * \retval err_enum_t::ERROR_IMPORT в случае ошибки при обработке импортируемого файла.
+     */
+    static err_enum_t import(const std::string& fname, std::vector<geometry::vector>& faces, unsigned threads = 1,
+      size_t min_size = PARALLEL_IMPORT_MIN_SIZE);
+
+    /**
+     * \brief Проверка треугольников, импортированных из файла STL, до построения фигуры.
+     *
+     * Треугольники с совпадающими (с точностью EPSILON_X) вершинами отбрасываются.
+     * Нулевые, ненормированные и неточные нормали заменяются нормалями, вычисленными
+     * по вершинам (кроме вытянутых треугольников, для которых вычисленная нормаль ненадёжна).
+     *
+     * \param [in,out] faces список треугольных граней (4 вектора на грань - нормаль и три вершины)
+     * \param [in] debug выводить сведения о каждой отброшенной грани
+     */
+    static void check_faces(std::vector<geometry::vector>& faces, bool debug);
+
+    /**
+     * \brief Проверить, содержит ли файл индексированную сетку (по расширению).
+     *
+     * \param [in] fname имя файла
+     * \return true для файлов .ply и .obj
+     */
+    static bool is_mesh_name(const std::string& fname);
+
+    /**
+     * \brief Импорт индексированной сетки треугольников из файла PLY (двоичного) или OBJ.
+     *
+     * Многоугольные грани разбиваются на треугольники веером от первой вершины.
+     *
+     * \param [in] fname имя импортируемого файла
+     * \param [out] points координаты вершин сетки
+     * \param [out] indices индексы вершин треугольников (по три на треугольник)
      * \retval err_enum_t::ERROR_OK в случае успешного импорта;
      * \retval err_enum_t::ERROR_FILE_IO в случае ошибки ввода-вывода;
      * \retval err_enum_t::ERROR_IMPORT в случае ошибки при обработке импортируемого файла.
      */
-    static err_enum_t import(const std::string& fname, std::vector<geometry::vector>& faces);
+    static err_enum_t import_mesh(const std::string& fname, std::vector<geometry::vector>& points, std::vector<size_t>& indices);
+
+    /**
+     * \brief Записать обработанные фигуры файла STL в файл топологии (см. \ref topology.h).
+     *
+     * Сохраняются вершины, рёбра (с левой и правой гранями), грани с границами, условные
+     * центры фигур и ссылки клонов на исходные фигуры (топология клонов не сохраняется).
+     * Файл записывается под временным именем и затем переименовывается, поэтому
+     * одновременно работающие программы не видят недописанный файл.
+     *
+     * \param [in] fname имя файла топологии
+     * \param [in] key ключ (описание исходного файла и параметров обработки)
+     * \param [in] shells фигуры
+     * \retval err_enum_t::ERROR_OK в случае успешного сохранения;
+     * \retval err_enum_t::ERROR_FILE_IO в случае ошибки ввода-вывода;
+     * \retval err_enum_t::ERROR_INTERNAL если примитивы фигуры ссылаются на примитивы вне её списков.
+     */
+    static err_enum_t save_topology(const std::string& fname, const std::string& key, const std::vector<shell*>& shells);
+
+    /**
+     * \brief Создать фигуры по открытому файлу топологии (см. \ref save_topology).
+     *
+     * \param [in] file файл топологии
+     * \param [out] shells фигуры (создаются в куче, уничтожаются вызывающей стороной)
+     * \return \ref err_enum_t::ERROR_OK "ERROR_OK"
+     */
+    static err_enum_t load_topology(const topology::file& file, std::vector<shell*>& shells);
   };
 }
 
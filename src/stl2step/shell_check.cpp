@@ -0,0 +1,151 @@
+/**
+ * \file
+ *
+ * \brief Файл с определением метода check_faces класса shell - проверка треугольников,
+ * импортированных из файла STL, до построения фигуры
+ *
+ * Нормали и площади треугольников вычисляются пакетами: координаты вершин пакета переносятся
+ * в массивы координат (\ref geometry::vector_array), которые обрабатываются пакетными
+ * функциями geometry::batch_*.
+ */
+
+#include "stdafx.h"
+#include <memory>
+#include "precision.h"
+#include "err.h"
+#include "shell.h"
+#include "metrics.h"
+
+/** \brief Количество векторов, определяющих одну грань (нормаль и три вершины) */
+#define FACE_VECTORS 4
+
+/** \brief Количество треугольников в пакете */
+#define CHECK_BATCH 256
+
+/**
+ * \brief Пакет треугольников в виде массивов координат и результаты расчёта
+ */
+struct check_batch {
+  /** \brief Вершины A, B, C */
+  geometry::vector_array a, b, c;
+  /** \brief Рёбра B - A, C - A, C - B */
+  geometry::vector_array u, v, w;
+  /** \brief Векторное произведение (B - A) x (C - A) - ненормированная нормаль */
+  geometry::vector_array n;
+  /** \brief Квадрат модуля векторного произведения (учетверённый квадрат площади) */
+  geometry::real area2[CHECK_BATCH];
+  /** \brief Квадраты длин рёбер */
+  geometry::real u2[CHECK_BATCH], v2[CHECK_BATCH], w2[CHECK_BATCH];
+  /** \brief Признаки совпадения (с точностью EPSILON_X) вершин A и B, A и C, B и C */
+  unsigned char ab[CHECK_BATCH], ac[CHECK_BATCH], bc[CHECK_BATCH];
+
+  /**
+   * \brief Рассчитать нормали, площади и признаки вырожденности для треугольников пакета.
+   */
+  void calculate() {
+    geometry::batch_sub(b, a, u);
+    geometry::batch_sub(c, a, v);
+    geometry::batch_sub(c, b, w);
+    geometry::batch_cross(u, v, n);
+    geometry::batch_dot(n, n, area2);
+    geometry::batch_dot(u, u, u2);
+    geometry::batch_dot(v, v, v2);
+    geometry::batch_dot(w, w, w2);
+    geometry::batch_equal(a, b, EPSILON_X, ab);
+    geometry::batch_equal(a, c, EPSILON_X, ac);
+    geometry::batch_equal(b, c, EPSILON_X, bc);
+  }
+};
+
+namespace prim3d {
+
+  /**
+   * \file
+   * Функции, являющиеся методами класса \ref prim3d::shell "shell":
+   * <BR>
+   */
+
+  /**
+   * \file
+   * * \copybrief prim3d::shell::check_faces(std::vector<geometry::vector>&, bool)
+   */
+  void shell::check_faces(std::vector<geometry::vector>& faces, bool debug) {
+    const size_t faces_num = faces.size() / FACE_VECTORS;
+    std::unique_ptr<check_batch> b(new check_batch);
+
+    size_t dropped = 0;        /** Отброшено вырожденных треугольников */
+    size_t slivers = 0;        /** Найдено вытянутых треугольников */
+    size_t fixed = 0;          /** Исправлено нормалей */
+    size_t out = 0;            /** Номер следующей сохраняемой грани */
+
+    for (size_t start = 0; start < faces_num; start += CHECK_BATCH) {
+      const size_t n = std::min(static_cast<size_t>(CHECK_BATCH), faces_num - start);
+
+      // Перенести координаты вершин пакета в массивы координат
+      b->a.resize(n);
+      b->b.resize(n);
+      b->c.resize(n);
+      for (size_t i = 0; i < n; ++i) {
+        const geometry::vector* f = &faces[(start + i) * FACE_VECTORS];
+        b->a.set(i, f[1]);
+        b->b.set(i, f[2]);
+        b->c.set(i, f[3]);
+      }
+
+      b->calculate();
+
+      for (size_t i = 0; i < n; ++i) {
+        const size_t idx = start + i;
+
+        /** Треугольник с совпадающими вершинами не образует грани - отбрасывается */
+        if (b->ab[i] || b->ac[i] || b->bc[i]) {
+          dropped++;
+          if (debug) {
+            std::cout << "WARNING (check_faces): отброшена вырожденная грань #" << idx + 1 << " " <<
+              faces[idx * FACE_VECTORS + 1] << faces[idx * FACE_VECTORS + 2] << faces[idx * FACE_VECTORS + 3] << std::endl;
+          }
+          continue;
+        }
+
+        geometry::vector& normal = faces[idx * FACE_VECTORS];
+        const double module = sqrt(b->area2[i]);
+
+        /**
+         * Вытянутый треугольник (высота мала по сравнению с длиной ребра) сохраняется,
+         * но его вычисленная нормаль ненадёжна, поэтому нормаль из файла заменяется
+         * только если она нулевая.
+         */
+        const bool sliver = (module < EPSILON_N * std::max(b->u2[i], std::max(b->v2[i], b->w2[i])));
+        if (sliver) slivers++;
+
+        const double normal_module = normal.module();
+        if (module > 0.0 && (!sliver || normal_module < EPSILON_N)) {
+          const geometry::vector nv = b->n.get(i);
+          geometry::vector calc(nv.getX() / module, nv.getY() / module, nv.getZ() / module);
+          /** Нулевая, ненормированная или неточная нормаль заменяется вычисленной по вершинам */
+          if (fabs(normal_module - 1.0) > EPSILON_N || !normal.is_equal(calc, EPSILON_N)) {
+            normal = calc;
+            fixed++;
+          }
+        }
+
+        if (out != idx) {
+          for (size_t k = 0; k < FACE_VECTORS; ++k) {
+            faces[out * FACE_VECTORS + k] = faces[idx * FACE_VECTORS + k];
+          }
+        }
+        out++;
+      }
+    }
+    faces.resize(out * FACE_VECTORS);
+    metrics::add("triangles_dropped", static_cast<long long>(dropped));
+    metrics::add("normals_recomputed", static_cast<long long>(fixed));
+
+    if (dropped > 0) {
+      std::cout << "WARNING (check_faces): отброшено вырожденных граней: " << dropped << std::endl;
+    }
+    if (debug && (slivers > 0 || fixed > 0)) {
+      std::cout << "check_faces: вытянутых граней " << slivers << ", исправлено нормалей " << fixed << std::endl;
+    }
+  }
+}
@@ -0,0 +1,559 @@
+/**
+ * \file
+ *
+ * \brief Файл с определением метода import класса shell - импорт треугольников из файла STL
+ *
+ * Файл STL в текстовом формате (в том числе сжатый gzip или упакованный в архив zip)
+ * может быть прочитан последовательно (построчно) или параллельно: файл целиком
+ * отображается в память, делится на части по строкам "facet normal", части
+ * разбираются одновременно несколькими потоками, после чего треугольники
+ * объединяются в порядке следования в файле.
+ */
+
+#include "stdafx.h"
+#include <unordered_map>
+#include "precision.h"
+#include "err.h"
+#include "shell.h"
+#include "mapped_file.h"
+#include "stl_input.h"
+#include "trace.h"
+
+/** \brief Количество векторов (координат), определяющих одну грань (нормаль и три вершины) */
+#define NORMAL_NUM 1
+#define COORDS_NUM 3
+
+/** \brief Размер буфера строки (как при чтении функцией fgets) */
+#define LINE_BUF_SIZE 1000
+
+/**
+ * \brief Шаг сетки поиска одинаковых граней (больше наибольшего отличия сумм координат
+ * вершин одинаковых граней 3 * EPSILON_X, чтобы одинаковые грани попадали в соседние ячейки)
+ */
+#define FACET_CELL (4 * EPSILON_X)
+
+/**
+ * \brief Разбор строк файла STL в текстовом формате.
+ *
+ * Хранит состояние разбора между строками. Сообщения об ошибках не выводятся,
+ * а сохраняются, чтобы при параллельном разборе их можно было вывести в порядке
+ * следования строк в файле.
+ */
+struct stl_line_parser {
+
+  /** \brief Результат разбора строки */
+  enum result_t {
+    /** Строка разобрана */
+    LINE_OK,
+    /** Строка завершила описание грани (endfacet) */
+    LINE_FACET,
+    /** Строка завершила описание тела (endsolid) */
+    LINE_END,
+    /** Ошибка разбора */
+    LINE_ERROR
+  };
+
+  /** \brief Было ключевое слово solid */
+  bool wassolid;
+  /** \brief Было ключевое слово facet */
+  bool wasface;
+  /** \brief Было ключевое слово outer loop */
+  bool wasouterloop;
+  /** \brief Нормаль новой грани */
+  geometry::vector face_normal;
+  /** \brief Вершины новой грани */
+  geometry::vector face_outer[COORDS_NUM];
+  /** \brief Номер строки, в которой начинается описание новой грани */
+  size_t face_line;
+  /** \brief Счётчик вершин в новой грани */
+  size_t vnum;
+  /** \brief Текст сообщения об ошибке (до номера строки) */
+  const char* error_text;
+  /** \brief Окончание сообщения об ошибке (после номера строки) */
+  const char* error_tail;
+
+  /**
+   * \brief Конструктор из параметров
+   *
+   * \param [in] Wassolid разбор начинается внутри описания тела (solid)
+   */
+  explicit stl_line_parser(bool Wassolid) :
+    wassolid(Wassolid), wasface(false), wasouterloop(false), face_line(0), vnum(0),
+    error_text(""), error_tail("") {
+  }
+
+  /**
+   * \brief Запомнить ошибку разбора.
+   *
+   * \param [in] text текст сообщения об ошибке (до номера строки)
+   * \param [in] tail окончание сообщения об ошибке (после номера строки)
+   * \return \ref stl_line_parser::LINE_ERROR "LINE_ERROR"
+   */
+  result_t error(const char* text, const char* tail) {
+    error_text = text;
+    error_tail = tail;
+    return LINE_ERROR;
+  }
+
+  /**
+   * \brief Разобрать одну строку файла.
+   *
+   * \param [in,out] Buf строка (символы перевода строки в конце удаляются)
+   * \param [in] line_num номер строки
+   * \return результат разбора строки
+   */
+  result_t parse(char* Buf, size_t line_num) {
+
+//!!! Свести любое количество пробелов/табуляций к одному пробелу!
+
+    // Убрать переводы строки в конце строки
+    size_t blen = strlen(Buf);
+    if (blen > 1 && Buf[blen - 1] == '\n') blen--;
+    if (blen > 1 && Buf[blen - 1] == '\r') blen--;
+    Buf[blen] = '\0';
+
+    // Убрать пробелы в начале строки
+    const char* B = Buf;
+    for (; *B == ' '; ++B);
+    if (*B == '\0') {
+      return error("no text", "");
+    }
+
+    // Разбор файла STL
+    if (strncmp(B, "solid ", 6) == 0) {
+      wassolid = true;
+      return LINE_OK;
+    }
+
+    if (wassolid == false) {
+      return error("no 'solid'", "!");
+    }
+
+    if (strncmp(B, "endsolid ", 9) == 0) {
+      wassolid = false;
+      return LINE_END;
+    }
+
+    if (strncmp(B, "facet normal ", 13) == 0) {
+      float X, Y, Z;
+      wasface = true;
+#if defined(_MSC_VER)
+      int readed = sscanf_s(&B[13], "%f %f %f", &X, &Y, &Z);
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+      int readed = sscanf(&B[13], "%f %f %f", &X, &Y, &Z);
+#else
+# error Unknown C++ compiler
+#endif
+
+      if (readed != 3) {
+        return error("can not read coordinates", "!");
+      }
+      face_normal = geometry::vector(X, Y, Z);
+      face_line = line_num;
+      return LINE_OK;
+    }
+
+    if (wasface == false) {
+      return error("no 'facet'", "!");
+    }
+
+    if (strncmp(B, "endfacet", 8) == 0) {
+      wasface = false;
+      return LINE_FACET;
+    }
+
+    if (strncmp(B, "outer loop", 10) == 0) {
+      wasouterloop = true;
+      vnum = 0;
+      return LINE_OK;
+    }
+
+    if (wasouterloop == false) {
+      return error("no 'outer loop'", "!");
+    }
+
+    if (strncmp(B, "endloop", 7) == 0) {
+      wasouterloop = false;
+      return LINE_OK;
+    }
+
+    // Запомнить координаты вершины
+    if (strncmp(B, "vertex ", 7) == 0) {
+      if (vnum >= 3) {
+        return error("4th vertex per face", "!");
+      }
+      float X, Y, Z;
+#if defined(_MSC_VER)
+      int readed = sscanf_s(&B[7], "%f %f %f", &X, &Y, &Z);
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+      int readed = sscanf(&B[7], "%f %f %f", &X, &Y, &Z);
+#else
+# error Unknown C++ compiler
+#endif
+      if (readed != 3) {
+        return error("can not read coordinates", "!");
+      }
+      face_outer[vnum++] = geometry::vector(X, Y, Z);
+      return LINE_OK;
+    }
+
+    return error("unknown keyword", "!");
+  }
+};
+
+/**
+ * \brief Список граней с проверкой на повторы.
+ *
+ * Вершины одинаковых граней совпадают с точностью EPSILON_X в некотором порядке,
+ * поэтому суммы координат вершин одинаковых граней (не зависящие от порядка вершин)
+ * отличаются меньше чем на 3 * EPSILON_X. Сумма округляется до ячейки пространственной
+ * сетки с шагом \ref FACET_CELL, и новая грань сравнивается только с гранями своей
+ * и соседних ячеек, а не со всеми прочитанными гранями.
+ */
+class facet_list {
+
+  /** \brief Ячейка сетки: округлённые суммы координат вершин грани */
+  typedef std::array<int64_t, 3> cell_t;
+
+  /** \brief Хэш ячейки сетки */
+  struct cell_hash {
+    size_t operator()(const cell_t& c) const {
+      uint64_t h = static_cast<uint64_t>(c[0]);
+      h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(c[1]);
+      h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(c[2]);
+      return static_cast<size_t>(h ^ (h >> 29));
+    }
+  };
+
+  /** \brief Список треугольных граней (4 вектора на грань - нормаль и три вершины) */
+  std::vector<geometry::vector>& faces;
+
+  /** \brief Номера строк, в которых начинается описание граней */
+  std::vector<size_t> facet_lines;
+
+  /** \brief Номера граней в ячейках сетки */
+  std::unordered_multimap<cell_t, size_t, cell_hash> cells;
+
+  /**
+   * \brief Получить ячейку сетки грани.
+   *
+   * \param [in] face_outer вершины грани
+   * \return ячейка сетки
+   */
+  static cell_t get_cell(const geometry::vector* face_outer) {
+    const double sum[3] = {
+      double(face_outer[0].getX()) + double(face_outer[1].getX()) + double(face_outer[2].getX()),
+      double(face_outer[0].getY()) + double(face_outer[1].getY()) + double(face_outer[2].getY()),
+      double(face_outer[0].getZ()) + double(face_outer[1].getZ()) + double(face_outer[2].getZ())
+    };
+    cell_t c;
+    for (int i = 0; i < 3; ++i) {
+      /** Координаты вне диапазона сетки (и не числа) попадают в крайние ячейки */
+      double v = floor(sum[i] / FACET_CELL);
+      if (!(v > -4.e18)) v = -4.e18;
+      else if (v > 4.e18) v = 4.e18;
+      c[i] = static_cast<int64_t>(v);
+    }
+    return c;
+  }
+
+  /**
+   * \brief Проверка: грани совпадают (нормали и вершины в любом порядке).
+   *
+   * \param [in] face первая грань (нормаль и три вершины)
+   * \param [in] face_normal нормаль второй грани
+   * \param [in] face_outer вершины второй грани
+   * \return true, если грани совпадают
+   */
+  static bool is_same(const geometry::vector* face, const geometry::vector& face_normal, const geometry::vector* face_outer) {
+    const geometry::vector& nr = face[0];
+    const geometry::vector& p1 = face[1];
+    const geometry::vector& p2 = face[2];
+    const geometry::vector& p3 = face[3];
+
+    return nr == face_normal &&
+      ((p1 == face_outer[0] && p2 == face_outer[1] && p3 == face_outer[2]) ||
+       (p1 == face_outer[0] && p2 == face_outer[2] && p3 == face_outer[1]) ||
+       (p1 == face_outer[1] && p2 == face_outer[2] && p3 == face_outer[0]) ||
+       (p1 == face_outer[1] && p2 == face_outer[0] && p3 == face_outer[2]) ||
+       (p1 == face_outer[2] && p2 == face_outer[0] && p3 == face_outer[1]) ||
+       (p1 == face_outer[2] && p2 == face_outer[1] && p3 == face_outer[0]));
+  }
+
+public:
+
+  /**
+   * \brief Конструктор.
+   *
+   * \param [out] f список граней (очищается)
+   */
+  explicit facet_list(std::vector<geometry::vector>& f) : faces(f) {
+    faces.clear();
+  }
+
+  /**
+   * \brief Добавить грань в список граней, если такой грани в нём ещё нет.
+   *
+   * Если грань уже есть, выводится предупреждение с номером строки первой такой грани.
+   *
+   * \param [in] face_normal нормаль новой грани
+   * \param [in] face_outer вершины новой грани
+   * \param [in] face_line номер строки, в которой начинается описание новой грани
+   */
+  void add(const geometry::vector& face_normal, const geometry::vector* face_outer, size_t face_line) {
+    const cell_t cell = get_cell(face_outer);
+
+    // Входной контроль: нет ли уже такой грани? (в соседних ячейках, первая по порядку)
+    size_t found = facet_lines.size();
+    cell_t c;
+    for (c[0] = cell[0] - 1; c[0] <= cell[0] + 1; ++c[0]) {
+      for (c[1] = cell[1] - 1; c[1] <= cell[1] + 1; ++c[1]) {
+        for (c[2] = cell[2] - 1; c[2] <= cell[2] + 1; ++c[2]) {
+          auto range = cells.equal_range(c);
+          for (auto it = range.first; it != range.second; ++it) {
+            if ((*it).second < found && is_same(&faces[(*it).second * (NORMAL_NUM + COORDS_NUM)], face_normal, face_outer)) {
+              found = (*it).second;
+            }
+          }
+        }
+      }
+    }
+    if (found != facet_lines.size()) {
+      std::cout << "WARNING (import): одинаковые грани в строке #" << facet_lines[found] << " и в строке #" << face_line << std::endl;
+      return;
+    }
+
+    // Можно формировать грань
+    cells.emplace(cell, facet_lines.size());
+    faces.emplace_back(face_normal);
+    faces.emplace_back(face_outer[0]);
+    faces.emplace_back(face_outer[1]);
+    faces.emplace_back(face_outer[2]);
+    facet_lines.push_back(face_line);
+  }
+};
+
+/**
+ * \brief Результат разбора одной части файла STL.
+ */
+struct stl_chunk {
+
+  /** \brief Начало части */
+  const char* begin;
+
+  /** \brief Конец части */
+  const char* end;
+
+  /** \brief Часть разбирается с начала описания тела (только первая часть) */
+  bool first;
+
+  /** \brief Прочитанные грани без проверки на повторы (4 вектора на грань) */
+  std::vector<geometry::vector> faces;
+
+  /** \brief Номера строк (относительно начала части), в которых начинается описание граней */
+  std::vector<size_t> facet_lines;
+
+  /** \brief Количество строк в части */
+  size_t lines_num;
+
+  /** \brief В части встретилось окончание описания тела (endsolid) */
+  bool ended;
+
+  /** \brief При разборе части произошла ошибка или встретилась слишком длинная строка */
+  bool failed;
+
+  stl_chunk() : begin(nullptr), end(nullptr), first(false), lines_num(0), ended(false), failed(false) {
+  }
+};
+
+/**
+ * \brief Разобрать часть файла STL (функция потока).
+ *
+ * \param [in,out] chunk часть файла и результат её разбора
+ */
+static void parse_chunk(stl_chunk* chunk) {
+  trace::span chunk_span("parse_chunk", "import");
+  chunk_span.arg("bytes", static_cast<long long>(chunk->end - chunk->begin));
+  stl_line_parser parser(!chunk->first);
+  char Buf[LINE_BUF_SIZE];
+
+  for (const char* p = chunk->begin; p < chunk->end;) {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', chunk->end - p));
+    const char* next = (eol == nullptr) ? chunk->end : eol + 1;
+    size_t len = next - p;
+
+    /** Строка, которую fgets прочитал бы по частям, или нулевой символ - разбор последовательно */
+    if (len >= LINE_BUF_SIZE - 1 || memchr(p, '\0', len) != nullptr) {
+      chunk->failed = true;
+      return;
+    }
+    memcpy(Buf, p, len);
+    Buf[len] = '\0';
+    p = next;
+
+    chunk->lines_num++;
+    stl_line_parser::result_t res = parser.parse(Buf, chunk->lines_num);
+    if (res == stl_line_parser::LINE_ERROR) {
+      chunk->failed = true;
+      return;
+    }
+    if (res == stl_line_parser::LINE_END) {
+      chunk->ended = true;
+      return;
+    }
+    if (res == stl_line_parser::LINE_FACET) {
+      chunk->faces.emplace_back(parser.face_normal);
+      chunk->faces.emplace_back(parser.face_outer[0]);
+      chunk->faces.emplace_back(parser.face_outer[1]);
+      chunk->faces.emplace_back(parser.face_outer[2]);
+      chunk->facet_lines.push_back(parser.face_line);
+    }
+  }
+}
+
+/**
+ * \brief Найти начало первой строки "facet normal", начиная с позиции pos.
+ *
+ * \param [in] data начало файла
+ * \param [in] size размер файла
+ * \param [in] pos позиция, с которой начинается поиск
+ * \return позиция начала строки или size, если строка не найдена
+ */
+static size_t find_facet_line(const char* data, size_t size, size_t pos) {
+  // Перейти к началу следующей строки
+  if (pos > 0) {
+    const char* eol = static_cast<const char*>(memchr(data + pos - 1, '\n', size - pos + 1));
+    if (eol == nullptr) return size;
+    pos = eol - data + 1;
+  }
+  while (pos < size) {
+    size_t b = pos;
+    while (b < size && data[b] == ' ') ++b;
+    if (size - b >= 13 && strncmp(data + b, "facet normal ", 13) == 0) return pos;
+    const char* eol = static_cast<const char*>(memchr(data + pos, '\n', size - pos));
+    if (eol == nullptr) return size;
+    pos = eol - data + 1;
+  }
+  return size;
+}
+
+namespace prim3d {
+
+  /**
+   * \file
+   * Функции, являющиеся методами класса \ref prim3d::shell "shell":
+   * <BR>
+   */
+
+  /**
+   * \file
+   * * \copybrief prim3d::shell::import(const std::string&, std::vector<geometry::vector>&, unsigned, size_t)
+   */
+  err_enum_t shell::import(const std::string& fname, std::vector<geometry::vector>& faces, unsigned threads, size_t min_size) {
+
+    /** Сжатые файлы и стандартный ввод читаются последовательно */
+    if (threads > 1 && !stl_input::is_packed_name(fname) && !stl_input::is_stdin_name(fname)) {
+      err_enum_t err = import_parallel(fname, faces, threads, min_size);
+      /** Если параллельный разбор невозможен, файл читается последовательно */
+      if (err != err_enum_t::ERROR_INTERNAL) return err;
+    }
+
+    size_t                   line_num = 0;     /** Счётчик строк импортируемого файла */
+    stl_line_parser          parser(false);
+
+    // Прочитать файл STL (сжатый файл распаковывается по мере чтения)
+    stl_input in;
+    if (in.open(fname) != err_enum_t::ERROR_OK) {
+      std::cout << "ERROR (import): Can't open file '" << fname << "' for reading" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+
+    facet_list list(faces);
+    for (;;) {
+      char Buf[LINE_BUF_SIZE];
+
+      if (in.gets(Buf, sizeof(Buf)) == nullptr) break;
+      line_num ++;
+
+      stl_line_parser::result_t res = parser.parse(Buf, line_num);
+      if (res == stl_line_parser::LINE_ERROR) {
+        std::cout << "ERROR (import): " << parser.error_text << " in line #" << line_num << parser.error_tail << std::endl;
+        return err_enum_t::ERROR_IMPORT;
+      }
+      if (res == stl_line_parser::LINE_END) break;
+      if (res == stl_line_parser::LINE_FACET) {
+        list.add(parser.face_normal, parser.face_outer, parser.face_line);
+      }
+    }
+
+    if (in.error()) {
+      std::cout << "ERROR (import): error reading or unpacking file '" << fname << "' after line #" << line_num << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    in.close();
+
+    if (faces.size() / (NORMAL_NUM + COORDS_NUM) * (NORMAL_NUM + COORDS_NUM) != faces.size()) {
+      std::cout << "ERROR (import): количество прочитанных векторов не кратно " << (NORMAL_NUM + COORDS_NUM) << std::endl;
+      return err_enum_t::ERROR_INTERNAL;
+    }
+
+    return err_enum_t::ERROR_OK;
+  }
+
+  /**
+   * \file
+   * * \copybrief prim3d::shell::import_parallel(const std::string&, std::vector<geometry::vector>&, unsigned, size_t)
+   */
+  err_enum_t shell::import_parallel(const std::string& fname, std::vector<geometry::vector>& faces, unsigned threads, size_t min_size) {
+
+    mapped_file file;
+    if (!file.open(fname) || file.get_size() < min_size) {
+      return err_enum_t::ERROR_INTERNAL;
+    }
+
+    const char* data = file.get_data();
+    const size_t size = file.get_size();
+
+    /** Разбиение файла на части по строкам "facet normal" */
+    std::vector<stl_chunk> chunks(threads);
+    size_t pos = 0;
+    for (size_t i = 0; i < threads; ++i) {
+      size_t next = (i + 1 == threads) ? size : find_facet_line(data, size, std::max(pos, size / threads * (i + 1)));
+      chunks[i].begin = data + pos;
+      chunks[i].end = data + next;
+      chunks[i].first = (i == 0);
+      pos = next;
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; ++i) {
+      workers.emplace_back(parse_chunk, &chunks[i]);
+    }
+    parse_chunk(&chunks[0]);
+    for (auto it = workers.begin(); it != workers.end(); ++it) {
+      (*it).join();
+    }
+
+    /**
+     * Объединение граней в порядке следования частей. Проверка на повторы выполняется
+     * так же, как при последовательном чтении, номера строк пересчитываются от начала файла.
+     */
+    facet_list list(faces);
+    size_t line_base = 0;
+    for (auto it = chunks.cbegin(); it != chunks.cend(); ++it) {
+      /** Ошибка - файл будет прочитан последовательно, чтобы сообщения совпали */
+      if ((*it).failed) {
+        faces.clear();
+        return err_enum_t::ERROR_INTERNAL;
+      }
+      for (size_t k = 0; k < (*it).facet_lines.size(); ++k) {
+        list.add((*it).faces[k * (NORMAL_NUM + COORDS_NUM)],
+          &(*it).faces[k * (NORMAL_NUM + COORDS_NUM) + NORMAL_NUM], line_base + (*it).facet_lines[k]);
+      }
+      if ((*it).ended) break;
+      line_base += (*it).lines_num;
+    }
+
+    return err_enum_t::ERROR_OK;
+  }
+}
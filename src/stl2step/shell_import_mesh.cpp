@@ -0,0 +1,539 @@
+/**
+ * \file
+ *
+ * \brief Файл с определением методов import_mesh и is_mesh_name класса shell - импорт
+ * индексированной сетки треугольников из файлов PLY (двоичных) и OBJ
+ *
+ * В отличие от STL, в этих форматах вершины задаются один раз и связываются с гранями
+ * индексами, поэтому фигура строится без поиска совпадающих вершин и повторяющихся граней.
+ */
+
+#include "stdafx.h"
+#include "precision.h"
+#include "err.h"
+#include "shell.h"
+#include "stl_input.h"
+
+/** \brief Размер буфера строки заголовка PLY и строки OBJ */
+#define MESH_LINE_SIZE 4096
+
+/** \brief Размер буфера чтения двоичных данных PLY */
+#define PLY_BUF_SIZE (1024 * 1024)
+
+/**
+ * \brief Тип значения свойства PLY
+ */
+enum class ply_type {
+  PLY_NONE,
+  PLY_INT8,
+  PLY_UINT8,
+  PLY_INT16,
+  PLY_UINT16,
+  PLY_INT32,
+  PLY_UINT32,
+  PLY_FLOAT32,
+  PLY_FLOAT64
+};
+
+/**
+ * \brief Свойство элемента PLY
+ */
+struct ply_property {
+  /** \brief Имя свойства */
+  std::string name;
+  /** \brief Тип значения (для списка - тип элементов списка) */
+  ply_type type;
+  /** \brief Тип длины списка или PLY_NONE, если свойство не является списком */
+  ply_type count_type;
+};
+
+/**
+ * \brief Элемент PLY (vertex, face и т. п.)
+ */
+struct ply_element {
+  /** \brief Имя элемента */
+  std::string name;
+  /** \brief Количество записей */
+  size_t count;
+  /** \brief Свойства записи */
+  std::vector<ply_property> properties;
+};
+
+/**
+ * \brief Получить тип значения PLY по имени.
+ *
+ * \param [in] name имя типа
+ * \return тип или ply_type::PLY_NONE для неизвестного имени
+ */
+static ply_type ply_type_by_name(const char* name) {
+  static const struct { const char* name; ply_type type; } types[] = {
+    { "char", ply_type::PLY_INT8 },     { "int8", ply_type::PLY_INT8 },
+    { "uchar", ply_type::PLY_UINT8 },   { "uint8", ply_type::PLY_UINT8 },
+    { "short", ply_type::PLY_INT16 },   { "int16", ply_type::PLY_INT16 },
+    { "ushort", ply_type::PLY_UINT16 }, { "uint16", ply_type::PLY_UINT16 },
+    { "int", ply_type::PLY_INT32 },     { "int32", ply_type::PLY_INT32 },
+    { "uint", ply_type::PLY_UINT32 },   { "uint32", ply_type::PLY_UINT32 },
+    { "float", ply_type::PLY_FLOAT32 }, { "float32", ply_type::PLY_FLOAT32 },
+    { "double", ply_type::PLY_FLOAT64 }, { "float64", ply_type::PLY_FLOAT64 }
+  };
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+    if (strcmp(name, types[i].name) == 0) return types[i].type;
+  }
+  return ply_type::PLY_NONE;
+}
+
+/**
+ * \brief Получить размер значения PLY.
+ *
+ * \param [in] type тип значения
+ * \return размер в байтах
+ */
+static size_t ply_type_size(ply_type type) {
+  switch (type) {
+  case ply_type::PLY_INT8:
+  case ply_type::PLY_UINT8:
+    return 1;
+  case ply_type::PLY_INT16:
+  case ply_type::PLY_UINT16:
+    return 2;
+  case ply_type::PLY_INT32:
+  case ply_type::PLY_UINT32:
+  case ply_type::PLY_FLOAT32:
+    return 4;
+  case ply_type::PLY_FLOAT64:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * \brief Преобразовать двоичное значение PLY в число.
+ *
+ * \param [in] p адрес значения
+ * \param [in] type тип значения
+ * \param [in] swap порядок байт значения отличается от порядка байт процессора
+ * \return значение
+ */
+static double ply_value(const unsigned char* p, ply_type type, bool swap) {
+  unsigned char b[8];
+  size_t n = ply_type_size(type);
+  for (size_t i = 0; i < n; ++i) b[i] = swap ? p[n - 1 - i] : p[i];
+
+  switch (type) {
+  case ply_type::PLY_INT8:    { int8_t v;   memcpy(&v, b, 1); return v; }
+  case ply_type::PLY_UINT8:   { uint8_t v;  memcpy(&v, b, 1); return v; }
+  case ply_type::PLY_INT16:   { int16_t v;  memcpy(&v, b, 2); return v; }
+  case ply_type::PLY_UINT16:  { uint16_t v; memcpy(&v, b, 2); return v; }
+  case ply_type::PLY_INT32:   { int32_t v;  memcpy(&v, b, 4); return v; }
+  case ply_type::PLY_UINT32:  { uint32_t v; memcpy(&v, b, 4); return v; }
+  case ply_type::PLY_FLOAT32: { float v;    memcpy(&v, b, 4); return v; }
+  case ply_type::PLY_FLOAT64: { double v;   memcpy(&v, b, 8); return v; }
+  default:
+    return 0.0;
+  }
+}
+
+/**
+ * \brief Буферизованное чтение двоичных данных файла.
+ */
+class ply_reader {
+
+private:
+
+  /** \brief Файл */
+  FILE* in; //-V122_NOPTR
+
+  /** \brief Буфер */
+  std::vector<unsigned char> buf;
+
+  /** \brief Позиция чтения в буфере */
+  size_t pos;
+
+  /** \brief Количество байт в буфере */
+  size_t len;
+
+public:
+
+  /**
+   * \brief Конструктор из параметров
+   *
+   * \param [in] In файл, открытый в двоичном режиме
+   */
+  explicit ply_reader(FILE* In) : in(In), buf(PLY_BUF_SIZE), pos(0), len(0) {
+  }
+
+  /**
+   * \brief Получить адрес следующих n байт данных.
+   *
+   * \param [in] n количество байт (не более размера буфера)
+   * \return адрес данных или nullptr в конце файла
+   */
+  const unsigned char* get(size_t n) {
+    if (len - pos < n) {
+      memmove(buf.data(), buf.data() + pos, len - pos);
+      len -= pos;
+      pos = 0;
+      len += fread(buf.data() + len, 1, buf.size() - len, in);
+      if (len < n) return nullptr;
+    }
+    const unsigned char* p = buf.data() + pos;
+    pos += n;
+    return p;
+  }
+};
+
+/**
+ * \brief Импорт двоичного файла PLY.
+ *
+ * \param [in] fname имя импортируемого файла
+ * \param [out] points координаты вершин сетки
+ * \param [out] indices индексы вершин треугольников
+ * \return код ошибки
+ */
+static err_enum_t import_ply(const std::string& fname, std::vector<geometry::vector>& points, std::vector<size_t>& indices) {
+  FILE* in;
+#if defined(_MSC_VER)
+  errno_t ferr = fopen_s(&in, fname.c_str(), "rb");
+  if (ferr != 0 || in == nullptr)
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  in = fopen(fname.c_str(), "rb");
+  if (in == nullptr)
+#else
+# error Unknown C++ compiler
+#endif
+  {
+    std::cout << "ERROR (import): Can't open file '" << fname << "' for reading" << std::endl;
+    return err_enum_t::ERROR_FILE_IO;
+  }
+
+  // Заголовок: описание элементов и их свойств
+  std::vector<ply_element> elements;
+  bool swap = false;
+  size_t line_num = 0;
+  for (;;) {
+    char Buf[MESH_LINE_SIZE];
+    if (fgets(Buf, sizeof(Buf), in) == nullptr) {
+      std::cout << "ERROR (import): no 'end_header' in PLY file '" << fname << "'" << std::endl;
+      fclose(in);
+      return err_enum_t::ERROR_IMPORT;
+    }
+    line_num++;
+
+    char w[4][64] = {};
+#if defined(_MSC_VER)
+    int words = sscanf_s(Buf, "%63s %63s %63s %63s", w[0], 64, w[1], 64, w[2], 64, w[3], 64);
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+    int words = sscanf(Buf, "%63s %63s %63s %63s", w[0], w[1], w[2], w[3]);
+#else
+# error Unknown C++ compiler
+#endif
+
+    if (line_num == 1) {
+      if (words != 1 || strcmp(w[0], "ply") != 0) {
+        std::cout << "ERROR (import): no 'ply' in line #1!" << std::endl;
+        fclose(in);
+        return err_enum_t::ERROR_IMPORT;
+      }
+      continue;
+    }
+    if (words < 1 || strcmp(w[0], "comment") == 0 || strcmp(w[0], "obj_info") == 0) continue;
+    if (strcmp(w[0], "end_header") == 0) break;
+
+    if (strcmp(w[0], "format") == 0 && words >= 2) {
+      /** Порядок байт процессора */
+      const uint16_t one = 1;
+      const bool little = (*reinterpret_cast<const unsigned char*>(&one) == 1);
+      if (strcmp(w[1], "binary_little_endian") == 0) {
+        swap = !little;
+      }
+      else
+      if (strcmp(w[1], "binary_big_endian") == 0) {
+        swap = little;
+      }
+      else {
+        std::cout << "ERROR (import): only binary PLY files are supported, format '" << w[1] << "' in line #" << line_num << "!" << std::endl;
+        fclose(in);
+        return err_enum_t::ERROR_IMPORT;
+      }
+      continue;
+    }
+
+    if (strcmp(w[0], "element") == 0 && words == 3) {
+      ply_element e;
+      e.name = w[1];
+      e.count = static_cast<size_t>(strtoull(w[2], nullptr, 10));
+      elements.push_back(e);
+      continue;
+    }
+
+    if (strcmp(w[0], "property") == 0 && !elements.empty()) {
+      ply_property p;
+      if (words == 3) {
+        p.type = ply_type_by_name(w[1]);
+        p.count_type = ply_type::PLY_NONE;
+        p.name = w[2];
+      }
+      else {
+#if defined(_MSC_VER)
+        char w4[64] = {};
+        int list_words = sscanf_s(Buf, "%*s %*s %*s %*s %63s", w4, 64);
+#else
+        char w4[64] = {};
+        int list_words = sscanf(Buf, "%*s %*s %*s %*s %63s", w4);
+#endif
+        if (list_words != 1 || strcmp(w[1], "list") != 0) {
+          std::cout << "ERROR (import): wrong property in line #" << line_num << "!" << std::endl;
+          fclose(in);
+          return err_enum_t::ERROR_IMPORT;
+        }
+        p.count_type = ply_type_by_name(w[2]);
+        p.type = ply_type_by_name(w[3]);
+        p.name = w4;
+        if (p.count_type == ply_type::PLY_NONE || p.count_type == ply_type::PLY_FLOAT32 || p.count_type == ply_type::PLY_FLOAT64) {
+          p.type = ply_type::PLY_NONE;
+        }
+      }
+      if (p.type == ply_type::PLY_NONE) {
+        std::cout << "ERROR (import): unknown property type in line #" << line_num << "!" << std::endl;
+        fclose(in);
+        return err_enum_t::ERROR_IMPORT;
+      }
+      elements.back().properties.push_back(p);
+      continue;
+    }
+
+    std::cout << "ERROR (import): unknown keyword in line #" << line_num << "!" << std::endl;
+    fclose(in);
+    return err_enum_t::ERROR_IMPORT;
+  }
+
+  // Данные элементов в порядке их описания
+  ply_reader reader(in);
+  points.clear();
+  indices.clear();
+  for (auto it = elements.cbegin(); it != elements.cend(); ++it) {
+    const ply_element& e = *it;
+    const bool is_vertex = (e.name.compare("vertex") == 0);
+    const bool is_face = (e.name.compare("face") == 0);
+
+    if (is_vertex) points.reserve(e.count);
+    if (is_face) indices.reserve(e.count * 3);
+    std::vector<size_t> poly;
+
+    for (size_t r = 0; r < e.count; ++r) {
+      double xyz[3] = {};
+      bool truncated = false;
+      for (auto ip = e.properties.cbegin(); ip != e.properties.cend(); ++ip) {
+        const ply_property& p = *ip;
+        const size_t vsize = ply_type_size(p.type);
+
+        if (p.count_type == ply_type::PLY_NONE) {
+          const unsigned char* d = reader.get(vsize);
+          if ((truncated = (d == nullptr))) break;
+          if (is_vertex && p.name.size() == 1 && p.name[0] >= 'x' && p.name[0] <= 'z') {
+            xyz[p.name[0] - 'x'] = ply_value(d, p.type, swap);
+          }
+          continue;
+        }
+
+        const unsigned char* d = reader.get(ply_type_size(p.count_type));
+        if ((truncated = (d == nullptr))) break;
+        const double cnt = ply_value(d, p.count_type, swap);
+        if (cnt < 0 || cnt * vsize >= PLY_BUF_SIZE) {
+          std::cout << "ERROR (import): wrong list size in element '" << e.name << "' #" << r << " of PLY file '" << fname << "'" << std::endl;
+          fclose(in);
+          return err_enum_t::ERROR_IMPORT;
+        }
+        const size_t n = static_cast<size_t>(cnt);
+        d = reader.get(n * vsize);
+        if ((truncated = (d == nullptr))) break;
+
+        if (is_face && (p.name.compare("vertex_indices") == 0 || p.name.compare("vertex_index") == 0)) {
+          // Индекс проверяется до преобразования: отрицательное, дробное или слишком большое
+          // значение (списки знаковых и вещественных типов) не является номером вершины
+          poly.resize(n);
+          for (size_t k = 0; k < n; ++k) {
+            const double v = ply_value(d + k * vsize, p.type, swap);
+            if (!(v >= 0.0 && v < 4294967296.0) || v != floor(v)) {
+              std::cout << "ERROR (import): wrong vertex index in element '" << e.name << "' #" << r << " of PLY file '" << fname << "'" << std::endl;
+              fclose(in);
+              return err_enum_t::ERROR_IMPORT;
+            }
+            poly[k] = static_cast<size_t>(v);
+          }
+          // Многоугольник разбивается на треугольники веером от первой вершины
+          for (size_t k = 2; k < n; ++k) {
+            indices.push_back(poly[0]);
+            indices.push_back(poly[k - 1]);
+            indices.push_back(poly[k]);
+          }
+        }
+      }
+      if (truncated) {
+        std::cout << "ERROR (import): unexpected end of PLY file '" << fname << "'" << std::endl;
+        fclose(in);
+        return err_enum_t::ERROR_IMPORT;
+      }
+      if (is_vertex) points.emplace_back(xyz[0], xyz[1], xyz[2]);
+    }
+  }
+  fclose(in);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Прочитать индекс вершины грани OBJ ("v", "v/vt", "v//vn" или "v/vt/vn").
+ *
+ * \param [in,out] p текущая позиция в строке
+ * \param [in] points_num количество уже прочитанных вершин (для отрицательных индексов)
+ * \param [out] index индекс вершины (с нуля)
+ * \return true, если индекс прочитан
+ */
+static bool obj_index(const char*& p, size_t points_num, size_t& index) {
+  char* end;
+  long long v = strtoll(p, &end, 10);
+  if (end == p || v == 0) return false;
+  p = end;
+  // Индексы текстурных координат и нормалей не используются
+  while (*p != '\0' && *p != ' ' && *p != '\t') ++p;
+
+  if (v < 0) {
+    if (static_cast<size_t>(-v) > points_num) return false;
+    index = points_num - static_cast<size_t>(-v);
+  }
+  else {
+    index = static_cast<size_t>(v - 1);
+  }
+  return true;
+}
+
+/**
+ * \brief Импорт файла OBJ.
+ *
+ * \param [in] fname имя импортируемого файла
+ * \param [out] points координаты вершин сетки
+ * \param [out] indices индексы вершин треугольников
+ * \return код ошибки
+ */
+static err_enum_t import_obj(const std::string& fname, std::vector<geometry::vector>& points, std::vector<size_t>& indices) {
+  stl_input in;
+  if (in.open(fname) != err_enum_t::ERROR_OK) {
+    std::cout << "ERROR (import): Can't open file '" << fname << "' for reading" << std::endl;
+    return err_enum_t::ERROR_FILE_IO;
+  }
+
+  points.clear();
+  indices.clear();
+  size_t line_num = 0;
+  std::vector<size_t> poly;
+  for (;;) {
+    char Buf[MESH_LINE_SIZE];
+    if (in.gets(Buf, sizeof(Buf)) == nullptr) break;
+    line_num++;
+
+    const char* B = Buf;
+    for (; *B == ' ' || *B == '\t'; ++B);
+
+    // Координаты вершины
+    if (B[0] == 'v' && (B[1] == ' ' || B[1] == '\t')) {
+      double X, Y, Z;
+#if defined(_MSC_VER)
+      int readed = sscanf_s(&B[2], "%lf %lf %lf", &X, &Y, &Z);
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+      int readed = sscanf(&B[2], "%lf %lf %lf", &X, &Y, &Z);
+#else
+# error Unknown C++ compiler
+#endif
+      if (readed != 3) {
+        std::cout << "ERROR (import): can not read coordinates in line #" << line_num << "!" << std::endl;
+        return err_enum_t::ERROR_IMPORT;
+      }
+      points.emplace_back(X, Y, Z);
+      continue;
+    }
+
+    // Грань - многоугольник, разбивается на треугольники веером от первой вершины
+    if (B[0] == 'f' && (B[1] == ' ' || B[1] == '\t')) {
+      poly.clear();
+      const char* p = &B[2];
+      for (;;) {
+        for (; *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'; ++p);
+        if (*p == '\0') break;
+        size_t index;
+        if (!obj_index(p, points.size(), index)) {
+          std::cout << "ERROR (import): wrong vertex index in line #" << line_num << "!" << std::endl;
+          return err_enum_t::ERROR_IMPORT;
+        }
+        poly.push_back(index);
+      }
+      if (poly.size() < 3) {
+        std::cout << "ERROR (import): less than 3 vertices per face in line #" << line_num << "!" << std::endl;
+        return err_enum_t::ERROR_IMPORT;
+      }
+      for (size_t k = 2; k < poly.size(); ++k) {
+        indices.push_back(poly[0]);
+        indices.push_back(poly[k - 1]);
+        indices.push_back(poly[k]);
+      }
+      continue;
+    }
+
+    // Нормали, текстурные координаты, группы, материалы и комментарии не используются
+  }
+
+  if (in.error()) {
+    std::cout << "ERROR (import): error reading or unpacking file '" << fname << "' after line #" << line_num << std::endl;
+    return err_enum_t::ERROR_FILE_IO;
+  }
+  return err_enum_t::ERROR_OK;
+}
+
+namespace prim3d {
+
+  /**
+   * \file
+   * Функции, являющиеся методами класса \ref prim3d::shell "shell":
+   * <BR>
+   */
+
+  /**
+   * \file
+   * * \copybrief prim3d::shell::is_mesh_name(const std::string&)
+   */
+  bool shell::is_mesh_name(const std::string& fname) {
+    std::string ext;
+    size_t pos = fname.find_last_of('.');
+    if (pos == std::string::npos) return false;
+    ext = fname.substr(pos);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext.compare(".ply") == 0 || ext.compare(".obj") == 0;
+  }
+
+  /**
+   * \file
+   * * \copybrief prim3d::shell::import_mesh(const std::string&, std::vector<geometry::vector>&, std::vector<size_t>&)
+   */
+  err_enum_t shell::import_mesh(const std::string& fname, std::vector<geometry::vector>& points, std::vector<size_t>& indices) {
+    std::string ext = fname.substr(fname.find_last_of('.'));
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    err_enum_t err = (ext.compare(".ply") == 0) ? import_ply(fname, points, indices) : import_obj(fname, points, indices);
+    if (err != err_enum_t::ERROR_OK) return err;
+
+    // Индексы проверяются после чтения: в PLY вершины могут следовать за гранями
+    for (auto it = indices.cbegin(); it != indices.cend(); ++it) {
+      if (*it >= points.size()) {
+        std::cout << "ERROR (import): vertex index " << *it << " is out of range (" << points.size() << " vertices)" << std::endl;
+        return err_enum_t::ERROR_IMPORT;
+      }
+    }
+
+    if (indices.empty()) {
+      std::cout << "ERROR (import): no faces in file '" << fname << "'" << std::endl;
+      return err_enum_t::ERROR_IMPORT;
+    }
+
+    return err_enum_t::ERROR_OK;
+  }
+}
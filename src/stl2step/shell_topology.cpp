@@ -0,0 +1,269 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями методов save_topology и load_topology класса shell - запись
+ * обработанных фигур в файл топологии и создание фигур по файлу топологии
+ *
+ * Формат файла топологии описан в \ref topology.h. Файл записывается целиком из массивов
+ * записей, собранных по спискам примитивов фигур, а читается отображением в память
+ * (\ref topology::file).
+ */
+
+#include "stdafx.h"
+#include <chrono>
+#include <unordered_map>
+
+#include "err.h"
+#include "shell.h"
+#include "topology.h"
+
+/**
+ * \brief Записать координаты вектора в массив из трёх чисел.
+ *
+ * \param [out] dst массив
+ * \param [in] v вектор
+ */
+static void put_vector(geometry::real* dst, const geometry::vector& v) {
+  dst[0] = v.getX();
+  dst[1] = v.getY();
+  dst[2] = v.getZ();
+}
+
+/**
+ * \brief Дописать раздел в буфер, выровняв его начало на \ref TOPOLOGY_ALIGN байт.
+ *
+ * \param [in,out] buf буфер
+ * \param [in] records записи раздела
+ * \return смещение раздела от начала буфера
+ */
+template <typename T> static uint64_t put_section(std::string& buf, const std::vector<T>& records) {
+  buf.append((TOPOLOGY_ALIGN - buf.size() % TOPOLOGY_ALIGN) % TOPOLOGY_ALIGN, '\0');
+  const uint64_t offset = buf.size();
+  buf.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+  return offset;
+}
+
+namespace prim3d {
+
+  /**
+   * \file
+   * Функции, являющиеся методами класса \ref prim3d::shell "shell":
+   * <BR>
+   */
+
+  /**
+   * \file
+   * * \copybrief prim3d::shell::save_topology(const std::string&, const std::string&, const std::vector<prim3d::shell*>&)
+   */
+  err_enum_t shell::save_topology(const std::string& fname, const std::string& key, const std::vector<shell*>& shells) {
+    std::vector<topology::shell_t> t_shells;
+    std::vector<topology::vertex_t> t_vertexes;
+    std::vector<topology::face_t> t_faces;
+    std::vector<topology::border_t> t_borders;
+    std::vector<uint32_t> t_oriented;
+    std::vector<topology::edge_t> t_edges;
+    t_shells.reserve(shells.size());
+
+    std::unordered_map<const shell*, uint32_t> shell_ids;
+    std::unordered_map<const vertex*, uint32_t> vertex_ids;
+    std::unordered_map<const edge*, uint32_t> edge_ids;
+    std::unordered_map<const face*, uint32_t> face_ids;
+    for (auto it_s = shells.cbegin(); it_s != shells.cend(); ++it_s) {
+      const shell& sh = **it_s;
+      shell_ids.emplace(&sh, static_cast<uint32_t>(t_shells.size()));
+
+      topology::shell_t ts;
+      memset(&ts, 0, sizeof(ts));
+      put_vector(ts.pos, sh.pos);
+      ts.first_vertex = static_cast<uint32_t>(t_vertexes.size());
+      ts.first_edge = static_cast<uint32_t>(t_edges.size());
+      ts.first_face = static_cast<uint32_t>(t_faces.size());
+      ts.clone = TOPOLOGY_NONE;
+
+      /** Клон сохраняется только ссылкой на исходную фигуру и условным центром */
+      if (sh.is_clone()) {
+        auto it = shell_ids.find(sh.get_clone());
+        if (it == shell_ids.end()) return err_enum_t::ERROR_INTERNAL;
+        ts.clone = it->second;
+        t_shells.push_back(ts);
+        continue;
+      }
+
+      vertex_ids.clear();
+      edge_ids.clear();
+      face_ids.clear();
+
+      for (auto it = sh.vertexes.cbegin(); it != sh.vertexes.cend(); ++it) {
+        vertex_ids.emplace(*it, static_cast<uint32_t>(t_vertexes.size()));
+        topology::vertex_t tv;
+        put_vector(tv.coord, (*it)->get_coord());
+        t_vertexes.push_back(tv);
+      }
+
+      for (auto it = sh.edges.cbegin(); it != sh.edges.cend(); ++it) {
+        edge_ids.emplace(*it, ts.first_edge + static_cast<uint32_t>(edge_ids.size()));
+      }
+
+      for (auto it = sh.faces.cbegin(); it != sh.faces.cend(); ++it) {
+        face_ids.emplace(*it, static_cast<uint32_t>(t_faces.size()));
+        topology::face_t tf;
+        put_vector(tf.normal, (*it)->get_normal());
+        tf.first_border = static_cast<uint32_t>(t_borders.size());
+        tf.borders_num = static_cast<uint32_t>((*it)->borders_num());
+        t_faces.push_back(tf);
+
+        for (auto it_b = (*it)->get_borders().cbegin(); it_b != (*it)->get_borders().cend(); ++it_b) {
+          topology::border_t tb;
+          tb.first_edge = static_cast<uint32_t>(t_oriented.size());
+          tb.edges_num = static_cast<uint32_t>((*it_b).edges_num());
+          t_borders.push_back(tb);
+          for (auto it_e = (*it_b).get_edges().cbegin(); it_e != (*it_b).get_edges().cend(); ++it_e) {
+            auto it_id = edge_ids.find((*it_e).get_base_edge());
+            if (it_id == edge_ids.end()) return err_enum_t::ERROR_INTERNAL;
+            t_oriented.push_back(it_id->second * 2 + ((*it_e).get_direction() ? 1 : 0));
+          }
+        }
+      }
+
+      /** Грань ребра может отсутствовать в списке граней, если она была объединена с соседней */
+      auto face_id = [&face_ids](const face* f) {
+        auto it = face_ids.find(f);
+        return (it == face_ids.end()) ? TOPOLOGY_NONE : it->second;
+      };
+      for (auto it = sh.edges.cbegin(); it != sh.edges.cend(); ++it) {
+        auto it_start = vertex_ids.find((*it)->get_start());
+        auto it_end = vertex_ids.find((*it)->get_end());
+        if (it_start == vertex_ids.end() || it_end == vertex_ids.end()) return err_enum_t::ERROR_INTERNAL;
+        topology::edge_t te;
+        te.start = it_start->second;
+        te.end = it_end->second;
+        te.left = face_id((*it)->get_left());
+        te.right = face_id((*it)->get_right());
+        t_edges.push_back(te);
+      }
+
+      ts.vertexes_num = static_cast<uint32_t>(t_vertexes.size()) - ts.first_vertex;
+      ts.edges_num = static_cast<uint32_t>(t_edges.size()) - ts.first_edge;
+      ts.faces_num = static_cast<uint32_t>(t_faces.size()) - ts.first_face;
+      t_shells.push_back(ts);
+    }
+
+    topology::header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TOPOLOGY_MAGIC, sizeof(header.magic));
+    header.version = TOPOLOGY_VERSION;
+    header.byte_order = TOPOLOGY_BYTE_ORDER;
+    header.real_size = sizeof(geometry::real);
+    header.key_size = static_cast<uint32_t>(key.size());
+    header.num[topology::SECTION_SHELLS] = static_cast<uint32_t>(t_shells.size());
+    header.num[topology::SECTION_VERTEXES] = static_cast<uint32_t>(t_vertexes.size());
+    header.num[topology::SECTION_FACES] = static_cast<uint32_t>(t_faces.size());
+    header.num[topology::SECTION_BORDERS] = static_cast<uint32_t>(t_borders.size());
+    header.num[topology::SECTION_ORIENTED] = static_cast<uint32_t>(t_oriented.size());
+    header.num[topology::SECTION_EDGES] = static_cast<uint32_t>(t_edges.size());
+
+    /** Заголовок записывается в начало буфера после того, как известны смещения разделов */
+    std::string buf(sizeof(header), '\0');
+    buf.append(key);
+    header.offset[topology::SECTION_SHELLS] = put_section(buf, t_shells);
+    header.offset[topology::SECTION_VERTEXES] = put_section(buf, t_vertexes);
+    header.offset[topology::SECTION_FACES] = put_section(buf, t_faces);
+    header.offset[topology::SECTION_BORDERS] = put_section(buf, t_borders);
+    header.offset[topology::SECTION_ORIENTED] = put_section(buf, t_oriented);
+    header.offset[topology::SECTION_EDGES] = put_section(buf, t_edges);
+    buf.replace(0, sizeof(header), reinterpret_cast<const char*>(&header), sizeof(header));
+
+    /** Временное имя уникально для каждой записи, так как файл могут одновременно записывать несколько программ */
+    const std::string tmp_name = fname + "." + std::to_string(static_cast<unsigned long long>(
+      std::chrono::high_resolution_clock::now().time_since_epoch().count())) + ".tmp";
+    FILE* out;
+#if defined(_MSC_VER)
+    if (fopen_s(&out, tmp_name.c_str(), "wb") != 0) out = nullptr;
+#else
+    out = fopen(tmp_name.c_str(), "wb");
+#endif
+    if (out == nullptr) return err_enum_t::ERROR_FILE_IO;
+    const bool ok = fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+    if (fclose(out) != 0 || !ok) {
+      remove(tmp_name.c_str());
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    /**
+     * Файл с тем же именем мог быть записан другой программой - тогда он заменяется
+     * (в Windows переименование не заменяет существующий файл, и он сначала удаляется)
+     */
+    if (rename(tmp_name.c_str(), fname.c_str()) != 0) {
+      remove(fname.c_str());
+      if (rename(tmp_name.c_str(), fname.c_str()) != 0) {
+        remove(tmp_name.c_str());
+        return err_enum_t::ERROR_FILE_IO;
+      }
+    }
+    return err_enum_t::ERROR_OK;
+  }
+
+  /**
+   * \file
+   * * \copybrief prim3d::shell::load_topology(const topology::file&, std::vector<prim3d::shell*>&)
+   */
+  err_enum_t shell::load_topology(const topology::file& file, std::vector<shell*>& shells) {
+    shells.clear();
+
+    const topology::shell_t* t_shells = file.get_shells();
+    const topology::vertex_t* t_vertexes = file.get_vertexes();
+    const topology::face_t* t_faces = file.get_faces();
+    const topology::border_t* t_borders = file.get_borders();
+    const uint32_t* t_oriented = file.get_oriented();
+    const topology::edge_t* t_edges = file.get_edges();
+
+    /** Номера записей проверены при открытии файла, поэтому здесь не проверяются */
+    const uint32_t shells_num = file.get_num(topology::SECTION_SHELLS);
+    shells.reserve(shells_num);
+    for (uint32_t s = 0; s < shells_num; ++s) {
+      const topology::shell_t& ts = t_shells[s];
+      shell* sh = new shell();
+      shells.push_back(sh);
+      sh->pos = geometry::vector(ts.pos[0], ts.pos[1], ts.pos[2]);
+      if (ts.clone != TOPOLOGY_NONE) {
+        sh->set_clone(shells[ts.clone]);
+        continue;
+      }
+
+      sh->vertexes.reserve(ts.vertexes_num);
+      for (uint32_t i = ts.first_vertex; i < ts.first_vertex + ts.vertexes_num; ++i) {
+        const geometry::real* c = t_vertexes[i].coord;
+        sh->vertexes.push_back(new vertex(geometry::vector(c[0], c[1], c[2])));
+      }
+
+      sh->faces.reserve(ts.faces_num);
+      for (uint32_t i = ts.first_face; i < ts.first_face + ts.faces_num; ++i) {
+        const geometry::real* n = t_faces[i].normal;
+        sh->faces.push_back(new face(geometry::vector(n[0], n[1], n[2])));
+      }
+
+      sh->edges.reserve(ts.edges_num);
+      for (uint32_t i = ts.first_edge; i < ts.first_edge + ts.edges_num; ++i) {
+        const topology::edge_t& te = t_edges[i];
+        vertex* start = sh->vertexes[te.start - ts.first_vertex];
+        vertex* end = sh->vertexes[te.end - ts.first_vertex];
+        edge* e = new edge(start, end, (te.left == TOPOLOGY_NONE) ? nullptr : sh->faces[te.left - ts.first_face]);
+        if (te.right != TOPOLOGY_NONE) e->set_right(sh->faces[te.right - ts.first_face]);
+        sh->edges.push_back(e);
+        start->add_edge(e);
+        end->add_edge(e);
+      }
+
+      for (uint32_t i = 0; i < ts.faces_num; ++i) {
+        const topology::face_t& tf = t_faces[ts.first_face + i];
+        for (uint32_t b = tf.first_border; b < tf.first_border + tf.borders_num; ++b) {
+          border bd;
+          for (uint32_t o = t_borders[b].first_edge; o < t_borders[b].first_edge + t_borders[b].edges_num; ++o) {
+            bd.add_edge(oriented_edge(sh->edges[t_oriented[o] / 2 - ts.first_edge], (t_oriented[o] & 1) != 0));
+          }
+          sh->faces[i]->add_border(std::move(bd));
+        }
+      }
+    }
+    return err_enum_t::ERROR_OK;
+  }
+}
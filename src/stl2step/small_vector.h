@@ -0,0 +1,284 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с определением шаблона массива с встроенным буфером
+ *
+ * Первые N элементов хранятся внутри самого объекта, и память в куче выделяется только
+ * при их превышении. Массив только перемещается (копирование запрещено), поэтому
+ * передача его содержимого не приводит к выделению памяти и копированию элементов.
+ */
+
+#ifndef _SMALL_VECTOR_H
+#define _SMALL_VECTOR_H
+
+namespace prim3d {
+
+  /**
+   * \brief Массив с встроенным буфером на N элементов.
+   *
+   * \tparam T тип элементов
+   * \tparam N количество элементов, размещаемых без выделения памяти в куче
+   */
+  template <typename T, size_t N>
+  class small_vector {
+
+  private:
+
+    /**
+     * \brief Указатель на первый элемент (встроенный буфер или память в куче)
+     */
+    T* items;
+
+    /**
+     * \brief Количество элементов
+     */
+    size_t count;
+
+    /**
+     * \brief Количество элементов, для которых выделена память
+     */
+    size_t capacity;
+
+    /**
+     * \brief Встроенный буфер
+     */
+    alignas(T) unsigned char inline_items[N * sizeof(T)];
+
+    /**
+     * \brief Проверка: элементы размещены во встроенном буфере
+     */
+    bool is_inline() const { return items == reinterpret_cast<const T*>(inline_items); }
+
+    /**
+     * \brief Перенести элементы в выделенную в куче память new_items на new_capacity элементов.
+     *
+     * \param [in] new_items выделенная память
+     * \param [in] new_capacity количество элементов, для которых выделена память
+     */
+    void relocate(T* new_items, size_t new_capacity) {
+      for (size_t i = 0; i < count; ++i) {
+        new (new_items + i) T(std::move(items[i]));
+        items[i].~T();
+      }
+      if (!is_inline()) {
+        ::operator delete(items);
+      }
+      items = new_items;
+      capacity = new_capacity;
+    }
+
+    /**
+     * \brief Добавить элемент в конец массива.
+     *
+     * При нехватке памяти новый элемент создаётся в новой памяти до переноса прежних
+     * элементов, поэтому v может ссылаться на элемент этого же массива.
+     *
+     * \tparam A тип добавляемого элемента (ссылка на T или на const T)
+     * \param [in] v добавляемый элемент
+     */
+    template <typename A>
+    void append(A&& v) {
+      if (count == capacity) {
+        const size_t new_capacity = capacity * 2;
+        T* new_items = static_cast<T*>(::operator new(new_capacity * sizeof(T)));
+        new (new_items + count) T(std::forward<A>(v));
+        relocate(new_items, new_capacity);
+      } else {
+        new (items + count) T(std::forward<A>(v));
+      }
+      ++count;
+    }
+
+    /**
+     * \brief Забрать элементы массива other, оставив его пустым.
+     *
+     * \param [in] other массив, элементы которого перемещаются
+     */
+    void take(small_vector& other) {
+      if (other.is_inline()) {
+        for (size_t i = 0; i < other.count; ++i) {
+          new (items + i) T(std::move(other.items[i]));
+          other.items[i].~T();
+        }
+        count = other.count;
+      } else {
+        items = other.items;
+        count = other.count;
+        capacity = other.capacity;
+        other.items = reinterpret_cast<T*>(other.inline_items);
+        other.capacity = N;
+      }
+      other.count = 0;
+    }
+
+  public:
+
+    /** \brief Итератор элементов */
+    typedef T* iterator;
+
+    /** \brief Итератор неизменяемых элементов */
+    typedef const T* const_iterator;
+
+    /**
+     * \brief Конструктор пустого массива
+     */
+    small_vector() : items(reinterpret_cast<T*>(inline_items)), count(0), capacity(N) {}
+
+    /**
+     * \brief Конструктор перемещения
+     *
+     * \param [in] other массив, элементы которого перемещаются (остаётся пустым)
+     */
+    small_vector(small_vector&& other) : small_vector() { take(other); }
+
+    /**
+     * \brief Перемещающее присваивание
+     *
+     * \param [in] other массив, элементы которого перемещаются (остаётся пустым)
+     * \return ссылку на этот массив
+     */
+    small_vector& operator=(small_vector&& other) {
+      if (this != &other) {
+        clear();
+        if (!is_inline()) {
+          ::operator delete(items);
+          items = reinterpret_cast<T*>(inline_items);
+          capacity = N;
+        }
+        take(other);
+      }
+      return *this;
+    }
+
+    small_vector(const small_vector&) = delete;
+    small_vector& operator=(const small_vector&) = delete;
+
+    /**
+     * \brief Деструктор
+     */
+    ~small_vector() {
+      clear();
+      if (!is_inline()) {
+        ::operator delete(items);
+      }
+    }
+
+    /**
+     * \brief Добавить элемент в конец массива
+     *
+     * \param [in] v добавляемый элемент
+     */
+    void push_back(T&& v) {
+      append(std::move(v));
+    }
+
+    /**
+     * \brief Добавить копию элемента в конец массива
+     *
+     * \param [in] v добавляемый элемент
+     */
+    void push_back(const T& v) {
+      append(v);
+    }
+
+    /**
+     * \brief Удалить элемент, сдвинув последующие
+     *
+     * \param [in] it итератор удаляемого элемента
+     * \return итератор элемента, находящегося после удаляемого, или итератор конца массива
+     */
+    iterator erase(const_iterator it) {
+      iterator pos = items + (it - items);
+      for (iterator p = pos; p + 1 != items + count; ++p) {
+        *p = std::move(*(p + 1));
+      }
+      --count;
+      items[count].~T();
+      return pos;
+    }
+
+    /**
+     * \brief Удалить все элементы (выделенная память сохраняется)
+     */
+    void clear() {
+      for (size_t i = 0; i < count; ++i) {
+        items[i].~T();
+      }
+      count = 0;
+    }
+
+    /**
+     * \brief Получить количество элементов
+     *
+     * \return количество элементов
+     */
+    size_t size() const { return count; }
+
+    /**
+     * \brief Проверка: массив пуст
+     *
+     * \return true, если в массиве нет элементов
+     */
+    bool empty() const { return count == 0; }
+
+    /**
+     * \brief Получить элемент по индексу
+     *
+     * \param [in] i индекс элемента (меньше \ref size)
+     * \return ссылку на элемент
+     */
+    T& operator[](size_t i) { return items[i]; }
+
+    /**
+     * \brief Получить неизменяемый элемент по индексу
+     *
+     * \param [in] i индекс элемента (меньше \ref size)
+     * \return ссылку на элемент
+     */
+    const T& operator[](size_t i) const { return items[i]; }
+
+    /**
+     * \brief Получить итератор первого элемента
+     *
+     * \return итератор первого элемента
+     */
+    iterator begin() { return items; }
+
+    /**
+     * \brief Получить итератор конца массива
+     *
+     * \return итератор элемента, следующего за последним
+     */
+    iterator end() { return items + count; }
+
+    /**
+     * \brief Получить итератор первого неизменяемого элемента
+     *
+     * \return итератор первого элемента
+     */
+    const_iterator begin() const { return items; }
+
+    /**
+     * \brief Получить итератор конца неизменяемого массива
+     *
+     * \return итератор элемента, следующего за последним
+     */
+    const_iterator end() const { return items + count; }
+
+    /**
+     * \brief Получить итератор первого неизменяемого элемента
+     *
+     * \return итератор первого элемента
+     */
+    const_iterator cbegin() const { return items; }
+
+    /**
+     * \brief Получить итератор конца неизменяемого массива
+     *
+     * \return итератор элемента, следующего за последним
+     */
+    const_iterator cend() const { return items + count; }
+  };
+}
+
+#endif /* _SMALL_VECTOR_H */
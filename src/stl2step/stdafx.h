@@ -67,9 +67,12 @@
 #if defined(_MSC_VER) && defined(_DEBUG)
 #define __CRTDBG_MAP_ALLOC
 #include <crtdbg.h>
+// При учёте выделения памяти (ALLOC_TRACKING) используются только заменяющие операторы new
+#if !defined(ALLOC_TRACKING)
  //  #define DEBUG_NEW new(_NORMAL_BLOCK, __FILE__, __LINE__)
 #define DEBUG_NEW new(_CLIENT_BLOCK, __FILE__, __LINE__)
 #define new DEBUG_NEW
+#endif
 
 #include <crtdbg.h>
 #include <errno.h>
@@ -98,6 +101,10 @@
 #include <sstream>
 #include <iostream>
 #include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #if defined(_MSC_VER)
 typedef unsigned char      uint8_t;
@@ -0,0 +1,372 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями методов класса записи выходного файла STEP
+ * крупными блоками в фоновом потоке
+ */
+
+#include "stdafx.h"
+#include <stdarg.h>
+#if defined(__GNUC__) && !defined(__MINGW32__)
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+#if defined(USE_ZLIB)
+# include <zlib.h>
+#endif
+#include "err.h"
+#include "step_output.h"
+
+/**
+ * \file
+ * Функции, являющиеся методами класса \ref step_output "step_output":
+ * <BR>
+ */
+
+/**
+ * \file
+ * * \copybrief step_output::step_output()
+ */
+step_output::step_output() :
+#if defined(__GNUC__) && !defined(__MINGW32__)
+  fd(-1),
+#else
+  out(nullptr),
+#endif
+  async(false), zs(nullptr), file_offset(0), block(nullptr), block_used(0), offset(0), reserved(0), stop(false), failed(false) {
+}
+
+/**
+ * \file
+ * * \copybrief step_output::compression_supported()
+ */
+bool step_output::compression_supported() {
+#if defined(USE_ZLIB)
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * \file
+ * * \copybrief step_output::is_compressed_name(const std::string&)
+ */
+bool step_output::is_compressed_name(const std::string& name) {
+  std::string ext;
+  size_t pos = name.find_last_of('.');
+  if (pos == std::string::npos) return false;
+  ext = name.substr(pos);
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext.compare(".gz") == 0 || ext.compare(".stpz") == 0;
+}
+
+/**
+ * \file
+ * * \copybrief step_output::~step_output()
+ */
+step_output::~step_output() {
+  close();
+}
+
+/**
+ * \file
+ * * \copybrief step_output::alloc_block()
+ */
+char* step_output::alloc_block() {
+  void* p = nullptr;
+#if defined(_MSC_VER) || defined(__MINGW32__)
+  p = _aligned_malloc(BLOCK_SIZE, 4096);
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  if (posix_memalign(&p, 4096, BLOCK_SIZE) != 0) p = nullptr;
+#else
+# error Unknown C++ compiler
+#endif
+  if (p != nullptr) blocks.push_back(static_cast<char*>(p));
+  return static_cast<char*>(p);
+}
+
+/**
+ * \file
+ * * \copybrief step_output::open(const char*, bool)
+ */
+err_enum_t step_output::open(const char* name, bool Async, bool Compress) {
+
+  if (Compress && !compression_supported()) return err_enum_t::ERROR_FILE_IO;
+
+  /** Сжатые данные записываются без преобразования символов конца строки */
+#if defined(_MSC_VER)
+  errno_t err = fopen_s(&out, name, Compress ? "wb" : "wt");
+  if (err != 0 || out == nullptr) return err_enum_t::ERROR_FILE_IO;
+#elif defined(__MINGW32__)
+  out = fopen(name, Compress ? "wb" : "wt");
+  if (out == nullptr) return err_enum_t::ERROR_FILE_IO;
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  fd = ::open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) return err_enum_t::ERROR_FILE_IO;
+#else
+# error Unknown C++ compiler
+#endif
+
+  block = alloc_block();
+  if (block == nullptr) {
+#if defined(__GNUC__) && !defined(__MINGW32__)
+    ::close(fd);
+    fd = -1;
+#else
+    fclose(out);
+    out = nullptr;
+#endif
+    return err_enum_t::ERROR_FILE_IO;
+  }
+  block_used = 0;
+  offset = 0;
+  file_offset = 0;
+  reserved = 0;
+  stop = false;
+  failed = false;
+
+#if defined(USE_ZLIB)
+  if (Compress) {
+    zs = new z_stream_s();
+    /** windowBits 15 + 16 - заголовок и контрольная сумма gzip */
+    if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      delete zs;
+      zs = nullptr;
+      close();
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    zbuf.resize(BLOCK_SIZE);
+  }
+#endif
+
+  async = Async;
+  if (async) {
+    /** Блоки для очереди выделяются заранее */
+    for (size_t i = 0; i < QUEUE_SIZE; ++i) {
+      char* p = alloc_block();
+      if (p == nullptr) break;
+      free_blocks.push_back(p);
+    }
+    writer = std::thread(&step_output::writer_loop, this);
+  }
+
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \file
+ * * \copybrief step_output::reserve(long long)
+ */
+void step_output::reserve(long long size) {
+  /** Размер сжатого файла заранее неизвестен */
+  if (zs != nullptr) return;
+#if defined(__GNUC__) && !defined(__MINGW32__) && defined(__linux__)
+  /** Ошибка выделения места (например, на сетевом диске) не является ошибкой записи */
+  if (fd >= 0 && size > 0 && posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0) {
+    reserved = size;
+  }
+#endif
+}
+
+/**
+ * \file
+ * * \copybrief step_output::write_block(const char*, size_t, long long)
+ */
+bool step_output::write_block(const char* data, size_t size, long long pos) {
+#if defined(__GNUC__) && !defined(__MINGW32__)
+  while (size > 0) {
+    ssize_t n = pwrite(fd, data, size, static_cast<off_t>(pos));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+    pos += n;
+  }
+  return true;
+#else
+  (void)pos;
+  return fwrite(data, 1, size, out) == size;
+#endif
+}
+
+/**
+ * \file
+ * * \copybrief step_output::output_block(const char*, size_t, bool)
+ */
+bool step_output::output_block(const char* data, size_t size, bool finish) {
+  if (zs == nullptr) {
+    bool ok = write_block(data, size, file_offset);
+    file_offset += static_cast<long long>(size);
+    return ok;
+  }
+
+#if defined(USE_ZLIB)
+  zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  zs->avail_in = static_cast<uInt>(size);
+  for (;;) {
+    zs->next_out = reinterpret_cast<Bytef*>(zbuf.data());
+    zs->avail_out = static_cast<uInt>(zbuf.size());
+    int ret = deflate(zs, finish ? Z_FINISH : Z_NO_FLUSH);
+    if (ret == Z_STREAM_ERROR) return false;
+    size_t have = zbuf.size() - zs->avail_out;
+    if (have > 0) {
+      if (!write_block(zbuf.data(), have, file_offset)) return false;
+      file_offset += static_cast<long long>(have);
+    }
+    if (finish ? (ret == Z_STREAM_END) : (zs->avail_out != 0)) break;
+  }
+  return true;
+#else
+  (void)finish;
+  return false;
+#endif
+}
+
+/**
+ * \file
+ * * \copybrief step_output::writer_loop()
+ */
+void step_output::writer_loop() {
+  for (;;) {
+    std::pair<char*, size_t> item;
+    {
+      std::unique_lock<std::mutex> lock(m);
+      while (queue.empty() && !stop) cv_queue.wait(lock);
+      if (queue.empty()) break;
+      item = queue.front();
+      queue.pop_front();
+    }
+
+    bool ok = output_block(item.first, item.second, false);
+
+    {
+      std::lock_guard<std::mutex> lock(m);
+      if (!ok) failed = true;
+      free_blocks.push_back(item.first);
+    }
+    cv_free.notify_one();
+  }
+}
+
+/**
+ * \file
+ * * \copybrief step_output::submit_block()
+ */
+void step_output::submit_block() {
+  if (block_used == 0) return;
+
+  if (!async) {
+    if (!output_block(block, block_used, false)) failed = true;
+    offset += static_cast<long long>(block_used);
+    block_used = 0;
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m);
+    queue.push_back(std::make_pair(block, block_used));
+    while (free_blocks.empty()) cv_free.wait(lock);
+    block = free_blocks.back();
+    free_blocks.pop_back();
+  }
+  cv_queue.notify_one();
+  offset += static_cast<long long>(block_used);
+  block_used = 0;
+}
+
+/**
+ * \file
+ * * \copybrief step_output::write(const char*, size_t)
+ */
+void step_output::write(const char* data, size_t size) {
+  while (size > 0) {
+    size_t n = std::min(size, BLOCK_SIZE - block_used);
+    memcpy(block + block_used, data, n);
+    block_used += n;
+    data += n;
+    size -= n;
+    if (block_used == BLOCK_SIZE) submit_block();
+  }
+}
+
+/**
+ * \file
+ * * \copybrief step_output::print(const char*, ...)
+ */
+void step_output::print(const char* format, ...) {
+  char Buff[1024];
+  va_list args;
+
+  va_start(args, format);
+  int len = vsnprintf(Buff, sizeof(Buff), format, args);
+  va_end(args);
+
+  if (len < 0) return;
+  if (static_cast<size_t>(len) < sizeof(Buff)) {
+    write(Buff, static_cast<size_t>(len));
+    return;
+  }
+
+  std::vector<char> Big(static_cast<size_t>(len) + 1);
+  va_start(args, format);
+  vsnprintf(Big.data(), Big.size(), format, args);
+  va_end(args);
+  write(Big.data(), static_cast<size_t>(len));
+}
+
+/**
+ * \file
+ * * \copybrief step_output::close()
+ */
+err_enum_t step_output::close() {
+  if (block == nullptr) return err_enum_t::ERROR_OK;
+
+  submit_block();
+
+  if (async) {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stop = true;
+    }
+    cv_queue.notify_one();
+    writer.join();
+    async = false;
+  }
+
+#if defined(USE_ZLIB)
+  /** Завершить поток сжатых данных */
+  if (zs != nullptr) {
+    if (!output_block(nullptr, 0, true)) failed = true;
+    deflateEnd(zs);
+    delete zs;
+    zs = nullptr;
+    zbuf.clear();
+  }
+#endif
+
+  for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    _aligned_free(*it);
+#else
+    free(*it);
+#endif
+  }
+  blocks.clear();
+  free_blocks.clear();
+  block = nullptr;
+
+#if defined(__GNUC__) && !defined(__MINGW32__)
+  /** Отбросить место, выделенное заранее сверх записанного */
+  if (reserved > file_offset && ftruncate(fd, static_cast<off_t>(file_offset)) != 0) failed = true;
+  if (::close(fd) != 0) failed = true;
+  fd = -1;
+#else
+  if (fclose(out) != 0) failed = true;
+  out = nullptr;
+#endif
+
+  return failed ? err_enum_t::ERROR_FILE_IO : err_enum_t::ERROR_OK;
+}
@@ -0,0 +1,231 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлением класса записи выходного файла STEP
+ * крупными блоками в фоновом потоке
+ */
+
+#ifndef _STEP_OUTPUT_H
+#define _STEP_OUTPUT_H
+
+#include "err.h"
+
+struct z_stream_s;
+
+/**
+ * \brief Класс записи выходного файла STEP.
+ *
+ * Текст накапливается в блоках большого размера, выровненных по границе страницы.
+ * Заполненный блок передаётся фоновому потоку, который записывает его в файл
+ * (в Linux - вызовом pwrite по известному смещению, в остальных средах - fwrite),
+ * пока основной поток заполняет следующий блок. Без фонового потока запись
+ * выполняется теми же блоками синхронно.
+ *
+ * При записи в сжатом виде (gzip, в том числе STEP-Z) блоки сжимаются тем же
+ * фоновым потоком непосредственно перед записью, так что несжатый текст на диск
+ * не попадает.
+ */
+class step_output {
+
+private:
+
+  /** \brief Размер блока */
+  static const size_t BLOCK_SIZE = 1024 * 1024;
+
+  /** \brief Количество блоков, которые одновременно могут ожидать записи */
+  static const size_t QUEUE_SIZE = 4;
+
+#if defined(__GNUC__) && !defined(__MINGW32__)
+  /** \brief Дескриптор файла */
+  int fd;
+#else
+  /** \brief Файл */
+  FILE* out; //-V122_NOPTR
+#endif
+
+  /** \brief Использовать фоновый поток */
+  bool async;
+
+  /** \brief Состояние сжатия gzip или nullptr, если файл записывается без сжатия */
+  z_stream_s* zs;
+
+  /** \brief Буфер сжатых данных */
+  std::vector<char> zbuf;
+
+  /** \brief Количество байт, записанных в файл (при сжатии отличается от offset) */
+  long long file_offset;
+
+  /** \brief Заполняемый блок */
+  char* block;
+
+  /** \brief Количество байт в заполняемом блоке */
+  size_t block_used;
+
+  /** \brief Количество байт текста, переданных на запись */
+  long long offset;
+
+  /** \brief Размер, выделенный файлу заранее */
+  long long reserved;
+
+  /** \brief Блоки, ожидающие записи: адрес и размер */
+  std::list<std::pair<char*, size_t> > queue;
+
+  /** \brief Свободные блоки */
+  std::vector<char*> free_blocks;
+
+  /** \brief Все выделенные блоки */
+  std::vector<char*> blocks;
+
+  /** \brief Блокировка для queue, free_blocks, stop и failed */
+  std::mutex m;
+
+  /** \brief Сигнал о появлении блока в очереди или о завершении */
+  std::condition_variable cv_queue;
+
+  /** \brief Сигнал об освобождении блока */
+  std::condition_variable cv_free;
+
+  /** \brief Фоновый поток записи */
+  std::thread writer;
+
+  /** \brief Признак завершения фонового потока */
+  bool stop;
+
+  /** \brief Признак ошибки записи */
+  bool failed;
+
+  /**
+   * \brief Записать блок в файл.
+   *
+   * \param [in] data адрес блока
+   * \param [in] size размер блока
+   * \param [in] pos смещение блока в файле
+   * \return true в случае успешного завершения
+   */
+  bool write_block(const char* data, size_t size, long long pos);
+
+  /**
+   * \brief Сжать (при необходимости) и записать блок в файл по порядку.
+   *
+   * \param [in] data адрес блока
+   * \param [in] size размер блока
+   * \param [in] finish завершить поток сжатых данных
+   * \return true в случае успешного завершения
+   */
+  bool output_block(const char* data, size_t size, bool finish);
+
+  /**
+   * \brief Функция фонового потока записи.
+   */
+  void writer_loop();
+
+  /**
+   * \brief Передать заполненный блок на запись и получить свободный.
+   */
+  void submit_block();
+
+  /**
+   * \brief Выделить блок, выровненный по границе страницы.
+   * \return адрес блока или nullptr
+   */
+  char* alloc_block();
+
+public:
+
+  /**
+   * \brief Конструктор по умолчанию
+   */
+  step_output();
+
+  /**
+   * \brief Деструктор. Закрывает файл, если он не был закрыт.
+   */
+  ~step_output();
+
+  step_output(const step_output&) = delete;
+  step_output& operator=(const step_output&) = delete;
+
+  /**
+   * \brief Открыть файл для записи.
+   *
+   * \param [in] name имя файла
+   * \param [in] Async использовать фоновый поток записи
+   * \param [in] Compress записывать файл в сжатом виде (gzip)
+   * \retval err_enum_t::ERROR_FILE_IO если файл не удалось открыть;
+   * \retval err_enum_t::ERROR_OK в случае успешного завершения.
+   */
+  err_enum_t open(const char* name, bool Async, bool Compress = false);
+
+  /**
+   * \brief Проверить, поддерживается ли запись в сжатом виде.
+   * \return true, если программа собрана с библиотекой zlib
+   */
+  static bool compression_supported();
+
+  /**
+   * \brief Проверить, требует ли имя файла записи в сжатом виде.
+   *
+   * \param [in] name имя файла
+   * \return true для расширений .gz и .stpZ (STEP-Z)
+   */
+  static bool is_compressed_name(const std::string& name);
+
+  /**
+   * \brief Заранее выделить файлу место на диске (если поддерживается).
+   *
+   * \param [in] size ожидаемый размер файла
+   */
+  void reserve(long long size);
+
+  /**
+   * \brief Дописать текст в файл.
+   *
+   * \param [in] data текст
+   * \param [in] size длина текста
+   */
+  void write(const char* data, size_t size);
+
+  /**
+   * \brief Дописать строку в файл.
+   *
+   * \param [in] s строка
+   */
+  void write(const std::string& s) {
+    write(s.data(), s.size());
+  }
+
+  /**
+   * \brief Дописать в файл текст, сформированный по образцу printf.
+   *
+   * \param [in] format образец
+   */
+  void print(const char* format, ...);
+
+  /**
+   * \brief Получить количество байт текста, переданных на запись.
+   *
+   * \return количество байт текста
+   */
+  long long get_text_size() const {
+    return offset + static_cast<long long>(block_used);
+  }
+
+  /**
+   * \brief Получить количество байт, записанных в файл (при сжатии - размер сжатых данных).
+   *
+   * \return количество байт, записанных в файл
+   */
+  long long get_file_size() const {
+    return file_offset;
+  }
+
+  /**
+   * \brief Записать оставшийся текст, дождаться завершения записи и закрыть файл.
+   *
+   * \retval err_enum_t::ERROR_FILE_IO в случае ошибки записи;
+   * \retval err_enum_t::ERROR_OK в случае успешного завершения.
+   */
+  err_enum_t close();
+};
+
+#endif /* _STEP_OUTPUT_H */
@@ -8,6 +8,11 @@
 #include "err.h"
 #include "support.h"
 #include "arg_parser.h"
+#include "stl_input.h"
+#include "trace.h"
+#include "metrics.h"
+#include "alloc_tracker.h"
+#include "jobs.h"
 
  /**
   * \brief Вывод справки о командной строке.
@@ -16,8 +21,15 @@ void print_help() {
   std::cout << "КРАТКАЯ СПРАВКА" << std::endl;
   std::cout << "stl2step <[ДОП. ПАРАМЕТРЫ] --stl in1.stl [ДОП. ПАРАМЕТРЫ] --stl in2.stl ... > <--out результат.step>" << std::endl;
   std::cout << "    in1.stl, in2.stl  - входные файлы формата STL (в том числе группы"  << std::endl;
-  std::cout << "                        файлов по маске с использованием джокерных символов)" << std::endl;
-  std::cout << "    результат.step    - выходной файл формата STEP" << std::endl;
+  std::cout << "                        файлов по маске с использованием джокерных символов)," << std::endl;
+  std::cout << "                        сжатые файлы STL (in.stl.gz), архивы zip (все файлы" << std::endl;
+  std::cout << "                        .stl архива) и файлы в архиве zip (архив.zip/маска)" << std::endl;
+  std::cout << "                        Вместо файлов STL могут быть указаны индексированные сетки" << std::endl;
+  std::cout << "                        треугольников: двоичные файлы PLY (.ply) и файлы OBJ (.obj)" << std::endl;
+  std::cout << "                        Имя '-' - чтение файла STL со стандартного ввода, именованные" << std::endl;
+  std::cout << "                        каналы читаются как обычные файлы" << std::endl;
+  std::cout << "    результат.step    - выходной файл формата STEP (с расширением .gz или .stpZ -" << std::endl;
+  std::cout << "                        в сжатом виде gzip)" << std::endl;
   std::cout << "    ДОПОЛНИТЕЛЬНЫЕ ПАРАМЕТРЫ:" << std::endl;
   std::cout << "    ------------------- действующие только для следующего файла (группы" << std::endl;
   std::cout << "                        файлов по маске) формата STL:" << std::endl;
@@ -40,67 +52,125 @@ void print_help() {
   std::cout << "                      (по умолчанию: разрешить)" << std::endl;
   std::cout << "    {--ocy|--ocn}     - разрешить/запретить замену дублирующихся фигур ссылками" << std::endl;
   std::cout << "                      (по умолчанию: разрешить)" << std::endl;
+  std::cout << "    {--oby|--obn}     - разрешить/запретить непосредственный вывод граней в текст STEP" << std::endl;
+  std::cout << "                      без создания промежуточных объектов (по умолчанию: разрешить)" << std::endl;
+  std::cout << "    {--oiy|--oin}     - разрешить/запретить вывод объектов во временный файл сразу после" << std::endl;
+  std::cout << "                      обработки каждого файла STL (по умолчанию: разрешить)" << std::endl;
+  std::cout << "    {--oay|--oan}     - разрешить/запретить запись файла STEP крупными блоками в фоновом" << std::endl;
+  std::cout << "                      потоке (по умолчанию: разрешить)" << std::endl;
+  std::cout << "    {--ony|--onn}     - разрешить/запретить проверку треугольников STL при импорте: пересчёт" << std::endl;
+  std::cout << "                      неточных нормалей по вершинам и отбрасывание вырожденных треугольников" << std::endl;
+  std::cout << "                      (по умолчанию: разрешить)" << std::endl;
+  std::cout << "    {--opy|--opn}     - разрешить/запретить проверку плоскостности при объединении треугольных" << std::endl;
+  std::cout << "                      граней: вершины объединяемых граней должны лежать в одной плоскости" << std::endl;
+  std::cout << "                      (по умолчанию: запретить)" << std::endl;
+  std::cout << "    --threads N [S]   - количество потоков для чтения файлов STL и записи файла STEP" << std::endl;
+  std::cout << "                      (по умолчанию: количество процессоров); файлы STL размером от S байт" << std::endl;
+  std::cout << "                      разбираются частями параллельно (по умолчанию: 4194304)" << std::endl;
+  std::cout << "    --cache D         - использовать директорию D как кэш обработанных фигур: файлы STL, содержимое" << std::endl;
+  std::cout << "                      и параметры обработки которых не изменились, не импортируются и не" << std::endl;
+  std::cout << "                      объединяются заново (по умолчанию: кэш не используется)" << std::endl;
+  std::cout << "    --topo D          - записать обработанные фигуры каждого файла STL в двоичный файл топологии" << std::endl;
+  std::cout << "                      D/имя.s2t; файлы .s2t могут быть указаны вместо файлов STL - фигуры" << std::endl;
+  std::cout << "                      создаются по ним без импорта и обработки; без флага --out создаются" << std::endl;
+  std::cout << "                      только файлы топологии; файлы STL с одинаковыми именами, но разным" << std::endl;
+  std::cout << "                      содержимым (из разных директорий или архивов) - ошибка" << std::endl;
+  std::cout << "пример: преобразовать файлы STL в файлы топологии, затем создать из них файл STEP" << std::endl;
+  std::cout << " stl2step --topo topo --stl lib/*.stl" << std::endl;
+  std::cout << " stl2step --stl topo/*.s2t --out out.step" << std::endl;
+  std::cout << "    --server [N]      - режим сервера: выполнять задания со стандартного ввода, по одному" << std::endl;
+  std::cout << "                      в строке (директивы задания - как в командной строке), N потоками" << std::endl;
+  std::cout << "                      (по умолчанию: количество процессоров); директивы перед флагом" << std::endl;
+  std::cout << "                      --server добавляются к каждому заданию; строка 'status' - состояние" << std::endl;
+  std::cout << "                      очереди, 'quit' или конец ввода - завершение после всех заданий;" << std::endl;
+  std::cout << "                      на каждое задание выводится строка с кодом завершения и временем этапов" << std::endl;
+  std::cout << "                      (за строкой задания с ошибкой - его сообщения);" << std::endl;
+  std::cout << "                      стандартный ввод и вывод заняты сервером, поэтому имя '-' после флагов" << std::endl;
+  std::cout << "                      --stl и --out в заданиях недопустимо" << std::endl;
+  std::cout << "пример: сервер с кэшем фигур, 4 задания одновременно по одному потоку на задание" << std::endl;
+  std::cout << " stl2step --threads 1 --cache cache --server 4" << std::endl;
+  std::cout << "    --batch F [N]     - пакетный режим: выполнить задания из файла F, по одному в строке" << std::endl;
+  std::cout << "                      (как в режиме сервера), N потоками (по умолчанию: количество процессоров)" << std::endl;
+  std::cout << "                      и вывести общий отчёт (для заданий с ошибкой - с их сообщениями);" << std::endl;
+  std::cout << "                      директивы перед флагом --batch добавляются к каждому заданию;" << std::endl;
+  std::cout << "                      строка, оканчивающаяся символом '\\', продолжается" << std::endl;
+  std::cout << "                      следующей; код завершения - код первого задания, завершившегося с ошибкой;" << std::endl;
+  std::cout << "                      ограничения заданий - как в режиме сервера" << std::endl;
+  std::cout << "пример: преобразовать библиотеку по списку заданий, 8 заданий одновременно" << std::endl;
+  std::cout << " stl2step --threads 1 --batch library.txt 8" << std::endl;
   std::cout << "    --d0              - отменить вывод отладочных сообщений" << std::endl;
   std::cout << "    --d1              - включить отладочные сообщения уровня 1 (самые общие)" << std::endl;
   std::cout << "    --d2              - включить отладочные сообщения уровня 2" << std::endl;
   std::cout << "    --d3              - включить отладочные сообщения уровня 3 (самые детальные)" << std::endl;
   std::cout << "    --dp              - разрешить профилирование (оценку времени работы отдельных этапов обработки)" << std::endl;
+  std::cout << "    --dh              - разрешить профилирование с аппаратными счётчиками процессора (Linux):" << std::endl;
+  std::cout << "                      такты, команды, промахи кэша и ошибки предсказания переходов этапов" << std::endl;
+  std::cout << "                      (недопустимо в режиме сервера и пакетном режиме)" << std::endl;
+  std::cout << "    --trace F         - записать трассировку этапов обработки (по файлам и фигурам) в файл F" << std::endl;
+  std::cout << "                      в формате Chrome Trace Event (JSON) для chrome://tracing или ui.perfetto.dev;" << std::endl;
+  std::cout << "                      в режиме сервера и пакетном режиме - только перед флагом --server или --batch:" << std::endl;
+  std::cout << "                      трассировка всех заданий, записываемая при завершении работы" << std::endl;
+  std::cout << "    --metrics F       - записать показатели обработки (количество треугольников, вершин, рёбер," << std::endl;
+  std::cout << "                      граней, экземпляров STEP по типам, байт, пиковый объём памяти после этапов)" << std::endl;
+  std::cout << "                      в файл F в формате JSON (недопустимо в режиме сервера и пакетном режиме)" << std::endl;
 }
 
 /**
- * \brief Функция, вызываемая при запуске исполняемого файла.
+ * \brief Обработать файлы STL из архива zip, имена которых соответствуют маске.
  *
- * \param [in] argc Количество аргументов-строк в командной строке.
- * \param [in] argv Аргументы-строки в командной строке.
- * \return код ошибки.
+ * \param [in] SAPI формируемые структуры файла STEP
+ * \param [in] archive имя архива zip
+ * \param [in] mask маска имён файлов в архиве
+ * \param [in] shell_name имя фигуры
+ * \param [in] color цвет фигур
+ * \param [in] transparency прозрачность фигур
+ * \param [in] copies список смещений для формирования фигур-клонов
+ * \param [out] input_present устанавливается в true, если в архиве был файл STL
+ * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
  */
-int main(int argc, char* argv[])
-{
-  /** Алгоритм: */
+static err_enum_t process_zip(
+  express::STEP_API* SAPI,
+  const std::string& archive,
+  const std::string& mask,
+  const std::string& shell_name,
+  const geometry::vector& color,
+  double transparency,
+  const std::vector<geometry::vector>& copies,
+  bool& input_present) {
 
-#if defined(_MSC_VER) && defined(_DEBUG)
-  _CrtSetReportMode(_CRT_WARN, _CRTDBG_MODE_FILE);
-  _CrtSetReportFile(_CRT_WARN, _CRTDBG_FILE_STDOUT);
-  _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
-  _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);
-  _CrtSetReportMode(_CRT_ASSERT, _CRTDBG_MODE_FILE);
-  _CrtSetReportFile(_CRT_ASSERT, _CRTDBG_FILE_STDOUT);
-#endif
+  std::vector<stl_input::zip_entry> entries;
+  if (stl_input::list_zip(archive, mask, entries) != err_enum_t::ERROR_OK) {
+    std::cout << "Ошибка чтения архива zip '" << archive << "'" << std::endl;
+    return err_enum_t::ERROR_FILE_IO;
+  }
+  /* Файлы читаются из архива без распаковки во временные файлы */
+  for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+    err_enum_t err = SAPI->process_file((*it).name, shell_name, archive + "/", color, transparency, copies);
+    if (err != err_enum_t::ERROR_OK) return err;
+    input_present = true;
+  }
+  return err_enum_t::ERROR_OK;
+}
 
-#if defined(_MSC_VER) || defined(__MINGW32__)
-//std::cout << "MSVC/MINGW32 version" << std::endl;
-  UINT OldCP = GetConsoleOutputCP();
-  SetConsoleOutputCP(CP_UTF8);
-#endif
+/**
+ * \brief Выполнить преобразование, заданное директивами командной строки (или задания).
+ *
+ * \param [in] args разобранные директивы
+ * \param [in] step_file последний аргумент командной строки (имя результирующего файла)
+ * \param [out] stages время этапов обработки или nullptr, если его не требуется возвращать
+ * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+ */
+static err_enum_t convert(const arg_parser& args, const std::string& step_file, jobs::stages_t* stages) {
 
-  /** 1 Сформировать список директив и их параметров из аргументов командной строки */
-  arg_parser args;
-  int err_parse = args.process_cmdline(const_cast<const char**>(argv), argc);
-   
-  /** 2 Проверить ошибку отсутствия аргументов программы */
-  if (err_parse == -2) {
-    print_help();
-#if defined(_MSC_VER) || defined(__MINGW32__)
-    SetConsoleOutputCP(OldCP);
-#endif
-    return static_cast<int>(err_enum_t::ERROR_OK);
-  /** 3 Проверить ошибки разбора командной строки */
-  } else if (err_parse == -1) {
-    std::cout << "Ошибка формата командной строки: первый аргумент '" << args.get_flag(0) << "' не является флагом" << std::endl;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-    SetConsoleOutputCP(OldCP);
-#endif
-    return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
-  } else if (err_parse == -3) {
-    std::cout << "Ошибка формата командной строки: первый аргумент '" << args.get_flag(0) << "' является пустым флагом" << std::endl;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-    SetConsoleOutputCP(OldCP);
-#endif
-    return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
-  }
+  /** Алгоритм: */
 
-  /** 4 Инициализировать и начать формирование структур для создания файла STEP */
-  express::STEP_API* SAPI = new express::STEP_API(str_remove_path(str_remove_ext(argv[argc - 1])));
+  /** 1 Инициализировать и начать формирование структур для создания файла STEP */
+  std::string step_name = str_remove_path(str_remove_ext(step_file));
+  /* У сжатого файла (например, 'model.stp.gz') отбросить и расширение файла STEP */
+  if (step_output::is_compressed_name(step_file)) step_name = str_remove_ext(step_name);
+  express::STEP_API* SAPI = new express::STEP_API(step_name);
+  /* Время этапов задания измеряется всегда */
+  if (stages != nullptr) SAPI->set_profiling(true);
 
   err_enum_t retcode(err_enum_t::ERROR_OK);
   
@@ -114,10 +184,22 @@ int main(int argc, char* argv[])
   std::string shell_name;
   /* Имя, которое будет присвоено результирующему файлу STEP */
   std::string out_file;
+  /* Имя файла трассировки */
+  std::string trace_file;
+  /* Имя файла показателей обработки */
+  std::string metrics_file;
   /* true, если в командной строке был файл STL */
   bool input_present = false;
 
-  /** 5 Обработать директивы в цикле */
+  /* Без результирующего файла, но с директорией файлов топологии, создаются только файлы топологии */
+  bool out_present = false, topo_present = false;
+  for (size_t i = 0; i < args.get_arg_num(); ++i) {
+    if (args.get_flag(i).compare("out") == 0) out_present = true;
+    if (args.get_flag(i).compare("topo") == 0) topo_present = true;
+  }
+  SAPI->set_topology_only(!out_present && topo_present);
+
+  /** 2 Обработать директивы в цикле */
   for (size_t i = 0; i < args.get_arg_num(); ++i) {
 
     if (args.get_flag(i).compare("out") == 0) {
@@ -130,18 +212,12 @@ int main(int argc, char* argv[])
       if (parms.size() < 3) {
         delete SAPI;
         std::cout << "Ошибка формата командной строки: количество параметров после флага 'copy' меньше трёх" << std::endl;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-        SetConsoleOutputCP(OldCP);
-#endif
-        return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+        return err_enum_t::ERROR_CMD_FORMAT;
       }
       if (parms.size() / 3 * 3 != parms.size()) {
         delete SAPI;
         std::cout << "Ошибка формата командной строки: количество параметров после флага 'copy' не кратно трём" << std::endl;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-        SetConsoleOutputCP(OldCP);
-#endif
-        return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+        return err_enum_t::ERROR_CMD_FORMAT;
       }
       for (size_t t = 0; t < parms.size(); t+= 3) {
         /* Добавить этот вектор сдвига */
@@ -155,10 +231,7 @@ int main(int argc, char* argv[])
       if (parms.size() < 3) {
         delete SAPI;
         std::cout << "Ошибка формата командной строки: количество параметров после флага 'color' меньше трёх" << std::endl;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-        SetConsoleOutputCP(OldCP);
-#endif
-        return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+        return err_enum_t::ERROR_CMD_FORMAT;
       }
       /* Установить этот цвет */
       color = geometry::vector(atof(parms[0].c_str()), atof(parms[1].c_str()), atof(parms[2].c_str()));
@@ -173,15 +246,109 @@ int main(int argc, char* argv[])
       if (parms.size() < 1) {
         delete SAPI;
         std::cout << "Ошибка формата командной строки: отсутствуют параметры после флага 'transp'" << std::endl;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-        SetConsoleOutputCP(OldCP);
-#endif
-        return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+        return err_enum_t::ERROR_CMD_FORMAT;
       }
       transparency = atof(parms[0].c_str());
       continue;
     }
     else
+    if (args.get_flag(i).compare("oay") == 0) {
+      SAPI->set_optim_async(true);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: enable asynchronous output - writing STEP file in background thread" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("oan") == 0) {
+      SAPI->set_optim_async(false);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: disable asynchronous output - writing STEP file synchronously" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("ony") == 0) {
+      SAPI->set_optim_normals(true);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: enable normals check - recompute bad normals and drop degenerate triangles" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("onn") == 0) {
+      SAPI->set_optim_normals(false);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: disable normals check - use triangles as read from STL" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("opy") == 0) {
+      SAPI->set_optim_plane(true);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: enable plane check - merged faces must be flat" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("opn") == 0) {
+      SAPI->set_optim_plane(false);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: disable plane check - faces are merged by normals only" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("threads") == 0) {
+      std::vector<std::string> parms = args.get_parameters_set(i);
+      if (parms.size() < 1 || parms.size() > 2 || atoi(parms[0].c_str()) < 1) {
+        delete SAPI;
+        std::cout << "Ошибка формата командной строки: отсутствует или неверно количество потоков после флага 'threads'" << std::endl;
+        return err_enum_t::ERROR_CMD_FORMAT;
+      }
+      if (parms.size() == 2 && atoll(parms[1].c_str()) < 0) {
+        delete SAPI;
+        std::cout << "Ошибка формата командной строки: неверный размер файла STL для параллельного разбора после флага 'threads'" << std::endl;
+        return err_enum_t::ERROR_CMD_FORMAT;
+      }
+      SAPI->set_threads(static_cast<unsigned>(atoi(parms[0].c_str())));
+      if (parms.size() == 2) SAPI->set_parallel_min_size(static_cast<size_t>(atoll(parms[1].c_str())));
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: set " << parms[0] << " threads for STL file reading and STEP file writing" << std::endl;
+        if (parms.size() == 2) std::cout << "Command line: parse STL files of " << parms[1] << " bytes and more in parallel" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("cache") == 0) {
+      std::vector<std::string> parms = args.get_parameters_set(i);
+      if (parms.size() != 1) {
+        delete SAPI;
+        std::cout << "Ошибка формата командной строки: отсутствует директория кэша после флага 'cache'" << std::endl;
+        return err_enum_t::ERROR_CMD_FORMAT;
+      }
+      SAPI->set_cache_dir(parms[0]);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: using shell cache directory '" << parms[0] << "'" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("topo") == 0) {
+      std::vector<std::string> parms = args.get_parameters_set(i);
+      if (parms.size() != 1) {
+        delete SAPI;
+        std::cout << "Ошибка формата командной строки: отсутствует директория файлов топологии после флага 'topo'" << std::endl;
+        return err_enum_t::ERROR_CMD_FORMAT;
+      }
+      SAPI->set_topology_dir(parms[0]);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: writing shell topology files to directory '" << parms[0] << "'" << std::endl;
+      }
+      continue;
+    }
+    else
     if (args.get_flag(i).compare("ofy") == 0) {
       SAPI->set_optim_faces(true);
       if (SAPI->get_debug_print1()) {
@@ -230,6 +397,38 @@ int main(int argc, char* argv[])
       continue;
     }
     else
+    if (args.get_flag(i).compare("oby") == 0) {
+      SAPI->set_optim_brep(true);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: enable direct B-rep output - writing faces without EXPRESS objects" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("obn") == 0) {
+      SAPI->set_optim_brep(false);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: disable direct B-rep output - creating EXPRESS objects for faces" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("oiy") == 0) {
+      SAPI->set_optim_flush(true);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: enable incremental output - flushing primitives after each STL" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("oin") == 0) {
+      SAPI->set_optim_flush(false);
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: disable incremental output - keeping all primitives until saving" << std::endl;
+      }
+      continue;
+    }
+    else
     if (args.get_flag(i).compare("d0") == 0) {
       if (SAPI->get_debug_print1()) {
         std::cout << "Command line: disable debug output" << std::endl;
@@ -263,6 +462,29 @@ int main(int argc, char* argv[])
       continue;
     }
     else
+    if (args.get_flag(i).compare("dh") == 0) {
+      SAPI->set_profiling_hw(true);
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("trace") == 0) {
+      trace_file = args.get_parameters(i);
+      trace::enable();
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: writing trace to '" << trace_file << "'" << std::endl;
+      }
+      continue;
+    }
+    else
+    if (args.get_flag(i).compare("metrics") == 0) {
+      metrics_file = args.get_parameters(i);
+      metrics::enable();
+      if (SAPI->get_debug_print1()) {
+        std::cout << "Command line: writing metrics to '" << metrics_file << "'" << std::endl;
+      }
+      continue;
+    }
+    else
     if (args.get_flag(i).compare("name") == 0) {
       shell_name = args.get_parameters(i);
       continue;
@@ -273,98 +495,295 @@ int main(int argc, char* argv[])
         std::cout << "Command line: processing STL '" << args.get_parameters(i) << "'" << std::endl;
       }
   
-      /* Путь к файлу STL */
-      std::string m_path = str_get_path(args.get_parameters(i));
+      /* Файл STL со стандартного ввода (например, от генератора модели через конвейер) */
+      std::string zip_archive, zip_mask;
+      if (stl_input::is_stdin_name(args.get_parameters(i))) {
+        if ((retcode = SAPI->process_file(args.get_parameters(i), shell_name, "", color, transparency, copies)) != err_enum_t::ERROR_OK) {
+          delete SAPI;
+          return retcode;
+        }
+        input_present = true;
+      }
+      else
+      /* Файлы STL в архиве zip, заданные маской вида 'архив.zip/маска' */
+      if (stl_input::split_zip_name(args.get_parameters(i), zip_archive, zip_mask)) {
+        if ((retcode = process_zip(SAPI, zip_archive, zip_mask, shell_name, color, transparency, copies, input_present)) != err_enum_t::ERROR_OK) {
+          delete SAPI;
+          return retcode;
+        }
+      }
+      else {
+        /* Путь к файлу STL */
+        std::string m_path = str_get_path(args.get_parameters(i));
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
-      struct _finddata_t ffblk;
-      auto Handle = _findfirst(args.get_parameters(i).c_str(), &ffblk);
-      if (Handle != -1) {
-        for (;;) {
-          if (!(ffblk.attrib & _A_SUBDIR)) {
-            /** 6 Обработать файл STL в том же цикле */
-            if ((retcode = SAPI->process_file(ffblk.name, shell_name, m_path, color, transparency, copies)) != err_enum_t::ERROR_OK) {
-              delete SAPI;
-              SetConsoleOutputCP(OldCP);
-              return static_cast<int>(retcode);
-            }
-            input_present = true;
-         }
-          auto Result = _findnext(Handle, &ffblk);
-          if (Result == -1) break;
+        struct _finddata_t ffblk;
+        auto Handle = _findfirst(args.get_parameters(i).c_str(), &ffblk);
+        if (Handle != -1) {
+          for (;;) {
+            if (!(ffblk.attrib & _A_SUBDIR)) {
+              /** 3 Обработать файл STL (или файлы STL из архива zip) в том же цикле */
+              if (stl_input::is_zip_name(ffblk.name)) {
+                retcode = process_zip(SAPI, m_path + ffblk.name, "*.stl", shell_name, color, transparency, copies, input_present);
+              } else {
+                retcode = SAPI->process_file(ffblk.name, shell_name, m_path, color, transparency, copies);
+                input_present = true;
+              }
+              if (retcode != err_enum_t::ERROR_OK) {
+                delete SAPI;
+                return retcode;
+              }
+           }
+            auto Result = _findnext(Handle, &ffblk);
+            if (Result == -1) break;
+          }
+          _findclose(Handle);
         }
-        _findclose(Handle);
-      }
 #elif defined(__GNUC__) || defined(__DOXYGEN__)
-      if (m_path.empty()) m_path = "./";
-      /* Маска файла материала без пути */
-      std::string m_mask = str_remove_path(args.get_parameters(i));
-      DIR* dir = opendir(m_path.c_str());
-      if (dir != nullptr) {
-        for (;;) {
-          struct dirent* entry = readdir(dir);
-          if (entry == nullptr) break;
-          if (fnmatch(m_mask.c_str(), entry->d_name, FNM_CASEFOLD) == FNM_NOMATCH) continue;
-          /** 6 Обработать файл STL в том же цикле */
-          if ((retcode = SAPI->process_file(entry->d_name, shell_name, m_path, color, transparency, copies)) != err_enum_t::ERROR_OK) {
-            delete SAPI;
-            return static_cast<int>(retcode);
+        if (m_path.empty()) m_path = "./";
+        /* Маска файла материала без пути */
+        std::string m_mask = str_remove_path(args.get_parameters(i));
+        DIR* dir = opendir(m_path.c_str());
+        if (dir != nullptr) {
+          for (;;) {
+            struct dirent* entry = readdir(dir);
+            if (entry == nullptr) break;
+            if (fnmatch(m_mask.c_str(), entry->d_name, FNM_CASEFOLD) == FNM_NOMATCH) continue;
+            /** 3 Обработать файл STL (или файлы STL из архива zip) в том же цикле */
+            if (stl_input::is_zip_name(entry->d_name)) {
+              retcode = process_zip(SAPI, m_path + entry->d_name, "*.stl", shell_name, color, transparency, copies, input_present);
+            } else {
+              retcode = SAPI->process_file(entry->d_name, shell_name, m_path, color, transparency, copies);
+              input_present = true;
+            }
+            if (retcode != err_enum_t::ERROR_OK) {
+              delete SAPI;
+              return retcode;
+            }
           }
-          input_present = true;
+          closedir(dir);
         }
-        closedir(dir);
-      }
 #else
 #error Unknown C++ compiler
 #endif
+      }
       /* Очистить список копий */
       copies.clear();
     }
     else {
       delete SAPI;
       std::cout << "Ошибка формата командной строки: неизвестный флаг '" << args.get_flag(i) << "'" << std::endl;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-      SetConsoleOutputCP(OldCP);
-#endif
-      return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+      return err_enum_t::ERROR_CMD_FORMAT;
     }
   }  
 
-  /** 7 Проверить ошибку отсутствия в комадной строке хотя бы одного файла STL или результирующего файла */
-  if (out_file.empty()) {
+  /** 4 Проверить ошибку отсутствия в комадной строке хотя бы одного файла STL или результирующего файла */
+  if (out_file.empty() && !SAPI->get_topology_only()) {
     delete SAPI;
     std::cout << "Ошибка формата командной строки: не указан результирующий файл" << std::endl;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-    SetConsoleOutputCP(OldCP);
-#endif
-    return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+    return err_enum_t::ERROR_CMD_FORMAT;
   }
 
   if (!input_present) {
     delete SAPI;
     std::cout << "Ошибка формата командной строки: не указан ни один файл STL" << std::endl;
+    return err_enum_t::ERROR_CMD_FORMAT;
+  }
+
+  /** 5 Сохранить выходной файл STEP (кроме режима записи только файлов топологии) */
+  err_enum_t err = SAPI->get_topology_only() ? err_enum_t::ERROR_OK : SAPI->save(out_file.c_str());
+  if (err != err_enum_t::ERROR_OK) {
+    delete SAPI;
+    return err;
+  }
+  if (stages != nullptr) SAPI->get_prof(*stages);
+
+  std::cout << "OK" << std::endl;
+  
+  /** 6 Вывести при необходимости результаты профилирования, записать трассировку и показатели */
+  /* Время этапов задания возвращается вызывающей стороне, а не выводится (формат вывода общий для потоков) */
+  if (stages == nullptr) SAPI->print_prof();
+  if ((!trace_file.empty() && (err = trace::write(trace_file)) != err_enum_t::ERROR_OK) ||
+      (!metrics_file.empty() && (err = metrics::write(metrics_file)) != err_enum_t::ERROR_OK)) {
+    delete SAPI;
+    return err;
+  }
+  
+  delete SAPI;
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Проверить директиву задания режима сервера или пакетного режима.
+ *
+ * Стандартный ввод занят потоком заданий сервера, а стандартный вывод - ответами на задания,
+ * поэтому задание не может читать файл STL со стандартного ввода или записывать в него.
+ * Трассировка, показатели обработки и аппаратные счётчики - общие для процесса, поэтому
+ * задания, выполняемые одновременно, не могут включать их каждое для себя: трассировка
+ * задаётся перед флагом 'server' или 'batch' для всех заданий, показатели и счётчики
+ * в этих режимах не собираются.
+ *
+ * \param [in] args разобранные директивы
+ * \param [in] i номер директивы
+ * \return true, если директива допустима в задании
+ */
+static bool check_job_directive(const arg_parser& args, size_t i) {
+  if ((args.get_flag(i).compare("stl") == 0 || args.get_flag(i).compare("out") == 0) &&
+      stl_input::is_stdin_name(args.get_parameters(i))) {
+    std::cout << "Ошибка формата задания: стандартный ввод и вывод недоступны заданию (имя '-' после флага '" << args.get_flag(i) << "')" << std::endl;
+    return false;
+  }
+  if (args.get_flag(i).compare("trace") == 0) {
+    std::cout << "Ошибка формата задания: флаг 'trace' допустим только перед флагом 'server' или 'batch' (трассировка всех заданий)" << std::endl;
+    return false;
+  }
+  if (args.get_flag(i).compare("metrics") == 0 || args.get_flag(i).compare("dh") == 0) {
+    std::cout << "Ошибка формата задания: флаг '" << args.get_flag(i) << "' недопустим в режиме сервера и пакетном режиме" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * \brief Выполнить задание режима сервера.
+ *
+ * \param [in] directives строка директив задания
+ * \param [out] stages время этапов обработки
+ * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+ */
+static err_enum_t convert_job(const std::string& directives, jobs::stages_t& stages) {
+  /* Строка задания разбирается так же, как командная строка из одного аргумента */
+  const char* cmdline[] = { "stl2step", directives.c_str() };
+  arg_parser args;
+  if (args.process_cmdline(cmdline, 2) != 0) return err_enum_t::ERROR_CMD_FORMAT;
+  for (size_t i = 0; i < args.get_arg_num(); ++i) {
+    if (!check_job_directive(args, i)) return err_enum_t::ERROR_CMD_FORMAT;
+  }
+  /* Область задания объединяет в трассировке всех заданий этапы одного задания */
+  trace::span job_span("job", "job");
+  job_span.arg("directives", directives);
+  /* Последний аргумент задания - имя результирующего файла (как последний аргумент командной строки) */
+  const std::vector<std::string>& last = args.get_parameters_set(args.get_arg_num() - 1);
+  return convert(args, last.empty() ? "--" + args.get_flag(args.get_arg_num() - 1) : last.back(), &stages);
+}
+
+/**
+ * \brief Функция, вызываемая при запуске исполняемого файла.
+ *
+ * \param [in] argc Количество аргументов-строк в командной строке.
+ * \param [in] argv Аргументы-строки в командной строке.
+ * \return код ошибки.
+ */
+int main(int argc, char* argv[])
+{
+  /** Алгоритм: */
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+  _CrtSetReportMode(_CRT_WARN, _CRTDBG_MODE_FILE);
+  _CrtSetReportFile(_CRT_WARN, _CRTDBG_FILE_STDOUT);
+  _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+  _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDOUT);
+  _CrtSetReportMode(_CRT_ASSERT, _CRTDBG_MODE_FILE);
+  _CrtSetReportFile(_CRT_ASSERT, _CRTDBG_FILE_STDOUT);
+#endif
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+//std::cout << "MSVC/MINGW32 version" << std::endl;
+  UINT OldCP = GetConsoleOutputCP();
+  SetConsoleOutputCP(CP_UTF8);
+#endif
+
+  /** 1 Сформировать список директив и их параметров из аргументов командной строки */
+  arg_parser args;
+  int err_parse = args.process_cmdline(const_cast<const char**>(argv), argc);
+   
+  /** 2 Проверить ошибку отсутствия аргументов программы */
+  if (err_parse == -2) {
+    print_help();
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    SetConsoleOutputCP(OldCP);
+#endif
+    return static_cast<int>(err_enum_t::ERROR_OK);
+  /** 3 Проверить ошибки разбора командной строки */
+  } else if (err_parse == -1) {
+    std::cout << "Ошибка формата командной строки: первый аргумент '" << args.get_flag(0) << "' не является флагом" << std::endl;
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    SetConsoleOutputCP(OldCP);
+#endif
+    return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+  } else if (err_parse == -3) {
+    std::cout << "Ошибка формата командной строки: первый аргумент '" << args.get_flag(0) << "' является пустым флагом" << std::endl;
 #if defined(_MSC_VER) || defined(__MINGW32__)
     SetConsoleOutputCP(OldCP);
 #endif
     return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
   }
 
-  /** 8 Сохранить выходной файл STEP */
-  err_enum_t err = SAPI->save(out_file.c_str());
+  /**
+   * 4 Выполнить задания со стандартного ввода (режим сервера) или из файла задания (пакетный режим);
+   * директивы перед флагом 'server' или 'batch' добавляются к каждому заданию (кроме трассировки,
+   * которая записывается одна для всех заданий)
+   */
+  for (size_t i = 0; i < args.get_arg_num(); ++i) {
+    const bool server = args.get_flag(i).compare("server") == 0;
+    if (!server && args.get_flag(i).compare("batch") != 0) continue;
+    const std::vector<std::string>& parms = args.get_parameters_set(i);
+    /* Количество исполнителей - единственный параметр флага 'server' или второй параметр флага 'batch' */
+    const size_t workers_parm = server ? 0 : 1;
+    if (parms.size() < workers_parm || parms.size() > workers_parm + 1 || i + 1 != args.get_arg_num() ||
+        (parms.size() == workers_parm + 1 && atoi(parms[workers_parm].c_str()) < 1)) {
+      if (server) {
+        std::cout << "Ошибка формата командной строки: после флага 'server' допустимо только количество исполнителей" << std::endl;
+      } else {
+        std::cout << "Ошибка формата командной строки: после флага 'batch' требуется файл задания и допустимо количество исполнителей" << std::endl;
+      }
+#if defined(_MSC_VER) || defined(__MINGW32__)
+      SetConsoleOutputCP(OldCP);
+#endif
+      return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+    }
+    std::string prefix, trace_file;
+    for (size_t j = 0; j < i; ++j) {
+      /* Трассировка перед флагом записывается одна для всех заданий */
+      if (args.get_flag(j).compare("trace") == 0) {
+        trace_file = args.get_parameters(j);
+        continue;
+      }
+      /* Недопустимая в задании директива перед флагом привела бы к ошибке каждого задания */
+      if (!check_job_directive(args, j)) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        SetConsoleOutputCP(OldCP);
+#endif
+        return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+      }
+      prefix += (j == 0 ? "--" : " --") + args.get_flag(j);
+      if (!args.get_parameters(j).empty()) prefix += " " + args.get_parameters(j);
+    }
+    unsigned workers = std::thread::hardware_concurrency() == 0 ? 1 : std::thread::hardware_concurrency();
+    if (parms.size() == workers_parm + 1) workers = static_cast<unsigned>(atoi(parms[workers_parm].c_str()));
+    if (!trace_file.empty()) trace::enable();
+    err_enum_t err = server ? jobs::serve(convert_job, prefix, workers) : jobs::batch(convert_job, prefix, parms[0], workers);
+    if (!trace_file.empty()) {
+      err_enum_t trace_err = trace::write(trace_file);
+      if (err == err_enum_t::ERROR_OK) err = trace_err;
+    }
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    SetConsoleOutputCP(OldCP);
+#endif
+    return static_cast<int>(err);
+  }
+
+  /** 5 Выполнить преобразование */
+  err_enum_t err = convert(args, argv[argc - 1], nullptr);
   if (err != err_enum_t::ERROR_OK) {
-    delete SAPI;
 #if defined(_MSC_VER) || defined(__MINGW32__)
     SetConsoleOutputCP(OldCP);
 #endif
     return static_cast<int>(err);
   }
 
-  std::cout << "OK" << std::endl;
-  
-  /** 9 Вывести при необходимости результаты профилирования */
-  SAPI->print_prof();
-  
-  delete SAPI;
+  /** 6 Вывести выделение памяти по этапам и типам экземпляров STEP (при сборке с ALLOC_TRACKING) */
+  alloc::report();
 
 #if defined(_MSC_VER) && defined(_DEBUG)
   if (_CrtDumpMemoryLeaks()) {
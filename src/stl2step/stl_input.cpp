@@ -0,0 +1,572 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями методов класса чтения входного файла STL,
+ * в том числе сжатого (gzip) или упакованного в архив zip
+ */
+
+#include "stdafx.h"
+#if defined(USE_ZLIB)
+# include <zlib.h>
+#endif
+#include "err.h"
+#include "stl_input.h"
+
+/** \brief Сигнатура локального заголовка файла в архиве zip */
+#define ZIP_LOCAL_SIG   0x04034b50
+/** \brief Сигнатура записи центрального каталога архива zip */
+#define ZIP_CENTRAL_SIG 0x02014b50
+/** \brief Сигнатура конца центрального каталога архива zip */
+#define ZIP_END_SIG     0x06054b50
+
+/**
+ * \brief Прочитать 16-битное число в порядке little-endian.
+ *
+ * \param [in] p адрес числа
+ * \return число
+ */
+static unsigned get16(const unsigned char* p) {
+  return static_cast<unsigned>(p[0]) | (static_cast<unsigned>(p[1]) << 8);
+}
+
+/**
+ * \brief Прочитать 32-битное число в порядке little-endian.
+ *
+ * \param [in] p адрес числа
+ * \return число
+ */
+static unsigned long get32(const unsigned char* p) {
+  return static_cast<unsigned long>(get16(p)) | (static_cast<unsigned long>(get16(p + 2)) << 16);
+}
+
+/**
+ * \brief Установить позицию в файле (в том числе за пределами 2 Гбайт).
+ *
+ * \param [in] f файл
+ * \param [in] pos позиция от начала файла (отрицательная - от конца файла)
+ * \return true в случае успешного завершения
+ */
+static bool file_seek(FILE* f, long long pos) {
+  int whence = (pos < 0) ? SEEK_END : SEEK_SET;
+#if defined(_MSC_VER) || defined(__MINGW32__)
+  return _fseeki64(f, pos, whence) == 0;
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  return fseeko(f, static_cast<off_t>(pos), whence) == 0;
+#else
+# error Unknown C++ compiler
+#endif
+}
+
+/**
+ * \brief Получить размер файла.
+ *
+ * \param [in] f файл
+ * \return размер файла или -1 в случае ошибки
+ */
+static long long file_size(FILE* f) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+  if (_fseeki64(f, 0, SEEK_END) != 0) return -1;
+  return _ftelli64(f);
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  if (fseeko(f, 0, SEEK_END) != 0) return -1;
+  return static_cast<long long>(ftello(f));
+#else
+# error Unknown C++ compiler
+#endif
+}
+
+/**
+ * \brief Открыть файл для чтения в двоичном режиме.
+ *
+ * \param [in] name имя файла
+ * \return файл или nullptr
+ */
+static FILE* open_binary(const std::string& name) {
+  FILE* f;
+#if defined(_MSC_VER)
+  if (fopen_s(&f, name.c_str(), "rb") != 0) return nullptr;
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+  f = fopen(name.c_str(), "rb");
+#else
+# error Unknown C++ compiler
+#endif
+  return f;
+}
+
+/**
+ * \brief Проверить окончание строки без учёта регистра.
+ *
+ * \param [in] name строка
+ * \param [in] ext окончание (в нижнем регистре)
+ * \return true, если строка заканчивается на ext
+ */
+static bool ends_with_nocase(const std::string& name, const char* ext) {
+  size_t len = strlen(ext);
+  if (name.size() < len) return false;
+  for (size_t i = 0; i < len; ++i) {
+    if (tolower(static_cast<unsigned char>(name[name.size() - len + i])) != ext[i]) return false;
+  }
+  return true;
+}
+
+/**
+ * \brief Сопоставить имя с маской (символы '*' и '?', без учёта регистра).
+ *
+ * \param [in] mask маска
+ * \param [in] name имя
+ * \return true, если имя соответствует маске
+ */
+static bool mask_match(const char* mask, const char* name) {
+  for (; *mask != '\0'; ++mask, ++name) {
+    if (*mask == '*') {
+      for (const char* n = name;; ++n) {
+        if (mask_match(mask + 1, n)) return true;
+        if (*n == '\0') return false;
+      }
+    }
+    if (*name == '\0') return false;
+    if (*mask != '?' && tolower(static_cast<unsigned char>(*mask)) != tolower(static_cast<unsigned char>(*name))) return false;
+  }
+  return *name == '\0';
+}
+
+/**
+ * \file
+ * Функции, являющиеся методами класса \ref stl_input "stl_input":
+ * <BR>
+ */
+
+/**
+ * \file
+ * * \copybrief stl_input::stl_input()
+ */
+stl_input::stl_input() :
+  in(nullptr), buffered(false), packed(false), stream_end(false), zs(nullptr), remain(-1), opos(0), olen(0), eof(false), failed(false) {
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::~stl_input()
+ */
+stl_input::~stl_input() {
+  close();
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::compression_supported()
+ */
+bool stl_input::compression_supported() {
+#if defined(USE_ZLIB)
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::is_zip_name(const std::string&)
+ */
+bool stl_input::is_zip_name(const std::string& name) {
+  return ends_with_nocase(name, ".zip");
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::is_gzip_name(const std::string&)
+ */
+bool stl_input::is_gzip_name(const std::string& name) {
+  return ends_with_nocase(name, ".gz");
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::split_zip_name(const std::string&, std::string&, std::string&)
+ */
+bool stl_input::split_zip_name(const std::string& name, std::string& archive, std::string& member) {
+  for (size_t pos = 0; pos < name.size(); ++pos) {
+    if (name[pos] != '/' && name[pos] != '\\') continue;
+    if (!is_zip_name(name.substr(0, pos))) continue;
+
+    /** Архив должен существовать как обычный файл */
+    FILE* f = open_binary(name.substr(0, pos));
+    if (f == nullptr) continue;
+    fclose(f);
+
+    archive = name.substr(0, pos);
+    member = name.substr(pos + 1);
+    std::replace(member.begin(), member.end(), '\\', '/');
+    return true;
+  }
+  return false;
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::list_zip(const std::string&, const std::string&, std::vector<zip_entry>&)
+ */
+err_enum_t stl_input::list_zip(const std::string& archive, const std::string& mask, std::vector<zip_entry>& entries) {
+  entries.clear();
+
+  FILE* f = open_binary(archive);
+  if (f == nullptr) return err_enum_t::ERROR_FILE_IO;
+
+  /** Найти запись конца центрального каталога (в конце архива, перед комментарием до 64 Кбайт) */
+  long long size = file_size(f);
+  long long tail = std::min(size, 22LL + 65535LL);
+  std::vector<unsigned char> buf(tail > 0 ? static_cast<size_t>(tail) : 0);
+  if (size < 22 || !file_seek(f, size - tail) || fread(buf.data(), 1, buf.size(), f) != buf.size()) {
+    fclose(f);
+    return err_enum_t::ERROR_FILE_IO;
+  }
+  long long end_pos = -1;
+  for (long long i = tail - 22; i >= 0; --i) {
+    if (get32(&buf[static_cast<size_t>(i)]) == ZIP_END_SIG) {
+      end_pos = i;
+      break;
+    }
+  }
+  if (end_pos < 0) {
+    fclose(f);
+    return err_enum_t::ERROR_FILE_IO;
+  }
+  const unsigned char* e = &buf[static_cast<size_t>(end_pos)];
+  unsigned entries_num = get16(e + 10);
+  unsigned long cd_size = get32(e + 12);
+  unsigned long cd_offset = get32(e + 16);
+
+  /** Архивы zip64 не поддерживаются */
+  if (entries_num == 0xFFFF || cd_size == 0xFFFFFFFFUL || cd_offset == 0xFFFFFFFFUL) {
+    fclose(f);
+    return err_enum_t::ERROR_FILE_IO;
+  }
+
+  std::vector<unsigned char> cd(cd_size);
+  if (!file_seek(f, static_cast<long long>(cd_offset)) || fread(cd.data(), 1, cd.size(), f) != cd.size()) {
+    fclose(f);
+    return err_enum_t::ERROR_FILE_IO;
+  }
+  fclose(f);
+
+  size_t pos = 0;
+  for (unsigned i = 0; i < entries_num; ++i) {
+    if (pos + 46 > cd.size() || get32(&cd[pos]) != ZIP_CENTRAL_SIG) return err_enum_t::ERROR_FILE_IO;
+    const unsigned char* c = &cd[pos];
+    size_t name_len = get16(c + 28);
+    size_t next = pos + 46 + name_len + get16(c + 30) + get16(c + 32);
+    if (next > cd.size()) return err_enum_t::ERROR_FILE_IO;
+
+    zip_entry entry;
+    entry.name.assign(reinterpret_cast<const char*>(c + 46), name_len);
+    entry.flags = get16(c + 8);
+    entry.method = get16(c + 10);
+    entry.crc = get32(c + 16);
+    entry.packed_size = static_cast<long long>(get32(c + 20));
+    entry.offset = static_cast<long long>(get32(c + 42));
+    pos = next;
+
+    /** Каталоги пропускаются */
+    if (entry.name.empty() || entry.name[entry.name.size() - 1] == '/') continue;
+    if (!mask_match(mask.c_str(), entry.name.c_str())) continue;
+    entries.push_back(entry);
+  }
+
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Найти файл в архиве zip и открыть архив на начале сжатых данных этого файла.
+ *
+ * \param [in] archive имя архива
+ * \param [in] member имя файла в архиве
+ * \param [out] entry сведения о файле в архиве
+ * \return архив, позиция чтения которого установлена на начало данных файла, или nullptr,
+ * если архив не удалось прочитать или в нём нет такого файла
+ */
+static FILE* open_zip_data(const std::string& archive, const std::string& member, stl_input::zip_entry& entry) {
+  std::vector<stl_input::zip_entry> entries;
+  if (stl_input::list_zip(archive, "*", entries) != err_enum_t::ERROR_OK) {
+    std::cout << "ERROR (import): can't read zip archive '" << archive << "'" << std::endl;
+    return nullptr;
+  }
+
+  auto it = entries.cbegin();
+  for (; it != entries.cend(); ++it) {
+    if ((*it).name.compare(member) == 0) break;
+  }
+  if (it == entries.cend()) return nullptr;
+  entry = *it;
+
+  /** Данные файла следуют за локальным заголовком, длина которого известна только из него самого */
+  FILE* f = open_binary(archive);
+  if (f == nullptr) return nullptr;
+  unsigned char h[30];
+  if (!file_seek(f, entry.offset) || fread(h, 1, sizeof(h), f) != sizeof(h) || get32(h) != ZIP_LOCAL_SIG ||
+      !file_seek(f, entry.offset + 30 + get16(h + 26) + get16(h + 28))) {
+    fclose(f);
+    return nullptr;
+  }
+  return f;
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::open_zip_member(const std::string&, const std::string&)
+ */
+err_enum_t stl_input::open_zip_member(const std::string& archive, const std::string& member) {
+  zip_entry entry;
+  in = open_zip_data(archive, member, entry);
+  if (in == nullptr) return err_enum_t::ERROR_FILE_IO;
+
+  if ((entry.flags & 1) != 0 || (entry.method != 0 && entry.method != 8) ||
+      (entry.method == 8 && !compression_supported())) {
+    std::cout << "ERROR (import): unsupported compression of '" << member << "' in zip archive '" << archive << "'" << std::endl;
+    close();
+    return err_enum_t::ERROR_FILE_IO;
+  }
+
+  buffered = true;
+  packed = (entry.method == 8);
+  remain = entry.packed_size;
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::content_hash(const std::string&, uint64_t&, long long&)
+ */
+err_enum_t stl_input::content_hash(const std::string& name, uint64_t& hash, long long& size) {
+  if (is_stdin_name(name)) return err_enum_t::ERROR_FILE_IO;
+
+  /** FNV-1a: начальное значение и простое число */
+  hash = 0xCBF29CE484222325ULL;
+  const uint64_t prime = 0x100000001B3ULL;
+  size = 0;
+
+  /** Для файла из архива zip хешируются только его сведения и сжатые данные */
+  std::string archive, member;
+  const bool in_zip = split_zip_name(name, archive, member);
+  zip_entry entry;
+  FILE* f = in_zip ? open_zip_data(archive, member, entry) : open_binary(name);
+  if (f == nullptr) return err_enum_t::ERROR_FILE_IO;
+
+  if (in_zip) {
+    for (auto it = member.cbegin(); it != member.cend(); ++it) {
+      hash = (hash ^ static_cast<unsigned char>(*it)) * prime;
+    }
+    const uint32_t info[2] = { entry.method, entry.crc };
+    for (size_t i = 0; i < 2; ++i) {
+      for (size_t k = 0; k < 4; ++k) {
+        hash = (hash ^ ((info[i] >> (8 * k)) & 0xFF)) * prime;
+      }
+    }
+  }
+
+  /** Для файла из архива zip читается не больше, чем занимают его сжатые данные */
+  long long left = in_zip ? entry.packed_size : -1;
+  std::vector<unsigned char> buf(BUF_SIZE);
+  size_t n;
+  while (left != 0 &&
+    (n = fread(buf.data(), 1, (left < 0 || left > static_cast<long long>(buf.size())) ? buf.size() : static_cast<size_t>(left), f)) > 0) {
+    for (size_t i = 0; i < n; ++i) {
+      hash = (hash ^ buf[i]) * prime;
+    }
+    size += static_cast<long long>(n);
+    if (left > 0) left -= static_cast<long long>(n);
+  }
+  const bool failed = ferror(f) != 0 || left > 0;
+  fclose(f);
+  if (failed) return err_enum_t::ERROR_FILE_IO;
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::open(const std::string&)
+ */
+err_enum_t stl_input::open(const std::string& name) {
+  close();
+  buffered = false;
+  packed = false;
+  stream_end = false;
+  remain = -1;
+  opos = olen = 0;
+  eof = false;
+  failed = false;
+
+  /** Стандартный ввод читается построчно по мере поступления данных от другой программы */
+  if (is_stdin_name(name)) {
+    in = stdin;
+    return err_enum_t::ERROR_OK;
+  }
+
+  std::string archive, member;
+  if (split_zip_name(name, archive, member)) {
+    err_enum_t err = open_zip_member(archive, member);
+    if (err != err_enum_t::ERROR_OK) return err;
+  }
+  else
+  if (is_gzip_name(name)) {
+    if (!compression_supported()) {
+      std::cout << "ERROR (import): reading of compressed file '" << name << "' is not supported (built without zlib)" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    in = open_binary(name);
+    if (in == nullptr) return err_enum_t::ERROR_FILE_IO;
+    buffered = true;
+    packed = true;
+  }
+  else {
+    /** Обычный файл читается в текстовом режиме, как и раньше */
+#if defined(_MSC_VER)
+    errno_t ferr = fopen_s(&in, name.c_str(), "rt");
+    if (ferr != 0 || in == nullptr) return err_enum_t::ERROR_FILE_IO;
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+    in = fopen(name.c_str(), "rt");
+    if (in == nullptr) return err_enum_t::ERROR_FILE_IO;
+#else
+# error Unknown C++ compiler
+#endif
+    return err_enum_t::ERROR_OK;
+  }
+
+  obuf.resize(BUF_SIZE);
+#if defined(USE_ZLIB)
+  if (packed) {
+    ibuf.resize(BUF_SIZE);
+    zs = new z_stream_s();
+    /** windowBits -15 - данные deflate в архиве zip, 15 + 32 - автоопределение заголовка gzip/zlib */
+    if (inflateInit2(zs, (remain >= 0) ? -15 : 15 + 32) != Z_OK) {
+      delete zs;
+      zs = nullptr;
+      close();
+      return err_enum_t::ERROR_FILE_IO;
+    }
+  }
+#endif
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::read_raw(char*, size_t)
+ */
+size_t stl_input::read_raw(char* buf, size_t size) {
+  if (remain >= 0 && static_cast<long long>(size) > remain) size = static_cast<size_t>(remain);
+  if (size == 0) return 0;
+  size_t n = fread(buf, 1, size, in);
+  if (n < size && ferror(in)) failed = true;
+  if (remain >= 0) {
+    remain -= static_cast<long long>(n);
+    /** Архив оборван посреди файла */
+    if (n < size) failed = true;
+  }
+  return n;
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::fill()
+ */
+bool stl_input::fill() {
+  opos = 0;
+  olen = 0;
+  if (eof) return false;
+
+  if (!packed) {
+    olen = read_raw(obuf.data(), obuf.size());
+    if (olen == 0) eof = true;
+    return olen > 0;
+  }
+
+#if defined(USE_ZLIB)
+  while (olen == 0) {
+    if (zs->avail_in == 0) {
+      size_t n = read_raw(ibuf.data(), ibuf.size());
+      if (n == 0) {
+        /** Сжатые данные закончились раньше конца потока */
+        if (!stream_end) failed = true;
+        eof = true;
+        return false;
+      }
+      zs->next_in = reinterpret_cast<Bytef*>(ibuf.data());
+      zs->avail_in = static_cast<uInt>(n);
+    }
+    zs->next_out = reinterpret_cast<Bytef*>(obuf.data());
+    zs->avail_out = static_cast<uInt>(obuf.size());
+    int ret = inflate(zs, Z_NO_FLUSH);
+    olen = obuf.size() - zs->avail_out;
+    if (ret == Z_STREAM_END) {
+      stream_end = true;
+      /** Файл в архиве zip - один поток, gzip может состоять из нескольких потоков подряд */
+      if (remain >= 0) {
+        eof = true;
+        return olen > 0;
+      }
+      inflateReset(zs);
+    }
+    else
+    if (ret == Z_OK || ret == Z_BUF_ERROR) {
+      if (olen > 0) stream_end = false;
+    }
+    else {
+      /** Мусор после последнего потока gzip игнорируется, как и утилитой gzip */
+      if (!stream_end || olen > 0) failed = true;
+      eof = true;
+      return olen > 0;
+    }
+  }
+  return true;
+#else
+  failed = true;
+  eof = true;
+  return false;
+#endif
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::gets(char*, int)
+ */
+char* stl_input::gets(char* buf, int size) {
+  if (in == nullptr || size <= 0) return nullptr;
+  if (!buffered) return fgets(buf, size, in);
+
+  size_t len = 0;
+  const size_t max_len = static_cast<size_t>(size) - 1;
+  while (len < max_len) {
+    if (opos == olen && !fill()) break;
+    size_t n = std::min(olen - opos, max_len - len);
+    const char* p = obuf.data() + opos;
+    const char* nl = static_cast<const char*>(memchr(p, '\n', n));
+    if (nl != nullptr) n = static_cast<size_t>(nl - p) + 1;
+    memcpy(buf + len, p, n);
+    len += n;
+    opos += n;
+    if (nl != nullptr) break;
+  }
+  if (len == 0) return nullptr;
+  buf[len] = '\0';
+  return buf;
+}
+
+/**
+ * \file
+ * * \copybrief stl_input::close()
+ */
+void stl_input::close() {
+#if defined(USE_ZLIB)
+  if (zs != nullptr) {
+    inflateEnd(zs);
+    delete zs;
+    zs = nullptr;
+  }
+#endif
+  if (in != nullptr) {
+    if (in != stdin) fclose(in);
+    in = nullptr;
+  }
+  ibuf.clear();
+  obuf.clear();
+}
@@ -0,0 +1,238 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлением класса чтения входного файла STL,
+ * в том числе сжатого (gzip) или упакованного в архив zip
+ */
+
+#ifndef _STL_INPUT_H
+#define _STL_INPUT_H
+
+#include "err.h"
+
+struct z_stream_s;
+
+/**
+ * \brief Класс построчного чтения входного файла STL.
+ *
+ * Обычный файл (в том числе именованный канал) и стандартный ввод (имя "-")
+ * читаются функцией fgets по мере поступления данных. Файл, сжатый gzip
+ * (с расширением .gz), и файл из архива zip (имя вида "архив.zip/файл.stl")
+ * распаковываются по мере чтения строк, без создания временных файлов.
+ */
+class stl_input {
+
+private:
+
+  /** \brief Размер буферов сжатых и распакованных данных */
+  static const size_t BUF_SIZE = 256 * 1024;
+
+  /** \brief Файл (или архив) */
+  FILE* in; //-V122_NOPTR
+
+  /** \brief Данные читаются через буфер (иначе - обычный файл читается функцией fgets) */
+  bool buffered;
+
+  /** \brief Данные файла сжаты (gzip или deflate в архиве zip) */
+  bool packed;
+
+  /** \brief Последний поток сжатых данных распакован полностью */
+  bool stream_end;
+
+  /** \brief Состояние распаковки или nullptr */
+  z_stream_s* zs;
+
+  /** \brief Количество байт сжатых данных, которые ещё предстоит прочитать (-1 - до конца файла) */
+  long long remain;
+
+  /** \brief Буфер сжатых данных */
+  std::vector<char> ibuf;
+
+  /** \brief Буфер распакованных данных */
+  std::vector<char> obuf;
+
+  /** \brief Позиция чтения в буфере распакованных данных */
+  size_t opos;
+
+  /** \brief Количество байт в буфере распакованных данных */
+  size_t olen;
+
+  /** \brief Распакованы все данные */
+  bool eof;
+
+  /** \brief Признак ошибки чтения или распаковки */
+  bool failed;
+
+  /**
+   * \brief Прочитать данные из файла (с учётом границы файла в архиве).
+   *
+   * \param [out] buf буфер
+   * \param [in] size размер буфера
+   * \return количество прочитанных байт
+   */
+  size_t read_raw(char* buf, size_t size);
+
+  /**
+   * \brief Заполнить буфер распакованных данных.
+   * \return true, если в буфере есть данные
+   */
+  bool fill();
+
+  /**
+   * \brief Открыть файл из архива zip.
+   *
+   * \param [in] archive имя архива
+   * \param [in] member имя файла в архиве
+   * \retval err_enum_t::ERROR_FILE_IO если файл не удалось открыть;
+   * \retval err_enum_t::ERROR_OK в случае успешного завершения.
+   */
+  err_enum_t open_zip_member(const std::string& archive, const std::string& member);
+
+public:
+
+  /**
+   * \brief Сведения о файле в архиве zip
+   */
+  struct zip_entry {
+    /** \brief Имя файла в архиве */
+    std::string name;
+    /** \brief Метод сжатия (0 - без сжатия, 8 - deflate) */
+    unsigned method;
+    /** \brief Признаки (бит 0 - файл зашифрован) */
+    unsigned flags;
+    /** \brief Контрольная сумма CRC-32 распакованных данных */
+    uint32_t crc;
+    /** \brief Размер сжатых данных */
+    long long packed_size;
+    /** \brief Смещение локального заголовка файла в архиве */
+    long long offset;
+  };
+
+  /**
+   * \brief Конструктор по умолчанию
+   */
+  stl_input();
+
+  /**
+   * \brief Деструктор. Закрывает файл, если он не был закрыт.
+   */
+  ~stl_input();
+
+  stl_input(const stl_input&) = delete;
+  stl_input& operator=(const stl_input&) = delete;
+
+  /**
+   * \brief Проверить, поддерживается ли чтение сжатых файлов.
+   * \return true, если программа собрана с библиотекой zlib
+   */
+  static bool compression_supported();
+
+  /**
+   * \brief Проверить, обозначает ли имя стандартный ввод.
+   *
+   * \param [in] name имя файла
+   * \return true для имени "-"
+   */
+  static bool is_stdin_name(const std::string& name) {
+    return name.compare("-") == 0;
+  }
+
+  /**
+   * \brief Проверить, является ли файл архивом zip (по расширению).
+   *
+   * \param [in] name имя файла
+   * \return true для расширения .zip
+   */
+  static bool is_zip_name(const std::string& name);
+
+  /**
+   * \brief Проверить, является ли файл сжатым gzip (по расширению).
+   *
+   * \param [in] name имя файла
+   * \return true для расширения .gz
+   */
+  static bool is_gzip_name(const std::string& name);
+
+  /**
+   * \brief Разделить имя вида "архив.zip/файл.stl" на имя архива и имя файла в архиве.
+   *
+   * \param [in] name имя файла
+   * \param [out] archive имя архива
+   * \param [out] member имя файла в архиве
+   * \return true, если имя указывает на файл в существующем архиве zip
+   */
+  static bool split_zip_name(const std::string& name, std::string& archive, std::string& member);
+
+  /**
+   * \brief Проверить, требует ли файл распаковки при чтении.
+   *
+   * \param [in] name имя файла
+   * \return true для файлов gzip и файлов из архивов zip
+   */
+  static bool is_packed_name(const std::string& name) {
+    std::string archive, member;
+    return is_gzip_name(name) || split_zip_name(name, archive, member);
+  }
+
+  /**
+   * \brief Получить список файлов архива zip, имена которых соответствуют маске.
+   *
+   * \param [in] archive имя архива
+   * \param [in] mask маска имени файла (символы '*' и '?', без учёта регистра)
+   * \param [out] entries список файлов в порядке следования в архиве
+   * \retval err_enum_t::ERROR_FILE_IO если архив не удалось прочитать;
+   * \retval err_enum_t::ERROR_OK в случае успешного завершения.
+   */
+  static err_enum_t list_zip(const std::string& archive, const std::string& mask, std::vector<zip_entry>& entries);
+
+  /**
+   * \brief Вычислить хеш содержимого файла (FNV-1a, 64 бита) для поиска результатов
+   * его обработки в кэше.
+   *
+   * Хешируются байты файла в том виде, в каком он хранится на диске (сжатый файл не
+   * распаковывается). Для файла из архива zip хешируются только его имя, метод сжатия,
+   * контрольная сумма и сжатые данные, поэтому изменение других файлов архива не
+   * изменяет хеш, а время хеширования не зависит от размера архива.
+   *
+   * \param [in] name имя файла
+   * \param [out] hash хеш содержимого
+   * \param [out] size размер хешированных данных, байт
+   * \retval err_enum_t::ERROR_FILE_IO если файл не удалось прочитать или это стандартный ввод;
+   * \retval err_enum_t::ERROR_OK в случае успешного завершения.
+   */
+  static err_enum_t content_hash(const std::string& name, uint64_t& hash, long long& size);
+
+  /**
+   * \brief Открыть файл для чтения.
+   *
+   * \param [in] name имя файла (файл в архиве zip задаётся именем "архив.zip/файл.stl",
+   * стандартный ввод - именем "-")
+   * \retval err_enum_t::ERROR_FILE_IO если файл не удалось открыть;
+   * \retval err_enum_t::ERROR_OK в случае успешного завершения.
+   */
+  err_enum_t open(const std::string& name);
+
+  /**
+   * \brief Прочитать строку (аналог fgets).
+   *
+   * \param [out] buf буфер строки
+   * \param [in] size размер буфера
+   * \return buf или nullptr в конце файла или в случае ошибки
+   */
+  char* gets(char* buf, int size);
+
+  /**
+   * \brief Проверить, произошла ли ошибка чтения или распаковки.
+   * \return true в случае ошибки
+   */
+  bool error() const {
+    return failed;
+  }
+
+  /**
+   * \brief Закрыть файл.
+   */
+  void close();
+};
+
+#endif /* _STL_INPUT_H */
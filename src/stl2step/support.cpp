@@ -9,6 +9,14 @@
 #include "err.h"
 #include "shell.h"
 #include "support.h"
+#include "brep_writer.h"
+#include "step_output.h"
+#include "stl_input.h"
+#include "topology.h"
+#include "trace.h"
+#include "metrics.h"
+#include "jobs.h"
+#include "alloc_tracker.h"
 
  /**
   * \brief Напечатать символ в качестве индикатора прогресса.
@@ -17,90 +25,150 @@
   * \param [in] s кратность вывода
   */
 static void print_dot(char symbol, int s) {
-  static int l = 0;
+  static std::atomic<int> l(0);
 
-  if ((l % s) == 0) {
+  /** Индикатор не выводится, пока задания режима сервера или пакетного режима выполняются одновременно */
+  if (jobs::active()) return;
+  if ((l++ % s) == 0) {
     std::cout.flush();
     std::setvbuf(stdout, nullptr, _IONBF, 0);
     std::cout << symbol;
     std::setvbuf(stdout, nullptr, _IOLBF, 4 * 1024);
   }
-  l++;
 }
 
-#if defined(__MINGW32__)
-# include <windows.h>
-
-  typedef union _UFILETIME {
-    uint64_t   u64;
-    FILETIME ft;
-  } UFILETIME;
+/**
+ * \brief Перевести время из наносекунд в миллисекунды.
+ *
+ * \param [in] ns время, нс
+ * \return время, мс
+ */
+static double to_ms(uint64_t ns) {
+  return static_cast<double>(ns) / 1.E6;
+}
 
-# ifndef POW10_9
-#  define POW10_9                 1000000000
-# endif
+/**
+ * \brief Вывести строку результатов профилирования.
+ *
+ * \param [in] title название этапа (с выравнивающими пробелами)
+ * \param [in] time время этапа, нс
+ * \param [in] full_time полное время обработки, нс
+ */
+static void print_prof_line(const char* title, uint64_t time, uint64_t full_time) {
+  if (time == 0) return;
+  std::cout << title << std::setw(12) << std::fixed << std::setprecision(3) << to_ms(time) << " ms (" <<
+    std::setprecision(2) << 100.0 * static_cast<double>(time) / static_cast<double>(full_time) << "%)" << std::endl;
+}
 
-# ifndef POW10_7
-#  define POW10_7                 10000000
-# endif
+/**
+ * \brief Вывести строку результатов измерения аппаратных счётчиков процессора:
+ * такты и команды (в миллионах), команд за такт, промахи кэша и ошибки предсказания
+ * переходов на тысячу команд.
+ *
+ * \param [in] title название этапа (с выравнивающими пробелами)
+ * \param [in] c изменения счётчиков за этап
+ */
+static void print_hw_line(const char* title, const perf::counts& c) {
+  const double cycles = static_cast<double>(c.values[0]);
+  const double instructions = static_cast<double>(c.values[1]);
+  if (instructions == 0.0) return;
+  std::cout << title << std::fixed << std::setprecision(2) <<
+    std::setw(10) << cycles / 1.E6 <<
+    std::setw(10) << instructions / 1.E6 <<
+    std::setw(7) << (cycles > 0.0 ? instructions / cycles : 0.0) <<
+    std::setw(10) << 1000.0 * static_cast<double>(c.values[2]) / instructions <<
+    std::setw(10) << 1000.0 * static_cast<double>(c.values[3]) / instructions << std::endl;
+}
 
-# ifndef DELTA_EPOCH_IN_100NS
-#  define DELTA_EPOCH_IN_100NS INT64_C(116444736000000000)
-# endif
-#endif
+/** \brief Количество уникальных имён в одной части массива S, отображаемой одним потоком */
+static const size_t SAVE_CHUNK = 1024;
 
 /**
- * \brief Получить системное время в миллисекундах.
- *
- * \return системное время
+ * \brief Общие данные потоков, параллельно отображающих части массива S.
  */
-static uint64_t get_sys_time(void) {
-#if defined(_MSC_VER)
-  SYSTEMTIME systime;
-  FILETIME filetime;
+struct save_chunks {
+
+  /** \brief Отображаемые объекты */
+  const std::vector<const express::STEP_ENTITY*>& S;
+
+  /** \brief Индексы первых объектов частей, последний элемент равен размеру массива S */
+  const std::vector<size_t>& bounds;
+
+  /** \brief Количество частей */
+  const size_t chunks_num;
+
+  /** \brief Наибольшее количество отображённых, но ещё не записанных частей */
+  const size_t window;
+
+  /** \brief Номер следующей части, которую возьмёт свободный поток */
+  std::atomic<size_t> next;
 
-  GetSystemTime(&systime);
-  if (!SystemTimeToFileTime(&systime, &filetime)) {
-    return 0;
+  /** \brief Блокировка для ready, text и written */
+  std::mutex m;
+
+  /** \brief Сигнал о готовности очередной части */
+  std::condition_variable cv_ready;
+
+  /** \brief Сигнал о записи очередной части в файл */
+  std::condition_variable cv_space;
+
+  /** \brief Признаки готовности частей */
+  std::vector<char> ready;
+
+  /** \brief Тексты отображённых частей */
+  std::vector<std::string> text;
+
+  /** \brief Количество записанных в файл частей */
+  size_t written;
+
+  /**
+   * \brief Конструктор из параметров
+   *
+   * \param [in] s отображаемые объекты
+   * \param [in] Bounds индексы первых объектов частей
+   * \param [in] Window наибольшее количество отображённых, но ещё не записанных частей
+   */
+  save_chunks(const std::vector<const express::STEP_ENTITY*>& s, const std::vector<size_t>& Bounds, size_t Window) :
+    S(s), bounds(Bounds), chunks_num(Bounds.size() - 1), window(Window), next(0),
+    ready(Bounds.size() - 1, 0), text(Bounds.size() - 1), written(0) {
   }
+};
 
-  union {
-    uint64_t qword;
-    struct {
-      uint32_t low;
-      uint32_t high;
-    } dword;
-  } ns_since_1601 = { 0 };
-
-  // copy the result into the ULARGE_INTEGER; this is actually
-  // copying the result into the ns_since_1601 int64_t.
-  ns_since_1601.dword.low = filetime.dwLowDateTime;
-  ns_since_1601.dword.high = filetime.dwHighDateTime;
-
-  // Compute the number of milliseconds since 1601; we have to
-  // divide by 10,000, since the current value is the number of 100ns
-  // intervals since 1601, not ms.
-  return (ns_since_1601.qword / 10000);
-#elif defined(__GNUC__) || defined(__DOXYGEN__)
+/**
+ * \brief Функция потока, отображающего части массива S.
+ *
+ * Поток берёт очередную часть, пока их количество, ожидающее записи, не превышает окна.
+ *
+ * \param [in,out] ctx общие данные потоков
+ */
+static void format_chunks(save_chunks* ctx) {
+  const unsigned alloc_prev = alloc::push_stage("save");
+  for (;;) {
+    const size_t c = ctx->next.fetch_add(1);
+    if (c >= ctx->chunks_num) break;
 
-# if defined(__MINGW32__)
-  UFILETIME ct;
-  struct timespec spec;
-  GetSystemTimeAsFileTime(&ct.ft);
-  uint64_t t = ct.u64 - DELTA_EPOCH_IN_100NS;
-  spec.tv_sec = t / POW10_7;
-  spec.tv_nsec = ((int) (t % POW10_7)) * 100;
-  return spec.tv_sec * 1000 + spec.tv_nsec / 1000000;
-# else
-  struct timespec spec;
-  clock_gettime(CLOCK_REALTIME, &spec);
-  return spec.tv_sec * 1000 + spec.tv_nsec / 1000000;
-# endif
+    {
+      std::unique_lock<std::mutex> lock(ctx->m);
+      while (c >= ctx->written + ctx->window) ctx->cv_space.wait(lock);
+    }
 
-#else
-  #error Unknown C++ compiler
-#endif
+    std::string text;
+    for (size_t i = ctx->bounds[c]; i < ctx->bounds[c + 1]; ++i) {
+      {
+        alloc::entity_scope tag(typeid(*ctx->S[i]).name(), false);
+        text += ctx->S[i]->print();
+      }
+      text += express::STEP_CRLF;
+    }
 
+    {
+      std::lock_guard<std::mutex> lock(ctx->m);
+      ctx->text[c].swap(text);
+      ctx->ready[c] = 1;
+    }
+    ctx->cv_ready.notify_all();
+  }
+  alloc::pop_stage(alloc_prev);
 }
 
 namespace express {
@@ -110,6 +178,8 @@ namespace express {
     g_name(name),
 
     start_full_time(0),
+    importing(0),
+    welding(0),
     optim_faces_time1(0),
     optim_faces_time2(0),
     optim_faces_time3(0),
@@ -124,13 +194,29 @@ namespace express {
     DEBUG_PRINT2(false),
     DEBUG_PRINT3(false),
     PROFILING(false),
+    PROFILING_HW(false),
 
     OPTIM_FACES(true),
     OPTIM_CLONES(true),
-    OPTIM_SEPARATION(true)
+    OPTIM_SEPARATION(true),
+    OPTIM_BREP(true),
+    OPTIM_FLUSH(true),
+    OPTIM_ASYNC(true),
+    OPTIM_NORMALS(true),
+    OPTIM_PLANE(false),
+    THREADS(std::thread::hardware_concurrency() == 0 ? 1 : std::thread::hardware_concurrency()),
+    PARALLEL_MIN_SIZE(PARALLEL_IMPORT_MIN_SIZE),
+    TOPOLOGY_ONLY(false),
+
+    brep_spool(nullptr),
+    S_counted(0),
+    S_next_id(1),
+    S_flushed(0),
+    S_flushed_id(1),
+    noS_flushed(0)
 
   {
-    start_full_time = get_sys_time();
+    start_full_time = trace::now();
 
     // Единицы измерения: длина, угол и объёмный угол
     named_unit* t_legth_group = new length_unit();
@@ -247,27 +333,38 @@ namespace express {
     noS.push_back(t_definition);
     g_shape_definition_representation = new shape_definition_representation(t_definition, g_shape_representation);
     S.push_back(g_shape_definition_representation);
+
+    /**
+     * Общие для всех изделий объекты остаются в памяти до записи файла STEP, но получают
+     * уникальные имена сразу, так как на них ссылаются выводимые во временный файл объекты.
+     */
+    for (auto it = S.cbegin(); it != S.cend(); ++it) {
+      (*it)->set_id(S_next_id++);
+    }
+    S_counted = S.size();
+    S_flushed = S.size();
+    S_flushed_id = S_next_id;
+    noS_flushed = noS.size();
   }
 
 
   err_enum_t STEP_API::save(const char* name) {
 
-    FILE* out;
+    step_output out;
 
     if (DEBUG_PRINT) std::cout << "Opening file '" << name << "' for writing" << std::endl;
 
-#if defined(_MSC_VER)
-    const char* CRLF = "\n";
-    errno_t err = fopen_s(&out, name, "wt");
-    if (err != 0 || out == nullptr)
-#elif defined(__GNUC__) || defined(__DOXYGEN__)
-    const char* CRLF = "\r\n";
-    out = fopen(name, "wt");
-    if (out == nullptr)
-#else
-# error Unknown C++ compiler
-#endif
-    {
+    const char* CRLF = STEP_CRLF;
+
+    // Файлы с расширением .gz и .stpZ (STEP-Z) записываются в сжатом виде
+    bool compress = step_output::is_compressed_name(name);
+    if (compress && !step_output::compression_supported()) {
+      std::cout << "ERROR (save): can't write compressed file '" << name << "' - program built without zlib" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    if (DEBUG_PRINT && compress) std::cout << "Writing compressed (gzip) file" << std::endl;
+
+    if (out.open(name, OPTIM_ASYNC, compress) != err_enum_t::ERROR_OK) {
       std::cout << "ERROR (save): can't open file '" << name << "' for writing" << std::endl;
       return err_enum_t::ERROR_FILE_IO;
     }
@@ -276,13 +373,23 @@ namespace express {
       std::cout << "Setting IDs" << std::endl;
     }
 
-    uint64_t start_time = get_sys_time();
+    trace::span save_span("save", "output", PROFILING ? &writing_file : nullptr, PROFILING_HW ? &writing_file_hw : nullptr);
+    metrics::end_file();
+    save_span.arg("file", std::string(name));
 
-    // Задать уникальные идентификаторы примитивам
+    // Задать уникальные идентификаторы примитивам (группа заранее выведенных экземпляров занимает несколько)
     unsigned int k = 1;
+    // Ожидаемый размер файла: заголовок, заранее выведенный текст и примерно 80 байт на прочие экземпляры
+    long long expected_size = 4096;
     for (std::vector<const STEP_ENTITY*>::const_iterator Sit = S.begin(); Sit != S.end(); ++Sit) {
-      if (*Sit != nullptr) (*Sit)->set_id(k++);
+      if (*Sit != nullptr) {
+        (*Sit)->set_id(k);
+        k += (*Sit)->get_ids_num();
+        const brep_fragment* fragment = dynamic_cast<const brep_fragment*>(*Sit);
+        expected_size += (fragment != nullptr) ? static_cast<long long>(fragment->get_length()) : 80;
+      }
     }
+    out.reserve(expected_size);
 
     if (DEBUG_PRINT) {
       std::cout << "Writing primitives" << std::endl;
@@ -295,10 +402,10 @@ namespace express {
 #endif
 
     // ISO 10303-21, 5.6
-    fprintf(out, "ISO-10303-21;%s", CRLF);
-    fprintf(out, "HEADER;%s", CRLF);
-    fprintf(out, "FILE_DESCRIPTION( ('STEP AP214'), '2;1');%s", CRLF);
-    fprintf(out, "FILE_NAME( '%s.step', '%i-%02i-%02iT%02i:%02i:%02i', ('Author'), (''), 'Processor', 'stl2step', '');%s",
+    out.print("ISO-10303-21;%s", CRLF);
+    out.print("HEADER;%s", CRLF);
+    out.print("FILE_DESCRIPTION( ('STEP AP214'), '2;1');%s", CRLF);
+    out.print("FILE_NAME( '%s.step', '%i-%02i-%02iT%02i:%02i:%02i', ('Author'), (''), 'Processor', 'stl2step', '');%s",
       g_name.c_str(),
 #ifndef CONSTANT_TIME
       tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec,
@@ -306,51 +413,484 @@ namespace express {
       2022, 2, 7, 17, 35, 32,
 #endif
       CRLF);
-    fprintf(out, "FILE_SCHEMA (( 'AUTOMOTIVE_DESIGN' ));%s", CRLF);
-    fprintf(out, "ENDSEC;%s", CRLF);
-    fprintf(out, "DATA;%s", CRLF);
+    out.print("FILE_SCHEMA (( 'AUTOMOTIVE_DESIGN' ));%s", CRLF);
+    out.print("ENDSEC;%s", CRLF);
+    out.print("DATA;%s", CRLF);
 
 
     // Записать все примитивы
-    for (auto ci = S.cbegin(); ci != S.cend(); ++ci) {
-      if (*ci != nullptr) {
-        fprintf(out, "%s%s", (*ci)->print().c_str(), CRLF);
-        if (DEBUG_PRINT3) {
-//          std::cout << (*ci)->print() << std::endl;
-        }
-      }
-      else {
-        std::cout << "ERROR (save): Trying to print nullptr entity" << std::endl;
-        fclose(out);
-        return err_enum_t::ERROR_INTERNAL;
-      }
+    err_enum_t err = write_entities(out);
+    if (err != err_enum_t::ERROR_OK) {
+      out.close();
+      return err;
     }
 
     // Записать окончание
-    fprintf(out, "ENDSEC;%sEND-ISO-10303-21;%s", CRLF, CRLF);
-    fclose(out);
-
-    // Засечь время записи файла
-    if (PROFILING) writing_file += get_sys_time() - start_time;
+    out.print("ENDSEC;%sEND-ISO-10303-21;%s", CRLF, CRLF);
+    if (out.close() != err_enum_t::ERROR_OK) {
+      std::cout << "ERROR (save): can't write file '" << name << "'" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    metrics::add("text_bytes_written", out.get_text_size());
+    metrics::add("bytes_written", out.get_file_size());
+    metrics::phase("save");
 
     return err_enum_t::ERROR_OK;
   }
 
+
   STEP_API::~STEP_API() {
 
     /** Уничтожение примитивов, которые были выведены в файл STEP */
     for (auto it = S.begin(); it != S.end(); ++it) {
+      alloc::entity_scope tag(typeid(**it).name(), true);
       delete* it;
     }
 
     /** Уничтожение примитивов, которые не были выведены в файл STEP */
     for (auto it = noS.begin(); it != noS.end(); ++it) {
+      alloc::entity_scope tag(typeid(**it).name(), true);
       delete* it;
     }
+
+    /** Закрытие временного файла с текстом граней */
+    if (brep_spool != nullptr) fclose(brep_spool);
   }
 
+  err_enum_t STEP_API::write_entities(step_output& out) const {
+
+    for (auto ci = S.cbegin(); ci != S.cend(); ++ci) {
+      if (*ci == nullptr) {
+        std::cout << "ERROR (save): Trying to print nullptr entity" << std::endl;
+        return err_enum_t::ERROR_INTERNAL;
+      }
+    }
+
+    /** Текст групп экземпляров читается из временного файла в обход буфера FILE */
+    if (brep_spool != nullptr && fflush(brep_spool) != 0) {
+      std::cout << "ERROR (save): can't write temporary file" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
 
+    /**
+     * Разбиение массива S на части по количеству уникальных имён, чтобы группа заранее
+     * выведенных экземпляров со многими именами оказалась в отдельной части.
+     */
+    std::vector<size_t> bounds(1, 0);
+    size_t ids_num = 0;
+    for (auto ci = S.cbegin(); ci != S.cend(); ++ci) {
+      ids_num += (*ci)->get_ids_num();
+      if (ids_num >= SAVE_CHUNK) {
+        bounds.push_back(std::distance(S.cbegin(), ci) + 1);
+        ids_num = 0;
+      }
+    }
+    if (bounds.back() != S.size()) bounds.push_back(S.size());
+    const size_t chunks_num = bounds.size() - 1;
+
+    if (THREADS <= 1 || chunks_num <= 1) {
+      for (auto ci = S.cbegin(); ci != S.cend(); ++ci) {
+        std::string text;
+        {
+          alloc::entity_scope tag(typeid(**ci).name(), false);
+          text = (*ci)->print();
+        }
+        metrics::count_entities(text.data(), text.size());
+        out.write(text);
+        out.write(STEP_CRLF, strlen(STEP_CRLF));
+      }
+      return err_enum_t::ERROR_OK;
+    }
 
+    if (DEBUG_PRINT) {
+      std::cout << "Printing " << chunks_num << " chunks in " << THREADS << " threads" << std::endl;
+    }
+
+    save_chunks ctx(S, bounds, 4 * static_cast<size_t>(THREADS));
+
+    std::vector<std::thread> workers;
+    const size_t threads_num = std::min(static_cast<size_t>(THREADS), chunks_num);
+    for (size_t i = 0; i < threads_num; ++i) {
+      workers.emplace_back(format_chunks, &ctx);
+    }
+
+    /** Части записываются в файл по мере готовности строго по порядку */
+    for (size_t c = 0; c < chunks_num; ++c) {
+      std::string text;
+      {
+        std::unique_lock<std::mutex> lock(ctx.m);
+        while (!ctx.ready[c]) ctx.cv_ready.wait(lock);
+        text.swap(ctx.text[c]);
+        ctx.written = c + 1;
+      }
+      ctx.cv_space.notify_all();
+      metrics::count_entities(text.data(), text.size());
+      out.write(text);
+    }
+
+    for (auto it = workers.begin(); it != workers.end(); ++it) {
+      (*it).join();
+    }
+
+    return err_enum_t::ERROR_OK;
+  }
+
+  err_enum_t STEP_API::open_spool() {
+    if (brep_spool != nullptr) return err_enum_t::ERROR_OK;
+#if defined(_MSC_VER)
+    if (tmpfile_s(&brep_spool) != 0) brep_spool = nullptr;
+#elif defined(__GNUC__) || defined(__DOXYGEN__)
+    brep_spool = tmpfile();
+#else
+# error Unknown C++ compiler
+#endif
+    if (brep_spool == nullptr) {
+      std::cout << "ERROR (open_spool): can't create temporary file" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    return err_enum_t::ERROR_OK;
+  }
+
+  err_enum_t STEP_API::flush_text(std::string& text, unsigned first_id, unsigned& ids_num) {
+    if (ids_num == 0) return err_enum_t::ERROR_OK;
+
+    brep_fragment* fragment = brep_fragment::create(brep_spool, first_id, ids_num, text);
+    if (fragment == nullptr) {
+      std::cout << "ERROR (flush_text): can't write temporary file" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    S.push_back(fragment);
+
+    text.clear();
+    ids_num = 0;
+    return err_enum_t::ERROR_OK;
+  }
+
+  err_enum_t STEP_API::flush_entities() {
+
+    err_enum_t err = open_spool();
+    if (err != err_enum_t::ERROR_OK) return err;
+
+    trace::span flush_span("flush_entities", "output", PROFILING ? &writing_file : nullptr, PROFILING_HW ? &writing_file_hw : nullptr);
+    flush_span.arg("entities", static_cast<long long>(S.size() - S_flushed));
+
+    // Задать уникальные идентификаторы новым примитивам
+    unsigned int k = S_flushed_id;
+    for (auto Sit = S.cbegin() + S_flushed; Sit != S.cend(); ++Sit) {
+      if (*Sit == nullptr) {
+        std::cout << "ERROR (flush_entities): Trying to print nullptr entity" << std::endl;
+        return err_enum_t::ERROR_INTERNAL;
+      }
+      (*Sit)->set_id(k);
+      k += (*Sit)->get_ids_num();
+    }
+
+    if (DEBUG_PRINT) {
+      std::cout << "Flushing " << S.size() - S_flushed << " primitives (#" << S_flushed_id << "..#" << k - 1 << ")" << std::endl;
+    }
+
+    // Новые примитивы заменяются группами выведенных экземпляров
+    std::vector<const STEP_ENTITY*> Sn(S.cbegin() + S_flushed, S.cend());
+    S.resize(S_flushed);
+    std::vector<const STEP_ENTITY*> printed;
+
+    std::string text;
+    unsigned first_id = 0;
+    unsigned ids_num = 0;
+    for (auto Sit = Sn.cbegin(); Sit != Sn.cend(); ++Sit) {
+
+      // Ранее выведенные группы и изделия, на которые ссылается категория изделия, остаются в массиве S
+      if (dynamic_cast<const brep_fragment*>(*Sit) != nullptr || dynamic_cast<const product*>(*Sit) != nullptr) {
+        err = flush_text(text, first_id, ids_num);
+        if (err != err_enum_t::ERROR_OK) break;
+        S.push_back(*Sit);
+        continue;
+      }
+
+      if (ids_num == 0) {
+        first_id = (*Sit)->get_id();
+      } else {
+        text += STEP_CRLF;
+      }
+      {
+        alloc::entity_scope tag(typeid(**Sit).name(), false);
+        text += (*Sit)->print();
+      }
+      ids_num += (*Sit)->get_ids_num();
+      printed.push_back(*Sit);
+    }
+    if (err == err_enum_t::ERROR_OK) {
+      err = flush_text(text, first_id, ids_num);
+    }
+
+    // Уничтожение выведенных примитивов и вспомогательных объектов обработанного файла
+    for (auto it = printed.begin(); it != printed.end(); ++it) {
+      alloc::entity_scope tag(typeid(**it).name(), true);
+      delete* it;
+    }
+    for (auto it = noS.begin() + noS_flushed; it != noS.end(); ++it) {
+      alloc::entity_scope tag(typeid(**it).name(), true);
+      delete* it;
+    }
+    noS.resize(noS_flushed);
+
+    if (err != err_enum_t::ERROR_OK) return err;
+
+    S_flushed = S.size();
+    S_flushed_id = k;
+    S_counted = S.size();
+    S_next_id = k;
+
+    return err_enum_t::ERROR_OK;
+  }
+
+  unsigned STEP_API::get_next_id() {
+    for (; S_counted < S.size(); ++S_counted) {
+      if (S[S_counted] != nullptr) S_next_id += S[S_counted]->get_ids_num();
+    }
+    return S_next_id;
+  }
+
+
+
+
+err_enum_t STEP_API::build_shells(const std::string& name, const std::string& f_name, const std::string& shell_name,
+  std::vector<prim3d::shell*>& Shells) {
+
+  /**
+   * Создать список нормалей и рёбер, испортировать в него файл.
+   */
+  prim3d::shell* sh;
+  err_enum_t err;
+  if (prim3d::shell::is_mesh_name(name)) {
+    /**
+     * Индексированная сетка (PLY, OBJ) сразу задаёт общие вершины граней:
+     * объединённая фигура создаётся без поиска совпадающих вершин и повторяющихся граней.
+     */
+    std::vector<geometry::vector> P;
+    std::vector<size_t> I;
+    trace::span import_span("import", "import", PROFILING ? &importing : nullptr, PROFILING_HW ? &importing_hw : nullptr);
+    err = prim3d::shell::import_mesh(f_name, P, I);
+    if (err != err_enum_t::ERROR_OK) return err;
+    import_span.arg("triangles", static_cast<long long>(I.size() / 3));
+    import_span.end();
+    metrics::add("triangles_imported", static_cast<long long>(I.size() / 3));
+    metrics::phase("import");
+
+    if (DEBUG_PRINT) {
+      std::cout << P.size() << " vertices, " << I.size() / 3 << " triangles, creating shells" << std::endl;
+    }
+    trace::span build_span("build_shell", "topology", PROFILING ? &welding : nullptr, PROFILING_HW ? &welding_hw : nullptr);
+    sh = new prim3d::shell(P, I);
+    metrics::add("vertices", static_cast<long long>(sh->vertexes_num()));
+    metrics::phase("build_shell");
+  }
+  else {
+    std::vector<geometry::vector> F;
+    trace::span import_span("import", "import", PROFILING ? &importing : nullptr, PROFILING_HW ? &importing_hw : nullptr);
+    err = prim3d::shell::import(f_name, F, THREADS, PARALLEL_MIN_SIZE);
+    if (err != err_enum_t::ERROR_OK) return err;
+    import_span.arg("triangles", static_cast<long long>(F.size() / 4));
+    import_span.end();
+    metrics::add("triangles_imported", static_cast<long long>(F.size() / 4));
+    metrics::phase("import");
+
+    /**
+     * Отбросить вырожденные треугольники и исправить нормали до построения фигуры,
+     * чтобы они не попали в построение топологии и объединение граней.
+     */
+    if (OPTIM_NORMALS) {
+      trace::span check_span("check_faces", "import");
+      prim3d::shell::check_faces(F, DEBUG_PRINT2);
+    }
+
+    if (DEBUG_PRINT) {
+      std::cout << F.size() << " faces, creating shells" << std::endl;
+    }
+
+    /**
+     * Создать объединённую фигуру из импортированных граней (с объединением совпадающих вершин).
+     */
+    trace::span weld_span("weld", "topology", PROFILING ? &welding : nullptr, PROFILING_HW ? &welding_hw : nullptr);
+    sh = new prim3d::shell(F);
+    weld_span.arg("vertexes", static_cast<long long>(sh->vertexes_num()));
+    /** Каждый треугольник ссылается на три вершины, совпадающие ссылки объединяются в одну вершину */
+    metrics::add("vertices", static_cast<long long>(sh->vertexes_num()));
+    metrics::add("vertices_welded", static_cast<long long>(sh->faces_num() * 3 - sh->vertexes_num()));
+    metrics::phase("weld");
+  }
+
+  /**
+   * Для объединённой фигуры удалить парные рёбра в списке рёбер,
+   * засечь время удаления парных рёбер.
+   */
+  trace::span edges_span("merge_edges", "topology", PROFILING ? &edges_reducing : nullptr, PROFILING_HW ? &edges_reducing_hw : nullptr);
+  err = sh->merge_edges(DEBUG_PRINT2);
+  if (err != err_enum_t::ERROR_OK) {
+    if (!shell_name.empty()) std::cout << "Ошибка при обработке '" << shell_name << "'" << std::endl;
+    delete sh;
+    return err;
+  }
+  edges_span.end();
+  metrics::phase("merge_edges");
+
+  /**
+   * При необходимости разделить объединённую фигуру на отдельные фигуры, определить время
+   * разделения на фигуры.
+   */
+  if (OPTIM_SEPARATION) {
+    trace::span separate_span("separate", "topology", PROFILING ? &optim_shells_time : nullptr, PROFILING_HW ? &optim_shells_hw : nullptr);
+    // Массив фигур как результат разбора граней по фигурам
+    Shells = sh->separate();
+    delete sh;
+    separate_span.arg("shells", static_cast<long long>(Shells.size()));
+    separate_span.end();
+    metrics::phase("separate");
+  }
+  else {
+    // Объединённая фигура содержит только одну фигуру
+    Shells.push_back(sh);
+  }
+
+  /**
+   * При необходимости вычислить условный центр и выполнить "нормализацию" координат
+   * относительно него для каждой фигуры, определить время нормализации координат.
+   */
+  if (OPTIM_CLONES) {
+    trace::span normalize_span("normalize_shell", "clones", PROFILING ? &optim_clones_time : nullptr, PROFILING_HW ? &optim_clones_hw : nullptr);
+    for (auto it = Shells.begin(); it != Shells.end(); ++it) {
+      (*it)->normalize_shell();
+    }
+  }
+
+  // Проверка наличия фигур в списке
+  if (Shells.size() == 0) {
+    std::cout << "ERROR (process_file): отсутствуют фигуры в файле '" << name << "'" << std::endl;
+    return err_enum_t::ERROR_INTERNAL;
+  }
+
+  if (DEBUG_PRINT) {
+    if (Shells.size() == 1) {
+      std::cout << "создана фигура:" << std::endl <<
+      (*Shells.begin())->faces_num() << " faces, " << 
+      (*Shells.begin())->vertexes_num() << " vertexes. Pos=" <<
+      (*Shells.begin())->get_pos();
+    }
+    else {
+      std::cout << Shells.size() << " фигур создано:" << std::endl;
+      for (auto it = Shells.cbegin(); it != Shells.cend(); ++it) {
+        std::cout << std::distance(Shells.cbegin(), it) + 1 << ": " << (*it)->faces_num() << \
+        " " << (*it)->vertexes_num() << " вершин. Условный центр=" << (*it)->get_pos();
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  /**
+   * При необходимости выполнить выявление клонов фигур, определить время выяления клонов.
+   */
+  if ((Shells.size() > 1) && OPTIM_CLONES) {
+
+    if (DEBUG_PRINT) {
+      std::cout << "Выявление фигур-клонов" << std::endl;
+    }
+
+    trace::span clones_span("find_clones", "clones", PROFILING ? &optim_clones_time : nullptr, PROFILING_HW ? &optim_clones_hw : nullptr);
+    // Тут приходится сравнивать кажую фигуру с каждой. Сортировка может ускорить этот этап.
+    for (auto it_s1 = Shells.begin(); it_s1 != Shells.end(); ++it_s1) {
+      for (auto it_s2 = it_s1 + 1; it_s2 != Shells.end(); ++it_s2) {
+        if ((*it_s2)->is_clone()) {
+          continue;
+        }
+        if (**it_s1 == **it_s2) {
+          // it_s2 является клоном it_s1.
+          (*it_s2)->set_clone(*it_s1);
+          if (DEBUG_PRINT) std::cout << "Clone found (" << std::distance(Shells.begin(), it_s2) + 1 << " is clone of " << std::distance(Shells.begin(), it_s1) + 1 << std::endl;
+        }
+      }
+    }
+    clones_span.end();
+    if (metrics::enabled()) {
+      long long clones_num = 0;
+      for (auto it = Shells.cbegin(); it != Shells.cend(); ++it) {
+        if ((*it)->is_clone()) clones_num++;
+      }
+      metrics::add("clones_matched", clones_num);
+      metrics::phase("clones");
+    }
+
+    if (DEBUG_PRINT3) {
+      for (auto it = Shells.cbegin(); it != Shells.cend(); ++it) {
+        (*it)->print();
+      }
+    }
+  }
+
+  /**
+   * При необходимости для каждой фигуры объединенить соседние треугольные грани, лежащие
+   * в одной плоскости, в многоугольные. Определить время каждого шага объединения.
+   */
+  if (OPTIM_FACES) {
+    for (auto it = Shells.begin(); it != Shells.end(); ++it) {
+      if ((*it)->is_clone()) continue;
+
+      if (DEBUG_PRINT) {
+        std::cout << "Объединение плоских граней (фигура #" << std::distance(Shells.begin(), it) + 1 << " из " << Shells.size() << ")" << std::endl;
+      } else {
+        print_dot('.', 5);
+      }
+
+      trace::span shell_span("merge_shell_faces", "shell");
+      shell_span.arg("shell", static_cast<long long>(std::distance(Shells.begin(), it) + 1));
+      shell_span.arg("faces", static_cast<long long>((*it)->faces_num()));
+
+      {
+        trace::span step_span("merge_faces", "topology", PROFILING ? &optim_faces_time1 : nullptr, PROFILING_HW ? &optim_faces_hw1 : nullptr);
+        (*it)->merge_faces(DEBUG_PRINT2, OPTIM_PLANE);
+      }
+
+      {
+        trace::span step_span("reduce_edges", "topology", PROFILING ? &optim_faces_time2 : nullptr, PROFILING_HW ? &optim_faces_hw2 : nullptr);
+        err = (*it)->reduce_edges(DEBUG_PRINT2);
+      }
+      if (err != err_enum_t::ERROR_OK) return err;
+
+      {
+        trace::span step_span("split_edges_to_borders", "topology", PROFILING ? &optim_faces_time3 : nullptr, PROFILING_HW ? &optim_faces_hw3 : nullptr);
+        err = (*it)->split_edges_to_borders(DEBUG_PRINT3);
+      }
+      if (err != err_enum_t::ERROR_OK) return err;
+
+      shell_span.arg("merged_faces", static_cast<long long>((*it)->faces_num()));
+    }
+    metrics::phase("merge_faces");
+  }
+
+  return err_enum_t::ERROR_OK;
+}
+
+bool STEP_API::cache_key(const std::string& f_name, std::string& cache_name, std::string& key) const {
+  uint64_t hash;
+  long long size;
+  if (stl_input::content_hash(f_name, hash, size) != err_enum_t::ERROR_OK) return false;
+
+  std::stringstream ss;
+  ss << std::hex << std::setfill('0') << std::setw(16) << hash << std::dec << " " << size <<
+    " eps " << EPSILON_X << " " << EPSILON_Y << " " << EPSILON_C << " " << EPSILON_P << " " << EPSILON_N <<
+    " f" << OPTIM_FACES << " c" << OPTIM_CLONES << " s" << OPTIM_SEPARATION << " n" << OPTIM_NORMALS <<
+    " p" << OPTIM_PLANE;
+  key = ss.str();
+
+  /** Имя файла кэша - хеш содержимого файла STL и хеш ключа (FNV-1a) */
+  uint64_t key_hash = 0xCBF29CE484222325ULL;
+  for (auto it = key.cbegin(); it != key.cend(); ++it) {
+    key_hash = (key_hash ^ static_cast<unsigned char>(*it)) * 0x100000001B3ULL;
+  }
+  std::stringstream name;
+  name << CACHE_DIR << std::hex << std::setfill('0') << std::setw(16) << hash << "-" << std::setw(16) << key_hash << ".s2c";
+  cache_name = name.str();
+  return true;
+}
 
 err_enum_t STEP_API::process_file(
   const std::string& name,
@@ -371,6 +911,10 @@ err_enum_t STEP_API::process_file(
 
   // Имя материала без пути и расширения
   std::string m_name = str_remove_path(str_remove_ext(name));
+  // У сжатого файла (например, 'body.stl.gz') отбросить и расширение файла STL
+  if (stl_input::is_gzip_name(name)) m_name = str_remove_ext(m_name);
+  // Данные со стандартного ввода
+  if (stl_input::is_stdin_name(name)) m_name = "stdin";
 
   // Геометрический контекст, точность представления (формирование экземпляра сложного объекта (complex entity instance))
   representation_context* m_representation_context_group = new geometric_representation_context("", "", 3);
@@ -533,154 +1077,99 @@ err_enum_t STEP_API::process_file(
     }
   }
 
-  /**
-   * Создать список нормалей и рёбер, испортировать в него файл.
-   */
-  std::vector<geometry::vector> F;
-  err_enum_t err = prim3d::shell::import(f_name, F);
-  if (err != err_enum_t::ERROR_OK) return err;
-
-  if (DEBUG_PRINT) {
-    std::cout << F.size() << " faces, creating shells" << std::endl;
-  }
-
-  uint64_t start_time;
+  /** Область трассировки обработки файла */
+  trace::span file_span("process_file", "file");
+  file_span.arg("file", f_name);
+  metrics::begin_file(f_name);
 
   /**
-   * Создать объединённую фигуру из импортированных граней.
-   */
-  prim3d::shell* sh = new prim3d::shell(F);
-
-  /**
-   * Для объединённой фигуры удалить парные рёбра в списке рёбер,
-   * засечь время удаления парных рёбер.
-   */
-  start_time = get_sys_time();
-  err = sh->merge_edges(DEBUG_PRINT2);
-  if (err != err_enum_t::ERROR_OK) {
-    if (!shell_name.empty()) std::cout << "Ошибка при обработке '" << shell_name << "'" << std::endl;
-    delete sh;
-    return err;
-  }
-  if (PROFILING) edges_reducing += get_sys_time() - start_time;
-
-  /**
-   * При необходимости разделить объединённую фигуру на отдельные фигуры, определить время
-   * разделения на фигуры.
+   * Фигуры файла топологии создаются по файлу без импорта и обработки. Фигуры файла STL
+   * загружаются из кэша, если файл с теми же параметрами обработки уже обрабатывался,
+   * иначе создаются из файла STL и сохраняются в кэш.
    */
   std::vector<prim3d::shell*> Shells;
-  if (OPTIM_SEPARATION) {
-    start_time = get_sys_time();
-    // Массив фигур как результат разбора граней по фигурам
-    Shells = sh->separate();
-    delete sh;
-    if (PROFILING) optim_shells_time += get_sys_time() - start_time;
-  }
-  else {
-    // Объединённая фигура содержит только одну фигуру
-    Shells.push_back(sh);
-  }
-
-  /**
-   * При необходимости вычислить условный центр и выполнить "нормализацию" координат
-   * относительно него для каждой фигуры, определить время нормализации координат.
-   */
-  if (OPTIM_CLONES) {
-    start_time = get_sys_time();
-    for (auto it = Shells.begin(); it != Shells.end(); ++it) {
-      (*it)->normalize_shell();
-    }
-    if (PROFILING) optim_clones_time += get_sys_time() - start_time;
-  }
-
-  // Проверка наличия фигур в списке
-  if (Shells.size() == 0) {
-    std::cout << "ERROR (process_file): отсутствуют фигуры в файле '" << name << "'" << std::endl;
-    return err_enum_t::ERROR_INTERNAL;
-  }
-
-  if (DEBUG_PRINT) {
-    if (Shells.size() == 1) {
-      std::cout << "создана фигура:" << std::endl <<
-      (*Shells.begin())->faces_num() << " faces, " << 
-      (*Shells.begin())->vertexes_num() << " vertexes. Pos=" <<
-      (*Shells.begin())->get_pos();
+  std::string cache_name, key;
+  err_enum_t err;
+  if (topology::is_topology_name(name)) {
+    trace::span topo_span("load_topology", "topology", PROFILING ? &importing : nullptr, PROFILING_HW ? &importing_hw : nullptr);
+    topology::file t_file;
+    err = t_file.open(f_name);
+    if (err == err_enum_t::ERROR_OK) err = prim3d::shell::load_topology(t_file, Shells);
+    if (err != err_enum_t::ERROR_OK) {
+      std::cout << "ERROR (process_file): файл топологии '" << f_name << "' не прочитан или повреждён" << std::endl;
+      return err;
     }
-    else {
-      std::cout << Shells.size() << " фигур создано:" << std::endl;
-      for (auto it = Shells.cbegin(); it != Shells.cend(); ++it) {
-        std::cout << std::distance(Shells.cbegin(), it) + 1 << ": " << (*it)->faces_num() << \
-        " " << (*it)->vertexes_num() << " вершин. Условный центр=" << (*it)->get_pos();
+    if (DEBUG_PRINT) std::cout << "Topology loaded: " << f_name << " (" << t_file.get_key() << ")" << std::endl;
+  } else {
+    if (!CACHE_DIR.empty() && cache_key(f_name, cache_name, key)) {
+      trace::span cache_span("load_cache", "cache", PROFILING ? &importing : nullptr, PROFILING_HW ? &importing_hw : nullptr);
+      topology::file t_file;
+      err = t_file.open(cache_name);
+      if (err == err_enum_t::ERROR_OK && t_file.get_key() != key) err = err_enum_t::ERROR_IMPORT;
+      if (err == err_enum_t::ERROR_OK) err = prim3d::shell::load_topology(t_file, Shells);
+      cache_span.arg("hit", static_cast<long long>(err == err_enum_t::ERROR_OK ? 1 : 0));
+      if (err == err_enum_t::ERROR_IMPORT) {
+        std::cout << "WARNING (process_file): файл кэша '" << cache_name << "' повреждён или не соответствует ключу" << std::endl;
+      }
+      if (DEBUG_PRINT) {
+        std::cout << (err == err_enum_t::ERROR_OK ? "Cache hit: " : "Cache miss: ") << cache_name << std::endl;
       }
+      metrics::add(err == err_enum_t::ERROR_OK ? "cache_hits" : "cache_misses", 1);
     }
-    std::cout << std::endl;
-  }
-
-  /**
-   * При необходимости выполнить выявление клонов фигур, определить время выяления клонов.
-   */
-  if ((Shells.size() > 1) && OPTIM_CLONES) {
-
-    if (DEBUG_PRINT) {
-      std::cout << "Выявление фигур-клонов" << std::endl;
+    if (Shells.empty()) {
+      err = build_shells(name, f_name, shell_name, Shells);
+      if (err != err_enum_t::ERROR_OK) return err;
+      if (!cache_name.empty()) {
+        trace::span cache_span("save_cache", "cache");
+        err = prim3d::shell::save_topology(cache_name, key, Shells);
+        if (err != err_enum_t::ERROR_OK) {
+          std::cout << "WARNING (process_file): не удалось записать файл кэша '" << cache_name << "'" << std::endl;
+        }
+      }
     }
 
-    start_time = get_sys_time();
-    // Тут приходится сравнивать кажую фигуру с каждой. Сортировка может ускорить этот этап.
-    for (auto it_s1 = Shells.begin(); it_s1 != Shells.end(); ++it_s1) {
-      for (auto it_s2 = it_s1 + 1; it_s2 != Shells.end(); ++it_s2) {
-        if ((*it_s2)->is_clone()) {
-          continue;
-        }
-        if (**it_s1 == **it_s2) {
-          // it_s2 является клоном it_s1.
-          (*it_s2)->set_clone(*it_s1);
-          if (DEBUG_PRINT) std::cout << "Clone found (" << std::distance(Shells.begin(), it_s2) + 1 << " is clone of " << std::distance(Shells.begin(), it_s1) + 1 << std::endl;
+    /** Записать фигуры в файл топологии, ключом которого служит ключ кэша (или имя файла, если хеш не получен) */
+    if (!TOPOLOGY_DIR.empty()) {
+      trace::span topo_span("save_topology", "topology");
+      std::string topo_cache_name;
+      if (key.empty() && !cache_key(f_name, topo_cache_name, key)) key = f_name;
+      const std::string topo_name = TOPOLOGY_DIR + m_name + ".s2t";
+
+      /** Файлы STL с одинаковым именем из разных директорий или архивов записывались бы в один файл топологии */
+      auto found = topology_files.find(topo_name);
+      if (found != topology_files.end() && found->second.compare(key) != 0) {
+        std::cout << "ERROR (process_file): файл топологии '" << topo_name << "' уже записан для другого файла STL с именем '" <<
+          m_name << "'; топологию файлов STL с одинаковыми именами нужно записывать в разные директории" << std::endl;
+        for (auto it = Shells.cbegin(); it != Shells.cend(); ++it) {
+          delete* it;
         }
+        return err_enum_t::ERROR_CMD_FORMAT;
       }
-    }
-    if (PROFILING) optim_clones_time += get_sys_time() - start_time;
+      topology_files[topo_name] = key;
 
-    if (DEBUG_PRINT3) {
-      for (auto it = Shells.cbegin(); it != Shells.cend(); ++it) {
-        (*it)->print();
+      err = prim3d::shell::save_topology(topo_name, key, Shells);
+      if (err != err_enum_t::ERROR_OK) {
+        std::cout << "ERROR (process_file): не удалось записать файл топологии '" << topo_name << "'" << std::endl;
+        for (auto it = Shells.cbegin(); it != Shells.cend(); ++it) {
+          delete* it;
+        }
+        return err;
       }
+      if (DEBUG_PRINT) std::cout << "Topology written: " << topo_name << std::endl;
     }
   }
 
-  /**
-   * При необходимости для каждой фигуры объединенить соседние треугольные грани, лежащие
-   * в одной плоскости, в многоугольные. Определить время каждого шага объединения.
-   */
-  if (OPTIM_FACES) {
-    for (auto it = Shells.begin(); it != Shells.end(); ++it) {
-      if ((*it)->is_clone()) continue;
-
-      if (DEBUG_PRINT) {
-        std::cout << "Объединение плоских граней (фигура #" << std::distance(Shells.begin(), it) + 1 << " из " << Shells.size() << ")" << std::endl;
-      } else {
-        print_dot('.', 5);
-      }
-
-      start_time = get_sys_time();
-      (*it)->merge_faces(DEBUG_PRINT2);
-      if (PROFILING) optim_faces_time1 += get_sys_time() - start_time;
-
-      start_time = get_sys_time();
-      err = (*it)->reduce_edges(DEBUG_PRINT2);
-      if (PROFILING) optim_faces_time2 += get_sys_time() - start_time;
-      if (err != err_enum_t::ERROR_OK) return err;
-
-      start_time = get_sys_time();
-      err = (*it)->split_edges_to_borders(DEBUG_PRINT3);
-      if (PROFILING) optim_faces_time3 += get_sys_time() - start_time;
-      if (err != err_enum_t::ERROR_OK) return err;
+  /** В режиме записи только файлов топологии экземпляры STEP фигур не создаются */
+  if (TOPOLOGY_ONLY) {
+    for (auto it = Shells.cbegin(); it != Shells.cend(); ++it) {
+      delete* it;
     }
+    return err_enum_t::ERROR_OK;
   }
 
   if (DEBUG_PRINT) std::cout << "Creating " << Shells.size() << " STEP shells" << std::endl;
   // Цикл по всем фигурам
-  start_time = get_sys_time();
+  trace::span steps_span("create_steps", "output", PROFILING ? &creating_steps : nullptr, PROFILING_HW ? &creating_steps_hw : nullptr);
   for (auto it_s = Shells.begin(); it_s != Shells.end(); ++it_s) {
     (*it_s)->reset_mark();
     // кроме клонов!
@@ -689,7 +1178,12 @@ err_enum_t STEP_API::process_file(
       continue;
     }
 
-    err = CreateShell(**it_s);
+    {
+      trace::span create_span(OPTIM_BREP ? "CreateShellDirect" : "CreateShell", "shell");
+      create_span.arg("shell", static_cast<long long>(std::distance(Shells.begin(), it_s) + 1));
+      create_span.arg("faces", static_cast<long long>((*it_s)->faces_num()));
+      err = OPTIM_BREP ? CreateShellDirect(**it_s) : CreateShell(**it_s);
+    }
     if (err != err_enum_t::ERROR_OK) return err;
 
     if (DEBUG_PRINT) std::cout << "Created STEP shell  #" << std::distance(Shells.begin(), it_s) + 1 << " of " << Shells.size() << " (" << (*it_s)->faces_num() << " faces, " << (*it_s)->edges_num() << " edges, " << (*it_s)->vertexes_num() << " vertexes)" << std::endl;
@@ -797,8 +1291,17 @@ err_enum_t STEP_API::process_file(
   }
 
   // Засечь время создания примитовов STEP
-  if (PROFILING) creating_steps += get_sys_time() - start_time;
+  steps_span.end();
+  metrics::add("shells_written", static_cast<long long>(Shells.size()));
+  metrics::phase("create_steps");
 
+  /**
+   * При необходимости вывести объекты файла во временный файл и освободить память.
+   */
+  if (OPTIM_FLUSH) {
+    err = flush_entities();
+    if (err != err_enum_t::ERROR_OK) return err;
+  }
 
   return err_enum_t::ERROR_OK;
 }
@@ -813,6 +1316,9 @@ err_enum_t STEP_API::CreateShell(const prim3d::shell & sh)
   /** Снять пометки с рёбер */
   sh.unmark_edges();
 
+  /** Направления рёбер грани (рассчитываются пакетно для каждой грани) */
+  geometry::vector_array edge_dirs, work;
+
   /** Цикл по всем граням фигуры для создания граней advanced_face */
   for (auto it_f = sh.get_faces().cbegin(); it_f != sh.get_faces().cend(); ++it_f) {
 
@@ -860,9 +1366,12 @@ err_enum_t STEP_API::CreateShell(const prim3d::shell & sh)
     const prim3d::edge* e1 = ce1.get_base_edge();
 
     const prim3d::vertex* fv1 = e1->get_start();
-    const prim3d::vertex* fv2 = e1->get_end();
 
-    geometry::vector fvd = geometry::vector(fv1->get_coord(), fv2->get_coord()).normalize();
+    (*it_f)->get_edge_directions(edge_dirs, work);
+    size_t edge_idx = 0;
+
+    // Направление первого ребра первой границы
+    geometry::vector fvd = edge_dirs.get(0);
 
     // Точка - начало отсчёта в системе координат грани (координаты первой вершины первой границы)
     const geometry::vector& vv1 = fv1->get_coord();
@@ -902,7 +1411,7 @@ err_enum_t STEP_API::CreateShell(const prim3d::shell & sh)
       aface->add_bound(Face_outer_bound);
 
       // Перебор ориентированных рёбер границы
-      for (auto it = (*it_l).get_edges().cbegin(); it != (*it_l).get_edges().cend(); ++it) {
+      for (auto it = (*it_l).get_edges().cbegin(); it != (*it_l).get_edges().cend(); ++it, ++edge_idx) {
 
         const prim3d::oriented_edge& ce2 = *it;
         const prim3d::edge* e2 = ce2.get_base_edge();
@@ -938,7 +1447,7 @@ err_enum_t STEP_API::CreateShell(const prim3d::shell & sh)
           }
 
           // Вектор ребра
-          geometry::vector vd = geometry::vector(v1->get_coord(), v2->get_coord()).normalize();
+          geometry::vector vd = edge_dirs.get(edge_idx);
           // Направление ребра
           const direction* dir = new direction("", 3, vd.getX(), vd.getY(), vd.getZ());
           // Вектор, задающий направление ребра
@@ -971,30 +1480,102 @@ err_enum_t STEP_API::CreateShell(const prim3d::shell & sh)
   return err_enum_t::ERROR_OK;
 }
 
+err_enum_t STEP_API::CreateShellDirect(const prim3d::shell& sh)
+{
+  /** Временный файл создаётся при выводе первой фигуры */
+  err_enum_t err = open_spool();
+  if (err != err_enum_t::ERROR_OK) return err;
+
+  /** Текст граней получает уникальные имена сразу после уже добавленных в S объектов */
+  brep_writer writer(brep_spool, get_next_id(), sh);
+
+  /** Цикл по всем граням фигуры */
+  for (auto it_f = sh.get_faces().cbegin(); it_f != sh.get_faces().cend(); ++it_f) {
+
+    if (!DEBUG_PRINT) {
+      print_dot('.', 300);
+    }
+
+    if (DEBUG_PRINT2) {
+      std::cout << "Adding face #" << std::distance(sh.get_faces().cbegin(), it_f) + 1 << \
+        " from " << sh.faces_num() << ": " << (*it_f)->borders_num() << \
+        ((*it_f)->borders_num() == 1 ? " border (" : " borders (");
+      for (auto it_borders = (*it_f)->get_borders().cbegin(); it_borders != (*it_f)->get_borders().cend(); ++it_borders) {
+        std::cout << (*it_borders).edges_num() << " ";
+      }
+      std::cout << ")" << std::endl;
+    }
+
+    err = writer.add_face(**it_f);
+    if (err != err_enum_t::ERROR_OK) return err;
+  }
+
+  brep_fragment* fragment = writer.create_fragment();
+  if (fragment != nullptr) S.push_back(fragment);
+
+  closed_shell* s_closed_shell = new brep_closed_shell("", writer.get_face_ids());
+  sh.set_mark(s_closed_shell);
+
+  return err_enum_t::ERROR_OK;
+}
+
 void STEP_API::print_prof() const {
 
-  if (writing_file + creating_steps + edges_reducing + optim_faces_time1 + optim_faces_time2 + optim_faces_time3 + optim_shells_time + optim_clones_time != 0) {
-    long long unsigned full_time = get_sys_time() - start_full_time;
+  if (importing + welding + writing_file + creating_steps + edges_reducing + optim_faces_time1 + optim_faces_time2 + optim_faces_time3 + optim_shells_time + optim_clones_time != 0) {
+    uint64_t full_time = trace::now() - start_full_time;
 
     std::cout << std::endl <<"Профилирование:" << std::endl;
-                           std::cout << "Всего затрачено времени:      " << std::setw(6) << full_time         << " ms" << std::endl;
+    std::cout << "Всего затрачено времени:      " << std::setw(12) << std::fixed << std::setprecision(3) << to_ms(full_time) << " ms" << std::endl;
+    // Импорт файлов и объединение вершин
+    print_prof_line("Импорт файлов:                ", importing, full_time);
+    print_prof_line("Объединение вершин:           ", welding, full_time);
     // Разбиение граней на отдельные фигуры
-    if (optim_shells_time) std::cout << "Разделение на фигуры:         " << std::setw(6) << optim_shells_time << " ms (" << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(optim_shells_time) / static_cast<double>(full_time) << "%)" << std::endl;
+    print_prof_line("Разделение на фигуры:         ", optim_shells_time, full_time);
     // Выявление фигур-клонов
-    if (optim_clones_time) std::cout << "Выявление клонов:             " << std::setw(6) << optim_clones_time << " ms (" << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(optim_clones_time) / static_cast<double>(full_time) << "%)" << std::endl;
+    print_prof_line("Выявление клонов:             ", optim_clones_time, full_time);
     // Удаление парных рёбер
-    if (edges_reducing)    std::cout << "Удаление парных рёбер:        " << std::setw(6) << edges_reducing    << " ms (" << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(edges_reducing) / static_cast<double>(full_time) << "%)" << std::endl;
+    print_prof_line("Удаление парных рёбер:        ", edges_reducing, full_time);
     // Объединение треугольных граней в многоугольные
-    if (optim_faces_time1) std::cout << "Объединение граней (шаг 1):   " << std::setw(6) << optim_faces_time1 << " ms (" << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(optim_faces_time1) / static_cast<double>(full_time) << "%)" << std::endl;
-    if (optim_faces_time2) std::cout << "Объединение граней (шаг 2):   " << std::setw(6) << optim_faces_time2 << " ms (" << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(optim_faces_time2) / static_cast<double>(full_time) << "%)" << std::endl;
-    if (optim_faces_time3) std::cout << "Объединение граней (шаг 3):   " << std::setw(6) << optim_faces_time3 << " ms (" << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(optim_faces_time3) / static_cast<double>(full_time) << "%)" << std::endl;
+    print_prof_line("Объединение граней (шаг 1):   ", optim_faces_time1, full_time);
+    print_prof_line("Объединение граней (шаг 2):   ", optim_faces_time2, full_time);
+    print_prof_line("Объединение граней (шаг 3):   ", optim_faces_time3, full_time);
     //  Создание примитивов STEP
-    if (creating_steps)    std::cout << "Создание примитивов SPEP:     " << std::setw(6) << creating_steps    << " ms (" << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(creating_steps) / static_cast<double>(full_time) << "%)" << std::endl;
+    print_prof_line("Создание примитивов SPEP:     ", creating_steps, full_time);
     // Запись файла
-    if (writing_file)      std::cout << "Запись файла:                 " << std::setw(6) << writing_file      << " ms (" << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(writing_file) / static_cast<double>(full_time) << "%)" << std::endl;
+    print_prof_line("Запись файла:                 ", writing_file, full_time);
+  }
+
+  if (PROFILING_HW) {
+    std::cout << std::endl << "Аппаратные счётчики (основной поток и потоки этапов):" << std::endl;
+    std::cout << "                          такты, млн команды, млн    IPC  кэш/1000 пер./1000" << std::endl;
+    print_hw_line("Импорт файлов:            ", importing_hw);
+    print_hw_line("Объединение вершин:       ", welding_hw);
+    print_hw_line("Разделение на фигуры:     ", optim_shells_hw);
+    print_hw_line("Выявление клонов:         ", optim_clones_hw);
+    print_hw_line("Удаление парных рёбер:    ", edges_reducing_hw);
+    print_hw_line("Объединение граней (1):   ", optim_faces_hw1);
+    print_hw_line("Объединение граней (2):   ", optim_faces_hw2);
+    print_hw_line("Объединение граней (3):   ", optim_faces_hw3);
+    print_hw_line("Создание примитивов SPEP: ", creating_steps_hw);
+    print_hw_line("Запись файла:             ", writing_file_hw);
   }
 }
 
+void STEP_API::get_prof(std::vector<std::pair<std::string, uint64_t> >& stages) const {
+  stages = {
+    { "import",       importing },
+    { "weld",         welding },
+    { "separate",     optim_shells_time },
+    { "clones",       optim_clones_time },
+    { "merge_edges",  edges_reducing },
+    { "merge_faces",  optim_faces_time1 },
+    { "reduce_edges", optim_faces_time2 },
+    { "split_edges",  optim_faces_time3 },
+    { "create_steps", creating_steps },
+    { "write",        writing_file }
+  };
+}
+
   }
 
   std::string str_remove_ext(const std::string& filename) {
@@ -11,11 +11,14 @@
 #include <time.h>
 #include <stdio.h>
 #include <string>
+#include <map>
 
 #include "err.h"
 #include "geometry.h"
 #include "shell.h"
 #include "express.h"
+#include "step_output.h"
+#include "perf_counters.h"
 
 namespace express {
 
@@ -58,24 +61,41 @@ namespace express {
     /** Имя выходного файла без расширения и без пути */
     std::string                               g_name;
 
-    /** Полное время обработки */
-    long long unsigned                        start_full_time;
+    /** Время начала обработки (монотонное время в наносекундах, \ref trace::now) */
+    uint64_t                                  start_full_time;
+    // Суммарное время этапов обработки в наносекундах
+    /** Импорт файлов */
+    uint64_t                                  importing;
+    /** Построение объединённой фигуры (объединение вершин) */
+    uint64_t                                  welding;
     /** Объединение треугольных граней в многоугольные (новые грани) */
-    long long unsigned                        optim_faces_time1;
+    uint64_t                                  optim_faces_time1;
     /** Объединение треугольных граней в многоугольные (удаление рёбер) */
-    long long unsigned                        optim_faces_time2;
+    uint64_t                                  optim_faces_time2;
     /** Объединение треугольных граней в многоугольные (составление границ) */
-    long long unsigned                        optim_faces_time3;
+    uint64_t                                  optim_faces_time3;
     /** Разбиение граней на отдельные фигуры */
-    long long unsigned                        optim_shells_time;
+    uint64_t                                  optim_shells_time;
     /** Выявление фигур-клонов */
-    long long unsigned                        optim_clones_time;
+    uint64_t                                  optim_clones_time;
     /** Удаление парных рёбер */
-    long long unsigned                        edges_reducing;
+    uint64_t                                  edges_reducing;
     /** Создание примитивов STEP */
-    long long unsigned                        creating_steps;
+    uint64_t                                  creating_steps;
     /** Запись файла STEP */
-    long long unsigned                        writing_file;
+    uint64_t                                  writing_file;
+
+    // Изменения аппаратных счётчиков процессора за те же этапы
+    perf::counts                              importing_hw;
+    perf::counts                              welding_hw;
+    perf::counts                              optim_faces_hw1;
+    perf::counts                              optim_faces_hw2;
+    perf::counts                              optim_faces_hw3;
+    perf::counts                              optim_shells_hw;
+    perf::counts                              optim_clones_hw;
+    perf::counts                              edges_reducing_hw;
+    perf::counts                              creating_steps_hw;
+    perf::counts                              writing_file_hw;
 
     /** Отладочный вывод, уровень 1 */
     bool                                      DEBUG_PRINT;
@@ -85,6 +105,8 @@ namespace express {
     bool                                      DEBUG_PRINT3;
     /** Измерять временные интервалы операций */
     bool                                      PROFILING;
+    /** Измерять изменения аппаратных счётчиков процессора за этапы обработки */
+    bool                                      PROFILING_HW;
 
     /** Объединять треугольные грани в многоугольные */
     bool                                      OPTIM_FACES;
@@ -92,6 +114,117 @@ namespace express {
     bool                                      OPTIM_CLONES;
     /** Выполнять разделение треугольников из STL на фигуры */
     bool                                      OPTIM_SEPARATION;
+    /** Выводить грани фигур сразу в текст ISO 10303-21, не создавая объекты EXPRESS */
+    bool                                      OPTIM_BREP;
+    /** Выводить объекты каждого файла STL во временный файл сразу после его обработки */
+    bool                                      OPTIM_FLUSH;
+    /** Записывать файл STEP крупными блоками в фоновом потоке */
+    bool                                      OPTIM_ASYNC;
+    /** Проверять нормали и отбрасывать вырожденные треугольники при импорте STL */
+    bool                                      OPTIM_NORMALS;
+    /** Проверять плоскостность граней при объединении треугольных граней в многоугольные */
+    bool                                      OPTIM_PLANE;
+    /** Количество потоков, разбирающих файлы STL и отображающих экземпляры при записи файла STEP */
+    unsigned                                  THREADS;
+    /** Размер файла STL, начиная с которого он разбирается несколькими потоками */
+    size_t                                    PARALLEL_MIN_SIZE;
+    /** Директория кэша обработанных фигур (пустая строка - кэш не используется) */
+    std::string                               CACHE_DIR;
+    /** Директория для записи файлов топологии обработанных фигур (пустая строка - не записываются) */
+    std::string                               TOPOLOGY_DIR;
+    /** Только записывать файлы топологии, не создавая экземпляры STEP */
+    bool                                      TOPOLOGY_ONLY;
+    /** Файлы топологии, записанные при этом запуске, и ключи записанных в них фигур */
+    std::map<std::string, std::string>        topology_files;
+
+    /** Временный файл с текстом граней, выведенных \ref express::brep_writer "brep_writer" */
+    FILE*                                     brep_spool; //-V122_NOPTR
+    /** Количество элементов массива S, учтённых в S_next_id */
+    size_t                                    S_counted;
+    /** Первое свободное уникальное имя после учтённых элементов массива S */
+    unsigned                                  S_next_id;
+    /** Количество элементов массива S, уже выведенных во временный файл или оставленных до записи файла STEP */
+    size_t                                    S_flushed;
+    /** Уникальное имя первого элемента массива S, ещё не выведенного во временный файл */
+    unsigned                                  S_flushed_id;
+    /** Количество элементов массива noS, которые нужны до записи файла STEP */
+    size_t                                    noS_flushed;
+
+    /**
+     * \brief Создать при необходимости временный файл для текста экземпляров.
+     *
+     * \return код ошибки
+     */
+    err_enum_t open_spool();
+
+    /**
+     * \brief Создать фигуры из файла STL: импорт, объединение вершин и рёбер, разделение
+     * на фигуры, выявление клонов, объединение граней и упорядочивание рёбер в границы.
+     *
+     * \param [in] name имя файла STL (без пути)
+     * \param [in] f_name имя файла STL с путём
+     * \param [in] shell_name имя фигуры (для сообщений об ошибках)
+     * \param [out] Shells фигуры (создаются в куче, уничтожаются вызывающей стороной)
+     * \return код ошибки
+     */
+    err_enum_t build_shells(const std::string& name, const std::string& f_name, const std::string& shell_name,
+      std::vector<prim3d::shell*>& Shells);
+
+    /**
+     * \brief Получить имя файла кэша и ключ для файла STL.
+     *
+     * Ключ содержит хеш и размер содержимого файла STL, а также параметры, от которых зависят
+     * создаваемые фигуры: режимы объединения граней, выявления клонов, разделения на фигуры,
+     * проверки нормалей и плоскостности, упорядочивания треугольников и допуски сравнения.
+     * Имя файла кэша составляется из хешей содержимого и ключа.
+     *
+     * \param [in] f_name имя файла STL с путём
+     * \param [out] cache_name имя файла кэша
+     * \param [out] key ключ
+     * \return false, если содержимое файла не удалось прочитать (например, стандартный ввод)
+     */
+    bool cache_key(const std::string& f_name, std::string& cache_name, std::string& key) const;
+
+    /**
+     * \brief Вывести во временный файл объекты, добавленные в массив S после последнего вывода,
+     * и освободить занимаемую ими память.
+     *
+     * Уникальные имена присваиваются объектам сразу. Объекты product остаются в памяти,
+     * так как на них ссылается общая для всех изделий категория изделия, которая выводится
+     * при записи файла STEP.
+     *
+     * \return код ошибки
+     */
+    err_enum_t flush_entities();
+
+    /**
+     * \brief Вывести накопленный текст экземпляров во временный файл и добавить
+     * в массив S соответствующую ему группу экземпляров.
+     *
+     * \param [in,out] text текст экземпляров, очищается после вывода
+     * \param [in] first_id первое уникальное имя, использованное в тексте
+     * \param [in,out] ids_num количество уникальных имён, использованных в тексте, обнуляется после вывода
+     * \return код ошибки
+     */
+    err_enum_t flush_text(std::string& text, unsigned first_id, unsigned& ids_num);
+
+    /**
+     * \brief Записать отображения всех объектов массива S в файл STEP.
+     *
+     * При количестве потоков больше одного массив разбивается на части, которые отображаются
+     * параллельно и записываются в файл в исходном порядке.
+     *
+     * \param [in] out файл STEP
+     * \return код ошибки
+     */
+    err_enum_t write_entities(step_output& out) const;
+
+    /**
+     * \brief Получить уникальное имя, которое будет присвоено следующему добавленному в массив S объекту.
+     *
+     * \return уникальное имя
+     */
+    unsigned get_next_id();
 
   public:
 
@@ -152,6 +285,14 @@ namespace express {
      */
     err_enum_t CreateShell(const prim3d::shell& sh);
 
+    /**
+     * \brief Вывести грани фигуры sh сразу в текст ISO 10303-21 без создания объектов EXPRESS.
+     *
+     * \param [in] sh фигура
+     * \return код ошибки
+     */
+    err_enum_t CreateShellDirect(const prim3d::shell& sh);
+
     /**
      * \brief Сохранить файл в формате STEP.
      *
@@ -166,6 +307,14 @@ namespace express {
      */
     void print_prof(void) const;
 
+    /**
+     * \brief Получить результаты профилирования: суммарное время этапов обработки.
+     *
+     * \param [out] stages пары "название этапа - время в наносекундах" в порядке вывода
+     * \ref print_prof
+     */
+    void get_prof(std::vector<std::pair<std::string, uint64_t> >& stages) const;
+
     /**
      * \brief Включить или выключть отладочный вывод, уровень 1
      *
@@ -230,6 +379,109 @@ namespace express {
       OPTIM_SEPARATION = val;
     }
 
+    /**
+     * \brief Включить или выключить режим непосредственного вывода граней в текст ISO 10303-21
+     *
+     * \param [in] val значение режима непосредственного вывода граней
+     */
+    void set_optim_brep(bool val) {
+      OPTIM_BREP = val;
+    }
+
+    /**
+     * \brief Включить или выключить режим вывода объектов во временный файл сразу после обработки файла STL
+     *
+     * \param [in] val значение режима вывода объектов после обработки файла STL
+     */
+    void set_optim_flush(bool val) {
+      OPTIM_FLUSH = val;
+    }
+
+    /**
+     * \brief Включить или выключить режим записи файла STEP в фоновом потоке
+     *
+     * \param [in] val значение режима записи файла STEP в фоновом потоке
+     */
+    void set_optim_async(bool val) {
+      OPTIM_ASYNC = val;
+    }
+
+    /**
+     * \brief Включить или выключить проверку нормалей и отбрасывание вырожденных треугольников при импорте STL
+     *
+     * \param [in] val новое значение
+     */
+    void set_optim_normals(bool val) {
+      OPTIM_NORMALS = val;
+    }
+
+    /**
+     * \brief Включить или выключить проверку плоскостности граней при объединении треугольных граней
+     *
+     * \param [in] val новое значение
+     */
+    void set_optim_plane(bool val) {
+      OPTIM_PLANE = val;
+    }
+
+    /**
+     * \brief Задать директорию кэша обработанных фигур. Фигуры файла STL, содержимое
+     * и параметры обработки которого совпадают с сохранёнными в кэше, загружаются из кэша
+     * без импорта и объединения граней; фигуры остальных файлов сохраняются в кэш.
+     *
+     * \param [in] dir директория (пустая строка - кэш не используется)
+     */
+    void set_cache_dir(const std::string& dir) {
+      CACHE_DIR = dir;
+      if (!CACHE_DIR.empty() && CACHE_DIR.back() != '/' && CACHE_DIR.back() != '\\') CACHE_DIR += '/';
+    }
+
+    /**
+     * \brief Задать директорию для записи файлов топологии: фигуры каждого обработанного
+     * файла STL записываются в файл "имя.s2t" этой директории (см. \ref topology.h).
+     *
+     * \param [in] dir директория (пустая строка - файлы топологии не записываются)
+     */
+    void set_topology_dir(const std::string& dir) {
+      TOPOLOGY_DIR = dir;
+      if (!TOPOLOGY_DIR.empty() && TOPOLOGY_DIR.back() != '/' && TOPOLOGY_DIR.back() != '\\') TOPOLOGY_DIR += '/';
+    }
+
+    /**
+     * \brief Включить или выключить режим, в котором файлы STL только преобразуются
+     * в файлы топологии, без создания экземпляров STEP
+     *
+     * \param [in] val новое значение
+     */
+    void set_topology_only(bool val) {
+      TOPOLOGY_ONLY = val;
+    }
+
+    /**
+     * \brief Получить значение режима записи только файлов топологии
+     *
+     * \return true, если экземпляры STEP не создаются
+     */
+    bool get_topology_only() const { return TOPOLOGY_ONLY; }
+
+    /**
+     * \brief Задать количество потоков, разбирающих файлы STL и отображающих экземпляры при записи файла STEP
+     *
+     * \param [in] val количество потоков (1 - чтение и запись без дополнительных потоков)
+     */
+    void set_threads(unsigned val) {
+      THREADS = (val == 0) ? 1 : val;
+    }
+
+    /**
+     * \brief Задать размер файла STL, начиная с которого он разбирается несколькими потоками
+     *
+     * \param [in] val размер файла, байт (0 - все файлы, которые можно отобразить в память)
+     */
+    void set_parallel_min_size(size_t val) {
+      PARALLEL_MIN_SIZE = val;
+    }
+
     /**
      * \brief Включить или выключить режим измерения временных интервалов операций
      *
@@ -238,6 +490,18 @@ namespace express {
     void set_profiling(bool val) {
       PROFILING = val;
     }
+
+    /**
+     * \brief Включить или выключить режим измерения аппаратных счётчиков процессора
+     * (вместе с измерением временных интервалов). Если счётчики недоступны,
+     * измеряются только временные интервалы.
+     *
+     * \param [in] val значение режима измерения аппаратных счётчиков
+     */
+    void set_profiling_hw(bool val) {
+      PROFILING_HW = val && perf::enable();
+      if (val) PROFILING = true;
+    }
   };
 }
 
@@ -9,6 +9,7 @@
 #include "err.h"
 #include "shell.h"
 #include "support.h"
+#include "trace.h"
 
 namespace express {
 
@@ -24,6 +25,8 @@ namespace express {
     const product_definition_or_reference* m_product_definition_or_reference,
     const geometry::vector* shift)
   {
+    trace::span shell_span("process_shell", "shell");
+    shell_span.arg("product", product_name);
 
     // Изделие - фигура (замкнутая оболочка)
     product* s_product = new product(product_name, product_name);
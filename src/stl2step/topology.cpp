@@ -0,0 +1,130 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями функций и методов класса чтения файла топологии
+ */
+
+#include "stdafx.h"
+#include "err.h"
+#include "topology.h"
+
+namespace topology {
+
+  /** \brief Размер записей разделов в порядке \ref section_t */
+  static const size_t record_size[SECTIONS_NUM] = {
+    sizeof(shell_t),
+    sizeof(vertex_t),
+    sizeof(face_t),
+    sizeof(border_t),
+    sizeof(uint32_t),
+    sizeof(edge_t)
+  };
+
+  /**
+   * \brief Проверка: диапазон записей [first, first + num) находится внутри [0, total).
+   *
+   * \param [in] first номер первой записи
+   * \param [in] num количество записей
+   * \param [in] total количество записей раздела
+   * \return true, если диапазон находится внутри раздела
+   */
+  static bool in_range(uint32_t first, uint32_t num, uint32_t total) {
+    return first <= total && num <= total - first;
+  }
+
+  /**
+   * \file
+   * * \copybrief topology::is_topology_name(const std::string&)
+   */
+  bool is_topology_name(const std::string& name) {
+    size_t pos = name.find_last_of('.');
+    if (pos == std::string::npos) return false;
+    std::string ext = name.substr(pos);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext.compare(".s2t") == 0;
+  }
+
+  /**
+   * \file
+   * * \copybrief topology::file::open(const std::string&)
+   */
+  err_enum_t file::open(const std::string& fname) {
+    header = nullptr;
+    if (!map.open(fname)) return err_enum_t::ERROR_FILE_IO;
+
+    const size_t size = map.get_size();
+    if (size < sizeof(header_t)) return err_enum_t::ERROR_IMPORT;
+    const header_t* h = reinterpret_cast<const header_t*>(map.get_data());
+    if (memcmp(h->magic, TOPOLOGY_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != TOPOLOGY_VERSION ||
+        h->byte_order != TOPOLOGY_BYTE_ORDER ||
+        h->real_size != sizeof(geometry::real) ||
+        h->key_size > size - sizeof(header_t)) {
+      return err_enum_t::ERROR_IMPORT;
+    }
+
+    /** Разделы следуют за ключом по порядку, не перекрываясь, и помещаются в файле */
+    uint64_t pos = sizeof(header_t) + h->key_size;
+    for (int s = 0; s < SECTIONS_NUM; ++s) {
+      if (h->offset[s] < pos || h->offset[s] % TOPOLOGY_ALIGN != 0 || h->offset[s] > size ||
+          (size - h->offset[s]) / record_size[s] < h->num[s]) {
+        return err_enum_t::ERROR_IMPORT;
+      }
+      pos = h->offset[s] + h->num[s] * record_size[s];
+    }
+
+    header = h;
+    if (!check_references()) {
+      header = nullptr;
+      return err_enum_t::ERROR_IMPORT;
+    }
+    return err_enum_t::ERROR_OK;
+  }
+
+  /**
+   * \file
+   * * \copybrief topology::file::check_references() const
+   */
+  bool file::check_references() const {
+    const shell_t* shells = get_shells();
+    const face_t* faces = get_faces();
+    const border_t* borders = get_borders();
+    const uint32_t* oriented = get_oriented();
+    const edge_t* edges = get_edges();
+
+    for (uint32_t s = 0; s < header->num[SECTION_SHELLS]; ++s) {
+      const shell_t& sh = shells[s];
+      /** Клон ссылается на предшествующую ему фигуру, которая сама не является клоном */
+      if (sh.clone != TOPOLOGY_NONE) {
+        if (sh.clone >= s || shells[sh.clone].clone != TOPOLOGY_NONE) return false;
+        if (sh.vertexes_num != 0 || sh.edges_num != 0 || sh.faces_num != 0) return false;
+        continue;
+      }
+      if (!in_range(sh.first_vertex, sh.vertexes_num, header->num[SECTION_VERTEXES]) ||
+          !in_range(sh.first_edge, sh.edges_num, header->num[SECTION_EDGES]) ||
+          !in_range(sh.first_face, sh.faces_num, header->num[SECTION_FACES])) {
+        return false;
+      }
+
+      for (uint32_t e = sh.first_edge; e < sh.first_edge + sh.edges_num; ++e) {
+        const edge_t& ed = edges[e];
+        if (ed.start - sh.first_vertex >= sh.vertexes_num || ed.end - sh.first_vertex >= sh.vertexes_num ||
+            (ed.left != TOPOLOGY_NONE && ed.left - sh.first_face >= sh.faces_num) ||
+            (ed.right != TOPOLOGY_NONE && ed.right - sh.first_face >= sh.faces_num)) {
+          return false;
+        }
+      }
+
+      for (uint32_t f = sh.first_face; f < sh.first_face + sh.faces_num; ++f) {
+        if (!in_range(faces[f].first_border, faces[f].borders_num, header->num[SECTION_BORDERS])) return false;
+        for (uint32_t b = faces[f].first_border; b < faces[f].first_border + faces[f].borders_num; ++b) {
+          if (!in_range(borders[b].first_edge, borders[b].edges_num, header->num[SECTION_ORIENTED])) return false;
+          for (uint32_t o = borders[b].first_edge; o < borders[b].first_edge + borders[b].edges_num; ++o) {
+            if (oriented[o] / 2 - sh.first_edge >= sh.edges_num) return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+}
@@ -0,0 +1,243 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с описанием двоичного формата обработанных фигур и объявлением
+ * класса чтения файла этого формата
+ *
+ * Файл топологии (расширение .s2t) содержит фигуры после объединения вершин и рёбер,
+ * разделения на фигуры, выявления клонов, объединения граней и упорядочивания рёбер
+ * в границы - в том виде, в каком они передаются созданию экземпляров STEP. Файл
+ * состоит из заголовка, ключа (описания исходного файла и параметров обработки) и шести
+ * разделов массивов записей постоянного размера, выровненных на 8 байт: фигуры, вершины,
+ * грани, границы, направленные рёбра и рёбра. Записи ссылаются друг на друга номерами
+ * в разделах файла, поэтому отображённый в память файл используется без разбора
+ * и без создания объектов для каждой записи.
+ *
+ * Числа записываются в порядке байт и с размером вещественного числа той программы,
+ * которая записала файл: заголовок содержит образец числа для проверки порядка байт
+ * и размер \ref geometry::real. Файл, записанный программой с другим порядком байт
+ * или другим типом координат, не читается.
+ */
+
+#ifndef _TOPOLOGY_H
+#define _TOPOLOGY_H
+
+#include "err.h"
+#include "geometry.h"
+#include "mapped_file.h"
+
+/** \brief Сигнатура файла топологии */
+#define TOPOLOGY_MAGIC "S2STOPOL"
+
+/** \brief Версия формата файла топологии */
+#define TOPOLOGY_VERSION 1
+
+/** \brief Образец числа для проверки порядка байт */
+#define TOPOLOGY_BYTE_ORDER 0x01020304u
+
+/** \brief Номер, обозначающий отсутствие записи (грани ребра, исходной фигуры клона) */
+#define TOPOLOGY_NONE 0xFFFFFFFFu
+
+/** \brief Выравнивание разделов файла топологии, байт */
+#define TOPOLOGY_ALIGN 8
+
+namespace topology {
+
+  /**
+   * \brief Разделы файла топологии в порядке следования в файле
+   */
+  enum section_t {
+    /** Фигуры (\ref shell_t) */
+    SECTION_SHELLS = 0,
+    /** Вершины (\ref vertex_t) */
+    SECTION_VERTEXES,
+    /** Грани (\ref face_t) */
+    SECTION_FACES,
+    /** Границы граней (\ref border_t) */
+    SECTION_BORDERS,
+    /** Направленные рёбра границ: номер ребра, умноженный на 2, плюс 1 для прямого направления */
+    SECTION_ORIENTED,
+    /** Рёбра (\ref edge_t) */
+    SECTION_EDGES,
+    /** Количество разделов */
+    SECTIONS_NUM
+  };
+
+  /**
+   * \brief Заголовок файла топологии
+   */
+  struct header_t {
+    /** Сигнатура \ref TOPOLOGY_MAGIC (без завершающего нуля) */
+    char magic[8];
+    /** Версия формата \ref TOPOLOGY_VERSION */
+    uint32_t version;
+    /** Образец числа \ref TOPOLOGY_BYTE_ORDER */
+    uint32_t byte_order;
+    /** Размер \ref geometry::real, байт */
+    uint32_t real_size;
+    /** Длина ключа, байт (ключ следует за заголовком) */
+    uint32_t key_size;
+    /** Количество записей разделов */
+    uint32_t num[SECTIONS_NUM];
+    /** Смещение разделов от начала файла, байт */
+    uint64_t offset[SECTIONS_NUM];
+  };
+
+  /**
+   * \brief Запись фигуры. Записи фигуры занимают непрерывные диапазоны разделов;
+   * у клона диапазоны пустые.
+   */
+  struct shell_t {
+    /** Условный центр фигуры */
+    geometry::real pos[3];
+    /** Номер исходной фигуры клона или \ref TOPOLOGY_NONE */
+    uint32_t clone;
+    /** Номер первой вершины */
+    uint32_t first_vertex;
+    /** Количество вершин */
+    uint32_t vertexes_num;
+    /** Номер первого ребра */
+    uint32_t first_edge;
+    /** Количество рёбер */
+    uint32_t edges_num;
+    /** Номер первой грани */
+    uint32_t first_face;
+    /** Количество граней */
+    uint32_t faces_num;
+    /** Не используется (выравнивание) */
+    uint32_t reserved;
+  };
+
+  /**
+   * \brief Запись вершины
+   */
+  struct vertex_t {
+    /** Координаты */
+    geometry::real coord[3];
+  };
+
+  /**
+   * \brief Запись грани
+   */
+  struct face_t {
+    /** Нормаль */
+    geometry::real normal[3];
+    /** Номер первой границы */
+    uint32_t first_border;
+    /** Количество границ */
+    uint32_t borders_num;
+  };
+
+  /**
+   * \brief Запись границы грани
+   */
+  struct border_t {
+    /** Номер первого направленного ребра */
+    uint32_t first_edge;
+    /** Количество направленных рёбер */
+    uint32_t edges_num;
+  };
+
+  /**
+   * \brief Запись ребра
+   */
+  struct edge_t {
+    /** Номер начальной вершины */
+    uint32_t start;
+    /** Номер конечной вершины */
+    uint32_t end;
+    /** Номер левой грани или \ref TOPOLOGY_NONE (грань объединена с соседней) */
+    uint32_t left;
+    /** Номер правой грани или \ref TOPOLOGY_NONE */
+    uint32_t right;
+  };
+
+  /**
+   * \brief Проверка: файл является файлом топологии (по расширению .s2t).
+   *
+   * \param [in] name имя файла
+   * \return true, если имя файла имеет расширение .s2t
+   */
+  bool is_topology_name(const std::string& name);
+
+  /**
+   * \brief Файл топологии, отображённый в память.
+   *
+   * При открытии проверяются заголовок, границы разделов и все номера записей (каждая
+   * фигура ссылается только на свои вершины, рёбра, грани и границы), после чего записи
+   * доступны по адресам в отображении без копирования.
+   */
+  class file {
+
+  private:
+
+    /** \brief Отображение файла */
+    mapped_file map;
+
+    /** \brief Заголовок (nullptr, если файл не открыт) */
+    const header_t* header;
+
+    /**
+     * \brief Получить адрес раздела.
+     *
+     * \param [in] s раздел
+     * \return адрес первой записи раздела
+     */
+    template <typename T> const T* section(section_t s) const {
+      return reinterpret_cast<const T*>(map.get_data() + header->offset[s]);
+    }
+
+    /**
+     * \brief Проверить номера записей, на которые ссылаются записи фигур.
+     *
+     * \return true, если все номера находятся в диапазонах своих фигур
+     */
+    bool check_references() const;
+
+  public:
+
+    file() : header(nullptr) {}
+
+    file(const file&) = delete;
+    file& operator=(const file&) = delete;
+
+    /**
+     * \brief Открыть файл топологии.
+     *
+     * \param [in] fname имя файла
+     * \retval err_enum_t::ERROR_OK в случае успешного открытия;
+     * \retval err_enum_t::ERROR_FILE_IO если файла нет или его не удалось отобразить в память;
+     * \retval err_enum_t::ERROR_IMPORT если файл повреждён или записан программой с другим
+     * порядком байт или другим типом координат.
+     */
+    err_enum_t open(const std::string& fname);
+
+    /** \brief Получить ключ (описание исходного файла и параметров обработки) */
+    std::string get_key() const {
+      return std::string(map.get_data() + sizeof(header_t), header->key_size);
+    }
+
+    /** \brief Получить количество записей раздела */
+    uint32_t get_num(section_t s) const { return header->num[s]; }
+
+    /** \brief Получить записи фигур */
+    const shell_t* get_shells() const { return section<shell_t>(SECTION_SHELLS); }
+
+    /** \brief Получить записи вершин */
+    const vertex_t* get_vertexes() const { return section<vertex_t>(SECTION_VERTEXES); }
+
+    /** \brief Получить записи граней */
+    const face_t* get_faces() const { return section<face_t>(SECTION_FACES); }
+
+    /** \brief Получить записи границ */
+    const border_t* get_borders() const { return section<border_t>(SECTION_BORDERS); }
+
+    /** \brief Получить направленные рёбра границ */
+    const uint32_t* get_oriented() const { return section<uint32_t>(SECTION_ORIENTED); }
+
+    /** \brief Получить записи рёбер */
+    const edge_t* get_edges() const { return section<edge_t>(SECTION_EDGES); }
+  };
+}
+
+#endif /* _TOPOLOGY_H */
@@ -0,0 +1,218 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями функций и методов класса трассировки этапов обработки
+ */
+
+#include "stdafx.h"
+#include <chrono>
+#include "err.h"
+#include "trace.h"
+#include "alloc_tracker.h"
+
+namespace trace {
+
+  /**
+   * \brief Записанная область трассировки
+   */
+  struct event {
+    /** Название этапа */
+    const char* name;
+    /** Категория этапа */
+    const char* category;
+    /** Время начала, нс */
+    uint64_t start;
+    /** Длительность, нс */
+    uint64_t duration;
+    /** Номер потока */
+    unsigned tid;
+    /** Аргументы этапа */
+    std::string args;
+  };
+
+  /** \brief Запись областей включена */
+  static std::atomic<bool> is_enabled(false);
+
+  /** \brief Записанные области */
+  static std::vector<event> events;
+
+  /** \brief Защита списка областей от одновременного изменения из разных потоков */
+  static std::mutex events_mutex;
+
+  /** \brief Время начала трассировки - точка отсчёта времени областей */
+  static uint64_t origin = 0;
+
+  /** \brief Количество потоков, получивших номер */
+  static std::atomic<unsigned> threads_num(0);
+
+  /**
+   * \brief Получить номер текущего потока (потоки нумеруются с 1 в порядке первой записи области).
+   *
+   * \return номер потока
+   */
+  static unsigned thread_number() {
+    thread_local unsigned tid = ++threads_num;
+    return tid;
+  }
+
+  /**
+   * \brief Добавить к тексту JSON строку в кавычках с экранированием специальных символов.
+   *
+   * \param [in,out] text текст JSON
+   * \param [in] s строка
+   */
+  static void append_quoted(std::string& text, const std::string& s) {
+    text += '"';
+    for (auto it = s.cbegin(); it != s.cend(); ++it) {
+      const unsigned char c = static_cast<unsigned char>(*it);
+      if (c == '"' || c == '\\') {
+        text += '\\';
+        text += *it;
+      } else if (c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        text += buf;
+      } else {
+        text += *it;
+      }
+    }
+    text += '"';
+  }
+
+  /**
+   * \brief Добавить к тексту JSON время в микросекундах (с точностью до наносекунды).
+   *
+   * \param [in,out] text текст JSON
+   * \param [in] ns время, нс
+   */
+  static void append_us(std::string& text, uint64_t ns) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu.%03u", static_cast<unsigned long long>(ns / 1000), static_cast<unsigned>(ns % 1000));
+    text += buf;
+  }
+
+  uint64_t now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  void enable() {
+    origin = now();
+    is_enabled = true;
+  }
+
+  bool enabled() {
+    return is_enabled;
+  }
+
+  err_enum_t write(const std::string& name) {
+    std::string text = "{\"traceEvents\":[\n";
+    {
+      std::lock_guard<std::mutex> lock(events_mutex);
+      for (auto it = events.cbegin(); it != events.cend(); ++it) {
+        if (it != events.cbegin()) text += ",\n";
+        text += "{\"name\":";
+        append_quoted(text, (*it).name);
+        text += ",\"cat\":";
+        append_quoted(text, (*it).category);
+        text += ",\"ph\":\"X\",\"ts\":";
+        append_us(text, (*it).start - origin);
+        text += ",\"dur\":";
+        append_us(text, (*it).duration);
+        text += ",\"pid\":1,\"tid\":" + std::to_string((*it).tid);
+        if (!(*it).args.empty()) {
+          text += ",\"args\":{" + (*it).args + "}";
+        }
+        text += "}";
+      }
+    }
+    text += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    FILE* out;
+#if defined(_MSC_VER)
+    if (fopen_s(&out, name.c_str(), "wb") != 0) out = nullptr;
+#else
+    out = fopen(name.c_str(), "wb");
+#endif
+    if (out == nullptr) {
+      std::cout << "ERROR (trace::write): can't open file '" << name << "' for writing" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    const bool ok = fwrite(text.data(), 1, text.size(), out) == text.size();
+    if (fclose(out) != 0 || !ok) {
+      std::cout << "ERROR (trace::write): can't write file '" << name << "'" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    return err_enum_t::ERROR_OK;
+  }
+
+  /**
+   * \file
+   * Функции, являющиеся методами класса \ref trace::span "span":
+   * <BR>
+   */
+
+  /**
+   * \file
+   * * \copybrief trace::span::span(const char*, const char*, uint64_t*, perf::counts*)
+   */
+  span::span(const char* name, const char* category, uint64_t* total, perf::counts* hw_total) :
+    name(name), category(category), start(0), total(total), hw_total(hw_total), alloc_prev(alloc::push_stage(name)), done(false) {
+    if (hw_total != nullptr) perf::read(hw_start);
+    start = now();
+  }
+
+  /**
+   * \file
+   * * \copybrief trace::span::~span()
+   */
+  span::~span() {
+    end();
+  }
+
+  /**
+   * \file
+   * * \copybrief trace::span::arg(const char*, const std::string&)
+   */
+  void span::arg(const char* key, const std::string& value) {
+    if (!is_enabled) return;
+    if (!args.empty()) args += ',';
+    append_quoted(args, key);
+    args += ':';
+    append_quoted(args, value);
+  }
+
+  /**
+   * \file
+   * * \copybrief trace::span::arg(const char*, long long)
+   */
+  void span::arg(const char* key, long long value) {
+    if (!is_enabled) return;
+    if (!args.empty()) args += ',';
+    append_quoted(args, key);
+    args += ':' + std::to_string(value);
+  }
+
+  /**
+   * \file
+   * * \copybrief trace::span::end()
+   */
+  void span::end() {
+    if (done) return;
+    done = true;
+    alloc::pop_stage(alloc_prev);
+    const uint64_t duration = now() - start;
+    if (total != nullptr) *total += duration;
+    if (hw_total != nullptr) {
+      perf::counts hw_end;
+      perf::read(hw_end);
+      for (size_t i = 0; i < PERF_COUNTERS_NUM; ++i) {
+        hw_total->values[i] += hw_end.values[i] - hw_start.values[i];
+      }
+    }
+    if (!is_enabled || start < origin) return;
+    const unsigned tid = thread_number();
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.push_back(event{ name, category, start, duration, tid, std::move(args) });
+  }
+}
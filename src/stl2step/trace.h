@@ -0,0 +1,120 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлениями функций и класса трассировки этапов обработки
+ *
+ * Этапы обработки отмечаются областями (span) с монотонным временем начала и длительностью
+ * в наносекундах. Области одного потока вкладываются друг в друга по времени, поэтому
+ * в просмотрщике трассировки (chrome://tracing, ui.perfetto.dev) видна иерархия этапов
+ * для каждого файла и каждой фигуры. Если трассировка не включена, область только
+ * засекает время для счётчиков профилирования.
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "err.h"
+#include "perf_counters.h"
+
+namespace trace {
+
+  /**
+   * \brief Получить монотонное время в наносекундах.
+   *
+   * \return время от произвольного момента в прошлом
+   */
+  uint64_t now();
+
+  /**
+   * \brief Включить запись областей трассировки.
+   */
+  void enable();
+
+  /**
+   * \brief Проверка: запись областей трассировки включена.
+   *
+   * \return true, если области записываются
+   */
+  bool enabled();
+
+  /**
+   * \brief Записать накопленные области в файл в формате Chrome Trace Event (JSON).
+   *
+   * \param [in] name имя файла
+   * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+   */
+  err_enum_t write(const std::string& name);
+
+  /**
+   * \brief Область трассировки: этап обработки от создания объекта до его уничтожения
+   * (или до вызова \ref end).
+   */
+  class span {
+
+  private:
+
+    /** Название этапа */
+    const char* name;
+    /** Категория этапа */
+    const char* category;
+    /** Время начала, нс */
+    uint64_t start;
+    /** Счётчик, к которому добавляется длительность этапа, или nullptr */
+    uint64_t* total;
+    /** Аппаратные счётчики, к которым добавляются их изменения за этап, или nullptr */
+    perf::counts* hw_total;
+    /** Значения аппаратных счётчиков в начале этапа */
+    perf::counts hw_start;
+    /** Аргументы этапа - текст пар "ключ":значение JSON через запятую */
+    std::string args;
+    /** Этап, действовавший до начала этого, для учёта выделения памяти (\ref alloc::push_stage) */
+    unsigned alloc_prev;
+    /** Этап завершён */
+    bool done;
+
+  public:
+
+    /**
+     * \brief Начать этап.
+     *
+     * \param [in] name название этапа (строковая константа)
+     * \param [in] category категория этапа (строковая константа)
+     * \param [in] total счётчик, к которому добавляется длительность этапа в наносекундах, или nullptr
+     * \param [in] hw_total аппаратные счётчики, к которым добавляются их изменения за этап, или nullptr
+     * (учитываются только при открытых счётчиках, \ref perf::enable, этап должен выполняться
+     * в основном потоке; потоки этапа учитываются, если они завершаются до его окончания)
+     */
+    span(const char* name, const char* category, uint64_t* total = nullptr, perf::counts* hw_total = nullptr);
+
+    /**
+     * \brief Завершить этап, если он не был завершён.
+     */
+    ~span();
+
+    span(const span&) = delete;
+    span& operator=(const span&) = delete;
+
+    /**
+     * \brief Добавить к этапу строковый аргумент (только при включённой трассировке).
+     *
+     * \param [in] key имя аргумента
+     * \param [in] value значение аргумента
+     */
+    void arg(const char* key, const std::string& value);
+
+    /**
+     * \brief Добавить к этапу числовой аргумент (только при включённой трассировке).
+     *
+     * \param [in] key имя аргумента
+     * \param [in] value значение аргумента
+     */
+    void arg(const char* key, long long value);
+
+    /**
+     * \brief Завершить этап: добавить его длительность к счётчику и записать область.
+     */
+    void end();
+  };
+}
+
+#endif /* _TRACE_H */
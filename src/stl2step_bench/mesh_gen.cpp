@@ -0,0 +1,242 @@
+/**
+ * \file
+ *
+ * \brief Файл с определениями функций создания синтетических фигур
+ */
+
+#include "stdafx.h"
+#include "mesh_gen.h"
+
+/** \brief Радиус цилиндра семейства cylinder */
+#define CYLINDER_R 10.0
+/** \brief Высота цилиндра семейства cylinder */
+#define CYLINDER_H 20.0
+/** \brief Количество сегментов вывода семейства pins */
+#define PIN_SEGMENTS 16
+/** \brief Шаг выводов семейства pins */
+#define PIN_PITCH 2.54
+/** \brief Количество коробок семейства boxes */
+#define BOXES_NUM 4
+/** \brief Число пи */
+#define GEN_PI 3.14159265358979323846
+
+namespace mesh_gen {
+
+  /**
+   * \brief Добавить треугольную грань с нормалью, вычисленной по обходу вершин против
+   * часовой стрелки (если смотреть снаружи).
+   *
+   * \param [in,out] faces грани
+   * \param [in] x0,y0,z0 первая вершина
+   * \param [in] x1,y1,z1 вторая вершина
+   * \param [in] x2,y2,z2 третья вершина
+   */
+  static void add_triangle(std::vector<geometry::vector>& faces,
+    double x0, double y0, double z0,
+    double x1, double y1, double z1,
+    double x2, double y2, double z2) {
+    const double ux = x1 - x0, uy = y1 - y0, uz = z1 - z0;
+    const double vx = x2 - x0, vy = y2 - y0, vz = z2 - z0;
+    double nx = uy * vz - uz * vy;
+    double ny = uz * vx - ux * vz;
+    double nz = ux * vy - uy * vx;
+    const double len = sqrt(nx * nx + ny * ny + nz * nz);
+    if (len > 0.0) {
+      nx /= len;
+      ny /= len;
+      nz /= len;
+    }
+    faces.emplace_back(static_cast<geometry::real>(nx), static_cast<geometry::real>(ny), static_cast<geometry::real>(nz));
+    faces.emplace_back(static_cast<geometry::real>(x0), static_cast<geometry::real>(y0), static_cast<geometry::real>(z0));
+    faces.emplace_back(static_cast<geometry::real>(x1), static_cast<geometry::real>(y1), static_cast<geometry::real>(z1));
+    faces.emplace_back(static_cast<geometry::real>(x2), static_cast<geometry::real>(y2), static_cast<geometry::real>(z2));
+  }
+
+  /**
+   * \brief Добавить четырёхугольник из двух треугольных граней, обращённый наружу
+   * в направлении dir (порядок обхода вершин при необходимости меняется на обратный).
+   *
+   * \param [in,out] faces грани
+   * \param [in] p вершины четырёхугольника по порядку обхода
+   * \param [in] dir направление наружу
+   */
+  static void add_quad(std::vector<geometry::vector>& faces, const double (&p)[4][3], const double (&dir)[3]) {
+    const double ux = p[1][0] - p[0][0], uy = p[1][1] - p[0][1], uz = p[1][2] - p[0][2];
+    const double vx = p[2][0] - p[0][0], vy = p[2][1] - p[0][1], vz = p[2][2] - p[0][2];
+    const double d = (uy * vz - uz * vy) * dir[0] + (uz * vx - ux * vz) * dir[1] + (ux * vy - uy * vx) * dir[2];
+    const size_t a = (d >= 0.0) ? 1 : 3;
+    const size_t c = (d >= 0.0) ? 3 : 1;
+    add_triangle(faces, p[0][0], p[0][1], p[0][2], p[a][0], p[a][1], p[a][2], p[2][0], p[2][1], p[2][2]);
+    add_triangle(faces, p[0][0], p[0][1], p[0][2], p[2][0], p[2][1], p[2][2], p[c][0], p[c][1], p[c][2]);
+  }
+
+  /**
+   * \brief Добавить коробку, каждая сторона которой разбита на N*N квадратов.
+   *
+   * \param [in,out] faces грани
+   * \param [in] n количество делений стороны
+   * \param [in] o начальный угол коробки
+   * \param [in] size размеры коробки
+   */
+  static void add_box(std::vector<geometry::vector>& faces, size_t n, const double (&o)[3], const double (&size)[3]) {
+    for (size_t axis = 0; axis < 3; ++axis) {
+      const size_t a1 = (axis + 1) % 3;
+      const size_t a2 = (axis + 2) % 3;
+      for (size_t side = 0; side < 2; ++side) {
+        double dir[3] = { 0.0, 0.0, 0.0 };
+        dir[axis] = side ? 1.0 : -1.0;
+        for (size_t i = 0; i < n; ++i) {
+          for (size_t j = 0; j < n; ++j) {
+            double p[4][3];
+            for (size_t k = 0; k < 4; ++k) {
+              const size_t di = i + ((k == 1 || k == 2) ? 1 : 0);
+              const size_t dj = j + ((k >= 2) ? 1 : 0);
+              p[k][axis] = o[axis] + (side ? size[axis] : 0.0);
+              p[k][a1] = o[a1] + size[a1] * static_cast<double>(di) / static_cast<double>(n);
+              p[k][a2] = o[a2] + size[a2] * static_cast<double>(dj) / static_cast<double>(n);
+            }
+            add_quad(faces, p, dir);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief Добавить цилиндр с осью, параллельной оси Z.
+   *
+   * \param [in,out] faces грани
+   * \param [in] n количество сегментов
+   * \param [in] x,y центр нижнего основания
+   * \param [in] r радиус
+   * \param [in] h высота
+   */
+  static void add_cylinder(std::vector<geometry::vector>& faces, size_t n, double x, double y, double r, double h) {
+    for (size_t i = 0; i < n; ++i) {
+      const double a0 = 2.0 * GEN_PI * static_cast<double>(i) / static_cast<double>(n);
+      const double a1 = 2.0 * GEN_PI * static_cast<double>((i + 1) % n) / static_cast<double>(n);
+      const double x0 = x + r * cos(a0), y0 = y + r * sin(a0);
+      const double x1 = x + r * cos(a1), y1 = y + r * sin(a1);
+      add_triangle(faces, x0, y0, 0.0, x1, y1, 0.0, x1, y1, h);
+      add_triangle(faces, x0, y0, 0.0, x1, y1, h, x0, y0, h);
+      add_triangle(faces, x, y, h, x0, y0, h, x1, y1, h);
+      add_triangle(faces, x, y, 0.0, x1, y1, 0.0, x0, y0, 0.0);
+    }
+  }
+
+  void make_boxes(size_t n, size_t boxes, std::vector<geometry::vector>& faces) {
+    const double l = static_cast<double>(n);
+    faces.clear();
+    faces.reserve(boxes * 6 * n * n * 2 * 4);
+    for (size_t b = 0; b < boxes; ++b) {
+      const double o[3] = { 2.0 * l * static_cast<double>(b), 0.0, 0.0 };
+      const double size[3] = { l, l, l };
+      add_box(faces, n, o, size);
+    }
+  }
+
+  void make_cylinder(size_t n, std::vector<geometry::vector>& faces) {
+    faces.clear();
+    faces.reserve(n * 4 * 4);
+    add_cylinder(faces, n < 3 ? 3 : n, 0.0, 0.0, CYLINDER_R, CYLINDER_H);
+  }
+
+  void make_pins(size_t k, std::vector<geometry::vector>& faces) {
+    faces.clear();
+    faces.reserve(k * PIN_SEGMENTS * 4 * 4);
+    for (size_t i = 0; i < k; ++i) {
+      add_cylinder(faces, PIN_SEGMENTS, PIN_PITCH * static_cast<double>(i), 0.0, 0.5, 3.0);
+    }
+  }
+
+  void make_plate(size_t g, std::vector<geometry::vector>& faces) {
+    /** Ячейка сплошная (не отверстие и не за краем пластины) */
+    auto solid = [g](long i, long j) {
+      return i >= 0 && j >= 0 && i < static_cast<long>(g) && j < static_cast<long>(g) && !(i % 3 == 1 && j % 3 == 1);
+    };
+    /** Соседние ячейки: смещение и направление наружу */
+    static const long steps[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+    static const double up[3] = { 0.0, 0.0, 1.0 };
+    static const double down[3] = { 0.0, 0.0, -1.0 };
+
+    faces.clear();
+    faces.reserve(g * g * 4 * 4);
+    for (long i = 0; i < static_cast<long>(g); ++i) {
+      for (long j = 0; j < static_cast<long>(g); ++j) {
+        if (!solid(i, j)) continue;
+        const double x = static_cast<double>(i), y = static_cast<double>(j);
+        const double top[4][3] = { { x, y, 1.0 }, { x + 1.0, y, 1.0 }, { x + 1.0, y + 1.0, 1.0 }, { x, y + 1.0, 1.0 } };
+        const double bottom[4][3] = { { x, y, 0.0 }, { x + 1.0, y, 0.0 }, { x + 1.0, y + 1.0, 0.0 }, { x, y + 1.0, 0.0 } };
+        add_quad(faces, top, up);
+        add_quad(faces, bottom, down);
+        for (size_t s = 0; s < 4; ++s) {
+          if (solid(i + steps[s][0], j + steps[s][1])) continue;
+          const double dir[3] = { static_cast<double>(steps[s][0]), static_cast<double>(steps[s][1]), 0.0 };
+          /** Ребро ячейки со стороны соседа */
+          const double ex = x + (steps[s][0] > 0 ? 1.0 : 0.0);
+          const double ey = y + (steps[s][1] > 0 ? 1.0 : 0.0);
+          const double dx = steps[s][0] ? 0.0 : 1.0;
+          const double dy = steps[s][1] ? 0.0 : 1.0;
+          const double wall[4][3] = { { ex, ey, 0.0 }, { ex + dx, ey + dy, 0.0 }, { ex + dx, ey + dy, 1.0 }, { ex, ey, 1.0 } };
+          add_quad(faces, wall, dir);
+        }
+      }
+    }
+  }
+
+  void make_parts(size_t m, std::vector<geometry::vector>& faces) {
+    /** Детали располагаются рядами по квадратной сетке */
+    size_t row = 1;
+    while (row * row < m) ++row;
+    faces.clear();
+    faces.reserve(m * 12 * 4);
+    for (size_t i = 0; i < m; ++i) {
+      const double o[3] = { 3.0 * static_cast<double>(i % row), 3.0 * static_cast<double>(i / row), 0.0 };
+      const double d = 0.001 * static_cast<double>(i);
+      const double size[3] = { 1.0 + d, 1.5 - d / 2.0, 2.0 + d / 4.0 };
+      add_box(faces, 1, o, size);
+    }
+  }
+
+  bool make(const std::string& family, size_t size, std::vector<geometry::vector>& faces) {
+    if (family == "boxes") make_boxes(size, BOXES_NUM, faces);
+    else if (family == "cylinder") make_cylinder(size, faces);
+    else if (family == "pins") make_pins(size, faces);
+    else if (family == "plate") make_plate(size, faces);
+    else if (family == "parts") make_parts(size, faces);
+    else return false;
+    return true;
+  }
+
+  err_enum_t write_stl(const std::string& name, const std::vector<geometry::vector>& faces) {
+    FILE* out;
+#if defined(_MSC_VER)
+    if (fopen_s(&out, name.c_str(), "wb") != 0) out = nullptr;
+#else
+    out = fopen(name.c_str(), "wb");
+#endif
+    if (out == nullptr) {
+      std::cout << "ERROR (mesh_gen::write_stl): can't open file '" << name << "' for writing" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    /** Текст в формате OpenSCAD; координаты выводятся с точностью, достаточной для совпадения вершин */
+    bool ok = fprintf(out, "solid OpenSCAD_Model\n") > 0;
+    for (size_t i = 0; ok && i + 3 < faces.size(); i += 4) {
+      const geometry::vector& n = faces[i];
+      ok = fprintf(out, "  facet normal %.9g %.9g %.9g\n    outer loop\n",
+        static_cast<double>(n.getX()), static_cast<double>(n.getY()), static_cast<double>(n.getZ())) > 0;
+      for (size_t k = 1; ok && k < 4; ++k) {
+        const geometry::vector& v = faces[i + k];
+        ok = fprintf(out, "      vertex %.9g %.9g %.9g\n",
+          static_cast<double>(v.getX()), static_cast<double>(v.getY()), static_cast<double>(v.getZ())) > 0;
+      }
+      ok = ok && fprintf(out, "    endloop\n  endfacet\n") > 0;
+    }
+    ok = ok && fprintf(out, "endsolid OpenSCAD_Model\n") > 0;
+    if (fclose(out) != 0 || !ok) {
+      std::cout << "ERROR (mesh_gen::write_stl): can't write file '" << name << "'" << std::endl;
+      return err_enum_t::ERROR_FILE_IO;
+    }
+    return err_enum_t::ERROR_OK;
+  }
+}
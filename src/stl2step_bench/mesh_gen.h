@@ -0,0 +1,85 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлениями функций создания синтетических фигур
+ *
+ * Фигуры похожи на модели, получаемые из OpenSCAD и САПР печатных плат: цилиндры
+ * с заданным количеством сегментов, ряды одинаковых выводов (клонов), плоские пластины
+ * с отверстиями и наборы многих не связанных деталей. Размер каждого семейства задаётся
+ * одним числом, количество треугольников растёт линейно с ним (для пластины - с квадратом).
+ * Грани записываются плоским списком "нормаль и три вершины", как при импорте STL.
+ */
+
+#ifndef _MESH_GEN_H
+#define _MESH_GEN_H
+
+#include "err.h"
+#include "geometry.h"
+
+namespace mesh_gen {
+
+  /**
+   * \brief Создать несколько не связанных одинаковых коробок, каждая сторона которых
+   * разбита на N*N квадратов из двух треугольников.
+   *
+   * \param [in] n количество делений стороны коробки
+   * \param [in] boxes количество коробок
+   * \param [out] faces грани
+   */
+  void make_boxes(size_t n, size_t boxes, std::vector<geometry::vector>& faces);
+
+  /**
+   * \brief Создать цилиндр (боковая поверхность из N прямоугольников, основания - веером
+   * из N треугольников).
+   *
+   * \param [in] n количество сегментов
+   * \param [out] faces грани
+   */
+  void make_cylinder(size_t n, std::vector<geometry::vector>& faces);
+
+  /**
+   * \brief Создать ряд из K одинаковых выводов (цилиндров из 16 сегментов с шагом 2.54).
+   *
+   * \param [in] k количество выводов
+   * \param [out] faces грани
+   */
+  void make_pins(size_t k, std::vector<geometry::vector>& faces);
+
+  /**
+   * \brief Создать плоскую пластину из G*G ячеек с квадратными отверстиями в каждой
+   * третьей ячейке по обоим направлениям.
+   *
+   * \param [in] g количество ячеек стороны пластины
+   * \param [out] faces грани
+   */
+  void make_plate(size_t g, std::vector<geometry::vector>& faces);
+
+  /**
+   * \brief Создать M не связанных коробок разного размера (не являющихся клонами).
+   *
+   * \param [in] m количество деталей
+   * \param [out] faces грани
+   */
+  void make_parts(size_t m, std::vector<geometry::vector>& faces);
+
+  /**
+   * \brief Создать фигуру семейства с указанным именем.
+   *
+   * \param [in] family имя семейства: boxes, cylinder, pins, plate или parts
+   * \param [in] size размер фигуры
+   * \param [out] faces грани
+   * \return true, если семейство известно
+   */
+  bool make(const std::string& family, size_t size, std::vector<geometry::vector>& faces);
+
+  /**
+   * \brief Записать грани в двоичный файл STL.
+   *
+   * \param [in] name имя файла
+   * \param [in] faces грани
+   * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+   */
+  err_enum_t write_stl(const std::string& name, const std::vector<geometry::vector>& faces);
+}
+
+#endif /* _MESH_GEN_H */
@@ -0,0 +1,193 @@
+/**
+ * \file
+ *
+ * \brief Файл с определением функции оценки масштабируемости преобразования
+ */
+
+#include "stdafx.h"
+#include "support.h"
+#include "mesh_gen.h"
+#include "scaling.h"
+#include "table.h"
+
+namespace scaling {
+
+  /**
+   * \brief Семейство фигур и его наименьший размер
+   */
+  struct family_t {
+    /** Имя семейства (\ref mesh_gen::make) */
+    const char* name;
+    /** Размер фигуры на первом шаге */
+    size_t base;
+  };
+
+  /** \brief Семейства фигур в порядке проверки */
+  static const family_t families_list[] = {
+    { "cylinder", 256 },
+    { "pins",     16 },
+    { "plate",    12 },
+    { "parts",    32 },
+    { "boxes",    2 }
+  };
+
+  /**
+   * \brief Результат преобразования фигуры одного размера
+   */
+  struct sample_t {
+    /** Размер фигуры */
+    size_t size;
+    /** Количество треугольников */
+    size_t triangles;
+    /** Время этапов, нс, в порядке \ref express::STEP_API::get_prof */
+    std::vector<uint64_t> times;
+  };
+
+  /**
+   * \brief Преобразовать файл STL в STEP с измерением времени этапов. Сообщения
+   * преобразователя не выводятся.
+   *
+   * \param [in] stl_name имя файла STL
+   * \param [in] step_name имя файла STEP
+   * \param [out] stages пары "название этапа - время в наносекундах"
+   * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+   */
+  static err_enum_t convert(const std::string& stl_name, const std::string& step_name,
+    std::vector<std::pair<std::string, uint64_t> >& stages) {
+    std::streambuf* old = std::cout.rdbuf(nullptr);
+    express::STEP_API* SAPI = new express::STEP_API(str_remove_path(str_remove_ext(step_name)));
+    SAPI->set_profiling(true);
+    err_enum_t err = SAPI->process_file(stl_name, "", "", geometry::vector(0.5, 0.5, 0.5), 1.0, std::vector<geometry::vector>());
+    if (err == err_enum_t::ERROR_OK) err = SAPI->save(step_name.c_str());
+    SAPI->get_prof(stages);
+    delete SAPI;
+    std::cout.rdbuf(old);
+    return err;
+  }
+
+  /**
+   * \brief Оценить показатель степени зависимости времени от количества треугольников
+   * методом наименьших квадратов в логарифмическом масштабе.
+   *
+   * \param [in] samples результаты преобразования
+   * \param [in] stage номер этапа
+   * \param [out] points количество учтённых размеров (с временем не менее \ref SCALING_MIN_TIME)
+   * \return показатель степени (0, если учтено меньше двух размеров)
+   */
+  static double fit_exponent(const std::vector<sample_t>& samples, size_t stage, size_t& points) {
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    points = 0;
+    for (auto it = samples.cbegin(); it != samples.cend(); ++it) {
+      const uint64_t t = (*it).times[stage];
+      if (t < SCALING_MIN_TIME) continue;
+      const double x = log(static_cast<double>((*it).triangles));
+      const double y = log(static_cast<double>(t));
+      sx += x;
+      sy += y;
+      sxx += x * x;
+      sxy += x * y;
+      ++points;
+    }
+    if (points < 2) return 0.0;
+    const double n = static_cast<double>(points);
+    const double d = n * sxx - sx * sx;
+    return (d > 0.0) ? (n * sxy - sx * sy) / d : 0.0;
+  }
+
+  /**
+   * \brief Преобразовать фигуры одного семейства всех размеров и вывести результаты.
+   *
+   * \param [in] family семейство фигур
+   * \param [in] steps количество размеров
+   * \param [in] repeat количество повторений преобразования
+   * \param [in] dir директория для временных файлов
+   * \param [in,out] superlinear список сверхлинейных этапов "семейство: этап"
+   * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+   */
+  static err_enum_t run_family(const family_t& family, unsigned steps, unsigned repeat, const std::string& dir,
+    std::vector<std::string>& superlinear) {
+    std::vector<std::string> names;
+    std::vector<sample_t> samples;
+    std::vector<geometry::vector> faces;
+
+    std::cout << "Семейство '" << family.name << "'" << std::endl;
+    std::cout << cell("размер", 10, true) << cell("треуг.", 10, true) << cell("всего, мс", 12, true) << std::endl;
+    for (unsigned s = 0; s < steps; ++s) {
+      sample_t sample;
+      sample.size = family.base << s;
+      mesh_gen::make(family.name, sample.size, faces);
+      sample.triangles = faces.size() / 4;
+      const std::string base = dir + "scaling_" + family.name + "_" + std::to_string(sample.size);
+      err_enum_t err = mesh_gen::write_stl(base + ".stl", faces);
+      if (err != err_enum_t::ERROR_OK) return err;
+
+      for (unsigned r = 0; r < repeat; ++r) {
+        std::vector<std::pair<std::string, uint64_t> > stages;
+        err = convert(base + ".stl", base + ".step", stages);
+        if (err != err_enum_t::ERROR_OK) {
+          std::cout << "ERROR (scaling): преобразование файла '" << base << ".stl' завершилось с ошибкой " << static_cast<int>(err) << std::endl;
+          return err;
+        }
+        if (names.empty()) {
+          for (auto it = stages.cbegin(); it != stages.cend(); ++it) names.push_back((*it).first);
+          names.push_back("всего");
+        }
+        uint64_t total = 0;
+        for (size_t i = 0; i < stages.size(); ++i) {
+          total += stages[i].second;
+          if (r == 0) sample.times.push_back(stages[i].second);
+          else sample.times[i] = std::min(sample.times[i], stages[i].second);
+        }
+        if (r == 0) sample.times.push_back(total);
+        else sample.times.back() = std::min(sample.times.back(), total);
+      }
+      remove((base + ".stl").c_str());
+      remove((base + ".step").c_str());
+
+      std::cout << cell(std::to_string(sample.size), 10, true) << cell(std::to_string(sample.triangles), 10, true) <<
+        std::fixed << std::setprecision(1) << std::setw(12) << static_cast<double>(sample.times.back()) / 1000000.0 << std::endl;
+      samples.push_back(sample);
+    }
+
+    std::cout << cell("этап", 16, false) << cell("показатель", 12, true) << cell("размеров", 10, true) << std::endl;
+    for (size_t i = 0; i < names.size(); ++i) {
+      size_t points;
+      const double k = fit_exponent(samples, i, points);
+      std::cout << cell(names[i], 16, false);
+      if (points < 2) {
+        std::cout << cell("-", 12, true) << cell(std::to_string(points), 10, true) << std::endl;
+        continue;
+      }
+      std::cout << std::fixed << std::setprecision(2) << std::setw(12) << k << cell(std::to_string(points), 10, true);
+      if (k > SCALING_SUPERLINEAR && i + 1 < names.size()) {
+        std::cout << "  сверхлинейный";
+        superlinear.push_back(std::string(family.name) + ": " + names[i]);
+      }
+      std::cout << std::endl;
+    }
+    std::cout << std::endl;
+    return err_enum_t::ERROR_OK;
+  }
+
+  err_enum_t run(const std::vector<std::string>& families, unsigned steps, unsigned repeat, const std::string& dir) {
+    std::string path(dir);
+    if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+
+    std::vector<std::string> superlinear;
+    for (size_t f = 0; f < sizeof(families_list) / sizeof(families_list[0]); ++f) {
+      if (!families.empty() && std::find(families.cbegin(), families.cend(), families_list[f].name) == families.cend()) continue;
+      const err_enum_t err = run_family(families_list[f], steps, repeat, path, superlinear);
+      if (err != err_enum_t::ERROR_OK) return err;
+    }
+
+    if (superlinear.empty()) {
+      std::cout << "Сверхлинейных этапов нет" << std::endl;
+    } else {
+      std::cout << "Сверхлинейные этапы (показатель больше " << SCALING_SUPERLINEAR << "):" << std::endl;
+      for (auto it = superlinear.cbegin(); it != superlinear.cend(); ++it) {
+        std::cout << "    " << *it << std::endl;
+      }
+    }
+    return err_enum_t::ERROR_OK;
+  }
+}
@@ -0,0 +1,39 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с объявлением функции оценки масштабируемости преобразования
+ *
+ * Для каждого семейства синтетических фигур (\ref mesh_gen) создаются файлы STL
+ * геометрически растущих размеров, каждый файл полностью преобразуется в STEP с
+ * измерением времени этапов (как при ключе --dp преобразователя). По времени этапа
+ * для разных размеров методом наименьших квадратов в логарифмическом масштабе
+ * оценивается показатель степени роста времени от количества треугольников.
+ * Этапы с показателем выше \ref SCALING_SUPERLINEAR отмечаются как сверхлинейные.
+ */
+
+#ifndef _SCALING_H
+#define _SCALING_H
+
+#include "err.h"
+
+/** \brief Показатель степени роста, начиная с которого этап считается сверхлинейным */
+#define SCALING_SUPERLINEAR 1.25
+
+/** \brief Наименьшее время этапа, нс, учитываемое при оценке показателя степени */
+#define SCALING_MIN_TIME 1000000
+
+namespace scaling {
+
+  /**
+   * \brief Оценить масштабируемость преобразования на синтетических фигурах.
+   *
+   * \param [in] families имена семейств фигур (пустой список - все семейства)
+   * \param [in] steps количество размеров каждого семейства (каждый следующий вдвое больше)
+   * \param [in] repeat количество повторений преобразования каждого файла (берётся наименьшее время этапа)
+   * \param [in] dir директория для временных файлов STL и STEP
+   * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+   */
+  err_enum_t run(const std::vector<std::string>& families, unsigned steps, unsigned repeat, const std::string& dir);
+}
+
+#endif /* _SCALING_H */
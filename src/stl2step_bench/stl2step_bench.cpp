@@ -0,0 +1,481 @@
+/**
+ * \file
+ *
+ * \brief Корневой файл для сборки исполняемого файла микротестов производительности
+ *
+ * Микротесты измеряют время основных вычислительных этапов преобразования (операции
+ * с векторами, объединение вершин, удаление парных рёбер, разделение на фигуры, объединение
+ * граней, выявление клонов, вывод чисел и экземпляров STEP) на синтетических фигурах
+ * заданных размеров. Каждый тест повторяется несколько раз с заново подготовленными
+ * данными (подготовка не учитывается), выводится наименьшее и срединное время на один
+ * обработанный элемент.
+ *
+ * В режиме --scaling файлы синтетических фигур (\ref mesh_gen) удваивающихся размеров
+ * преобразуются полностью, и для каждого этапа оценивается показатель степени роста
+ * времени (\ref scaling). В режиме --gen синтетическая фигура записывается в файл STL.
+ */
+
+#include "stdafx.h"
+#include "err.h"
+#include "support.h"
+#include "arg_parser.h"
+#include "trace.h"
+#include "mesh_gen.h"
+#include "scaling.h"
+#include "table.h"
+
+/** \brief Количество отдельных коробок в синтетической фигуре */
+#define BENCH_BOXES 4
+
+/**
+ * \brief Вывод справки о командной строке.
+ */
+static void print_help() {
+  std::cout << "КРАТКАЯ СПРАВКА" << std::endl;
+  std::cout << "stl2step_bench [--sizes N [N]...] [--repeat R] [--only тест [тест]...]" << std::endl;
+  std::cout << "stl2step_bench --scaling [семейство]... [--steps K] [--repeat R] [--dir директория]" << std::endl;
+  std::cout << "stl2step_bench --gen семейство размер файл.stl" << std::endl;
+  std::cout << "    --sizes N...      - размеры синтетических фигур: количество делений стороны каждой" << std::endl;
+  std::cout << "                        из " << BENCH_BOXES << " коробок, 12*N*N треугольников на коробку (по умолчанию: 4 16 32)" << std::endl;
+  std::cout << "    --repeat R        - количество повторений каждого теста (по умолчанию: 5, для --scaling: 1)" << std::endl;
+  std::cout << "    --only тест...    - выполнить только указанные тесты:" << std::endl;
+  std::cout << "                        vector weld merge_edges separate merge_faces reduce_edges" << std::endl;
+  std::cout << "                        split_edges_to_borders clones real_print entity_print" << std::endl;
+  std::cout << "    --scaling         - преобразовать синтетические фигуры указанных семейств (по умолчанию" << std::endl;
+  std::cout << "                        всех) удваивающихся размеров, оценить показатель степени роста времени" << std::endl;
+  std::cout << "                        каждого этапа и отметить этапы с показателем больше " << SCALING_SUPERLINEAR << std::endl;
+  std::cout << "    --steps K         - количество размеров каждого семейства (по умолчанию: 4)" << std::endl;
+  std::cout << "    --dir директория  - директория временных файлов STL и STEP (по умолчанию: текущая)" << std::endl;
+  std::cout << "    --gen             - записать синтетическую фигуру в файл STL. Семейства и размеры:" << std::endl;
+  std::cout << "                        cylinder N - цилиндр из N сегментов" << std::endl;
+  std::cout << "                        pins K     - ряд из K одинаковых выводов" << std::endl;
+  std::cout << "                        plate G    - пластина G*G с отверстиями" << std::endl;
+  std::cout << "                        parts M    - M не связанных разных деталей" << std::endl;
+  std::cout << "                        boxes N    - " << BENCH_BOXES << " коробки с N*N делениями стороны" << std::endl;
+}
+
+/**
+ * \brief Вывести строку результатов теста.
+ *
+ * \param [in] name название теста
+ * \param [in] n размер фигуры
+ * \param [in] elements количество обработанных элементов в одном повторении
+ * \param [in] unit название элемента
+ * \param [in,out] times время повторений, нс (упорядочивается)
+ */
+static void print_result(const char* name, size_t n, size_t elements, const char* unit, std::vector<uint64_t>& times) {
+  std::sort(times.begin(), times.end());
+  const double e = static_cast<double>(elements > 0 ? elements : 1);
+  std::cout << cell(name, 24, false) << cell(std::to_string(n), 6, true) <<
+    cell(std::to_string(elements), 10, true) << " " << cell(unit, 8, false) << std::fixed << std::setprecision(1) <<
+    std::setw(12) << static_cast<double>(times.front()) / e <<
+    std::setw(12) << static_cast<double>(times[times.size() / 2]) / e << std::endl;
+}
+
+/**
+ * \brief Подготовленные для теста фигуры
+ */
+struct prepared {
+  /** Фигуры после разделения (или одна объединённая фигура) */
+  std::vector<prim3d::shell*> shells;
+
+  /** \brief Деструктор - уничтожение фигур */
+  ~prepared() {
+    for (auto it = shells.begin(); it != shells.end(); ++it) {
+      delete *it;
+    }
+  }
+};
+
+/** \brief Этапы подготовки фигур для теста */
+enum class stage_t {
+  WELD,
+  MERGE_EDGES,
+  SEPARATE,
+  MERGE_FACES,
+  REDUCE_EDGES,
+  SPLIT_EDGES
+};
+
+/**
+ * \brief Подготовить фигуры, выполнив этапы преобразования до указанного включительно.
+ *
+ * \param [in] faces треугольные грани
+ * \param [in] last последний выполняемый этап (не далее REDUCE_EDGES)
+ * \param [out] p подготовленные фигуры
+ * \return код ошибки или \ref err_enum_t::ERROR_OK "ERROR_OK" в случае успешного завершения.
+ */
+static err_enum_t prepare(const std::vector<geometry::vector>& faces, stage_t last, prepared& p) {
+  prim3d::shell* sh = new prim3d::shell(faces);
+  if (last == stage_t::WELD) {
+    p.shells.push_back(sh);
+    return err_enum_t::ERROR_OK;
+  }
+  err_enum_t err = sh->merge_edges(false);
+  if (err != err_enum_t::ERROR_OK || last == stage_t::MERGE_EDGES) {
+    p.shells.push_back(sh);
+    return err;
+  }
+  p.shells = sh->separate();
+  delete sh;
+  if (last == stage_t::SEPARATE) return err_enum_t::ERROR_OK;
+  for (auto it = p.shells.begin(); it != p.shells.end(); ++it) {
+    (*it)->merge_faces(false);
+  }
+  if (last == stage_t::MERGE_FACES) return err_enum_t::ERROR_OK;
+  for (auto it = p.shells.begin(); it != p.shells.end(); ++it) {
+    err = (*it)->reduce_edges(false);
+    if (err != err_enum_t::ERROR_OK) return err;
+  }
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест операций с векторами: нормаль треугольника (разности, векторное
+ * произведение, нормирование) и скалярное произведение с заданной нормалью.
+ */
+static err_enum_t bench_vector(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  std::vector<uint64_t> times;
+  volatile double sink = 0.0;
+  for (unsigned r = 0; r < repeat; ++r) {
+    const uint64_t t0 = trace::now();
+    double sum = 0.0;
+    for (size_t i = 0; i + 3 < faces.size(); i += 4) {
+      const geometry::vector e1 = faces[i + 2] - faces[i + 1];
+      const geometry::vector e2 = faces[i + 3] - faces[i + 1];
+      const geometry::vector nv = (e1 * e2).normalize();
+      sum += nv.scalar(faces[i]);
+    }
+    times.push_back(trace::now() - t0);
+    sink = sink + sum;
+  }
+  print_result("vector", n, faces.size() / 4, "треуг.", times);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест объединения вершин при создании фигуры из треугольных граней.
+ */
+static err_enum_t bench_weld(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  std::vector<uint64_t> times;
+  for (unsigned r = 0; r < repeat; ++r) {
+    const uint64_t t0 = trace::now();
+    prim3d::shell* sh = new prim3d::shell(faces);
+    times.push_back(trace::now() - t0);
+    delete sh;
+  }
+  print_result("weld", n, faces.size() / 4, "треуг.", times);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест удаления парных рёбер.
+ */
+static err_enum_t bench_merge_edges(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  std::vector<uint64_t> times;
+  size_t edges = 0;
+  for (unsigned r = 0; r < repeat; ++r) {
+    prepared p;
+    err_enum_t err = prepare(faces, stage_t::WELD, p);
+    if (err != err_enum_t::ERROR_OK) return err;
+    edges = p.shells.front()->edges_num();
+    const uint64_t t0 = trace::now();
+    err = p.shells.front()->merge_edges(false);
+    times.push_back(trace::now() - t0);
+    if (err != err_enum_t::ERROR_OK) return err;
+  }
+  print_result("merge_edges", n, edges, "рёбер", times);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест разделения граней по не связанным фигурам.
+ */
+static err_enum_t bench_separate(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  std::vector<uint64_t> times;
+  for (unsigned r = 0; r < repeat; ++r) {
+    prepared p;
+    err_enum_t err = prepare(faces, stage_t::MERGE_EDGES, p);
+    if (err != err_enum_t::ERROR_OK) return err;
+    const uint64_t t0 = trace::now();
+    std::vector<prim3d::shell*> shells = p.shells.front()->separate();
+    times.push_back(trace::now() - t0);
+    p.shells.insert(p.shells.end(), shells.begin(), shells.end());
+  }
+  print_result("separate", n, faces.size() / 4, "треуг.", times);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест объединения треугольных граней в многоугольные и следующих за ним этапов.
+ *
+ * \param [in] faces треугольные грани
+ * \param [in] n размер фигуры
+ * \param [in] repeat количество повторений
+ * \param [in] step измеряемый этап: MERGE_FACES, REDUCE_EDGES или SPLIT_EDGES
+ */
+static err_enum_t bench_faces_step(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat, stage_t step) {
+  std::vector<uint64_t> times;
+  /** Фигуры готовятся до предыдущего этапа включительно */
+  const stage_t before = static_cast<stage_t>(static_cast<int>(step) - 1);
+  for (unsigned r = 0; r < repeat; ++r) {
+    prepared p;
+    err_enum_t err = prepare(faces, before, p);
+    if (err != err_enum_t::ERROR_OK) return err;
+    const uint64_t t0 = trace::now();
+    for (auto it = p.shells.begin(); it != p.shells.end() && err == err_enum_t::ERROR_OK; ++it) {
+      if (step == stage_t::MERGE_FACES) {
+        (*it)->merge_faces(false);
+      } else if (step == stage_t::REDUCE_EDGES) {
+        err = (*it)->reduce_edges(false);
+      } else {
+        err = (*it)->split_edges_to_borders(false);
+      }
+    }
+    times.push_back(trace::now() - t0);
+    if (err != err_enum_t::ERROR_OK) return err;
+  }
+  const char* name = (step == stage_t::MERGE_FACES) ? "merge_faces" :
+    (step == stage_t::REDUCE_EDGES) ? "reduce_edges" : "split_edges_to_borders";
+  print_result(name, n, faces.size() / 4, "треуг.", times);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест выявления клонов: приведение координат к условному центру и попарное
+ * сравнение фигур.
+ */
+static err_enum_t bench_clones(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  std::vector<uint64_t> times;
+  size_t vertexes = 0;
+  for (unsigned r = 0; r < repeat; ++r) {
+    prepared p;
+    err_enum_t err = prepare(faces, stage_t::SEPARATE, p);
+    if (err != err_enum_t::ERROR_OK) return err;
+    vertexes = 0;
+    for (auto it = p.shells.cbegin(); it != p.shells.cend(); ++it) {
+      vertexes += (*it)->vertexes_num();
+    }
+    const uint64_t t0 = trace::now();
+    for (auto it = p.shells.begin(); it != p.shells.end(); ++it) {
+      (*it)->normalize_shell();
+    }
+    for (auto it_s1 = p.shells.begin(); it_s1 != p.shells.end(); ++it_s1) {
+      for (auto it_s2 = it_s1 + 1; it_s2 != p.shells.end(); ++it_s2) {
+        if ((*it_s2)->is_clone()) continue;
+        if (**it_s1 == **it_s2) (*it_s2)->set_clone(*it_s1);
+      }
+    }
+    times.push_back(trace::now() - t0);
+  }
+  print_result("clones", n, vertexes, "вершин", times);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест вывода вещественных чисел (\ref express::REAL::print_value) - координат вершин.
+ */
+static err_enum_t bench_real_print(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  std::vector<express::REAL> values;
+  values.reserve(faces.size() / 4 * 9);
+  for (size_t i = 0; i + 3 < faces.size(); i += 4) {
+    for (size_t k = 1; k < 4; ++k) {
+      values.emplace_back(faces[i + k].getX());
+      values.emplace_back(faces[i + k].getY());
+      values.emplace_back(faces[i + k].getZ());
+    }
+  }
+  std::vector<uint64_t> times;
+  volatile size_t sink = 0;
+  for (unsigned r = 0; r < repeat; ++r) {
+    size_t len = 0;
+    const uint64_t t0 = trace::now();
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+      len += (*it).print_value().size();
+    }
+    times.push_back(trace::now() - t0);
+    sink = sink + len;
+  }
+  print_result("real_print", n, values.size(), "чисел", times);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест вывода экземпляров STEP (\ref express::STEP_ENTITY::print) - декартовых точек вершин.
+ */
+static err_enum_t bench_entity_print(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  prepared p;
+  err_enum_t err = prepare(faces, stage_t::WELD, p);
+  if (err != err_enum_t::ERROR_OK) return err;
+  const std::vector<prim3d::vertex*>& vertexes = p.shells.front()->get_vertexes();
+  std::vector<express::cartesian_point*> points;
+  points.reserve(vertexes.size());
+  for (auto it = vertexes.cbegin(); it != vertexes.cend(); ++it) {
+    const geometry::vector& c = (*it)->get_coord();
+    points.push_back(new express::cartesian_point("", c.getX(), c.getY(), c.getZ()));
+    points.back()->set_id(static_cast<unsigned>(points.size()));
+  }
+  std::vector<uint64_t> times;
+  volatile size_t sink = 0;
+  for (unsigned r = 0; r < repeat; ++r) {
+    size_t len = 0;
+    const uint64_t t0 = trace::now();
+    for (auto it = points.cbegin(); it != points.cend(); ++it) {
+      len += (*it)->print().size();
+    }
+    times.push_back(trace::now() - t0);
+    sink = sink + len;
+  }
+  for (auto it = points.begin(); it != points.end(); ++it) {
+    delete *it;
+  }
+  print_result("entity_print", n, points.size(), "экз.", times);
+  return err_enum_t::ERROR_OK;
+}
+
+/**
+ * \brief Тест в списке тестов
+ */
+struct bench_test {
+  /** Название теста */
+  const char* name;
+  /** Функция теста */
+  err_enum_t (*run)(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat);
+};
+
+/** \brief Тест объединения граней */
+static err_enum_t bench_merge_faces(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  return bench_faces_step(faces, n, repeat, stage_t::MERGE_FACES);
+}
+
+/** \brief Тест удаления избыточных рёбер */
+static err_enum_t bench_reduce_edges(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  return bench_faces_step(faces, n, repeat, stage_t::REDUCE_EDGES);
+}
+
+/** \brief Тест упорядочивания рёбер в границы */
+static err_enum_t bench_split_edges(const std::vector<geometry::vector>& faces, size_t n, unsigned repeat) {
+  return bench_faces_step(faces, n, repeat, stage_t::SPLIT_EDGES);
+}
+
+/** \brief Список тестов в порядке этапов преобразования */
+static const bench_test tests[] = {
+  { "vector",                 bench_vector },
+  { "weld",                   bench_weld },
+  { "merge_edges",            bench_merge_edges },
+  { "separate",               bench_separate },
+  { "merge_faces",            bench_merge_faces },
+  { "reduce_edges",           bench_reduce_edges },
+  { "split_edges_to_borders", bench_split_edges },
+  { "clones",                 bench_clones },
+  { "real_print",             bench_real_print },
+  { "entity_print",           bench_entity_print }
+};
+
+/**
+ * \brief Точка входа программы микротестов
+ *
+ * \param [in] argc количество аргументов командной строки
+ * \param [in] argv массив аргументов командной строки
+ * \return код ошибки или 0 в случае успешного завершения.
+ */
+int main(int argc, char** argv) {
+
+  std::vector<size_t> sizes = { 4, 16, 32 };
+  unsigned repeat = 0;
+  std::vector<std::string> only;
+  bool scaling_mode = false;
+  std::vector<std::string> families;
+  unsigned steps = 4;
+  std::string dir;
+
+  arg_parser args;
+  const int err_parse = args.process_cmdline(const_cast<const char**>(argv), argc);
+  if (err_parse == -1 || err_parse == -3) {
+    std::cout << "Ошибка формата командной строки: первый аргумент '" << args.get_flag(0) << "' не является флагом" << std::endl;
+    return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+  }
+  for (size_t i = 0; err_parse != -2 && i < args.get_arg_num(); ++i) {
+    const std::vector<std::string>& parms = args.get_parameters_set(i);
+    if (args.get_flag(i).compare("sizes") == 0 && !parms.empty()) {
+      sizes.clear();
+      for (auto it = parms.cbegin(); it != parms.cend(); ++it) {
+        const long v = strtol((*it).c_str(), nullptr, 10);
+        if (v <= 0) {
+          std::cout << "Ошибка формата командной строки: неверный размер '" << *it << "'" << std::endl;
+          return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+        }
+        sizes.push_back(static_cast<size_t>(v));
+      }
+    }
+    else
+    if (args.get_flag(i).compare("repeat") == 0 && parms.size() == 1) {
+      const long v = strtol(parms.front().c_str(), nullptr, 10);
+      if (v <= 0) {
+        std::cout << "Ошибка формата командной строки: неверное количество повторений '" << parms.front() << "'" << std::endl;
+        return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+      }
+      repeat = static_cast<unsigned>(v);
+    }
+    else
+    if (args.get_flag(i).compare("only") == 0 && !parms.empty()) {
+      only = parms;
+    }
+    else
+    if (args.get_flag(i).compare("scaling") == 0) {
+      scaling_mode = true;
+      families = parms;
+    }
+    else
+    if (args.get_flag(i).compare("steps") == 0 && parms.size() == 1) {
+      const long v = strtol(parms.front().c_str(), nullptr, 10);
+      if (v < 2 || v > 16) {
+        std::cout << "Ошибка формата командной строки: неверное количество размеров '" << parms.front() << "'" << std::endl;
+        return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+      }
+      steps = static_cast<unsigned>(v);
+    }
+    else
+    if (args.get_flag(i).compare("dir") == 0 && parms.size() == 1) {
+      dir = parms.front();
+    }
+    else
+    if (args.get_flag(i).compare("gen") == 0 && parms.size() == 3) {
+      const long v = strtol(parms[1].c_str(), nullptr, 10);
+      std::vector<geometry::vector> faces;
+      if (v <= 0 || !mesh_gen::make(parms[0], static_cast<size_t>(v), faces)) {
+        std::cout << "Ошибка формата командной строки: неверное семейство или размер фигуры '" << parms[0] << " " << parms[1] << "'" << std::endl;
+        return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+      }
+      const err_enum_t err = mesh_gen::write_stl(parms[2], faces);
+      if (err == err_enum_t::ERROR_OK) std::cout << parms[2] << ": " << faces.size() / 4 << " треугольников" << std::endl;
+      return static_cast<int>(err);
+    }
+    else {
+      print_help();
+      return static_cast<int>(err_enum_t::ERROR_CMD_FORMAT);
+    }
+  }
+
+  if (scaling_mode) {
+    return static_cast<int>(scaling::run(families, steps, repeat == 0 ? 1 : repeat, dir));
+  }
+  if (repeat == 0) repeat = 5;
+
+  std::cout << cell("тест", 24, false) << cell("N", 6, true) << cell("элементов", 10, true) << " " <<
+    cell("", 8, false) << cell("нс/эл. мин.", 12, true) << cell("медиана", 12, true) << std::endl;
+
+  std::vector<geometry::vector> faces;
+  for (auto it_n = sizes.cbegin(); it_n != sizes.cend(); ++it_n) {
+    mesh_gen::make_boxes(*it_n, BENCH_BOXES, faces);
+    for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); ++t) {
+      if (!only.empty() && std::find(only.cbegin(), only.cend(), tests[t].name) == only.cend()) continue;
+      const err_enum_t err = tests[t].run(faces, *it_n, repeat);
+      if (err != err_enum_t::ERROR_OK) {
+        std::cout << "ERROR (" << tests[t].name << "): тест завершился с ошибкой " << static_cast<int>(err) << std::endl;
+        return static_cast<int>(err);
+      }
+    }
+  }
+  return static_cast<int>(err_enum_t::ERROR_OK);
+}
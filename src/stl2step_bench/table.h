@@ -0,0 +1,29 @@
+/**
+ * \file
+ *
+ * \brief Заголовочный файл с функциями вывода таблиц результатов тестов
+ */
+
+#ifndef _TABLE_H
+#define _TABLE_H
+
+#include <string>
+
+/**
+ * \brief Дополнить текст пробелами до ширины столбца таблицы (ширина считается в символах UTF-8).
+ *
+ * \param [in] text текст
+ * \param [in] width ширина столбца
+ * \param [in] right выравнивание по правому краю
+ * \return текст столбца
+ */
+inline std::string cell(const std::string& text, size_t width, bool right) {
+  size_t chars = 0;
+  for (auto it = text.cbegin(); it != text.cend(); ++it) {
+    if ((static_cast<unsigned char>(*it) & 0xC0) != 0x80) ++chars;
+  }
+  const std::string spaces(chars < width ? width - chars : 0, ' ');
+  return right ? spaces + text : text + spaces;
+}
+
+#endif /* _TABLE_H */